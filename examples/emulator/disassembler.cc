@@ -168,7 +168,9 @@ void Disassemble(const Memory& memory, Disassembler* disassembler, uint16_t entr
   std::deque<uint16_t> pending_queue;
 
   // Clear the instructions.
-  memset(disassembler->instructions, 0, sizeof(disassembler->instructions));
+  for (Instruction& instruction : disassembler->instructions) {
+    instruction = {};
+  }
 
   // Add always add the gameboy begin point. And then also add the |entry_point|.
   PushToQueue(&pending_queue, 0x100);
@@ -7,13 +7,18 @@
 
 #include "cpu_instructions.h"
 
+#include "rothko/memory/memory_tracker.h"
+
 namespace rothko {
 namespace emulator {
 
 struct Memory;
 
 struct Disassembler {
-  Instruction instructions[64*1024];
+  static constexpr size_t kInstructionCount = 64 * 1024;
+
+  TaggedVector<Instruction, MemoryTag::kEmulator> instructions =
+      TaggedVector<Instruction, MemoryTag::kEmulator>(kInstructionCount);
 };
 
 void Disassemble(const Memory&, Disassembler*, uint16_t entry_point = 0x100);
@@ -51,7 +51,7 @@ bool InitDisplay(Game* game, Display* out) {
   out->background.mag_filter = TextureFilterMode::kNearest;
 
   size_t size = sizeof(Color) * kTextureDim.width * kTextureDim.height;
-  out->background.data = std::make_unique<uint8_t[]>(size);
+  out->background.data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(size);
 
   if (!RendererStageTexture(game->renderer.get(), &out->background))
     return false;
@@ -11,17 +11,19 @@ bool Init(Renderer* renderer, QuadManager* quads, const QuadManagerConfig& confi
 
   quads->mesh.name = config.name;
   quads->mesh.vertex_type = VertexType::k3dUVColor;
+  quads->mesh.usage = MeshUsage::kDynamic;    // Rebuilt every frame.
 
   // Each quad entry is reflected into 4 vertices.
-  quads->mesh.vertices = std::vector<uint8_t>(4 * sizeof(Vertex3dUVColor) * config.capacity);
+  quads->mesh.vertices.resize(4 * sizeof(Vertex3dUVColor) * config.capacity);
   quads->mesh.vertex_count = 4 * config.capacity;
 
   LOG(App, "Mesh size: %zu", quads->mesh.vertices.size());
 
 
-  // Each quad is 6 vertices.
-  quads->mesh.indices.resize(6 * config.capacity);
-  /* quads->mesh.index_count = 6 * config.capacity; */
+  // Each quad is 6 indices.
+  quads->mesh.index_format = SelectIndexFormat(quads->mesh.vertex_count);
+  quads->mesh.indices.resize(6 * config.capacity * ToSize(quads->mesh.index_format));
+  quads->mesh.index_count = 6 * config.capacity;
 
   if (!RendererStageMesh(renderer, &quads->mesh))
     return false;
@@ -96,7 +98,7 @@ void Push(QuadManager* quads, const QuadEntry& entry) {
     render_mesh.shader = entry.shader;
     render_mesh.primitive_type = PrimitiveType::kTriangles;
     render_mesh.textures.push_back(entry.texture);
-    render_mesh.indices_offset = quads->index_offset;
+    render_mesh.indices_offset = quads->index_offset * ToSize(quads->mesh.index_format);
     render_mesh.indices_count = 6;
     render_mesh.ubo_data[0] = entry.vert_ubo;
     render_mesh.ubo_data[1] = entry.frag_ubo;
@@ -25,7 +25,7 @@ bool CreateTexture(Game* game, std::string name, Vec2 size, Texture* out) {
   out->mag_filter = TextureFilterMode::kNearest;
 
   size_t alloc_size = sizeof(Color) * size.x * size.y;
-  out->data = std::make_unique<uint8_t[]>(alloc_size);
+  out->data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(alloc_size);
 
   if (!RendererStageTexture(game->renderer.get(), out))
     return false;
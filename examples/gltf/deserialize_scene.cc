@@ -120,6 +120,7 @@ std::vector<Mesh> ExtractMeshes(const Header* header, const uint8_t* data) {
     printf("Mesh %u: Vertex Type %s: %u\n", i, ToString(vertex_type), mesh->vertex_type);
     printf("Mesh %u: Vertex Count: %u\n", i, mesh->vertex_count);
     printf("Mesh %u: Index Count: %u\n", i, mesh->index_count);
+    printf("Mesh %u: Index Format: %s\n", i, ToString((IndexFormat)mesh->index_format));
 
     char name[MeshHeader::kNameLength + 1] = {};
     memcpy(name, mesh->name, MeshHeader::kNameLength);
@@ -6,6 +6,7 @@
 #include <rothko/math/math.h>
 #include <rothko/memory/stack_allocator.h>
 #include <rothko/models/gltf/loader.h>
+#include <rothko/models/lod.h>
 #include <rothko/models/model.h>
 #include <rothko/scene/camera.h>
 #include <rothko/ui/imgui.h>
@@ -142,9 +143,10 @@ void ModelSelectionWindow(ModelContext* model_context) {
           auto& mesh = model->meshes[i];
           ImGui::Text("%s", mesh->name.c_str());
           ImGui::Text("Vertices: %u (%zu bytes)", mesh->vertex_count, mesh->vertices.size());
-          ImGui::Text("Indices: %zu (%zu bytes)",
-                      mesh->indices.size(),
-                      mesh->indices.size() / sizeof(Mesh::IndexType));
+          ImGui::Text("Indices: %u %s (%zu bytes)",
+                      mesh->index_count,
+                      ToString(mesh->index_format),
+                      mesh->indices.size());
 
           ImGui::PopID();
         }
@@ -209,7 +211,7 @@ std::vector<RenderCommand> CreateSelectedModelCommands(const ModelContext& model
       render_mesh.mesh = primitive.mesh;
       render_mesh.shader = model_shader;
       render_mesh.primitive_type = PrimitiveType::kTriangles;
-      render_mesh.indices_count = primitive.mesh->indices.size();
+      render_mesh.indices_count = primitive.mesh->index_count;
       SetWireframeMode(&render_mesh.flags);
 
       render_mesh.ubo_data[0] = (uint8_t*)model_transform;
@@ -229,11 +231,17 @@ std::vector<RenderCommand> CreateSelectedModelCommands(const ModelContext& model
 }
 
 std::vector<RenderCommand> CreateInstancesCommands(const PushCamera& camera,
+                                                   int viewport_height,
                                                    ModelContext* model_context,
                                                    const Shader* model_shader) {
   static auto stack_allocator = CreateStackAllocatorFor<ModelTransform>(1024);
   Reset(&stack_allocator);
 
+  LODSelection lod_selection = {};
+  lod_selection.camera_pos = camera.camera_pos;
+  lod_selection.projection = camera.projection;
+  lod_selection.viewport_height = viewport_height;
+
   std::vector<RenderCommand> commands;
   for (int instance_index = 0; instance_index < (int)model_context->instances.size();
        instance_index++) {
@@ -244,21 +252,26 @@ std::vector<RenderCommand> CreateInstancesCommands(const PushCamera& camera,
       Update(&instance.transform);
     }
 
-    for (auto& node : instance.model->nodes) {
+    SelectModelLODs(&instance, lod_selection);
+
+    for (uint32_t node_index = 0; node_index < instance.model->nodes.size(); node_index++) {
+      auto& node = instance.model->nodes[node_index];
       auto* model_transform = Allocate<ModelTransform>(&stack_allocator);
       model_transform->transform = instance.transform.world_matrix * node.transform.world_matrix;
       model_transform->inverse_transform = Transpose(Inverse(model_transform->transform));
 
-      for (const ModelPrimitive& primitive : node.primitives) {
+      for (uint32_t i = 0; i < kMaxPrimitivesPerModelNode; i++) {
+        const ModelPrimitive& primitive = node.primitives[i];
         if (!Valid(primitive))
           continue;
 
         // Render the mesh!
+        const Mesh* mesh = GetLODMesh(primitive, GetLOD(instance, node_index, i));
         RenderMesh render_mesh = {};
-        render_mesh.mesh = primitive.mesh;
+        render_mesh.mesh = mesh;
         render_mesh.shader = model_shader;
         render_mesh.primitive_type = PrimitiveType::kTriangles;
-        render_mesh.indices_count = primitive.mesh->indices.size();
+        render_mesh.indices_count = mesh->index_count;
 
         render_mesh.ubo_data[0] = (uint8_t*)model_transform;
         render_mesh.ubo_data[1] = (uint8_t*)&primitive.material->base_color;
@@ -314,7 +327,9 @@ int main(int argc, const char* argv[]) {
       continue;
 
     auto model = std::make_unique<Model>();
-    if (!gltf::LoadModel(dir_entry.path, model.get()))
+    gltf::LoadOptions load_options = {};
+    load_options.generate_lods = true;
+    if (!gltf::LoadModel(dir_entry.path, model.get(), load_options))
       return 1;
 
     /* if (!StageModel(game.renderer.get(), model.get())) */
@@ -402,8 +417,8 @@ int main(int argc, const char* argv[]) {
     commands.push_back(push_camera);
 
     PushCommands(&commands, CreateSelectedModelCommands(model_context, model_shader.get()));
-    PushCommands(&commands, CreateInstancesCommands(push_camera, &model_context,
-                                                    model_shader.get()));
+    PushCommands(&commands, CreateInstancesCommands(push_camera, game.window.screen_size.height,
+                                                    &model_context, model_shader.get()));
 
     commands.push_back(grid.render_command);
     if (!Stage(&lines, game.renderer.get()))
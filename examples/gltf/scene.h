@@ -78,11 +78,12 @@ struct MeshHeader {
   uint32_t vertex_type = 0;
   uint32_t vertex_count = 0;
   uint32_t index_count = 0;
+  uint32_t index_format = 0;    // IndexFormat. Indices are 2 or 4 bytes each.
 
   static constexpr uint32_t kNameLength = 64;
   char name[kNameLength] = {};
 };
-static_assert(sizeof(MeshHeader) == 92);
+static_assert(sizeof(MeshHeader) == 96);
 
 // Textures ----------------------------------------------------------------------------------------
 //
@@ -14,7 +14,7 @@ namespace gltf {
 
 namespace {
 
-constexpr uint32_t kVersion = 1;
+constexpr uint32_t kVersion = 2;  // 2: Mesh headers carry the index format.
 
 Header CreateMainHeader(const Scene& scene) {
   (void)scene;
@@ -64,7 +64,8 @@ MeshesCalculationResult CalculateMeshes(const Scene& scene) {
 
     mesh_header.vertex_type = (uint32_t)mesh->vertex_type;
     mesh_header.vertex_count = mesh->vertex_count;
-    mesh_header.index_count = mesh->indices.size();
+    mesh_header.index_count = mesh->index_count;
+    mesh_header.index_format = (uint32_t)mesh->index_format;
 
     printf("Vertex Type %s: %u.\n", ToString(mesh->vertex_type), (uint32_t)mesh->vertex_type);
     printf("Vertex count: %u.\n", mesh_header.vertex_count);
@@ -82,7 +83,7 @@ MeshesCalculationResult CalculateMeshes(const Scene& scene) {
     // Mark where the mesh data is going to be.
     mesh_header.data = data_offset;
     data_offset += mesh->vertices.size();
-    data_offset += mesh->indices.size() * sizeof(Mesh::IndexType);
+    data_offset += mesh->indices.size();
 
     mesh_headers.push_back(std::move(mesh_header));
   }
@@ -226,7 +227,7 @@ bool SerializeScene(const Scene& scene, const std::string& path) {
   // Actually write the data now.
   for (auto* mesh : meshes.meshes) {
     WriteToFile(&file, (void*)mesh->vertices.data(), mesh->vertices.size());
-    WriteToFile(&file, (void*)mesh->indices.data(), mesh->indices.size() * sizeof(Mesh::IndexType));
+    WriteToFile(&file, (void*)mesh->indices.data(), mesh->indices.size());
   }
 
   for (auto* texture : textures.textures) {
@@ -251,7 +252,7 @@ bool SerializeScene(const Scene& scene, const std::string& path) {
   /*   WriteToFile(&file, &mesh_header, sizeof(MeshHeader)); */
 
   /*   mesh_data_offset += meshes[i]->vertices.size(); */
-  /*   mesh_data_offset += meshes[i]->indices.size() * sizeof(Mesh::IndexType); */
+  /*   mesh_data_offset += meshes[i]->indices.size(); */
   /* } */
 
   return true;
@@ -23,7 +23,7 @@ RenderMesh GetCubeRenderCommand(Mesh* mesh, Shader* shader, SceneNode* node) {
   render_mesh.shader = shader;
   render_mesh.primitive_type = PrimitiveType::kTriangles;
   ClearCullFaces(&render_mesh.flags);
-  render_mesh.indices_count = mesh->indices.size();
+  render_mesh.indices_count = mesh->index_count;
   render_mesh.ubo_data[0] = (uint8_t*)&node->transform.world_matrix;
   /* render_mesh.textures.push_back(tex1); */
   /* render_mesh.textures.push_back(tex0); */
@@ -28,7 +28,7 @@ RenderMesh CreateRenderCommand(Mesh* mesh,
   render_mesh.mesh = mesh;
   render_mesh.shader = shader;
   render_mesh.primitive_type = PrimitiveType::kTriangles;
-  render_mesh.indices_count = mesh->indices.size();
+  render_mesh.indices_count = mesh->index_count;
 
   render_mesh.ubo_data[0] = (uint8_t*)&ubo.vert;
   render_mesh.ubo_data[1] = (uint8_t*)&ubo.frag;
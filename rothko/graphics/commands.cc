@@ -18,6 +18,11 @@ const char* ToString(RenderCommandType type) {
     case RenderCommandType::kPushCamera: return "Push Camera";
     case RenderCommandType::kPopCamera: return "Pop Camera";
     case RenderCommandType::kRenderMesh: return "Render Mesh";
+    case RenderCommandType::kPushRenderTarget: return "Push Render Target";
+    case RenderCommandType::kPopRenderTarget: return "Pop Render Target";
+    case RenderCommandType::kBlitRenderTarget: return "Blit Render Target";
+    case RenderCommandType::kReadback: return "Readback";
+    case RenderCommandType::kRenderInstanceSet: return "Render Instance Set";
     case RenderCommandType::kLast: return "<last>";
   }
 
@@ -87,6 +92,36 @@ std::string ToString(const PopCamera&) {
   return "Pop camera";
 }
 
+// Render Target -----------------------------------------------------------------------------------
+
+std::string ToString(const PushRenderTarget& push_render_target) {
+  const RenderTarget* target = push_render_target.target;
+  std::stringstream ss;
+  ss << "Target: " << target->name << ", Size: " << ToString(target->size)
+     << ", Render size: " << ToString(GetRenderSize(*target));
+  return ss.str();
+}
+
+std::string ToString(const PopRenderTarget&) {
+  return "Pop render target";
+}
+
+std::string ToString(const BlitRenderTarget& blit) {
+  std::stringstream ss;
+  ss << "Source: " << blit.source->name << ", Dest pos: " << ToString(blit.dest_pos)
+     << ", Dest size: " << ToString(blit.dest_size);
+  return ss.str();
+}
+
+// Readback ----------------------------------------------------------------------------------------
+
+std::string ToString(const Readback& readback) {
+  std::stringstream ss;
+  ss << "Source: " << (readback.source ? readback.source->name : "<current>")
+     << ", Pos: " << ToString(readback.pos) << ", Size: " << ToString(readback.size);
+  return ss.str();
+}
+
 // Render Mesh -------------------------------------------------------------------------------------
 
 std::string ToString(const RenderMesh& render_mesh) {
@@ -96,7 +131,9 @@ std::string ToString(const RenderMesh& render_mesh) {
      << std::endl;
 
   ss << "Indices= Offset: " << render_mesh.indices_offset
-     << ", Count: " << render_mesh.indices_count << std::endl;
+     << ", Count: " << render_mesh.indices_count
+     << ", Format: " << ToString(render_mesh.mesh->index_format)
+     << ", Base Vertex: " << render_mesh.base_vertex << std::endl;
 
   ss << std::hex;
   for (uint32_t i = 0; i < std::size(render_mesh.ubo_data); i++) {
@@ -126,6 +163,18 @@ std::string ToString(const RenderMesh& render_mesh) {
   return ss.str();
 };
 
+// Render Instance Set -----------------------------------------------------------------------------
+
+std::string ToString(const RenderInstanceSet& render) {
+  std::stringstream ss;
+  ss << "Instance set: " << render.instance_set->name
+     << ", Instances: " << render.instance_set->instances.size()
+     << ", Draws: " << render.instance_set->draws.size()
+     << ", Shader: " << render.shader->config.name
+     << ", Occlusion: " << (render.depth_pyramid ? "true" : "false");
+  return ss.str();
+}
+
 // Render Command ----------------------------------------------------------------------------------
 
 std::string ToString(const RenderCommand& command) {
@@ -134,6 +183,7 @@ std::string ToString(const RenderCommand& command) {
   switch (command.type()) {
     case RenderCommandType::kNop:
       ss << "Nop";
+      break;
     case RenderCommandType::kClearFrame:
       ss << ToString(command.GetClearFrame());
       break;
@@ -148,8 +198,25 @@ std::string ToString(const RenderCommand& command) {
       break;
     case RenderCommandType::kPushCamera:
       ss << ToString(command.GetPushCamera());
+      break;
     case RenderCommandType::kPopCamera:
       ss << ToString(command.GetPopCamera());
+      break;
+    case RenderCommandType::kPushRenderTarget:
+      ss << ToString(command.GetPushRenderTarget());
+      break;
+    case RenderCommandType::kPopRenderTarget:
+      ss << ToString(command.GetPopRenderTarget());
+      break;
+    case RenderCommandType::kBlitRenderTarget:
+      ss << ToString(command.GetBlitRenderTarget());
+      break;
+    case RenderCommandType::kReadback:
+      ss << ToString(command.GetReadback());
+      break;
+    case RenderCommandType::kRenderInstanceSet:
+      ss << ToString(command.GetRenderInstanceSet());
+      break;
     case RenderCommandType::kLast:
       break;
   }
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <functional>
 #include <variant>
 
 #include "rothko/containers/vector.h"
@@ -23,7 +24,10 @@ namespace rothko {
 // viewport).
 
 struct Camera;
+struct DepthPyramid;
+struct InstanceSet;
 struct Mesh;
+struct RenderTarget;
 struct Shader;
 struct Texture;
 
@@ -37,6 +41,11 @@ enum class RenderCommandType {
   kRenderMesh,
   kPushCamera,
   kPopCamera,
+  kPushRenderTarget,
+  kPopRenderTarget,
+  kBlitRenderTarget,
+  kReadback,
+  kRenderInstanceSet,
   kLast,
 };
 const char* ToString(RenderCommandType);
@@ -109,6 +118,66 @@ struct PopCamera {
 };
 std::string ToString(const PopCamera&);
 
+// Render Target -----------------------------------------------------------------------------------
+
+// Renders into |target| (see render_target.h) until the matching |PopRenderTarget|. The viewport is
+// set to the render size of the target, and restored when popping.
+// |kMaxRenderTargetCount| establishes how many targets can be pushed at the same time.
+constexpr int kMaxRenderTargetCount = 4;
+
+struct PushRenderTarget {
+  static constexpr RenderCommandType kType = RenderCommandType::kPushRenderTarget;
+
+  RenderTarget* target = nullptr;
+};
+std::string ToString(const PushRenderTarget&);
+
+// Multisampled targets get resolved here, so pop before sampling them.
+struct PopRenderTarget {
+  static constexpr RenderCommandType kType = RenderCommandType::kPopRenderTarget;
+};
+std::string ToString(const PopRenderTarget&);
+
+// Copies the rendered region of |source| into the current framebuffer (a target or the window),
+// scaling it with the filter of |source|. Used to upscale dynamic resolution passes.
+struct BlitRenderTarget {
+  static constexpr RenderCommandType kType = RenderCommandType::kBlitRenderTarget;
+
+  const RenderTarget* source = nullptr;
+
+  // Zero size means the whole current viewport.
+  Int2 dest_pos = {};
+  Int2 dest_size = {};
+};
+std::string ToString(const BlitRenderTarget&);
+
+// Readback ----------------------------------------------------------------------------------------
+
+// Pixels delivered by a |Readback| command. RGBA8, rows from bottom to top.
+struct ReadbackResult {
+  Int2 pos = {};
+  Int2 size = {};
+  const uint8_t* data = nullptr;   // Only valid during the callback.
+};
+
+// Copies a region of |source| (or the current framebuffer if null) into a buffer, without waiting
+// for the GPU to render it. |callback| gets called once the pixels are there, which is some frames
+// later (checked on |RendererEndFrame|), or on |RendererFlushReadbacks|.
+//
+// Multisampled targets can only be read once popped (they get resolved then).
+struct Readback {
+  static constexpr RenderCommandType kType = RenderCommandType::kReadback;
+
+  const RenderTarget* source = nullptr;
+
+  // Zero size means the whole current viewport (or the render size of |source|).
+  Int2 pos = {};
+  Int2 size = {};
+
+  std::function<void(const ReadbackResult&)> callback;
+};
+std::string ToString(const Readback&);
+
 // RenderMesh --------------------------------------------------------------------------------------
 
 namespace lines {
@@ -121,8 +190,13 @@ inline uint64_t SetLineWidth(uint64_t ctx, int width) { return ctx & (width | ~(
 namespace line_strip {
 
 // Value to use for reseting the indices lookup (basically glPrimitiveRestartIndex).
+// 16-bit meshes see it narrowed (0xfffe), see |GetPrimitiveReset|.
 constexpr Mesh::IndexType kPrimitiveReset = (Mesh::IndexType)-2;
 
+inline uint32_t GetPrimitiveReset(IndexFormat format) {
+  return format == IndexFormat::kUint16 ? (uint16_t)kPrimitiveReset : kPrimitiveReset;
+}
+
 inline uint32_t GetRestartIndex(uint64_t ctx) { return (uint32_t)(ctx & (uint32_t)-1); }
 inline uint64_t SetRestartIndex(uint64_t ctx, uint32_t i) {
   uint64_t mask = (i | ~(uint64_t)(uint32_t)-1);
@@ -155,8 +229,9 @@ struct RenderMesh {
   Int2 scissor_pos = {};
   Int2 scissor_size = {};
 
-  uint32_t indices_offset = 0;
+  uint32_t indices_offset = 0;   // In bytes.
   uint32_t indices_count = 0;
+  uint32_t base_vertex = 0;      // Added to each index before fetching the vertex.
 
   // The size of the UBO is given by the description of the corresponding shader.
   // It is the responsability of the caller that these buffers match.
@@ -166,6 +241,31 @@ struct RenderMesh {
 };
 std::string ToString(const RenderMesh&);
 
+// RenderInstanceSet -------------------------------------------------------------------------------
+
+// Culls the instances of |instance_set| on the GPU and draws the visible ones (see instance_set.h).
+// The draw state works as in |RenderMesh|.
+struct RenderInstanceSet {
+  static constexpr RenderCommandType kType = RenderCommandType::kRenderInstanceSet;
+
+  const InstanceSet* instance_set = nullptr;
+  const Shader* shader = nullptr;
+
+  PrimitiveType primitive_type = PrimitiveType::kTriangles;
+  uint32_t flags = kCullFaces | kDepthMask | kDepthTest;
+
+  uint8_t* ubo_data[kMaxUBOs] = {};
+  PerFrameVector<Texture*> textures;
+
+  // Normally the projection * view of the camera. Instances outside of its frustum are culled.
+  Mat4 cull_view_projection = Mat4::Identity();
+
+  // If set, instances hidden behind its depth are culled too. Must have been created with
+  // |cull_view_projection|. Only read while executing the command.
+  const DepthPyramid* depth_pyramid = nullptr;
+};
+std::string ToString(const RenderInstanceSet&);
+
 // Render Command ----------------------------------------------------------------------------------
 
 #define GENERATE_COMMAND(Command, getter)                                  \
@@ -192,10 +292,17 @@ struct RenderCommand {
   GENERATE_COMMAND(PushCamera, is_push_camera);
   GENERATE_COMMAND(PopCamera, is_pop_camera);
   GENERATE_COMMAND(RenderMesh, is_render_mesh);
+  GENERATE_COMMAND(PushRenderTarget, is_push_render_target);
+  GENERATE_COMMAND(PopRenderTarget, is_pop_render_target);
+  GENERATE_COMMAND(BlitRenderTarget, is_blit_render_target);
+  GENERATE_COMMAND(Readback, is_readback);
+  GENERATE_COMMAND(RenderInstanceSet, is_render_instance_set);
 
  private:
   RenderCommandType type_ = RenderCommandType::kLast;
-  std::variant<Nop, ClearFrame, PushConfig, PopConfig, PushCamera, PopCamera, RenderMesh> data_;
+  std::variant<Nop, ClearFrame, PushConfig, PopConfig, PushCamera, PopCamera, RenderMesh,
+               PushRenderTarget, PopRenderTarget, BlitRenderTarget, Readback,
+               RenderInstanceSet> data_;
 
   template <typename T>
   void SetRenderCommand(T t) {
@@ -0,0 +1,45 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/cpu_data.h"
+
+#include <atomic>
+
+#include "rothko/logging/logging.h"
+
+namespace rothko {
+
+namespace {
+
+std::atomic<CPUDataPolicy> gDefaultPolicy = CPUDataPolicy::kKeep;
+
+}  // namespace
+
+const char* ToString(CPUDataPolicy policy) {
+  switch (policy) {
+    case CPUDataPolicy::kDefault: return "Default";
+    case CPUDataPolicy::kKeep: return "Keep";
+    case CPUDataPolicy::kDiscard: return "Discard";
+    case CPUDataPolicy::kReload: return "Reload";
+    case CPUDataPolicy::kLast: return "Last";
+  }
+
+  NOT_REACHED();
+  return nullptr;
+}
+
+CPUDataPolicy GetDefaultCPUDataPolicy() { return gDefaultPolicy; }
+
+void SetDefaultCPUDataPolicy(CPUDataPolicy policy) {
+  ASSERT_MSG(policy != CPUDataPolicy::kDefault && policy != CPUDataPolicy::kLast,
+             "Invalid default policy: %s", ToString(policy));
+  gDefaultPolicy = policy;
+}
+
+CPUDataPolicy Resolve(CPUDataPolicy policy) {
+  if (policy == CPUDataPolicy::kDefault)
+    return gDefaultPolicy;
+  return policy;
+}
+
+}  // namespace rothko
@@ -0,0 +1,31 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace rothko {
+
+// CPU Data Policy ---------------------------------------------------------------------------------
+//
+// Once a resource (mesh, texture) is staged, the GPU holds its own copy of the data. The policy
+// says what happens to the CPU copy afterwards. Keeping it means every asset is resident twice.
+
+enum class CPUDataPolicy : uint8_t {
+  kDefault,   // Use the global default (see |SetDefaultCPUDataPolicy|).
+  kKeep,      // Keep it. Needed for re-uploading it or reading it from the CPU.
+  kDiscard,   // Free it after staging.
+  kReload,    // Free it after staging. It can be reloaded from its source on demand.
+  kLast,
+};
+const char* ToString(CPUDataPolicy);
+
+// The global default starts as |kKeep|.
+CPUDataPolicy GetDefaultCPUDataPolicy();
+void SetDefaultCPUDataPolicy(CPUDataPolicy);
+
+// Returns the global default for |kDefault|.
+CPUDataPolicy Resolve(CPUDataPolicy);
+
+}  // namespace rothko
@@ -119,6 +119,48 @@ std::unique_ptr<Shader> Vertex3dNormalTangentUVShader(Renderer* renderer) {
 
 }  // namespace
 
+// VertexQuantized3dNormalTangentUV ----------------------------------------------------------------
+
+namespace {
+
+constexpr char kVertexQuantized3dNormalTangentUVVertexShader[] = R"(
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec2 in_normal;
+layout (location = 2) in vec4 in_tangent;
+layout (location = 3) in vec2 in_uv;
+
+out vec2 f_uv;
+out vec4 f_color;
+
+layout (std140) uniform Uniforms {
+  mat4 model;
+};
+
+void main() {
+  gl_Position = camera_proj * camera_view * model * vec4(DequantizePos(in_pos), 1.0);
+
+  f_uv = DequantizeUV(in_uv);
+  f_color = vec4(OctDecode(in_normal), 1);
+}
+)";
+
+std::unique_ptr<Shader> VertexQuantized3dNormalTangentUVShader(Renderer* renderer) {
+  ShaderConfig config;
+  config.name = "Quantized3dNormalTangentUV-default";
+  config.vertex_type = VertexType::kQuantized3dNormalTangentUV;
+  config.ubos[0].name = "Uniforms";
+  config.ubos[0].size = sizeof(Mat4);
+  config.texture_count = 2;
+
+  // Same fragment stage as the non-quantized version.
+  auto vert_src = CreateVertexSource(kVertexQuantized3dNormalTangentUVVertexShader);
+  auto frag_src = CreateFragmentSource(kVertex3dNormalTangentUVFragmentShader);
+
+  return RendererStageShader(renderer, config, vert_src, frag_src);
+}
+
+}  // namespace
+
 // GetDefaultShader --------------------------------------------------------------------------------
 
 std::unique_ptr<Shader> CreateDefaultShader(Renderer* renderer, VertexType vertex_type) {
@@ -131,6 +173,9 @@ std::unique_ptr<Shader> CreateDefaultShader(Renderer* renderer, VertexType verte
     case VertexType::k3dUV: return {};
     case VertexType::k3dUVColor: return Vertex3dUVColorShader(renderer);
     case VertexType::k3dNormalTangentUV: return Vertex3dNormalTangentUVShader(renderer);
+    case VertexType::kQuantized3dNormalUV: return {};
+    case VertexType::kQuantized3dNormalTangentUV:
+      return VertexQuantized3dNormalTangentUVShader(renderer);
     case VertexType::kLast: return {};
   }
 
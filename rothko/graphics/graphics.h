@@ -6,9 +6,16 @@
 // Proxy header to include all the common graphics functionality.
 #include "rothko/graphics/color.h"
 #include "rothko/graphics/commands.h"
+#include "rothko/graphics/cpu_data.h"
 #include "rothko/graphics/definitions.h"
+#include "rothko/graphics/instance_set.h"
 #include "rothko/graphics/material.h"
 #include "rothko/graphics/mesh.h"
+#include "rothko/graphics/render_target.h"
 #include "rothko/graphics/renderer.h"
 #include "rothko/graphics/shader.h"
+#include "rothko/graphics/shader_permutations.h"
 #include "rothko/graphics/texture.h"
+#include "rothko/graphics/texture_atlas.h"
+#include "rothko/graphics/texture_compression.h"
+#include "rothko/graphics/texture_mipmaps.h"
@@ -0,0 +1,73 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/instance_set.h"
+
+#include <math.h>
+
+#include "rothko/graphics/renderer.h"
+
+namespace rothko {
+
+InstanceSet::~InstanceSet() {
+  if (Staged(*this))
+    RendererUnstageInstanceSet(this->renderer, this);
+}
+
+uint32_t GetDepthPyramidLength(Int2 size, uint32_t level_count) {
+  uint32_t length = 0;
+  for (uint32_t i = 0; i < level_count; i++) {
+    length += size.x * size.y;
+    size = {Max((size.x + 1) / 2, 1), Max((size.y + 1) / 2, 1)};
+  }
+  return length;
+}
+
+// Frustum -----------------------------------------------------------------------------------------
+
+Frustum GetFrustum(const Mat4& m) {
+  // Each clip plane is the last row plus/minus one of the others (Gribb & Hartmann).
+  Vec4 r0 = m.row(0), r1 = m.row(1), r2 = m.row(2), r3 = m.row(3);
+
+  Frustum frustum;
+  frustum.planes[0] = r3 + r0;  // Left.
+  frustum.planes[1] = r3 - r0;  // Right.
+  frustum.planes[2] = r3 + r1;  // Bottom.
+  frustum.planes[3] = r3 - r1;  // Top.
+  frustum.planes[4] = r3 + r2;  // Near.
+  frustum.planes[5] = r3 - r2;  // Far.
+
+  for (Vec4& plane : frustum.planes) {
+    float length = Length(ToVec3(plane));
+    if (length > 0)
+      plane = plane * (1.0f / length);
+  }
+
+  return frustum;
+}
+
+bool IsInFrustum(const Frustum& frustum, const Vec3& bounds_min, const Vec3& bounds_max,
+                 const Mat4& transform) {
+  // Transform the box into a world space one that contains it.
+  Vec3 center = ToVec3(transform * ((bounds_min + bounds_max) * 0.5f));
+  Vec3 extent = (bounds_max - bounds_min) * 0.5f;
+  Vec3 world_extent = {};
+  for (int i = 0; i < 3; i++) {
+    world_extent.elements[i] = fabsf(transform.cols[0].elements[i]) * extent.x +
+                               fabsf(transform.cols[1].elements[i]) * extent.y +
+                               fabsf(transform.cols[2].elements[i]) * extent.z;
+  }
+
+  for (const Vec4& plane : frustum.planes) {
+    Vec3 normal = ToVec3(plane);
+    float distance = Dot(normal, center) + plane.w;
+    float radius = fabsf(normal.x) * world_extent.x + fabsf(normal.y) * world_extent.y +
+                   fabsf(normal.z) * world_extent.z;
+    if (distance < -radius)
+      return false;
+  }
+
+  return true;
+}
+
+}  // namespace rothko
@@ -0,0 +1,100 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "rothko/math/math.h"
+#include "rothko/memory/memory_tracker.h"
+#include "rothko/utils/clear_on_move.h"
+#include "rothko/utils/macros.h"
+
+namespace rothko {
+
+struct Mesh;
+struct Renderer;
+
+// Instance Set ------------------------------------------------------------------------------------
+//
+// A big set of instances (eg. vegetation) that is culled on the GPU. The instances live in GPU
+// buffers, so each frame only costs a compute dispatch that tests every instance against the view
+// frustum (and optionally a |DepthPyramid|), followed by a single glMultiDrawElementsIndirect with
+// the ones that survived. Nothing about the instances goes through the CPU after staging.
+//
+// Each instance selects one entry of |draws| (a mesh range) with |draw_index|. All the meshes in
+// |draws| must be drawable with the same VAO: either the same mesh or shared meshes
+// (MeshUsage::kShared) of the same vertex type and index format.
+//
+// Drawn with the |RenderInstanceSet| command. The shader must be created with
+// |kInstanceSetVertexHeader| and |kInstanceSetFragmentHeader| (see shader.h).
+//
+// Needs the same support as multi-draw shaders (GL 4.3 + GL_ARB_shader_draw_parameters). Staging
+// fails otherwise.
+
+// Layout matches the std430 storage block the shaders read, so it can be uploaded as is.
+struct CullInstance {
+  Mat4 transform;
+  Vec3 bounds_min;            // |bounds_min| and |bounds_max| are in local space.
+  uint32_t draw_index = 0;    // Into |InstanceSet::draws|.
+  Vec3 bounds_max;
+  uint32_t padding = 0;
+};
+static_assert(sizeof(CullInstance) == 96);
+
+struct InstanceDraw {
+  const Mesh* mesh = nullptr;   // Must be staged before the instance set.
+
+  // Same meaning as in |RenderMesh|. Zero count means all the indices of |mesh|.
+  uint32_t indices_offset = 0;  // In bytes.
+  uint32_t indices_count = 0;
+  uint32_t base_vertex = 0;
+};
+
+struct InstanceSet {
+  RAII_CONSTRUCTORS(InstanceSet);
+
+  Renderer* renderer = nullptr;
+  ClearOnMove<uint32_t> uuid = 0;
+
+  std::string name;
+
+  std::vector<InstanceDraw> draws;
+  TaggedVector<CullInstance, MemoryTag::kGraphics> instances;
+};
+
+inline bool Staged(const InstanceSet& set) { return set.renderer && set.uuid.has_value(); }
+
+// Depth Pyramid -----------------------------------------------------------------------------------
+//
+// Optional occlusion information for |RenderInstanceSet|. Each level is half the size of the
+// previous one (rounded up) down to 1x1, holding the farthest depth ([0, 1]) of the texels it
+// covers, like the one built by |OcclusionCuller| (rothko/scene/occlusion.h).
+
+struct DepthPyramid {
+  Int2 size = {};               // Of the first level.
+  uint32_t level_count = 0;
+  const float* data = nullptr;  // All the levels back to back, rows from bottom to top.
+};
+
+uint32_t GetDepthPyramidLength(Int2 size, uint32_t level_count);
+
+// Frustum -----------------------------------------------------------------------------------------
+//
+// The same test the culling compute shader does, so it can be used (and tested) on the CPU.
+
+struct Frustum {
+  Vec4 planes[6];   // xyz = normal (pointing inside), w = distance. Normalized.
+};
+
+// OpenGL clip space (-w <= z <= w).
+Frustum GetFrustum(const Mat4& view_projection);
+
+// |bounds| are in the space defined by |transform|.
+bool IsInFrustum(const Frustum&, const Vec3& bounds_min, const Vec3& bounds_max,
+                 const Mat4& transform);
+
+}  // namespace rothko
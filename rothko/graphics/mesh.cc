@@ -3,6 +3,7 @@
 
 #include "rothko/graphics/mesh.h"
 
+#include "rothko/graphics/commands.h"
 #include "rothko/graphics/renderer.h"
 #include "rothko/logging/logging.h"
 
@@ -14,7 +15,7 @@ Mesh::~Mesh() {
 }
 
 bool StageWithCapacity(Renderer* renderer, Mesh* mesh, VertexType vertex_type,
-                       uint32_t vertex_count, uint32_t index_count) {
+                       uint32_t vertex_count, uint32_t index_count, IndexFormat index_format) {
   ASSERT(!Staged(*mesh));
   ASSERT(vertex_count > 0);
   ASSERT(index_count > 0);
@@ -23,7 +24,10 @@ bool StageWithCapacity(Renderer* renderer, Mesh* mesh, VertexType vertex_type,
   mesh->vertex_type = vertex_type;
   mesh->vertices.resize(ToSize(vertex_type) * vertex_count);
 
-  mesh->indices.resize(index_count);
+  if (index_format == IndexFormat::kLast)
+    index_format = SelectIndexFormat(vertex_count);
+  mesh->index_format = index_format;
+  mesh->indices.resize(ToSize(index_format) * index_count);
 
   bool staged = RendererStageMesh(renderer, mesh);
   if (!staged)
@@ -36,4 +40,277 @@ bool StageWithCapacity(Renderer* renderer, Mesh* mesh, VertexType vertex_type,
   return true;
 }
 
+// Index Format ------------------------------------------------------------------------------------
+
+const char* ToString(IndexFormat format) {
+  switch (format) {
+    case IndexFormat::kUint16: return "Uint16";
+    case IndexFormat::kUint32: return "Uint32";
+    case IndexFormat::kLast: return "Last";
+  }
+
+  NOT_REACHED();
+  return nullptr;
+}
+
+uint32_t ToSize(IndexFormat format) {
+  switch (format) {
+    case IndexFormat::kUint16: return sizeof(uint16_t);
+    case IndexFormat::kUint32: return sizeof(uint32_t);
+    case IndexFormat::kLast: break;
+  }
+
+  NOT_REACHED();
+  return 0;
+}
+
+void ApplyCPUDataPolicy(Mesh* mesh) {
+  CPUDataPolicy policy = Resolve(mesh->cpu_data_policy);
+  if (policy == CPUDataPolicy::kKeep)
+    return;
+
+  ASSERT_MSG(policy != CPUDataPolicy::kReload || mesh->reload_cpu_data,
+             "Mesh %s: Reload policy without a way to reload.", mesh->name.c_str());
+
+  // Swap with empty buffers so that the memory is actually returned.
+  Mesh::VertexBuffer().swap(mesh->vertices);
+  Mesh::IndexBuffer().swap(mesh->indices);
+}
+
+bool EnsureCPUData(Mesh* mesh) {
+  if (HasCPUData(*mesh) || (mesh->vertex_count == 0 && mesh->index_count == 0))
+    return true;
+
+  if (!mesh->reload_cpu_data) {
+    ERROR(Graphics, "Mesh %s: CPU data was discarded (policy %s).", mesh->name.c_str(),
+          ToString(Resolve(mesh->cpu_data_policy)));
+    return false;
+  }
+
+  if (!mesh->reload_cpu_data(mesh)) {
+    ERROR(Graphics, "Mesh %s: Could not reload CPU data.", mesh->name.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+const char* ToString(MeshUsage usage) {
+  switch (usage) {
+    case MeshUsage::kStatic: return "Static";
+    case MeshUsage::kShared: return "Shared";
+    case MeshUsage::kDynamic: return "Dynamic";
+    case MeshUsage::kLast: return "Last";
+  }
+
+  NOT_REACHED();
+  return nullptr;
+}
+
+void SetIndexFormat(Mesh* mesh, IndexFormat format) {
+  ASSERT_MSG(!Staged(*mesh), "Mesh %s: Cannot change the index format of a staged mesh",
+             mesh->name.c_str());
+  if (mesh->index_format == format)
+    return;
+
+  Mesh::IndexBuffer indices;
+  indices.resize(mesh->index_count * ToSize(format));
+  CopyIndicesWithOffset(format, indices.data(), mesh->index_format, mesh->indices.data(),
+                        mesh->index_count, 0);
+
+  // Widened restart indices have to become the 32-bit restart index.
+  if (format == IndexFormat::kUint32) {
+    uint32_t reset16 = line_strip::GetPrimitiveReset(IndexFormat::kUint16);
+    uint32_t* ptr = (uint32_t*)indices.data();
+    for (uint32_t i = 0; i < mesh->index_count; i++) {
+      if (ptr[i] == reset16)
+        ptr[i] = line_strip::kPrimitiveReset;
+    }
+  }
+
+  mesh->indices = std::move(indices);
+  mesh->index_format = format;
+}
+
+// Quantization ------------------------------------------------------------------------------------
+
+namespace {
+
+template <typename VertexType>
+VertexDequantization CalculateDequantization(const VertexType* vertices, uint32_t count) {
+  Vec3 pos_min = vertices[0].pos;
+  Vec3 pos_max = vertices[0].pos;
+  Vec2 uv_min = vertices[0].uv;
+  Vec2 uv_max = vertices[0].uv;
+  for (uint32_t i = 1; i < count; i++) {
+    pos_min = Min(pos_min, vertices[i].pos);
+    pos_max = Max(pos_max, vertices[i].pos);
+    uv_min = Min(uv_min, vertices[i].uv);
+    uv_max = Max(uv_max, vertices[i].uv);
+  }
+
+  // Avoid dividing by zero on flat meshes.
+  Vec3 pos_scale = pos_max - pos_min;
+  Vec2 uv_scale = uv_max - uv_min;
+  for (float& v : pos_scale.elements) {
+    if (v == 0.0f)
+      v = 1.0f;
+  }
+  for (float& v : uv_scale.elements) {
+    if (v == 0.0f)
+      v = 1.0f;
+  }
+
+  VertexDequantization dequantization = {};
+  dequantization.pos_offset = pos_min;
+  dequantization.pos_scale = pos_scale;
+  dequantization.uv_offset = uv_min;
+  dequantization.uv_scale = uv_scale;
+  return dequantization;
+}
+
+template <typename Src, typename Dst>
+void QuantizeCommon(const VertexDequantization& dq, const Src& src, Dst* dst) {
+  for (int i = 0; i < 3; i++) {
+    float normalized = (src.pos.elements[i] - dq.pos_offset.elements[i]) / dq.pos_scale.elements[i];
+    dst->pos[i] = QuantizeUnorm16(normalized);
+  }
+  dst->pos[3] = 0;
+
+  Vec2 oct = OctEncode(src.normal);
+  dst->normal[0] = QuantizeSnorm16(oct.x);
+  dst->normal[1] = QuantizeSnorm16(oct.y);
+
+  for (int i = 0; i < 2; i++) {
+    float normalized = (src.uv.elements[i] - dq.uv_offset.elements[i]) / dq.uv_scale.elements[i];
+    dst->uv[i] = QuantizeUnorm16(normalized);
+  }
+}
+
+template <typename Src, typename Dst>
+void QuantizeVerticesAs(Mesh* mesh) {
+  const Src* src = (const Src*)mesh->vertices.data();
+  VertexDequantization dq = CalculateDequantization(src, mesh->vertex_count);
+
+  Mesh::VertexBuffer vertices;
+  vertices.resize(mesh->vertex_count * sizeof(Dst));
+  Dst* dst = (Dst*)vertices.data();
+
+  for (uint32_t i = 0; i < mesh->vertex_count; i++) {
+    QuantizeCommon(dq, src[i], dst + i);
+    if constexpr (Dst::kVertexType == VertexType::kQuantized3dNormalTangentUV) {
+      for (int j = 0; j < 4; j++) {
+        dst[i].tangent[j] = QuantizeSnorm8(src[i].tangent.elements[j]);
+      }
+    }
+  }
+
+  mesh->vertices = std::move(vertices);
+  mesh->vertex_type = Dst::kVertexType;
+  mesh->dequantization = dq;
+}
+
+}  // namespace
+
+bool QuantizeVertices(Mesh* mesh) {
+  ASSERT_MSG(!Staged(*mesh), "Mesh %s: Cannot quantize a staged mesh", mesh->name.c_str());
+  if (mesh->vertex_count == 0)
+    return false;
+
+  switch (mesh->vertex_type) {
+    case VertexType::k3dNormalUV:
+      QuantizeVerticesAs<Vertex3dNormalUV, VertexQuantized3dNormalUV>(mesh);
+      return true;
+    case VertexType::k3dNormalTangentUV:
+      QuantizeVerticesAs<Vertex3dNormalTangentUV, VertexQuantized3dNormalTangentUV>(mesh);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Positions ---------------------------------------------------------------------------------------
+
+bool GetVertexPositions(const Mesh& mesh, std::vector<Vec3>* out) {
+  out->clear();
+  if (mesh.vertices.size() < (size_t)mesh.vertex_count * ToSize(mesh.vertex_type))
+    return false;
+
+  VertexLayout layout = GetVertexLayout(mesh.vertex_type);
+  for (uint32_t i = 0; i < layout.count; i++) {
+    const VertexAttribute& attribute = layout.attributes[i];
+    const uint8_t* ptr = mesh.vertices.data() + attribute.offset;
+
+    if (attribute.component == VertComponent::kPos3d) {
+      out->resize(mesh.vertex_count);
+      for (uint32_t v = 0; v < mesh.vertex_count; v++, ptr += layout.stride) {
+        memcpy(&(*out)[v], ptr, sizeof(Vec3));
+      }
+      return true;
+    }
+
+    if (attribute.component == VertComponent::kPos3d_short) {
+      const VertexDequantization& dq = mesh.dequantization;
+      out->resize(mesh.vertex_count);
+      for (uint32_t v = 0; v < mesh.vertex_count; v++, ptr += layout.stride) {
+        uint16_t pos[3];
+        memcpy(pos, ptr, sizeof(pos));
+        for (int j = 0; j < 3; j++) {
+          (*out)[v].elements[j] = dq.pos_offset.elements[j] +
+                                  DequantizeUnorm16(pos[j]) * dq.pos_scale.elements[j];
+        }
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Builder -----------------------------------------------------------------------------------------
+
+void Reserve(Mesh* mesh, uint32_t vertex_count, uint32_t index_count) {
+  if (!Staged(*mesh) && mesh->index_count == 0)
+    mesh->index_format = SelectIndexFormat(mesh->vertex_count + vertex_count);
+
+  internal::GrowCapacity(&mesh->vertices,
+                         mesh->vertices.size() + vertex_count * ToSize(mesh->vertex_type));
+  internal::GrowCapacity(&mesh->indices,
+                         mesh->indices.size() + index_count * ToSize(mesh->index_format));
+}
+
+namespace {
+
+// No aliasing and no branches in the body: this gets turned into SIMD adds/packs.
+template <typename Dst, typename Src>
+void CopyIndices(Dst* __restrict dst, const Src* __restrict src, uint32_t count,
+                 Mesh::IndexType offset) {
+  for (uint32_t i = 0; i < count; i++) {
+    dst[i] = (Dst)(src[i] + offset);
+  }
+}
+
+}  // namespace
+
+void CopyIndicesWithOffset(IndexFormat dst_format, void* dst,
+                           IndexFormat src_format, const void* src,
+                           uint32_t count, Mesh::IndexType offset) {
+  if (dst_format == src_format && offset == 0) {
+    memcpy(dst, src, count * ToSize(dst_format));
+    return;
+  }
+
+  bool dst16 = dst_format == IndexFormat::kUint16;
+  bool src16 = src_format == IndexFormat::kUint16;
+  if (dst16 && src16) {
+    CopyIndices((uint16_t*)dst, (const uint16_t*)src, count, offset);
+  } else if (dst16) {
+    CopyIndices((uint16_t*)dst, (const uint32_t*)src, count, offset);
+  } else if (src16) {
+    CopyIndices((uint32_t*)dst, (const uint16_t*)src, count, offset);
+  } else {
+    CopyIndices((uint32_t*)dst, (const uint32_t*)src, count, offset);
+  }
+}
+
 }  // namespace rothko
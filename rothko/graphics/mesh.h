@@ -4,11 +4,15 @@
 #pragma once
 
 #include <stdint.h>
+#include <string.h>
 
+#include <functional>
 #include <vector>
 
+#include "rothko/graphics/cpu_data.h"
 #include "rothko/graphics/vertices.h"
 #include "rothko/math/math.h"
+#include "rothko/memory/memory_tracker.h"
 #include "rothko/utils/clear_on_move.h"
 #include "rothko/logging/logging.h"
 #include "rothko/utils/macros.h"
@@ -17,10 +21,47 @@ namespace rothko {
 
 struct Renderer;
 
+// Index Format ------------------------------------------------------------------------------------
+
+// Indices are stored either as 16 or 32 bit values. Most meshes have less than 64k vertices, so
+// they can use half the memory and bandwidth for their indices.
+enum class IndexFormat : uint8_t {
+  kUint16,
+  kUint32,
+  kLast,
+};
+const char* ToString(IndexFormat);
+uint32_t ToSize(IndexFormat);
+
+// The top two values of each format are reserved (primitive restart, see commands.h), so a 16-bit
+// mesh can have at most this many vertices.
+constexpr uint32_t kMax16BitVertexCount = 0xfffe;
+
+inline IndexFormat SelectIndexFormat(uint32_t vertex_count) {
+  return vertex_count <= kMax16BitVertexCount ? IndexFormat::kUint16 : IndexFormat::kUint32;
+}
+
+// Mesh Usage --------------------------------------------------------------------------------------
+
+// How the renderer stores the mesh in the GPU. Must be set before staging.
+enum class MeshUsage : uint8_t {
+  kStatic,  // The mesh gets its own buffers.
+  kShared,  // Sub-allocated from big buffers shared by all meshes with the same vertex type and
+            // index format, so drawing them one after the other doesn't require re-binding.
+  kDynamic, // Re-uploaded every frame (or more). Each upload goes into the next copy of a ring of
+            // buffers, so it never waits for the GPU to finish drawing the previous ones.
+            // Only the range given on the last upload is valid (see |RendererUploadMeshRange|).
+  kLast,
+};
+const char* ToString(MeshUsage);
+
 // Mesh --------------------------------------------------------------------------------------------
 
 struct Mesh {
+  // Indices are always given as 32-bit values and narrowed when the mesh uses 16-bit indices.
   using IndexType = uint32_t;
+  using VertexBuffer = TaggedVector<uint8_t, MemoryTag::kGraphics>;
+  using IndexBuffer = TaggedVector<uint8_t, MemoryTag::kGraphics>;
 
   RAII_CONSTRUCTORS(Mesh);
 
@@ -30,14 +71,29 @@ struct Mesh {
 
   Renderer* renderer = nullptr;
   VertexType vertex_type = VertexType::kLast;
+  MeshUsage usage = MeshUsage::kStatic;
 
-  std::vector<uint8_t> vertices;
+  VertexBuffer vertices;
   uint32_t vertex_count = 0;
 
-  std::vector<IndexType> indices;
+  // Only meaningful for quantized vertex types. Passed to the shaders (see shader.h).
+  VertexDequantization dequantization = {};
+
+  // Meshes start as 16-bit and get widened automatically when they go over
+  // |kMax16BitVertexCount| vertices. Once staged, the format cannot change.
+  IndexFormat index_format = IndexFormat::kUint16;
+  IndexBuffer indices;
+  uint32_t index_count = 0;
+
+  // What to do with |vertices| and |indices| once staged. The counts are always kept.
+  CPUDataPolicy cpu_data_policy = CPUDataPolicy::kDefault;
+  // Refills |vertices| and |indices|. Needed for |CPUDataPolicy::kReload|.
+  std::function<bool(Mesh*)> reload_cpu_data;
 };
 
-bool StageWithCapacity(Renderer*, Mesh*, VertexType, uint32_t vertex_count, uint32_t index_count);
+// If |index_format| is |kLast|, it's selected from |vertex_count|.
+bool StageWithCapacity(Renderer*, Mesh*, VertexType, uint32_t vertex_count, uint32_t index_count,
+                       IndexFormat index_format = IndexFormat::kLast);
 inline bool Staged(const Mesh& mesh) { return mesh.staged != 0; }
 
 inline void Reset(Mesh* mesh) {
@@ -45,35 +101,168 @@ inline void Reset(Mesh* mesh) {
   mesh->vertex_count = 0;
 
   mesh->indices.clear();
+  mesh->index_count = 0;
 }
 
+// Frees the CPU data if the (resolved) |cpu_data_policy| says so. Called by the renderer after
+// staging the mesh.
+void ApplyCPUDataPolicy(Mesh*);
+
+inline bool HasCPUData(const Mesh& mesh) {
+  return !mesh.vertices.empty() || !mesh.indices.empty();
+}
+
+// Makes sure the CPU data is present, reloading it if it was evicted with |CPUDataPolicy::kReload|.
+// Returns false if the data is not there and cannot be reloaded.
+bool EnsureCPUData(Mesh*);
+
+// Converts the current indices to |format|. Cannot be called on a staged mesh.
+void SetIndexFormat(Mesh*, IndexFormat format);
+
+// Converts the vertices into the quantized equivalent of their type (eg. k3dNormalUV into
+// kQuantized3dNormalUV), filling |dequantization| from the bounds of the positions and UVs.
+// Returns false (leaving the mesh untouched) if the type has no quantized equivalent.
+// Cannot be called on a staged mesh.
+bool QuantizeVertices(Mesh*);
+
+// Reads the 3d positions of the CPU vertices into |out|, dequantizing them if needed.
+// Returns false if the vertex type has no 3d positions or the CPU data is not there.
+bool GetVertexPositions(const Mesh&, std::vector<Vec3>* out);
+
+inline Mesh::IndexType GetIndex(const Mesh& mesh, uint32_t i) {
+  ASSERT(i < mesh.index_count);
+  if (mesh.index_format == IndexFormat::kUint16)
+    return ((const uint16_t*)mesh.indices.data())[i];
+  return ((const uint32_t*)mesh.indices.data())[i];
+}
+
+// MeshBuilder -------------------------------------------------------------------------------------
+//
+// Procedural geometry should pre-size the mesh with |Reserve| and then ask for spans of vertices
+// and indices to fill in place. The buffers grow geometrically, so many small appends (eg. one line
+// at a time) are amortised instead of reallocating on every call.
+
+// A typed window into the mesh buffers. Only valid until the mesh grows again.
+template <typename T>
+struct WriteSpan {
+  T* data = nullptr;
+  uint32_t count = 0;
+  // For vertices, the index of the first vertex of the span. Useful for building the indices.
+  // For indices, the offset within the index buffer.
+  uint32_t base = 0;
+
+  T& operator[](uint32_t i) { ASSERT(i < count); return data[i]; }
+  T* begin() { return data; }
+  T* end() { return data + count; }
+};
+
+namespace internal {
+
+// Like |reserve|, but making sure the capacity at least doubles when it has to grow.
+template <typename Vector>
+inline void GrowCapacity(Vector* v, size_t size) {
+  if (size > v->capacity()) {
+    size_t capacity = v->capacity() * 2;
+    v->reserve(capacity > size ? capacity : size);
+  }
+}
+
+template <typename Vector>
+inline void GrowTo(Vector* v, size_t size) {
+  GrowCapacity(v, size);
+  v->resize(size);
+}
+
+}  // namespace internal
+
+// Index writes go through |Set|, which narrows to the mesh's index format.
+struct IndexSpan {
+  uint8_t* data = nullptr;
+  uint32_t count = 0;
+  uint32_t base = 0;  // Offset (in indices) within the index buffer.
+  IndexFormat format = IndexFormat::kLast;
+
+  void Set(uint32_t i, Mesh::IndexType index) {
+    ASSERT(i < count);
+    if (format == IndexFormat::kUint16) {
+      ((uint16_t*)data)[i] = (uint16_t)index;
+    } else {
+      ((uint32_t*)data)[i] = index;
+    }
+  }
+};
+
+// Makes sure the mesh can hold |vertex_count| and |index_count| more elements without reallocating.
+// Grows geometrically too, so calling it before every append is fine.
+// This also selects the index format for an un-staged mesh.
+void Reserve(Mesh* mesh, uint32_t vertex_count, uint32_t index_count);
+
 template <typename VertexType>
-void PushVertices(Mesh* mesh, VertexType* data, uint32_t count) {
+WriteSpan<VertexType> AppendVertices(Mesh* mesh, uint32_t count) {
   ASSERT_MSG(mesh->vertex_type == VertexType::kVertexType,
              "Expected \"%s\", Got \"%s\"",
              ToString(mesh->vertex_type),
              ToString(VertexType::kVertexType));
 
-  // Have to be able to hold all the vertices.
-  mesh->vertices.reserve((mesh->vertex_count + count) * ToSize(mesh->vertex_type));
+  // Going over what 16-bit indices can address widens the existing ones. Staged meshes have a fixed
+  // format (and might be using a base vertex per draw, like imgui).
+  if (!Staged(*mesh) && mesh->index_format == IndexFormat::kUint16 &&
+      mesh->vertex_count + count > kMax16BitVertexCount) {
+    SetIndexFormat(mesh, IndexFormat::kUint32);
+  }
+
+  size_t offset = mesh->vertices.size();
+  internal::GrowTo(&mesh->vertices, offset + count * sizeof(VertexType));
 
-  VertexType* begin = data;
-  VertexType* end = data + count;
+  WriteSpan<VertexType> span = {};
+  span.data = (VertexType*)(mesh->vertices.data() + offset);
+  span.count = count;
+  span.base = mesh->vertex_count;
 
-  mesh->vertices.insert(mesh->vertices.end(), (uint8_t*)begin, (uint8_t*)end);
   mesh->vertex_count += count;
+  return span;
+}
+
+inline IndexSpan AppendIndices(Mesh* mesh, uint32_t count) {
+  uint32_t index_size = ToSize(mesh->index_format);
+  size_t offset = mesh->indices.size();
+  internal::GrowTo(&mesh->indices, offset + count * index_size);
+
+  IndexSpan span = {};
+  span.data = mesh->indices.data() + offset;
+  span.count = count;
+  span.base = mesh->index_count;
+  span.format = mesh->index_format;
+
+  mesh->index_count += count;
+  return span;
+}
+
+// Writes |src| + |offset| into |dst|, converting to |dst_format|. Written so that the compiler can
+// vectorise it (memcpy when there is nothing to convert).
+void CopyIndicesWithOffset(IndexFormat dst_format, void* dst,
+                           IndexFormat src_format, const void* src,
+                           uint32_t count, Mesh::IndexType offset);
+
+template <typename VertexType>
+void PushVertices(Mesh* mesh, const VertexType* data, uint32_t count) {
+  WriteSpan<VertexType> span = AppendVertices<VertexType>(mesh, count);
+  memcpy(span.data, data, count * sizeof(VertexType));
 }
 
 // Pushes an array of indices into the mesh.
 // The |offset| is a value that will be added to each element.
 inline void
-PushIndices(Mesh* mesh, Mesh::IndexType* data, uint32_t count, Mesh::IndexType offset = 0) {
-  mesh->indices.reserve(mesh->indices.size() + count);
+PushIndices(Mesh* mesh, const Mesh::IndexType* data, uint32_t count, Mesh::IndexType offset = 0) {
+  IndexSpan span = AppendIndices(mesh, count);
+  CopyIndicesWithOffset(span.format, span.data, IndexFormat::kUint32, data, count, offset);
+}
 
-  for (uint32_t i = 0; i < count; i++) {
-    Mesh::IndexType index = *data++ + offset;
-    mesh->indices.push_back(index);
-  }
+// Same, but for 16-bit source data (eg. imgui or glTF).
+inline void
+PushIndices(Mesh* mesh, const uint16_t* data, uint32_t count, Mesh::IndexType offset = 0) {
+  IndexSpan span = AppendIndices(mesh, count);
+  CopyIndicesWithOffset(span.format, span.data, IndexFormat::kUint16, data, count, offset);
 }
 
 }  // namespace rothko
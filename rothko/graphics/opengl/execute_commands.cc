@@ -2,11 +2,16 @@
 // This code has a BSD license. See LICENSE.
 
 #include <GL/gl3w.h>
+#include <string.h>
 
 #include "rothko/graphics/graphics.h"
+#include "rothko/graphics/opengl/instance_set.h"
+#include "rothko/graphics/opengl/readback.h"
+#include "rothko/graphics/opengl/render_target.h"
 #include "rothko/graphics/opengl/renderer_backend.h"
 #include "rothko/graphics/renderer.h"
 #include "rothko/logging/logging.h"
+#include "rothko/memory/stack_allocator.h"
 #include "rothko/utils/macros.h"
 
 namespace rothko {
@@ -15,7 +20,8 @@ namespace opengl {
 namespace {
 
 void ValidateRenderCommands(const PerFrameVector<RenderCommand>& commands) {
-  for (auto& command : commands) {
+  for (uint32_t i = 0; i < commands.size(); i++) {
+    auto& command = commands[i];
     switch (command.type()) {
       case RenderCommandType::kNop: continue;
       case RenderCommandType::kClearFrame: continue;
@@ -23,6 +29,30 @@ void ValidateRenderCommands(const PerFrameVector<RenderCommand>& commands) {
       case RenderCommandType::kPopConfig: continue;
       case RenderCommandType::kPushCamera: continue;
       case RenderCommandType::kPopCamera: continue;
+      case RenderCommandType::kPushRenderTarget:
+        ASSERT(command.GetPushRenderTarget().target);
+        continue;
+      case RenderCommandType::kPopRenderTarget: continue;
+      case RenderCommandType::kBlitRenderTarget:
+        ASSERT(command.GetBlitRenderTarget().source);
+        continue;
+      case RenderCommandType::kReadback:
+        ASSERT(command.GetReadback().callback);
+        continue;
+      case RenderCommandType::kRenderInstanceSet: {
+        auto& render = command.GetRenderInstanceSet();
+        ASSERT(render.instance_set);
+        ASSERT(render.shader);
+        ASSERT(Staged(*render.instance_set));
+        ASSERT_MSG(render.instance_set->draws[0].mesh->vertex_type ==
+                   render.shader->config.vertex_type,
+                   "Instance set (%s): %s, Shader: (%s) %s",
+                   render.instance_set->name.c_str(),
+                   ToString(render.instance_set->draws[0].mesh->vertex_type),
+                   render.shader->config.name.c_str(),
+                   ToString(render.shader->config.vertex_type));
+        continue;
+      }
       case RenderCommandType::kRenderMesh: {
         ASSERT(command.is_render_mesh());
         auto& render_mesh = command.GetRenderMesh();
@@ -170,7 +200,21 @@ void SetUniforms(const OpenGLRendererBackend& opengl, const RenderMesh& render_m
                        (GLfloat*)&camera.view);
   }
 
-  // UBOs.
+  // Dequantization.
+  const VertexDequantization& dq = render_mesh.mesh->dequantization;
+  if (shader_handles.mesh_pos_offset_location != -1)
+    glUniform3fv(shader_handles.mesh_pos_offset_location, 1, (GLfloat*)&dq.pos_offset);
+  if (shader_handles.mesh_pos_scale_location != -1)
+    glUniform3fv(shader_handles.mesh_pos_scale_location, 1, (GLfloat*)&dq.pos_scale);
+  if (shader_handles.mesh_uv_offset_location != -1)
+    glUniform2fv(shader_handles.mesh_uv_offset_location, 1, (GLfloat*)&dq.uv_offset);
+  if (shader_handles.mesh_uv_scale_location != -1)
+    glUniform2fv(shader_handles.mesh_uv_scale_location, 1, (GLfloat*)&dq.uv_scale);
+
+  // UBOs. Multi-draw shaders get them through the per draw storage buffers (see ExecuteMultiDraw).
+  if (shader->config.multi_draw)
+    return;
+
   for (uint32_t i = 0; i < std::size(shader->config.ubos); i++) {
     auto& binding = shader_handles.ubos[i];
     if (binding.binding_index < 0)
@@ -206,7 +250,7 @@ void SetTextures(const OpenGLRendererBackend& opengl,
 
     uint32_t tex_handle = tex_handles->tex_handle;
     glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D, tex_handle);
+    glBindTexture(tex_handles->target, tex_handle);
     glUniform1i(shader_handles.texture_handles[i], i);
   }
 }
@@ -223,27 +267,35 @@ GLenum ToGLEnum(PrimitiveType type) {
   return 0;
 }
 
-void ExecuteMeshRenderActions(const OpenGLRendererBackend& opengl, const RenderMesh& render_mesh) {
-  if (render_mesh.primitive_type == PrimitiveType::kLast) {
-    ERROR(OpenGL,
-          "Received mesh render (%s) without primitive type", render_mesh.mesh->name.c_str());
-    return;
+GLenum ToGLEnum(IndexFormat format) {
+  switch (format) {
+    case IndexFormat::kUint16: return GL_UNSIGNED_SHORT;
+    case IndexFormat::kUint32: return GL_UNSIGNED_INT;
+    case IndexFormat::kLast: break;
   }
 
-  ASSERT_MSG(render_mesh.indices_count > 0, "Received mesh render mesh command with size 0");
+  NOT_REACHED();
+  return 0;
+}
 
-  auto shader_it = opengl.loaded_shaders.find(render_mesh.shader->uuid.value);
+const ShaderHandles& GetShaderHandles(const OpenGLRendererBackend& opengl, const Shader* shader) {
+  auto shader_it = opengl.loaded_shaders.find(shader->uuid.value);
   ASSERT(shader_it != opengl.loaded_shaders.end());
-  const ShaderHandles& shader_handles = shader_it->second;
+  return shader_it->second;
+}
 
-  // Setup the render command.
+const MeshHandles& GetMeshHandles(const OpenGLRendererBackend& opengl, const Mesh* mesh) {
+  auto mesh_it = opengl.loaded_meshes.find(mesh->id);
+  ASSERT(mesh_it != opengl.loaded_meshes.end());
+  return mesh_it->second;
+}
+
+// Sets all the state needed to draw |render_mesh|, except the VAO.
+void SetupMeshRender(const OpenGLRendererBackend& opengl, const RenderMesh& render_mesh,
+                     const ShaderHandles& shader_handles) {
   glUseProgram(shader_handles.program);
   SetRenderCommandConfig(render_mesh);
 
-  auto mesh_it = opengl.loaded_meshes.find(render_mesh.mesh->id);
-  ASSERT(mesh_it != opengl.loaded_meshes.end());
-
-  const MeshHandles& mesh_handles = mesh_it->second;
   SetUniforms(opengl, render_mesh, shader_handles);
   SetTextures(opengl, shader_handles, render_mesh);
 
@@ -254,16 +306,203 @@ void ExecuteMeshRenderActions(const OpenGLRendererBackend& opengl, const RenderM
               render_mesh.scissor_size.width, render_mesh.scissor_size.height);
   }
 
+  // Primitive restart is always enabled, so the restart index has to match the index format of
+  // every draw. Otherwise a 32-bit mesh drawn after a 16-bit one would drop vertex 0xfffe.
+  glPrimitiveRestartIndex(line_strip::GetPrimitiveReset(render_mesh.mesh->index_format));
+}
+
+void ExecuteMeshRenderActions(const OpenGLRendererBackend& opengl, const RenderMesh& render_mesh) {
+  if (render_mesh.primitive_type == PrimitiveType::kLast) {
+    ERROR(OpenGL,
+          "Received mesh render (%s) without primitive type", render_mesh.mesh->name.c_str());
+    return;
+  }
+
+  ASSERT_MSG(render_mesh.indices_count > 0, "Received mesh render mesh command with size 0");
+
+  const ShaderHandles& shader_handles = GetShaderHandles(opengl, render_mesh.shader);
+  const MeshHandles& mesh_handles = GetMeshHandles(opengl, render_mesh.mesh);
+
+  // Setup the render command.
+  SetupMeshRender(opengl, render_mesh, shader_handles);
+
+  // Shared meshes live somewhere within the pool buffers.
+  IndexFormat index_format = render_mesh.mesh->index_format;
+  uint64_t indices_offset = mesh_handles.index_offset + render_mesh.indices_offset;
+  uint32_t base_vertex = mesh_handles.base_vertex + render_mesh.base_vertex;
+
   glBindVertexArray(mesh_handles.vao);
-  glDrawElements(ToGLEnum(render_mesh.primitive_type),
-                 render_mesh.indices_count,
-                 GL_UNSIGNED_INT,
-                 (void*)(uint64_t)render_mesh.indices_offset);
+  if (base_vertex == 0) {
+    glDrawElements(ToGLEnum(render_mesh.primitive_type),
+                   render_mesh.indices_count,
+                   ToGLEnum(index_format),
+                   (void*)indices_offset);
+  } else {
+    glDrawElementsBaseVertex(ToGLEnum(render_mesh.primitive_type),
+                             render_mesh.indices_count,
+                             ToGLEnum(index_format),
+                             (void*)indices_offset,
+                             base_vertex);
+  }
 
   glBindVertexArray(NULL);
   glUseProgram(NULL);
 }
 
+// Execute Multi Draw ------------------------------------------------------------------------------
+//
+// Runs of consecutive render mesh commands that only differ in the mesh range and their UBO data
+// are drawn with a single glMultiDrawElementsIndirect. The UBO data of each draw goes into a
+// storage buffer that the shader indexes with the draw id (see shader.h).
+
+bool SameTextures(const RenderMesh& a, const RenderMesh& b) {
+  if (a.textures.size() != b.textures.size())
+    return false;
+
+  for (size_t i = 0; i < a.textures.size(); i++) {
+    if (a.textures[i] != b.textures[i])
+      return false;
+  }
+
+  return true;
+}
+
+// Whether |b| can be drawn with the same state as |a|. They need to read from the same VAO, which
+// means either the same mesh or meshes in the same pool (MeshUsage::kShared).
+bool CanBatch(const OpenGLRendererBackend& opengl, const RenderMesh& a,
+              const MeshHandles& a_handles, const RenderMesh& b) {
+  if (a.shader != b.shader || a.primitive_type != b.primitive_type || a.flags != b.flags)
+    return false;
+
+  if (GetScissorTest(a.flags) && (a.scissor_pos != b.scissor_pos ||
+                                  a.scissor_size != b.scissor_size)) {
+    return false;
+  }
+
+  if (!SameTextures(a, b))
+    return false;
+
+  if (a.mesh != b.mesh) {
+    if (GetMeshHandles(opengl, b.mesh).vao != a_handles.vao)
+      return false;
+
+    // Dequantization is still a regular uniform.
+    if (memcmp(&a.mesh->dequantization, &b.mesh->dequantization, sizeof(VertexDequantization)))
+      return false;
+  }
+
+  return true;
+}
+
+// Returns how many commands (starting at |start|) were drawn.
+uint32_t ExecuteMultiDraw(const OpenGLRendererBackend& opengl,
+                          const PerFrameVector<RenderCommand>& commands, uint32_t start) {
+  const RenderMesh& first = commands[start].GetRenderMesh();
+  const MeshHandles& mesh_handles = GetMeshHandles(opengl, first.mesh);
+
+  uint32_t end = start + 1;
+  while (end < commands.size() && commands[end].is_render_mesh() &&
+         CanBatch(opengl, first, mesh_handles, commands[end].GetRenderMesh())) {
+    end++;
+  }
+  uint32_t draw_count = end - start;
+
+  ScratchScope scratch;
+
+  // Indirect commands.
+  uint32_t index_size = ToSize(first.mesh->index_format);
+  auto* draws = Allocate<DrawElementsIndirectCommand>(scratch.allocator, draw_count);
+  for (uint32_t i = 0; i < draw_count; i++) {
+    const RenderMesh& render_mesh = commands[start + i].GetRenderMesh();
+    ASSERT_MSG(render_mesh.indices_count > 0, "Received mesh render mesh command with size 0");
+    const MeshHandles& handles = GetMeshHandles(opengl, render_mesh.mesh);
+
+    uint64_t indices_offset = handles.index_offset + render_mesh.indices_offset;
+    ASSERT(indices_offset % index_size == 0);
+
+    DrawElementsIndirectCommand& draw = draws[i];
+    draw.count = render_mesh.indices_count;
+    draw.instance_count = 1;
+    draw.first_index = (uint32_t)(indices_offset / index_size);
+    draw.base_vertex = (int32_t)(handles.base_vertex + render_mesh.base_vertex);
+    draw.base_instance = 0;
+  }
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, opengl.indirect_buffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, draw_count * sizeof(DrawElementsIndirectCommand), draws,
+               GL_STREAM_DRAW);
+
+  // Per draw UBO data.
+  const Shader* shader = first.shader;
+  const ShaderHandles& shader_handles = GetShaderHandles(opengl, shader);
+  for (uint32_t i = 0; i < std::size(shader->config.ubos); i++) {
+    auto& binding = shader_handles.ubos[i];
+    if (binding.binding_index < 0)
+      continue;
+
+    uint32_t ubo_size = shader->config.ubos[i].size;
+    uint8_t* data = Allocate<uint8_t>(scratch.allocator, (uint64_t)draw_count * ubo_size);
+    for (uint32_t j = 0; j < draw_count; j++) {
+      const RenderMesh& render_mesh = commands[start + j].GetRenderMesh();
+      ASSERT(render_mesh.ubo_data[i]);
+      memcpy(data + j * ubo_size, render_mesh.ubo_data[i], ubo_size);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, binding.buffer_handle);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, draw_count * ubo_size, data, GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding.binding_index, binding.buffer_handle);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, NULL);
+
+  SetupMeshRender(opengl, first, shader_handles);
+
+  glBindVertexArray(mesh_handles.vao);
+  glMultiDrawElementsIndirect(ToGLEnum(first.primitive_type), ToGLEnum(first.mesh->index_format),
+                              nullptr, draw_count, 0);
+  glBindVertexArray(NULL);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, NULL);
+  glUseProgram(NULL);
+
+  return draw_count;
+}
+
+// Execute Render Instance Set ---------------------------------------------------------------------
+
+void ExecuteRenderInstanceSet(OpenGLRendererBackend* opengl, const RenderInstanceSet& render) {
+  const InstanceSetHandles* handles = OpenGLCullInstanceSet(opengl, render);
+  if (!handles)
+    return;
+
+  const InstanceSet& set = *render.instance_set;
+  const Mesh* first_mesh = set.draws[0].mesh;
+
+  // Everything but the mesh range works as a normal render mesh.
+  RenderMesh render_mesh = {};
+  render_mesh.mesh = first_mesh;
+  render_mesh.shader = render.shader;
+  render_mesh.primitive_type = render.primitive_type;
+  render_mesh.flags = render.flags;
+  for (uint32_t i = 0; i < std::size(render.ubo_data); i++) {
+    render_mesh.ubo_data[i] = render.ubo_data[i];
+  }
+  render_mesh.textures = render.textures;
+
+  const ShaderHandles& shader_handles = GetShaderHandles(*opengl, render.shader);
+  SetupMeshRender(*opengl, render_mesh, shader_handles);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kInstanceSetInstancesBinding,
+                   handles->instance_buffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kInstanceSetVisibleBinding, handles->visible_buffer);
+
+  glBindVertexArray(GetMeshHandles(*opengl, first_mesh).vao);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, handles->draw_buffer);
+  glMultiDrawElementsIndirect(ToGLEnum(render.primitive_type), ToGLEnum(first_mesh->index_format),
+                              nullptr, (GLsizei)set.draws.size(), 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, NULL);
+  glBindVertexArray(NULL);
+  glUseProgram(NULL);
+}
+
 }  // namespace
 
 }  // namespace opengl
@@ -278,7 +517,8 @@ void RendererExecuteCommands(Renderer*,
   ValidateRenderCommands(commands);
 #endif
 
-  for (auto& command : commands) {
+  for (uint32_t i = 0; i < commands.size(); i++) {
+    auto& command = commands[i];
     switch (command.type()) {
       case RenderCommandType::kNop:
         continue;
@@ -297,9 +537,40 @@ void RendererExecuteCommands(Renderer*,
       case RenderCommandType::kPopCamera:
         ExecutePopCamera(opengl);
         break;
+      case RenderCommandType::kPushRenderTarget:
+        OpenGLPushRenderTarget(opengl, command.GetPushRenderTarget());
+        break;
+      case RenderCommandType::kPopRenderTarget:
+        OpenGLPopRenderTarget(opengl);
+        break;
+      case RenderCommandType::kBlitRenderTarget:
+        OpenGLBlitRenderTarget(opengl, command.GetBlitRenderTarget());
+        break;
+      case RenderCommandType::kReadback:
+        OpenGLReadback(opengl, command.GetReadback());
+        break;
       case RenderCommandType::kRenderMesh:
+        // Async shaders still compiling are waited on. Failed ones don't render.
+        if (OpenGLPollShader(opengl, *command.GetRenderMesh().shader, true) !=
+            ShaderStatus::kReady) {
+          break;
+        }
+
+        if (command.GetRenderMesh().shader->config.multi_draw) {
+          // Skip over the commands that got batched.
+          i += ExecuteMultiDraw(*opengl, commands, i) - 1;
+          break;
+        }
         ExecuteMeshRenderActions(*opengl, command.GetRenderMesh());
         break;
+      case RenderCommandType::kRenderInstanceSet:
+        if (OpenGLPollShader(opengl, *command.GetRenderInstanceSet().shader, true) !=
+            ShaderStatus::kReady) {
+          break;
+        }
+
+        ExecuteRenderInstanceSet(opengl, command.GetRenderInstanceSet());
+        break;
       case RenderCommandType::kLast:
         NOT_REACHED();
     }
@@ -0,0 +1,434 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/opengl/instance_set.h"
+
+#include <GL/gl3w.h>
+
+#include <atomic>
+
+#include "rothko/graphics/mesh.h"
+#include "rothko/graphics/opengl/renderer_backend.h"
+#include "rothko/logging/logging.h"
+#include "rothko/memory/stack_allocator.h"
+
+namespace rothko {
+namespace opengl {
+
+namespace {
+
+std::atomic<uint32_t> kNextInstanceSetUUID = 1;
+uint32_t GetNextInstanceSetUUID() {
+  uint32_t id = kNextInstanceSetUUID++;
+  ASSERT(id < UINT32_MAX);
+  return id;
+}
+
+constexpr uint32_t kCullingGroupSize = 64;
+
+// Buffer bindings of the culling shader.
+constexpr uint32_t kCullInstancesBinding = 0;
+constexpr uint32_t kCullDrawsBinding = 1;
+constexpr uint32_t kCullVisibleBinding = 2;
+constexpr uint32_t kCullPyramidBinding = 3;
+
+// One invocation per instance. Visible instances bump the instance count of their draw and write
+// their index in the slot they got, so the visible list comes out compacted (in no particular
+// order within each draw).
+//
+// The tests are the same as |IsInFrustum| (instance_set.cc) and |IsOccluded|
+// (rothko/scene/occlusion.cc).
+constexpr char kCullingShader[] = R"(
+#version 430 core
+layout (local_size_x = 64) in;
+
+struct Instance {
+  mat4 transform;
+  vec3 bounds_min;
+  uint draw_index;
+  vec3 bounds_max;
+  uint padding;
+};
+
+struct DrawCommand {
+  uint count;
+  uint instance_count;
+  uint first_index;
+  int base_vertex;
+  uint base_instance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout (std430, binding = 1) buffer Draws { DrawCommand draws[]; };
+layout (std430, binding = 2) writeonly buffer Visible { uint visible[]; };
+layout (std430, binding = 3) readonly buffer Pyramid { float pyramid[]; };
+
+uniform uint instance_count;
+uniform vec4 frustum_planes[6];
+uniform mat4 view_projection;
+uniform ivec2 pyramid_size;
+uniform int pyramid_levels;   // Zero means no occlusion culling.
+
+bool IsInFrustum(vec3 center, vec3 extent) {
+  for (int i = 0; i < 6; i++) {
+    vec4 plane = frustum_planes[i];
+    if (dot(plane.xyz, center) + plane.w < -dot(abs(plane.xyz), extent))
+      return false;
+  }
+  return true;
+}
+
+bool IsOccluded(Instance instance) {
+  mat4 mvp = view_projection * instance.transform;
+
+  vec2 screen_min = vec2(1e30);
+  vec2 screen_max = vec2(-1e30);
+  float nearest = 1e30;
+  for (int i = 0; i < 8; i++) {
+    vec3 corner = vec3((i & 1) != 0 ? instance.bounds_max.x : instance.bounds_min.x,
+                       (i & 2) != 0 ? instance.bounds_max.y : instance.bounds_min.y,
+                       (i & 4) != 0 ? instance.bounds_max.z : instance.bounds_min.z);
+    vec4 clip = mvp * vec4(corner, 1.0);
+    if (clip.w <= 1e-5)
+      return false;
+
+    vec3 ndc = clip.xyz / clip.w;
+    vec2 screen = (ndc.xy * 0.5 + 0.5) * vec2(pyramid_size);
+    screen_min = min(screen_min, screen);
+    screen_max = max(screen_max, screen);
+    nearest = min(nearest, ndc.z * 0.5 + 0.5);
+  }
+
+  if (any(lessThan(screen_max, vec2(0))) || any(greaterThan(screen_min, vec2(pyramid_size))))
+    return false;
+
+  ivec2 p0 = max(ivec2(screen_min), ivec2(0));
+  ivec2 p1 = min(ivec2(screen_max), pyramid_size - 1);
+
+  // Use the level where the rect covers at most 2x2 texels.
+  int extent = max(p1.x - p0.x, p1.y - p0.y) + 1;
+  int level = 0;
+  int offset = 0;
+  ivec2 size = pyramid_size;
+  while ((1 << level) < extent && level + 1 < pyramid_levels) {
+    offset += size.x * size.y;
+    size = max((size + 1) / 2, ivec2(1));
+    level++;
+  }
+
+  p0 >>= level;
+  p1 >>= level;
+  for (int y = p0.y; y <= p1.y; y++) {
+    for (int x = p0.x; x <= p1.x; x++) {
+      if (pyramid[offset + y * size.x + x] >= nearest)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+void main() {
+  uint index = gl_GlobalInvocationID.x;
+  if (index >= instance_count)
+    return;
+
+  Instance instance = instances[index];
+
+  // World space box containing the transformed bounds.
+  vec3 local_center = (instance.bounds_min + instance.bounds_max) * 0.5;
+  vec3 local_extent = (instance.bounds_max - instance.bounds_min) * 0.5;
+  vec3 center = (instance.transform * vec4(local_center, 1.0)).xyz;
+  mat3 m = mat3(instance.transform);
+  vec3 extent = abs(m[0]) * local_extent.x + abs(m[1]) * local_extent.y +
+                abs(m[2]) * local_extent.z;
+
+  if (!IsInFrustum(center, extent))
+    return;
+
+  if (pyramid_levels > 0 && IsOccluded(instance))
+    return;
+
+  uint slot = atomicAdd(draws[instance.draw_index].instance_count, 1u);
+  visible[draws[instance.draw_index].base_instance + slot] = index;
+}
+)";
+
+uint32_t CreateCullingProgram() {
+  uint32_t shader = glCreateShader(GL_COMPUTE_SHADER);
+  const GLchar* src = kCullingShader;
+  glShaderSource(shader, 1, &src, 0);
+  glCompileShader(shader);
+
+  GLint success = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (success == GL_FALSE) {
+    GLchar log[2048];
+    glGetShaderInfoLog(shader, sizeof(log), 0, log);
+    WARNING(OpenGL, "Could not compile the instance culling shader: %s", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+
+  uint32_t program = glCreateProgram();
+  glAttachShader(program, shader);
+  glLinkProgram(program);
+  glDeleteShader(shader);
+
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (success == GL_FALSE) {
+    GLchar log[2048];
+    glGetProgramInfoLog(program, sizeof(log), 0, log);
+    WARNING(OpenGL, "Could not link the instance culling shader: %s", log);
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
+}
+
+void FreeHandles(InstanceSetHandles* handles) {
+  glDeleteBuffers(1, &handles->instance_buffer);
+  glDeleteBuffers(1, &handles->draw_buffer);
+  glDeleteBuffers(1, &handles->visible_buffer);
+}
+
+bool Validate(const InstanceSet& set) {
+  if (set.draws.empty()) {
+    ERROR(OpenGL, "Instance set %s: No draws.", set.name.c_str());
+    return false;
+  }
+
+  const Mesh* first = set.draws[0].mesh;
+  for (const InstanceDraw& draw : set.draws) {
+    if (!draw.mesh || !Staged(*draw.mesh)) {
+      ERROR(OpenGL, "Instance set %s: All draws need a staged mesh.", set.name.c_str());
+      return false;
+    }
+
+    // Cheap checks. Whether they share the VAO is checked on each draw (pools can move).
+    if (draw.mesh->vertex_type != first->vertex_type ||
+        draw.mesh->index_format != first->index_format) {
+      ERROR(OpenGL, "Instance set %s: Mesh %s doesn't match the vertex type or index format of %s.",
+            set.name.c_str(), draw.mesh->name.c_str(), first->name.c_str());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Upload(const InstanceSet& set, InstanceSetHandles* handles) {
+  // Each draw gets a range of the visible buffer big enough for all its instances.
+  std::vector<uint32_t> draw_offsets(set.draws.size(), 0);
+  for (const CullInstance& instance : set.instances) {
+    if (instance.draw_index >= set.draws.size()) {
+      ERROR(OpenGL, "Instance set %s: Draw index %u out of range (%zu draws).", set.name.c_str(),
+            instance.draw_index, set.draws.size());
+      return false;
+    }
+    draw_offsets[instance.draw_index]++;
+  }
+
+  uint32_t offset = 0;
+  for (uint32_t& draw_offset : draw_offsets) {
+    uint32_t count = draw_offset;
+    draw_offset = offset;
+    offset += count;
+  }
+
+  uint32_t instance_count = (uint32_t)set.instances.size();
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, handles->instance_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, instance_count * sizeof(CullInstance),
+               set.instances.data(), GL_STATIC_DRAW);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, handles->visible_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, instance_count * sizeof(uint32_t), nullptr,
+               GL_DYNAMIC_COPY);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, handles->draw_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, set.draws.size() * sizeof(DrawElementsIndirectCommand),
+               nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, NULL);
+
+  handles->instance_count = instance_count;
+  handles->draw_offsets = std::move(draw_offsets);
+  return true;
+}
+
+InstanceSetHandles* GetHandles(OpenGLRendererBackend* opengl, const InstanceSet& set) {
+  auto it = opengl->loaded_instance_sets.find(set.uuid.value);
+  ASSERT(it != opengl->loaded_instance_sets.end());
+  return &it->second;
+}
+
+}  // namespace
+
+// Init --------------------------------------------------------------------------------------------
+
+void OpenGLInitInstanceCulling(OpenGLRendererBackend* opengl) {
+  opengl->instance_culling_supported = false;
+  if (!opengl->multi_draw_supported)
+    return;
+
+  InstanceCulling* culling = &opengl->instance_culling;
+  culling->program = CreateCullingProgram();
+  if (!culling->program)
+    return;
+
+  uint32_t program = culling->program;
+  culling->instance_count_location = glGetUniformLocation(program, "instance_count");
+  culling->frustum_planes_location = glGetUniformLocation(program, "frustum_planes");
+  culling->view_projection_location = glGetUniformLocation(program, "view_projection");
+  culling->pyramid_size_location = glGetUniformLocation(program, "pyramid_size");
+  culling->pyramid_levels_location = glGetUniformLocation(program, "pyramid_levels");
+
+  glGenBuffers(1, &culling->pyramid_buffer);
+
+  // The pyramid block must always have a buffer bound, even if not read.
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, culling->pyramid_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(float), nullptr, GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, NULL);
+
+  opengl->instance_culling_supported = true;
+}
+
+void OpenGLShutdownInstanceCulling(OpenGLRendererBackend* opengl) {
+  InstanceCulling* culling = &opengl->instance_culling;
+  if (culling->program)
+    glDeleteProgram(culling->program);
+  if (culling->pyramid_buffer)
+    glDeleteBuffers(1, &culling->pyramid_buffer);
+  *culling = {};
+}
+
+// Stage Instance Set ------------------------------------------------------------------------------
+
+bool OpenGLStageInstanceSet(OpenGLRendererBackend* opengl, InstanceSet* set) {
+  LOG(OpenGL, "Staging instance set %s [Instances: %zu, Draws: %zu]", set->name.c_str(),
+              set->instances.size(), set->draws.size());
+
+  if (!opengl->instance_culling_supported) {
+    ERROR(OpenGL, "Instance set %s: GPU culling is not supported.", set->name.c_str());
+    return false;
+  }
+
+  if (!Validate(*set))
+    return false;
+
+  InstanceSetHandles handles;
+  glGenBuffers(1, &handles.instance_buffer);
+  glGenBuffers(1, &handles.draw_buffer);
+  glGenBuffers(1, &handles.visible_buffer);
+  if (!Upload(*set, &handles)) {
+    FreeHandles(&handles);
+    return false;
+  }
+
+  uint32_t uuid = GetNextInstanceSetUUID();
+  opengl->loaded_instance_sets[uuid] = std::move(handles);
+  set->uuid = uuid;
+  return true;
+}
+
+void OpenGLUnstageInstanceSet(OpenGLRendererBackend* opengl, InstanceSet* set) {
+  auto it = opengl->loaded_instance_sets.find(set->uuid.value);
+  ASSERT(it != opengl->loaded_instance_sets.end());
+
+  FreeHandles(&it->second);
+  opengl->loaded_instance_sets.erase(it);
+  set->uuid.clear();
+}
+
+bool OpenGLUploadInstanceSet(OpenGLRendererBackend* opengl, InstanceSet* set) {
+  if (!Validate(*set))
+    return false;
+  return Upload(*set, GetHandles(opengl, *set));
+}
+
+// Culling -----------------------------------------------------------------------------------------
+
+const InstanceSetHandles* OpenGLCullInstanceSet(OpenGLRendererBackend* opengl,
+                                                const RenderInstanceSet& render) {
+  const InstanceSet& set = *render.instance_set;
+  InstanceSetHandles* handles = GetHandles(opengl, set);
+  if (handles->instance_count == 0)
+    return nullptr;
+
+  ASSERT(handles->draw_offsets.size() == set.draws.size());
+
+  // The draws start with no instances, the culling shader adds the visible ones.
+  ScratchScope scratch;
+  uint32_t draw_count = (uint32_t)set.draws.size();
+  auto* draws = Allocate<DrawElementsIndirectCommand>(scratch.allocator, draw_count);
+
+  uint32_t vao = 0;
+  for (uint32_t i = 0; i < draw_count; i++) {
+    const InstanceDraw& draw = set.draws[i];
+    auto mesh_it = opengl->loaded_meshes.find(draw.mesh->id);
+    ASSERT(mesh_it != opengl->loaded_meshes.end());
+    const MeshHandles& mesh_handles = mesh_it->second;
+
+    if (i == 0) {
+      vao = mesh_handles.vao;
+    } else if (mesh_handles.vao != vao) {
+      ERROR(OpenGL, "Instance set %s: Mesh %s is not in the same buffers as %s.", set.name.c_str(),
+            draw.mesh->name.c_str(), set.draws[0].mesh->name.c_str());
+      return nullptr;
+    }
+
+    uint32_t index_size = ToSize(draw.mesh->index_format);
+    uint64_t indices_offset = mesh_handles.index_offset + draw.indices_offset;
+    ASSERT(indices_offset % index_size == 0);
+
+    draws[i] = {};
+    draws[i].count = draw.indices_count != 0 ? draw.indices_count : draw.mesh->index_count;
+    draws[i].instance_count = 0;
+    draws[i].first_index = (uint32_t)(indices_offset / index_size);
+    draws[i].base_vertex = (int32_t)(mesh_handles.base_vertex + draw.base_vertex);
+    draws[i].base_instance = handles->draw_offsets[i];
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, handles->draw_buffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, draw_count * sizeof(DrawElementsIndirectCommand),
+                  draws);
+
+  InstanceCulling* culling = &opengl->instance_culling;
+  glUseProgram(culling->program);
+
+  Frustum frustum = GetFrustum(render.cull_view_projection);
+  glUniform1ui(culling->instance_count_location, handles->instance_count);
+  glUniform4fv(culling->frustum_planes_location, 6, (GLfloat*)frustum.planes);
+  glUniformMatrix4fv(culling->view_projection_location, 1, GL_FALSE,
+                     (GLfloat*)&render.cull_view_projection);
+
+  const DepthPyramid* pyramid = render.depth_pyramid;
+  if (pyramid && pyramid->level_count > 0) {
+    uint32_t length = GetDepthPyramidLength(pyramid->size, pyramid->level_count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culling->pyramid_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, length * sizeof(float), pyramid->data, GL_STREAM_DRAW);
+    glUniform2i(culling->pyramid_size_location, pyramid->size.x, pyramid->size.y);
+    glUniform1i(culling->pyramid_levels_location, pyramid->level_count);
+  } else {
+    glUniform1i(culling->pyramid_levels_location, 0);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, NULL);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullInstancesBinding, handles->instance_buffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullDrawsBinding, handles->draw_buffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullVisibleBinding, handles->visible_buffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullPyramidBinding, culling->pyramid_buffer);
+
+  uint32_t group_count = (handles->instance_count + kCullingGroupSize - 1) / kCullingGroupSize;
+  glDispatchCompute(group_count, 1, 1);
+
+  // The draw reads the commands and the visible list written by the shader.
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+  glUseProgram(NULL);
+
+  return handles;
+}
+
+}  // namespace opengl
+}  // namespace rothko
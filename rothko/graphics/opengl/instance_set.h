@@ -0,0 +1,35 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "rothko/graphics/commands.h"
+#include "rothko/graphics/instance_set.h"
+
+namespace rothko {
+namespace opengl {
+
+struct InstanceSetHandles;
+struct OpenGLRendererBackend;
+
+// Storage block bindings of the instance set buffers while drawing. Must match
+// |kInstanceSetVertexHeader| (shader.cc).
+constexpr uint32_t kInstanceSetInstancesBinding = 6;
+constexpr uint32_t kInstanceSetVisibleBinding = 7;
+
+// Compiles the culling compute shader. Sets |instance_culling_supported|.
+void OpenGLInitInstanceCulling(OpenGLRendererBackend*);
+void OpenGLShutdownInstanceCulling(OpenGLRendererBackend*);
+
+bool OpenGLStageInstanceSet(OpenGLRendererBackend*, InstanceSet*);
+void OpenGLUnstageInstanceSet(OpenGLRendererBackend*, InstanceSet*);
+bool OpenGLUploadInstanceSet(OpenGLRendererBackend*, InstanceSet*);
+
+// Runs the culling shader, leaving |draw_buffer| ready to be drawn with
+// glMultiDrawElementsIndirect (one command per draw). Returns null if there is nothing to draw.
+const InstanceSetHandles* OpenGLCullInstanceSet(OpenGLRendererBackend*, const RenderInstanceSet&);
+
+}  // namespace opengl
+}  // namespace rothko
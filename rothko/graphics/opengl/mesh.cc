@@ -5,13 +5,12 @@
 
 #include <GL/gl3w.h>
 #include <inttypes.h>
-#include <stddef.h>
+#include <string.h>
 
-#include <atomic>
+#include <algorithm>
 
 #include "rothko/graphics/mesh.h"
 #include "rothko/graphics/opengl/renderer_backend.h"
-#include "rothko/graphics/opengl/utils.h"
 #include "rothko/logging/logging.h"
 
 namespace rothko {
@@ -21,13 +20,6 @@ namespace opengl {
 
 namespace {
 
-std::atomic<uint32_t> kNextMeshUUID = 1;
-uint32_t GetNextMeshUUID() {
-  uint32_t id = kNextMeshUUID++;
-  ASSERT(id < UINT32_MAX);
-  return id;
-}
-
 MeshHandles GenerateMeshHandles() {
   uint32_t buffers[2];
   glGenBuffers(ARRAY_SIZE(buffers), buffers);
@@ -48,116 +40,399 @@ void UnbindMeshHandles() {
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, NULL);
 }
 
-// The static_asserts are here to ensure that if the vertices change, this code has to change too.
-void StageAttributes(Mesh* mesh) {
-  switch (mesh->vertex_type) {
-    case VertexType::k3dNormalUV: {
-      using VERT = Vertex3dNormalUV;
-      static_assert(sizeof(VERT) == 32);
-      GLsizei stride = sizeof(VERT);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, pos));
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, normal));
-      glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, uv));
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-      glEnableVertexAttribArray(2);
-      return;
-    }
-    case VertexType::k2dUVColor: {
-      using VERT = Vertex2dUVColor;
-      static_assert(sizeof(VERT) == 20);
-      GLsizei stride = sizeof(VERT);
-      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, pos));
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, uv));
-      glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(VERT, color));
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-      glEnableVertexAttribArray(2);
-      return;
-    }
-    case VertexType::k3d: {
-      using VERT = Vertex3d;
-      static_assert(sizeof(VERT) == 12);
-      GLsizei stride = sizeof(VERT);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, pos));
-      glEnableVertexAttribArray(0);
-      return;
-    }
-    case VertexType::k3dColor: {
-      using VERT = Vertex3dColor;
-      static_assert(sizeof(VERT) == 16);
-      GLsizei stride = sizeof(VERT);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, pos));
-      glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(VERT, color));
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-      return;
-    }
-    case VertexType::k3dNormal: {
-      using VERT = Vertex3dNormal;
-      static_assert(sizeof(VERT) == 24);
-      GLsizei stride = sizeof(VERT);
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, pos));
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, normal));
-      glEnableVertexAttribArray(1);
-      glEnableVertexAttribArray(2);
-      return;
-    }
-    case VertexType::k3dUV: {
-      using VERT = Vertex3dUV;
-      static_assert(sizeof(VERT) == 20);
-      GLsizei stride = sizeof(VERT);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, pos));
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, uv));
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-      return;
-    }
-    case VertexType::k3dUVColor: {
-      using VERT = Vertex3dUVColor;
-      static_assert(sizeof(VERT) == 24);
-      GLsizei stride = sizeof(VERT);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, pos));
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, uv));
-      glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(VERT, color));
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-      glEnableVertexAttribArray(2);
-      return;
-    }
-    case VertexType::k3dNormalTangentUV: {
-      using VERT = Vertex3dNormalTangentUV;
-      static_assert(sizeof(VERT) == 48);
-      GLsizei stride = sizeof(VERT);
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, pos));
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, normal));
-      glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, tangent));
-      glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(VERT, uv));
-      glEnableVertexAttribArray(1);
-      glEnableVertexAttribArray(2);
-      glEnableVertexAttribArray(3);
-      glEnableVertexAttribArray(4);
-      return;
-    }
-    case VertexType::kLast: break;
+// How OpenGL should read each vertex component.
+struct GLAttribute {
+  GLint size = 0;
+  GLenum type = 0;
+  GLboolean normalized = GL_FALSE;
+  bool integer = false;   // Read as ivec/uvec (glVertexAttribIPointer).
+};
+
+GLAttribute ToGLAttribute(VertComponent component) {
+  switch (component) {
+    case VertComponent::kPos2d: return {2, GL_FLOAT};
+    case VertComponent::kPos3d: return {3, GL_FLOAT};
+    case VertComponent::kPos3d_short: return {3, GL_UNSIGNED_SHORT, GL_TRUE};
+    case VertComponent::kNormal: return {3, GL_FLOAT};
+    case VertComponent::kTangent: return {4, GL_FLOAT};
+    case VertComponent::kNormal_oct: return {2, GL_SHORT, GL_TRUE};
+    case VertComponent::kTangent_byte: return {4, GL_BYTE, GL_TRUE};
+    case VertComponent::kUV0_byte: return {2, GL_UNSIGNED_BYTE, GL_TRUE};
+    case VertComponent::kUV0_short: return {2, GL_UNSIGNED_SHORT, GL_TRUE};
+    case VertComponent::kUV0_float: return {2, GL_FLOAT};
+    case VertComponent::kUV1_byte: return {2, GL_UNSIGNED_BYTE, GL_TRUE};
+    case VertComponent::kUV1_short: return {2, GL_UNSIGNED_SHORT, GL_TRUE};
+    case VertComponent::kUV1_float: return {2, GL_FLOAT};
+    case VertComponent::kColorRGB_byte: return {3, GL_UNSIGNED_BYTE, GL_TRUE};
+    case VertComponent::kColorRGB_short: return {3, GL_UNSIGNED_SHORT, GL_TRUE};
+    case VertComponent::kColorRGB_float: return {3, GL_FLOAT};
+    case VertComponent::kColorRGBA_byte: return {4, GL_UNSIGNED_BYTE, GL_TRUE};
+    case VertComponent::kColorRGBA_short: return {4, GL_UNSIGNED_SHORT, GL_TRUE};
+    case VertComponent::kColorRGBA_float: return {4, GL_FLOAT};
+    case VertComponent::kJoints_byte: return {4, GL_UNSIGNED_BYTE, GL_FALSE, true};
+    case VertComponent::kJoints_short: return {4, GL_UNSIGNED_SHORT, GL_FALSE, true};
+    case VertComponent::kWeights_byte: return {4, GL_UNSIGNED_BYTE, GL_TRUE};
+    case VertComponent::kWeights_short: return {4, GL_UNSIGNED_SHORT, GL_TRUE};
+    case VertComponent::kWeights_float: return {4, GL_FLOAT};
+    case VertComponent::kLast: break;
   }
 
-  NOT_REACHED_MSG("Invalid vertex type: %s", ToString(mesh->vertex_type));
+  NOT_REACHED_MSG("Invalid vertex component: %s", ToString(component));
+  return {};
+}
+
+// Each component of the vertex type gets the next attribute location, in bit order.
+void StageAttributes(VertexType vertex_type) {
+  VertexLayout layout = GetVertexLayout(vertex_type);
+  ASSERT_MSG(layout.count > 0, "Invalid vertex type: %s", ToString(vertex_type));
+
+  for (uint32_t i = 0; i < layout.count; i++) {
+    const VertexAttribute& attribute = layout.attributes[i];
+    GLAttribute gl_attribute = ToGLAttribute(attribute.component);
+
+    void* offset = (void*)(uint64_t)attribute.offset;
+    if (gl_attribute.integer) {
+      glVertexAttribIPointer(i, gl_attribute.size, gl_attribute.type, layout.stride, offset);
+    } else {
+      glVertexAttribPointer(i, gl_attribute.size, gl_attribute.type, gl_attribute.normalized,
+                            layout.stride, offset);
+    }
+    glEnableVertexAttribArray(i);
+  }
 }
 
 void StageVertices(Mesh* mesh, MeshHandles* handles) {
   glBindBuffer(GL_ARRAY_BUFFER, handles->vbo);
   glBufferData(GL_ARRAY_BUFFER, mesh->vertices.size(), mesh->vertices.data(), GL_STATIC_DRAW);
-  StageAttributes(mesh);
+  StageAttributes(mesh->vertex_type);
+  handles->vertex_size = mesh->vertices.size();
 }
 
 void StageIndices(Mesh* mesh, MeshHandles* handles) {
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handles->ebo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               mesh->indices.size() * sizeof(Mesh::IndexType), mesh->indices.data(),
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indices.size(), mesh->indices.data(),
                GL_STATIC_DRAW);
+  handles->index_size = mesh->indices.size();
+}
+
+bool StageStaticMesh(Mesh* mesh, MeshHandles* out) {
+  // Always bind the VAO first, so that it doesn't overwrite.
+  MeshHandles handles = GenerateMeshHandles();
+
+  glBindVertexArray(handles.vao);
+  StageVertices(mesh, &handles);
+  StageIndices(mesh, &handles);
+  glBindVertexArray(NULL);
+
+  UnbindMeshHandles();
+
+  *out = std::move(handles);
+  return true;
+}
+
+// Mesh Pools --------------------------------------------------------------------------------------
+
+constexpr uint64_t kMinPoolVertexSize = 4 * 1024 * 1024;
+constexpr uint64_t kMinPoolIndexSize = 1 * 1024 * 1024;
+
+uint64_t GetPoolKey(VertexType vertex_type, IndexFormat index_format) {
+  return ((uint64_t)vertex_type << 8) | (uint64_t)index_format;
+}
+
+uint32_t CreateBuffer(GLenum target, uint64_t size) {
+  uint32_t buffer = 0;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(target, buffer);
+  glBufferData(target, size, nullptr, GL_STATIC_DRAW);
+  glBindBuffer(target, NULL);
+  return buffer;
+}
+
+// The VAO has to be re-created every time the pool moves to new buffers.
+void SetupPoolVAO(MeshPool* pool) {
+  if (pool->vao != 0)
+    glDeleteVertexArrays(1, &pool->vao);
+  glGenVertexArrays(1, &pool->vao);
+
+  glBindVertexArray(pool->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, pool->vbo);
+  StageAttributes(pool->vertex_type);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool->ebo);
+  glBindVertexArray(NULL);
+
+  UnbindMeshHandles();
+}
+
+MeshPool* GetOrCreateMeshPool(OpenGLRendererBackend* opengl, Mesh* mesh) {
+  uint64_t key = GetPoolKey(mesh->vertex_type, mesh->index_format);
+  auto it = opengl->mesh_pools.find(key);
+  if (it != opengl->mesh_pools.end())
+    return it->second.get();
+
+  auto pool = std::make_unique<MeshPool>();
+  pool->vertex_type = mesh->vertex_type;
+  pool->index_format = mesh->index_format;
+
+  // Round the vertex buffer to the stride, so the whole buffer is addressable by a base vertex.
+  uint64_t stride = ToSize(mesh->vertex_type);
+  uint64_t vertex_size = (kMinPoolVertexSize / stride) * stride;
+  pool->vertices = CreateRangeAllocator(vertex_size);
+  pool->indices = CreateRangeAllocator(kMinPoolIndexSize);
+  pool->vbo = CreateBuffer(GL_ARRAY_BUFFER, vertex_size);
+  pool->ebo = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, kMinPoolIndexSize);
+  SetupPoolVAO(pool.get());
+
+  LOG(OpenGL, "Created mesh pool %s/%s (VAO: %u).",
+      ToString(pool->vertex_type), ToString(pool->index_format), pool->vao);
+
+  MeshPool* pool_ptr = pool.get();
+  opengl->mesh_pools[key] = std::move(pool);
+  return pool_ptr;
+}
+
+// Which of the pool buffers is being moved.
+enum class PoolBuffer { kVertices, kIndices };
+
+// Moves one of the pool buffers into a new one of |new_size|, packing all the meshes at the start.
+// This both grows and defragments the pool. Updates the handles of all the meshes within the pool.
+void RelocatePoolBuffer(OpenGLRendererBackend* opengl, MeshPool* pool, PoolBuffer which,
+                        uint64_t new_size) {
+  bool vertices = which == PoolBuffer::kVertices;
+  RangeAllocator* allocator = vertices ? &pool->vertices : &pool->indices;
+  uint32_t* buffer = vertices ? &pool->vbo : &pool->ebo;
+  GLenum target = vertices ? GL_ARRAY_BUFFER : GL_ELEMENT_ARRAY_BUFFER;
+  uint64_t alignment = vertices ? ToSize(pool->vertex_type) : ToSize(pool->index_format);
+
+  // Collect the meshes in offset order, so the copies keep the same relative layout.
+  std::vector<MeshHandles*> members;
+  for (auto& [id, handles] : opengl->loaded_meshes) {
+    (void)id;
+    if (handles.pool == pool)
+      members.push_back(&handles);
+  }
+  std::sort(members.begin(), members.end(), [vertices](MeshHandles* a, MeshHandles* b) {
+    return vertices ? a->vertex_offset < b->vertex_offset : a->index_offset < b->index_offset;
+  });
+
+  uint32_t new_buffer = CreateBuffer(target, new_size);
+  RangeAllocator new_allocator = CreateRangeAllocator(new_size);
+
+  glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+  for (MeshHandles* handles : members) {
+    uint64_t* offset = vertices ? &handles->vertex_offset : &handles->index_offset;
+    uint64_t size = vertices ? handles->vertex_size : handles->index_size;
+    if (size == 0)
+      continue;
+
+    uint64_t new_offset = AllocateRange(&new_allocator, size, alignment);
+    ASSERT(new_offset != kInvalidRange);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, *offset, new_offset, size);
+    *offset = new_offset;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, NULL);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, NULL);
+
+  glDeleteBuffers(1, buffer);
+  *buffer = new_buffer;
+  *allocator = std::move(new_allocator);
+  SetupPoolVAO(pool);
+
+  for (MeshHandles* handles : members) {
+    handles->vbo = pool->vbo;
+    handles->ebo = pool->ebo;
+    handles->vao = pool->vao;
+    handles->base_vertex = (uint32_t)(handles->vertex_offset / ToSize(pool->vertex_type));
+  }
+
+  LOG(OpenGL, "Relocated mesh pool %s/%s %s: %zu meshes, %" PRIu64 " bytes.",
+      ToString(pool->vertex_type), ToString(pool->index_format),
+      vertices ? "vertices" : "indices", members.size(), new_size);
+}
+
+// Allocates |size| bytes within one of the pool buffers. If there is no room, the buffer is
+// defragmented (if the free space is enough) or grown.
+uint64_t AllocateInPool(OpenGLRendererBackend* opengl, MeshPool* pool, PoolBuffer which,
+                        uint64_t size) {
+  if (size == 0)
+    return 0;
+
+  bool vertices = which == PoolBuffer::kVertices;
+  RangeAllocator* allocator = vertices ? &pool->vertices : &pool->indices;
+  uint64_t alignment = vertices ? ToSize(pool->vertex_type) : ToSize(pool->index_format);
+
+  uint64_t offset = AllocateRange(allocator, size, alignment);
+  if (offset != kInvalidRange)
+    return offset;
+
+  // All sizes are multiples of the alignment, so packing the meshes leaves all the free space
+  // usable.
+  uint64_t new_size = allocator->size;
+  if (allocator->size - allocator->used < size) {
+    new_size = 2 * allocator->size;
+    while (new_size - allocator->used < size) {
+      new_size *= 2;
+    }
+  }
+
+  RelocatePoolBuffer(opengl, pool, which, new_size);
+  offset = AllocateRange(allocator, size, alignment);
+  ASSERT(offset != kInvalidRange);
+  return offset;
+}
+
+bool StageSharedMesh(OpenGLRendererBackend* opengl, Mesh* mesh, MeshHandles* out) {
+  MeshPool* pool = GetOrCreateMeshPool(opengl, mesh);
+
+  MeshHandles handles = {};
+  handles.pool = pool;
+  handles.vertex_size = mesh->vertices.size();
+  handles.index_size = mesh->indices.size();
+
+  // NOTE: Allocating can relocate the pool, so the buffers are read afterwards.
+  handles.vertex_offset = AllocateInPool(opengl, pool, PoolBuffer::kVertices, handles.vertex_size);
+  handles.index_offset = AllocateInPool(opengl, pool, PoolBuffer::kIndices, handles.index_size);
+  handles.base_vertex = (uint32_t)(handles.vertex_offset / ToSize(mesh->vertex_type));
+
+  handles.vbo = pool->vbo;
+  handles.ebo = pool->ebo;
+  handles.vao = pool->vao;
+
+  if (handles.vertex_size > 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, pool->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, handles.vertex_offset, handles.vertex_size,
+                    mesh->vertices.data());
+  }
+
+  if (handles.index_size > 0) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, handles.index_offset, handles.index_size,
+                    mesh->indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, NULL);
+  }
+
+  UnbindMeshHandles();
+
+  *out = std::move(handles);
+  return true;
+}
+
+// Dynamic Meshes ----------------------------------------------------------------------------------
+
+// Creates the storage for all the regions of the buffer bound to |target|.
+// Returns the persistent mapping, if any.
+uint8_t* CreateDynamicStorage(const OpenGLRendererBackend& opengl, GLenum target, uint64_t size) {
+  if (!opengl.buffer_storage_supported) {
+    glBufferData(target, size, nullptr, GL_DYNAMIC_DRAW);
+    return nullptr;
+  }
+
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glBufferStorage(target, size, nullptr, flags);
+  return (uint8_t*)glMapBufferRange(target, 0, size, flags);
+}
+
+// The fences guarantee nobody is reading this range, so there is no need for the driver to sync.
+// The range must be within the buffer (checked by the callers).
+bool WriteDynamicRange(GLenum target, uint32_t buffer, uint8_t* mapped, uint64_t offset,
+                       uint64_t size, const void* data) {
+  if (size == 0)
+    return true;
+
+  if (mapped) {
+    memcpy(mapped + offset, data, size);
+    return true;
+  }
+
+  glBindBuffer(target, buffer);
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+  void* ptr = glMapBufferRange(target, offset, size, flags);
+  if (!ptr) {
+    glBindBuffer(target, NULL);
+    ERROR(OpenGL, "Could not map buffer %u (offset: %" PRIu64 ", size: %" PRIu64 ").", buffer,
+          offset, size);
+    return false;
+  }
+
+  memcpy(ptr, data, size);
+  glUnmapBuffer(target);
+  glBindBuffer(target, NULL);
+  return true;
+}
+
+void WaitForRegion(Mesh* mesh, MeshHandles* handles, uint32_t region) {
+  GLsync fence = (GLsync)handles->region_fences[region];
+  if (!fence)
+    return;
+
+  // Only blocks if the CPU is more than |kDynamicMeshRegions| uploads ahead of the GPU.
+  constexpr GLuint64 kTimeout = 1000000000;   // 1 second, in nanoseconds.
+  GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kTimeout);
+  if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+    WARNING(OpenGL, "Mesh %s: Waiting for region %u failed.", mesh->name.c_str(), region);
+
+  glDeleteSync(fence);
+  handles->region_fences[region] = nullptr;
+}
+
+void SetDynamicRegion(Mesh* mesh, MeshHandles* handles, uint32_t region) {
+  handles->region = region;
+  handles->vertex_offset = region * handles->vertex_size;
+  handles->index_offset = region * handles->index_size;
+  handles->base_vertex = (uint32_t)(handles->vertex_offset / ToSize(mesh->vertex_type));
+}
+
+// Moves the mesh to the next region, which is safe to write once this returns.
+void AdvanceDynamicRegion(Mesh* mesh, MeshHandles* handles) {
+  // All the draws reading the current region have already been issued.
+  uint32_t current = handles->region;
+  ASSERT(handles->region_fences[current] == nullptr);
+  handles->region_fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  uint32_t next = (current + 1) % kDynamicMeshRegions;
+  WaitForRegion(mesh, handles, next);
+  SetDynamicRegion(mesh, handles, next);
+}
+
+bool StageDynamicMesh(const OpenGLRendererBackend& opengl, Mesh* mesh, MeshHandles* out) {
+  if (mesh->vertices.empty() || mesh->indices.empty()) {
+    ERROR(OpenGL, "Dynamic mesh %s must be staged with its capacity (see StageWithCapacity).",
+          mesh->name.c_str());
+    return false;
+  }
+
+  MeshHandles handles = GenerateMeshHandles();
+  handles.vertex_size = mesh->vertices.size();
+  handles.index_size = mesh->indices.size();
+
+  // Always bind the VAO first, so that it doesn't overwrite.
+  glBindVertexArray(handles.vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, handles.vbo);
+  handles.mapped_vertices = CreateDynamicStorage(opengl, GL_ARRAY_BUFFER,
+                                                 kDynamicMeshRegions * handles.vertex_size);
+  StageAttributes(mesh->vertex_type);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handles.ebo);
+  handles.mapped_indices = CreateDynamicStorage(opengl, GL_ELEMENT_ARRAY_BUFFER,
+                                                kDynamicMeshRegions * handles.index_size);
+
+  glBindVertexArray(NULL);
+  UnbindMeshHandles();
+
+  // The initial data goes into the first region.
+  SetDynamicRegion(mesh, &handles, 0);
+  if (!WriteDynamicRange(GL_ARRAY_BUFFER, handles.vbo, handles.mapped_vertices, 0,
+                         handles.vertex_size, mesh->vertices.data()) ||
+      !WriteDynamicRange(GL_COPY_WRITE_BUFFER, handles.ebo, handles.mapped_indices, 0,
+                         handles.index_size, mesh->indices.data())) {
+    glDeleteBuffers(2, (GLuint*)&handles);
+    glDeleteVertexArrays(1, &handles.vao);
+    return false;
+  }
+
+  *out = std::move(handles);
+  return true;
 }
 
 }  // namespace
@@ -175,21 +450,24 @@ bool OpenGLStageMesh(OpenGLRendererBackend* opengl, Mesh* mesh) {
     return false;
   }
 
-  // Always bind the VAO first, so that it doesn't overwrite.
-  MeshHandles handles = GenerateMeshHandles();
-
-  glBindVertexArray(handles.vao);
-  StageVertices(mesh, &handles);
-  StageIndices(mesh, &handles);
-  glBindVertexArray(NULL);
+  MeshHandles handles = {};
+  bool staged = false;
+  switch (mesh->usage) {
+    case MeshUsage::kStatic: staged = StageStaticMesh(mesh, &handles); break;
+    case MeshUsage::kShared: staged = StageSharedMesh(opengl, mesh, &handles); break;
+    case MeshUsage::kDynamic: staged = StageDynamicMesh(*opengl, mesh, &handles); break;
+    case MeshUsage::kLast: NOT_REACHED(); break;
+  }
 
-  UnbindMeshHandles();
+  if (!staged)
+    return false;
 
   LOG(OpenGL,
-      "Staging mesh %s (uuid: %u, VAO: %u) [%u vertices (%zu bytes)] [%lu indices (%zu bytes)]",
-      mesh->name.c_str(), mesh->id, handles.vao,
+      "Staging %s mesh %s (uuid: %u, VAO: %u, base vertex: %u) "
+      "[%u vertices (%zu bytes)] [%u %s indices (%zu bytes)]",
+      ToString(mesh->usage), mesh->name.c_str(), mesh->id, handles.vao, handles.base_vertex,
       mesh->vertex_count, mesh->vertices.size(),
-      mesh->indices.size(), mesh->indices.size() * sizeof(Mesh::IndexType));
+      mesh->index_count, ToString(mesh->index_format), mesh->indices.size());
 
   opengl->loaded_meshes[mesh->id] = std::move(handles);
 #if DEBUG_MODE
@@ -205,6 +483,22 @@ bool OpenGLStageMesh(OpenGLRendererBackend* opengl, Mesh* mesh) {
 namespace {
 
 void DeleteMeshHandles(MeshHandles* handles) {
+  // Shared meshes only give back their ranges. The pool buffers stay alive for the next meshes.
+  if (MeshPool* pool = handles->pool; pool) {
+    if (handles->vertex_size > 0)
+      FreeRange(&pool->vertices, handles->vertex_offset, handles->vertex_size);
+    if (handles->index_size > 0)
+      FreeRange(&pool->indices, handles->index_offset, handles->index_size);
+    return;
+  }
+
+  for (void*& fence : handles->region_fences) {
+    if (fence)
+      glDeleteSync((GLsync)fence);
+    fence = nullptr;
+  }
+
+  // Deleting the buffers also unmaps them.
   glDeleteBuffers(2, (GLuint*)handles);
   glDeleteVertexArrays(1, &handles->vao);
 }
@@ -229,19 +523,20 @@ void OpenGLUnstageMesh(OpenGLRendererBackend* opengl, Mesh* mesh) {
 
 namespace {
 
-void VerifyBufferSize(Mesh* mesh, GLenum target, uint32_t size, uint32_t offset) {
-  GLint gl_size= 0;
-  glGetBufferParameteriv(target, GL_BUFFER_SIZE, &gl_size);
-  uint64_t buf_size = (uint64_t)gl_size;
-  uint32_t total = size + offset;
+bool UploadDynamicMeshRange(Mesh* mesh, MeshHandles* handles, uint32_t vertex_offset,
+                            uint32_t vertex_size, uint32_t index_offset, uint32_t index_size) {
+  AdvanceDynamicRegion(mesh, handles);
 
-  ASSERT_MSG(buf_size >= (size + offset), "Mesh %s (%s): Buf size exceeded. %" PRIu64 " <= %u",
-             mesh->name.c_str(), ToString(target), buf_size, total);
+  return WriteDynamicRange(GL_ARRAY_BUFFER, handles->vbo, handles->mapped_vertices,
+                           handles->vertex_offset + vertex_offset, vertex_size,
+                           mesh->vertices.data()) &&
+         WriteDynamicRange(GL_COPY_WRITE_BUFFER, handles->ebo, handles->mapped_indices,
+                           handles->index_offset + index_offset, index_size,
+                           mesh->indices.data());
 }
 
 }  // namespace
 
-
 bool OpenGLUploadMeshRange(OpenGLRendererBackend* opengl, Mesh* mesh,
                            Int2 vertex_range, Int2 index_range) {
   auto it = opengl->loaded_meshes.find(mesh->id);
@@ -252,39 +547,66 @@ bool OpenGLUploadMeshRange(OpenGLRendererBackend* opengl, Mesh* mesh,
 
   MeshHandles& handles = it->second;
 
-  // Vertices.
-  {
-    uint32_t vertex_size = ToSize(mesh->vertex_type);
-    uint32_t offset = vertex_range.x;
-    uint32_t size = vertex_range.y;
-    if (size == 0)
-      size = mesh->vertex_count * vertex_size;
+  uint32_t vertex_offset = vertex_range.x;
+  uint32_t vertex_size = vertex_range.y;
+  if (vertex_size == 0)
+    vertex_size = mesh->vertex_count * ToSize(mesh->vertex_type);
+
+  uint32_t index_offset = index_range.x;
+  uint32_t index_size = index_range.y;
+  if (index_size == 0)
+    index_size = mesh->index_count * ToSize(mesh->index_format);
+
+  // The sizes are tracked since staging, so there is no need to query the driver. Dynamic meshes
+  // write straight into mapped memory, so going over would corrupt it instead of a GL error.
+  if ((uint64_t)vertex_offset + vertex_size > handles.vertex_size) {
+    ERROR(OpenGL, "Mesh %s: Vertex range out of bounds. %" PRIu64 " < %" PRIu64,
+          mesh->name.c_str(), handles.vertex_size, (uint64_t)vertex_offset + vertex_size);
+    return false;
+  }
 
+  if ((uint64_t)index_offset + index_size > handles.index_size) {
+    ERROR(OpenGL, "Mesh %s: Index range out of bounds. %" PRIu64 " < %" PRIu64,
+          mesh->name.c_str(), handles.index_size, (uint64_t)index_offset + index_size);
+    return false;
+  }
+
+  if (mesh->usage == MeshUsage::kDynamic) {
+    return UploadDynamicMeshRange(mesh, &handles, vertex_offset, vertex_size, index_offset,
+                                  index_size);
+  }
+
+  // Vertices.
+  if (vertex_size > 0) {
     glBindBuffer(GL_ARRAY_BUFFER, handles.vbo);
-#if DEBUG_MODE
-    VerifyBufferSize(mesh, GL_ARRAY_BUFFER, size, offset);
-#endif
-    glBufferSubData(GL_ARRAY_BUFFER, offset, size, mesh->vertices.data());
+    glBufferSubData(GL_ARRAY_BUFFER, handles.vertex_offset + vertex_offset, vertex_size,
+                    mesh->vertices.data());
     glBindBuffer(GL_ARRAY_BUFFER, NULL);
   }
 
   // Indices.
-  {
-    uint32_t offset = index_range.x;
-    uint32_t size = index_range.y;
-    if (size == 0)
-      size = mesh->indices.size() * sizeof(Mesh::IndexType);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handles.ebo);
-#if DEBUG_MODE
-    VerifyBufferSize(mesh, GL_ELEMENT_ARRAY_BUFFER, size, offset);
-#endif
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, mesh->indices.data());
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, NULL);
+  // Binding the element buffer outside a VAO is not a good idea, so use a generic target.
+  if (index_size > 0) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, handles.ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, handles.index_offset + index_offset, index_size,
+                    mesh->indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, NULL);
   }
 
   return true;
 }
 
+// Mesh Pools --------------------------------------------------------------------------------------
+
+void OpenGLDeleteMeshPools(OpenGLRendererBackend* opengl) {
+  for (auto& [key, pool] : opengl->mesh_pools) {
+    (void)key;
+    glDeleteBuffers(1, &pool->vbo);
+    glDeleteBuffers(1, &pool->ebo);
+    glDeleteVertexArrays(1, &pool->vao);
+  }
+  opengl->mesh_pools.clear();
+}
+
 }  // namespace opengl
 }  // namespace rothko
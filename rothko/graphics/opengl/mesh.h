@@ -18,5 +18,8 @@ void OpenGLUnstageMesh(OpenGLRendererBackend*, Mesh*);
 
 bool OpenGLUploadMeshRange(OpenGLRendererBackend*, Mesh*, Int2 vertex_range, Int2 index_range);
 
+// Frees the buffers of all the shared mesh pools. Meant for shutdown.
+void OpenGLDeleteMeshPools(OpenGLRendererBackend*);
+
 }  // namespace opengl
 }  // namespace rothko
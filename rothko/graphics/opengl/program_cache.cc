@@ -0,0 +1,173 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/opengl/program_cache.h"
+
+#include <GL/gl3w.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "rothko/graphics/opengl/renderer_backend.h"
+#include "rothko/graphics/shader.h"
+#include "rothko/logging/logging.h"
+#include "rothko/math/hash.h"
+#include "rothko/platform/platform.h"
+#include "rothko/utils/defer.h"
+#include "rothko/utils/file.h"
+#include "rothko/utils/strings.h"
+
+namespace rothko {
+namespace opengl {
+
+namespace {
+
+constexpr uint32_t kProgramCacheMagic = 0x43505452;   // "RTPC"
+constexpr uint32_t kProgramCacheVersion = 1;
+
+struct ProgramCacheHeader {
+  uint32_t magic = kProgramCacheMagic;
+  uint32_t version = kProgramCacheVersion;
+  uint64_t key = 0;
+  uint32_t format = 0;    // GLenum returned by glGetProgramBinary.
+  uint32_t size = 0;      // Of the binary that follows.
+};
+
+std::string GetEntryPath(const OpenGLRendererBackend& opengl, uint64_t key) {
+  return JoinPaths({opengl.program_cache_dir,
+                    StringPrintf("%016llx.glprogram", (unsigned long long)key)});
+}
+
+// A missing entry is the normal case, so unlike |ReadWholeFile| this doesn't complain about it.
+bool ReadEntry(const std::string& path, std::vector<uint8_t>* out) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  DEFER([file]() { fclose(file); });
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (size <= (long)sizeof(ProgramCacheHeader))
+    return false;
+
+  out->resize(size);
+  return fread(out->data(), 1, size, file) == (size_t)size;
+}
+
+}  // namespace
+
+bool ProgramBinariesSupported() {
+  if (!glGetProgramBinary || !glProgramBinary)
+    return false;
+
+  // Some drivers expose the functions but no formats, which means they can't actually do it.
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  return formats > 0;
+}
+
+uint64_t GetDriverHash() {
+  uint64_t hash = kFNV1a64Hash;
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const char* str = (const char*)glGetString(name);
+    if (str)
+      hash = FNA1a64Hash(str, strlen(str), hash);
+  }
+  return hash;
+}
+
+bool SetProgramCacheDir(OpenGLRendererBackend* opengl, const std::string& dir) {
+  opengl->program_cache_dir.clear();
+  if (dir.empty())
+    return true;
+
+  if (!opengl->program_binary_supported) {
+    WARNING(OpenGL, "Program binaries not supported by the driver. Not caching shaders.");
+    return false;
+  }
+
+  if (!IsDirectory(dir)) {
+    WARNING(OpenGL, "Program cache dir %s is not a directory. Not caching shaders.", dir.c_str());
+    return false;
+  }
+
+  opengl->program_cache_dir = dir;
+  return true;
+}
+
+bool ProgramCacheEnabled(const OpenGLRendererBackend& opengl) {
+  return !opengl.program_cache_dir.empty();
+}
+
+uint64_t GetProgramCacheKey(const OpenGLRendererBackend& opengl, const Shader& shader) {
+  uint64_t key = FNA1a64Hash(&opengl.driver_hash, sizeof(opengl.driver_hash));
+  key = FNA1a64Hash(shader.vert_src.data(), shader.vert_src.size(), key);
+  // Separate the sources, so that moving code between them changes the key.
+  key = FNA1a64Hash("\0", 1, key);
+  key = FNA1a64Hash(shader.frag_src.data(), shader.frag_src.size(), key);
+  return key;
+}
+
+uint32_t LoadCachedProgram(const OpenGLRendererBackend& opengl, uint64_t key) {
+  std::vector<uint8_t> data;
+  if (!ReadEntry(GetEntryPath(opengl, key), &data))
+    return 0;
+
+  ProgramCacheHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kProgramCacheMagic || header.version != kProgramCacheVersion ||
+      header.key != key || sizeof(header) + header.size != data.size()) {
+    return 0;
+  }
+
+  uint32_t program = glCreateProgram();
+  glProgramBinary(program, header.format, data.data() + sizeof(header), header.size);
+
+  // The driver is free to reject binaries (eg. it was updated).
+  GLint success = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (success == GL_FALSE) {
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
+}
+
+void StoreProgramBinary(const OpenGLRendererBackend& opengl, uint64_t key, uint32_t program) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  ProgramCacheHeader header = {};
+  header.key = key;
+  header.size = length;
+
+  std::vector<uint8_t> data(sizeof(header) + length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, nullptr, &format, data.data() + sizeof(header));
+  header.format = format;
+  memcpy(data.data(), &header, sizeof(header));
+
+  // Write to a temporary and then move it, so a crash never leaves a half written entry.
+  std::string path = GetEntryPath(opengl, key);
+  std::string tmp_path = path + ".tmp";
+  {
+    FileHandle file = OpenFile(tmp_path, false, true);
+    if (!Valid(file))
+      return;
+    WriteToFile(&file, data.data(), data.size());
+  }
+
+  remove(path.c_str());
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    WARNING(OpenGL, "Could not write program cache entry %s.", path.c_str());
+    remove(tmp_path.c_str());
+  }
+}
+
+}  // namespace opengl
+}  // namespace rothko
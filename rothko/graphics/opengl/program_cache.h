@@ -0,0 +1,47 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+namespace rothko {
+
+struct Shader;
+
+namespace opengl {
+
+struct OpenGLRendererBackend;
+
+// Program Binary Cache ----------------------------------------------------------------------------
+//
+// Linked programs are stored on disk (glGetProgramBinary) and loaded back on later runs
+// (glProgramBinary), skipping compilation and linking.
+//
+// Entries are keyed by a hash of the shader sources and the driver identity (vendor, renderer and
+// version strings), so changing either simply misses the cache. Drivers can still reject a binary
+// (eg. after an update that kept the version string), in which case the caller should compile
+// from source and store the program again.
+
+// Whether the context can retrieve program binaries. Call once at init.
+bool ProgramBinariesSupported();
+
+// Hash of the GL_VENDOR, GL_RENDERER and GL_VERSION strings.
+uint64_t GetDriverHash();
+
+// Returns false (and leaves the cache disabled) if |dir| is not a directory. Empty disables it.
+bool SetProgramCacheDir(OpenGLRendererBackend*, const std::string& dir);
+bool ProgramCacheEnabled(const OpenGLRendererBackend&);
+
+uint64_t GetProgramCacheKey(const OpenGLRendererBackend&, const Shader&);
+
+// Returns a linked program or 0 if there was no valid entry.
+uint32_t LoadCachedProgram(const OpenGLRendererBackend&, uint64_t key);
+
+// |program| must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+void StoreProgramBinary(const OpenGLRendererBackend&, uint64_t key, uint32_t program);
+
+}  // namespace opengl
+}  // namespace rothko
@@ -0,0 +1,139 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/opengl/readback.h"
+
+#include <GL/gl3w.h>
+
+#include "rothko/graphics/opengl/render_target.h"
+#include "rothko/graphics/opengl/renderer_backend.h"
+#include "rothko/logging/logging.h"
+
+namespace rothko {
+namespace opengl {
+
+namespace {
+
+uint32_t GetPBO(OpenGLRendererBackend* opengl) {
+  if (!opengl->readback_pbos.empty()) {
+    uint32_t pbo = opengl->readback_pbos.back();
+    opengl->readback_pbos.pop_back();
+    return pbo;
+  }
+
+  uint32_t pbo = 0;
+  glGenBuffers(1, &pbo);
+  return pbo;
+}
+
+void Deliver(OpenGLRendererBackend* opengl, PendingReadback* readback) {
+  uint32_t data_size = readback->size.width * readback->size.height * 4;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+  void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, data_size, GL_MAP_READ_BIT);
+  if (data) {
+    ReadbackResult result = {};
+    result.pos = readback->pos;
+    result.size = readback->size;
+    result.data = (const uint8_t*)data;
+    readback->callback(result);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else {
+    ERROR(OpenGL, "Could not map readback buffer of size %s.", ToString(readback->size).c_str());
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, NULL);
+
+  glDeleteSync((GLsync)readback->fence);
+  opengl->readback_pbos.push_back(readback->pbo);
+}
+
+}  // namespace
+
+void OpenGLReadback(OpenGLRendererBackend* opengl, const Readback& readback) {
+  ASSERT(readback.callback);
+
+  uint32_t read_fbo = 0;
+  Int2 pos = readback.pos;
+  Int2 size = readback.size;
+  if (readback.source) {
+    for (int i = 0; i <= opengl->render_target_index; i++) {
+      ASSERT_MSG(opengl->render_targets[i].target != readback.source ||
+                 readback.source->samples <= 1,
+                 "Render target %s: Reading a bound multisampled target (pop it first).",
+                 readback.source->name.c_str());
+    }
+
+    read_fbo = OpenGLGetResolvedFramebuffer(*opengl, *readback.source);
+    if (IsZero(size))
+      size = GetRenderSize(*readback.source);
+  } else {
+    read_fbo = OpenGLGetDrawFramebuffer(*opengl);
+    if (IsZero(size)) {
+      int viewport[4];
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      pos = {viewport[0], viewport[1]};
+      size = {viewport[2], viewport[3]};
+    }
+  }
+
+  if (size.width <= 0 || size.height <= 0) {
+    ERROR(OpenGL, "Readback with invalid size %s.", ToString(size).c_str());
+    return;
+  }
+
+  PendingReadback pending = {};
+  pending.pbo = GetPBO(opengl);
+  pending.pos = pos;
+  pending.size = size;
+  pending.callback = readback.callback;
+
+  // With a pack buffer bound, glReadPixels only schedules the copy into it.
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+  glReadBuffer(read_fbo == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pending.pbo);
+  glBufferData(GL_PIXEL_PACK_BUFFER, size.width * size.height * 4, nullptr, GL_STREAM_READ);
+  glReadPixels(pos.x, pos.y, size.width, size.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, NULL);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, OpenGLGetDrawFramebuffer(*opengl));
+
+  pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  opengl->pending_readbacks.push_back(std::move(pending));
+}
+
+void OpenGLProcessReadbacks(OpenGLRendererBackend* opengl, bool wait) {
+  // Fences signal in order, so we can stop at the first one that is not done.
+  constexpr GLuint64 kWaitTimeout = 1000000000;   // 1 second, in nanoseconds.
+  uint32_t done = 0;
+  for (PendingReadback& readback : opengl->pending_readbacks) {
+    GLenum result = glClientWaitSync((GLsync)readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     wait ? kWaitTimeout : 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+      break;
+
+    if (result == GL_WAIT_FAILED) {
+      ERROR(OpenGL, "Waiting for readback failed.");
+      glDeleteSync((GLsync)readback.fence);
+      opengl->readback_pbos.push_back(readback.pbo);
+    } else {
+      Deliver(opengl, &readback);
+    }
+    done++;
+  }
+
+  auto& pending = opengl->pending_readbacks;
+  pending.erase(pending.begin(), pending.begin() + done);
+}
+
+void OpenGLDeleteReadbacks(OpenGLRendererBackend* opengl) {
+  for (PendingReadback& readback : opengl->pending_readbacks) {
+    glDeleteSync((GLsync)readback.fence);
+    opengl->readback_pbos.push_back(readback.pbo);
+  }
+  opengl->pending_readbacks.clear();
+
+  if (!opengl->readback_pbos.empty())
+    glDeleteBuffers(opengl->readback_pbos.size(), opengl->readback_pbos.data());
+  opengl->readback_pbos.clear();
+}
+
+}  // namespace opengl
+}  // namespace rothko
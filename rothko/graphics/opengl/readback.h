@@ -0,0 +1,23 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include "rothko/graphics/commands.h"
+
+namespace rothko {
+namespace opengl {
+
+struct OpenGLRendererBackend;
+
+// Issues the copy into a pixel buffer object. Never waits on the GPU.
+void OpenGLReadback(OpenGLRendererBackend*, const Readback&);
+
+// Delivers the readbacks the GPU is done with. |wait| blocks until all of them are.
+void OpenGLProcessReadbacks(OpenGLRendererBackend*, bool wait);
+
+// Frees the buffers and fences, without delivering the pending readbacks.
+void OpenGLDeleteReadbacks(OpenGLRendererBackend*);
+
+}  // namespace opengl
+}  // namespace rothko
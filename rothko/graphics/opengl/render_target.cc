@@ -0,0 +1,308 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/opengl/render_target.h"
+
+#include <GL/gl3w.h>
+
+#include <atomic>
+
+#include "rothko/graphics/opengl/renderer_backend.h"
+#include "rothko/graphics/opengl/texture.h"
+#include "rothko/logging/logging.h"
+
+namespace rothko {
+namespace opengl {
+
+namespace {
+
+std::atomic<uint32_t> kNextRenderTargetUUID = 1;
+uint32_t GetNextRenderTargetUUID() {
+  uint32_t id = kNextRenderTargetUUID++;
+  ASSERT(id < UINT32_MAX);
+  return id;
+}
+
+const char* FramebufferStatusToString(GLenum status) {
+  switch (status) {
+    case GL_FRAMEBUFFER_COMPLETE: return "GL_FRAMEBUFFER_COMPLETE";
+    case GL_FRAMEBUFFER_UNDEFINED: return "GL_FRAMEBUFFER_UNDEFINED";
+    case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: return "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
+    case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
+      return "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
+    case GL_FRAMEBUFFER_UNSUPPORTED: return "GL_FRAMEBUFFER_UNSUPPORTED";
+    case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: return "GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE";
+    default: break;
+  }
+
+  return "<unknown>";
+}
+
+bool CheckFramebuffer(const RenderTarget& rt, uint32_t fbo) {
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    ERROR(OpenGL, "Render target %s: Incomplete framebuffer: %s", rt.name.c_str(),
+          FramebufferStatusToString(status));
+    return false;
+  }
+
+  return true;
+}
+
+uint32_t CreateRenderbuffer(GLenum internal_format, Int2 size, uint32_t samples) {
+  uint32_t rbo = 0;
+  glGenRenderbuffers(1, &rbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+  if (samples > 1) {
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internal_format, size.width,
+                                     size.height);
+  } else {
+    glRenderbufferStorage(GL_RENDERBUFFER, internal_format, size.width, size.height);
+  }
+  glBindRenderbuffer(GL_RENDERBUFFER, NULL);
+  return rbo;
+}
+
+void FreeHandles(RenderTargetHandles* handles) {
+  glDeleteFramebuffers(1, &handles->fbo);
+  glDeleteFramebuffers(1, &handles->msaa_fbo);
+  glDeleteRenderbuffers(1, &handles->depth_rbo);
+  glDeleteRenderbuffers(1, &handles->msaa_color_rbo);
+}
+
+bool Validate(const RenderTarget& rt) {
+  if (rt.size.width <= 0 || rt.size.height <= 0) {
+    ERROR(OpenGL, "Render target %s: Invalid size %s.", rt.name.c_str(),
+          ToString(rt.size).c_str());
+    return false;
+  }
+
+  if (rt.color_type == TextureType::kLast && !rt.depth) {
+    ERROR(OpenGL, "Render target %s: Needs at least one attachment.", rt.name.c_str());
+    return false;
+  }
+
+  if (rt.color_type != TextureType::kLast && IsCompressed(rt.color_type)) {
+    ERROR(OpenGL, "Render target %s: Cannot render into compressed type %s.", rt.name.c_str(),
+          ToString(rt.color_type));
+    return false;
+  }
+
+  Int2 render_size = GetRenderSize(rt);
+  if (render_size.width > rt.size.width || render_size.height > rt.size.height) {
+    ERROR(OpenGL, "Render target %s: Render size %s doesn't fit in %s.", rt.name.c_str(),
+          ToString(render_size).c_str(), ToString(rt.size).c_str());
+    return false;
+  }
+
+  return true;
+}
+
+const RenderTargetHandles& GetHandles(const OpenGLRendererBackend& opengl,
+                                      const RenderTarget& rt) {
+  auto it = opengl.loaded_render_targets.find(rt.uuid.value);
+  ASSERT(it != opengl.loaded_render_targets.end());
+  return it->second;
+}
+
+}  // namespace
+
+uint32_t OpenGLGetDrawFramebuffer(const OpenGLRendererBackend& opengl) {
+  if (opengl.render_target_index < 0)
+    return 0;
+
+  const RenderTarget* target = opengl.render_targets[opengl.render_target_index].target;
+  const RenderTargetHandles& handles = GetHandles(opengl, *target);
+  return handles.msaa_fbo != 0 ? handles.msaa_fbo : handles.fbo;
+}
+
+uint32_t OpenGLGetResolvedFramebuffer(const OpenGLRendererBackend& opengl,
+                                      const RenderTarget& rt) {
+  return GetHandles(opengl, rt).fbo;
+}
+
+// Stage Render Target -----------------------------------------------------------------------------
+
+bool OpenGLStageRenderTarget(OpenGLRendererBackend* opengl, RenderTarget* rt) {
+  LOG(OpenGL, "Staging render target %s [Color: %s, Depth: %s, Size: %s, Samples: %u]",
+              rt->name.c_str(),
+              ToString(rt->color_type),
+              rt->depth ? "true" : "false",
+              ToString(rt->size).c_str(),
+              rt->samples);
+
+  if (!Validate(*rt))
+    return false;
+
+  bool multisampled = rt->samples > 1;
+  bool has_color = rt->color_type != TextureType::kLast;
+
+  RenderTargetHandles handles;
+  std::unique_ptr<Texture> color_texture;
+  if (has_color) {
+    color_texture = std::make_unique<Texture>();
+    color_texture->name = rt->name + "-color";
+    color_texture->type = rt->color_type;
+    color_texture->size = rt->size;
+    color_texture->wrap_mode_u = TextureWrapMode::kClampToEdge;
+    color_texture->wrap_mode_v = TextureWrapMode::kClampToEdge;
+    color_texture->min_filter = rt->filter;
+    color_texture->mag_filter = rt->filter;
+    color_texture->mipmaps = 0;
+
+    // Without data only the storage gets allocated.
+    if (!OpenGLStageTexture(opengl, color_texture.get()))
+      return false;
+  }
+
+  // Multisampled targets render into renderbuffers and get resolved into the texture.
+  glGenFramebuffers(1, &handles.fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, handles.fbo);
+  if (has_color) {
+    auto tex_it = opengl->loaded_textures.find(color_texture->uuid.value);
+    ASSERT(tex_it != opengl->loaded_textures.end());
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           tex_it->second.tex_handle, 0);
+  } else {
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+  }
+
+  if (multisampled) {
+    glGenFramebuffers(1, &handles.msaa_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, handles.msaa_fbo);
+    if (has_color) {
+      handles.msaa_color_rbo = CreateRenderbuffer(TextureTypeToInternalFormat(rt->color_type),
+                                                  rt->size, rt->samples);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                                handles.msaa_color_rbo);
+    } else {
+      glDrawBuffer(GL_NONE);
+      glReadBuffer(GL_NONE);
+    }
+  }
+
+  if (rt->depth) {
+    handles.depth_rbo = CreateRenderbuffer(GL_DEPTH_COMPONENT24, rt->size, rt->samples);
+    glBindFramebuffer(GL_FRAMEBUFFER, multisampled ? handles.msaa_fbo : handles.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                              handles.depth_rbo);
+  }
+
+  bool complete = CheckFramebuffer(*rt, handles.fbo) &&
+                  (!multisampled || CheckFramebuffer(*rt, handles.msaa_fbo));
+  glBindFramebuffer(GL_FRAMEBUFFER, OpenGLGetDrawFramebuffer(*opengl));
+  if (!complete) {
+    FreeHandles(&handles);
+    if (color_texture)
+      OpenGLUnstageTexture(opengl, color_texture.get());
+    return false;
+  }
+
+  uint32_t uuid = GetNextRenderTargetUUID();
+  opengl->loaded_render_targets[uuid] = std::move(handles);
+  rt->color_texture = std::move(color_texture);
+  rt->uuid = uuid;
+  return true;
+}
+
+// Unstage Render Target ---------------------------------------------------------------------------
+
+void OpenGLUnstageRenderTarget(OpenGLRendererBackend* opengl, RenderTarget* rt) {
+  for (int i = 0; i <= opengl->render_target_index; i++) {
+    ASSERT_MSG(opengl->render_targets[i].target != rt,
+               "Render target %s: Unstaged while bound.", rt->name.c_str());
+  }
+
+  auto it = opengl->loaded_render_targets.find(rt->uuid.value);
+  ASSERT(it != opengl->loaded_render_targets.end());
+
+  FreeHandles(&it->second);
+  opengl->loaded_render_targets.erase(it);
+
+  if (rt->color_texture) {
+    OpenGLUnstageTexture(opengl, rt->color_texture.get());
+    rt->color_texture.reset();
+  }
+
+  rt->uuid.clear();
+}
+
+// Commands ----------------------------------------------------------------------------------------
+
+void OpenGLPushRenderTarget(OpenGLRendererBackend* opengl, const PushRenderTarget& push) {
+  ASSERT(push.target);
+  ASSERT_MSG(Staged(*push.target), "Render target %s is not staged.", push.target->name.c_str());
+
+  opengl->render_target_index++;
+  ASSERT(opengl->render_target_index < kMaxRenderTargetCount);
+
+  BoundRenderTarget* bound = opengl->render_targets + opengl->render_target_index;
+  bound->target = push.target;
+  glGetIntegerv(GL_VIEWPORT, bound->prev_viewport);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, OpenGLGetDrawFramebuffer(*opengl));
+  Int2 render_size = GetRenderSize(*push.target);
+  glViewport(0, 0, render_size.width, render_size.height);
+}
+
+void OpenGLPopRenderTarget(OpenGLRendererBackend* opengl) {
+  ASSERT(opengl->render_target_index >= 0);
+  BoundRenderTarget* bound = opengl->render_targets + opengl->render_target_index;
+
+  // Resolve the rendered region into the texture.
+  const RenderTargetHandles& handles = GetHandles(*opengl, *bound->target);
+  if (handles.msaa_fbo != 0 && handles.msaa_color_rbo != 0) {
+    Int2 size = GetRenderSize(*bound->target);
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, handles.msaa_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, handles.fbo);
+    glBlitFramebuffer(0, 0, size.width, size.height, 0, 0, size.width, size.height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  }
+
+  const int* viewport = bound->prev_viewport;
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  *bound = {};
+  opengl->render_target_index--;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, OpenGLGetDrawFramebuffer(*opengl));
+}
+
+void OpenGLBlitRenderTarget(OpenGLRendererBackend* opengl, const BlitRenderTarget& blit) {
+  const RenderTarget* source = blit.source;
+  ASSERT(source);
+  ASSERT_MSG(source->color_type != TextureType::kLast, "Render target %s has no color.",
+             source->name.c_str());
+  for (int i = 0; i <= opengl->render_target_index; i++) {
+    ASSERT_MSG(opengl->render_targets[i].target != source,
+               "Render target %s: Blitting from a bound target (pop it first).",
+               source->name.c_str());
+  }
+
+  Int2 dest_pos = blit.dest_pos;
+  Int2 dest_size = blit.dest_size;
+  if (IsZero(dest_size)) {
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    dest_pos = {viewport[0], viewport[1]};
+    dest_size = {viewport[2], viewport[3]};
+  }
+
+  Int2 src_size = GetRenderSize(*source);
+  GLenum filter = source->filter == TextureFilterMode::kNearest ? GL_NEAREST : GL_LINEAR;
+
+  // Blits are clipped by the scissor.
+  glDisable(GL_SCISSOR_TEST);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, OpenGLGetResolvedFramebuffer(*opengl, *source));
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OpenGLGetDrawFramebuffer(*opengl));
+  glBlitFramebuffer(0, 0, src_size.width, src_size.height,
+                    dest_pos.x, dest_pos.y, dest_pos.x + dest_size.width,
+                    dest_pos.y + dest_size.height,
+                    GL_COLOR_BUFFER_BIT, filter);
+  glBindFramebuffer(GL_FRAMEBUFFER, OpenGLGetDrawFramebuffer(*opengl));
+}
+
+}  // namespace opengl
+}  // namespace rothko
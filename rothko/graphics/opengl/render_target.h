@@ -0,0 +1,29 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "rothko/graphics/commands.h"
+#include "rothko/graphics/render_target.h"
+
+namespace rothko {
+namespace opengl {
+
+struct OpenGLRendererBackend;
+
+bool OpenGLStageRenderTarget(OpenGLRendererBackend*, RenderTarget*);
+void OpenGLUnstageRenderTarget(OpenGLRendererBackend*, RenderTarget*);
+
+// The framebuffer being rendered into: the one of the top render target or 0 (the window).
+uint32_t OpenGLGetDrawFramebuffer(const OpenGLRendererBackend&);
+// The one holding |RenderTarget::color_texture|.
+uint32_t OpenGLGetResolvedFramebuffer(const OpenGLRendererBackend&, const RenderTarget&);
+
+void OpenGLPushRenderTarget(OpenGLRendererBackend*, const PushRenderTarget&);
+void OpenGLPopRenderTarget(OpenGLRendererBackend*);
+void OpenGLBlitRenderTarget(OpenGLRendererBackend*, const BlitRenderTarget&);
+
+}  // namespace opengl
+}  // namespace rothko
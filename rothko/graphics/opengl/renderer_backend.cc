@@ -4,11 +4,16 @@
 #include "rothko/graphics/opengl/renderer_backend.h"
 
 #include <GL/gl3w.h>
+#include <string.h>
 
 #include <memory>
 #include <sstream>
 
+#include "rothko/graphics/opengl/instance_set.h"
 #include "rothko/graphics/opengl/mesh.h"
+#include "rothko/graphics/opengl/program_cache.h"
+#include "rothko/graphics/opengl/readback.h"
+#include "rothko/graphics/opengl/render_target.h"
 #include "rothko/graphics/opengl/shader.h"
 #include "rothko/graphics/opengl/texture.h"
 #include "rothko/graphics/renderer.h"
@@ -98,6 +103,44 @@ Gl3wInitResultToString(int res) {
 
 std::unique_ptr<OpenGLRendererBackend> gBackend;
 
+bool SupportsExtension(const char* name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++) {
+    const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+    if (strcmp(extension, name) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+bool SupportsMultiDraw() {
+  if (!gl3wIsSupported(4, 3))
+    return false;
+  return SupportsExtension("GL_ARB_shader_draw_parameters");
+}
+
+// gl3w only loads core functions, so the extension ones are queried directly.
+using MaxShaderCompilerThreadsFunction = void (APIENTRY*)(GLuint count);
+
+bool InitParallelShaderCompile() {
+  const char* function_name = nullptr;
+  if (SupportsExtension("GL_KHR_parallel_shader_compile")) {
+    function_name = "glMaxShaderCompilerThreadsKHR";
+  } else if (SupportsExtension("GL_ARB_parallel_shader_compile")) {
+    function_name = "glMaxShaderCompilerThreadsARB";
+  } else {
+    return false;
+  }
+
+  // Let the driver choose how many threads to use (the default can be 0, meaning none).
+  auto max_threads = (MaxShaderCompilerThreadsFunction)gl3wGetProcAddress(function_name);
+  if (max_threads)
+    max_threads(0xFFFFFFFF);
+  return true;
+}
+
 std::unique_ptr<Texture> CreateWhiteTexture(OpenGLRendererBackend* opengl) {
   auto texture = std::make_unique<Texture>();
   texture->name = "opengl-default-white";
@@ -106,7 +149,7 @@ std::unique_ptr<Texture> CreateWhiteTexture(OpenGLRendererBackend* opengl) {
   texture->mipmaps = 0;
   texture->min_filter = TextureFilterMode::kNearest;
   texture->mag_filter = TextureFilterMode::kNearest;
-  texture->data = std::make_unique<uint8_t[]>(sizeof(uint32_t));
+  texture->data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(sizeof(uint32_t));
   *(uint32_t*)texture->data.get() = ToUint32(Color::White());
 
   if (!OpenGLStageTexture(opengl, texture.get()))
@@ -131,6 +174,13 @@ OpenGLRendererBackend::~OpenGLRendererBackend() {
     OpenGLUnstageTexture(this, white_texture.get());
     white_texture.reset();
   }
+
+  OpenGLDeleteMeshPools(this);
+  OpenGLDeleteReadbacks(this);
+  OpenGLShutdownInstanceCulling(this);
+
+  if (indirect_buffer != 0)
+    glDeleteBuffers(1, &indirect_buffer);
 }
 
 }  // opengl
@@ -166,6 +216,23 @@ std::unique_ptr<Renderer> InitRenderer() {
 
   gBackend = std::make_unique<OpenGLRendererBackend>();
 
+  gBackend->buffer_storage_supported = gl3wIsSupported(4, 4);
+  gBackend->multi_draw_supported = SupportsMultiDraw();
+  LOG(OpenGL, "Multi-draw supported: %s", gBackend->multi_draw_supported ? "true" : "false");
+  if (gBackend->multi_draw_supported)
+    glGenBuffers(1, &gBackend->indirect_buffer);
+
+  OpenGLInitInstanceCulling(gBackend.get());
+  LOG(OpenGL, "Instance culling supported: %s",
+      gBackend->instance_culling_supported ? "true" : "false");
+
+  gBackend->parallel_shader_compile_supported = InitParallelShaderCompile();
+  LOG(OpenGL, "Parallel shader compile supported: %s",
+      gBackend->parallel_shader_compile_supported ? "true" : "false");
+
+  gBackend->program_binary_supported = ProgramBinariesSupported();
+  gBackend->driver_hash = GetDriverHash();
+
   auto renderer = std::make_unique<Renderer>();
   renderer->renderer_type = "OpenGL";
 
@@ -200,9 +267,17 @@ void ResetRendererState() {
 void RendererEndFrame(Renderer*, Window* window) {
   auto* opengl = GetOpenGL();
   ASSERT(opengl->camera_index == -1);     // All cameras should be popped.
+  ASSERT(opengl->render_target_index == -1);
 
   WindowSwapBuffers(window);
   ResetRendererState();
+
+  // Only the ones the GPU is already done with.
+  OpenGLProcessReadbacks(opengl, false);
+}
+
+void RendererFlushReadbacks(Renderer*) {
+  OpenGLProcessReadbacks(GetOpenGL(), true);
 }
 
 // Meshes ------------------------------------------------------------------------------------------
@@ -212,7 +287,11 @@ bool RendererStageMesh(Renderer*, Mesh* mesh) {
 
   // Override the id.
   mesh->id = HashString32(mesh->name.c_str());
-  return OpenGLStageMesh(gBackend.get(), mesh);
+  if (!OpenGLStageMesh(gBackend.get(), mesh))
+    return false;
+
+  ApplyCPUDataPolicy(mesh);
+  return true;
 }
 
 void RendererUnstageMesh(Renderer*, Mesh* mesh) {
@@ -225,10 +304,17 @@ bool RendererUploadMeshRange(Renderer*, Mesh* mesh, Int2 vertex_range, Int2 inde
 
 // Shaders -----------------------------------------------------------------------------------------
 
-std::unique_ptr<Shader> RendererStageShader(Renderer*,
-                                            const ShaderConfig& config,
-                                            const std::string& vert_src,
-                                            const std::string& frag_src) {
+namespace {
+
+using StageShaderFunction = std::unique_ptr<Shader> (*)(OpenGLRendererBackend*,
+                                                        const ShaderConfig&,
+                                                        const std::string&,
+                                                        const std::string&);
+
+std::unique_ptr<Shader> StageShader(StageShaderFunction stage_function,
+                                    const ShaderConfig& config,
+                                    const std::string& vert_src,
+                                    const std::string& frag_src) {
   auto* opengl = gBackend.get();
   auto it = opengl->shader_map.find(config.name);
   if (it != opengl->shader_map.end()) {
@@ -237,7 +323,7 @@ std::unique_ptr<Shader> RendererStageShader(Renderer*,
   }
 
   // Create it and add it to the shader.
-  auto shader = OpenGLStageShader(opengl, config, vert_src, frag_src);
+  auto shader = stage_function(opengl, config, vert_src, frag_src);
   if (!shader)
     return shader;
 
@@ -245,12 +331,40 @@ std::unique_ptr<Shader> RendererStageShader(Renderer*,
   return shader;
 }
 
+}  // namespace
+
+std::unique_ptr<Shader> RendererStageShader(Renderer*,
+                                            const ShaderConfig& config,
+                                            const std::string& vert_src,
+                                            const std::string& frag_src) {
+  return StageShader(OpenGLStageShader, config, vert_src, frag_src);
+}
+
+std::unique_ptr<Shader> RendererStageShaderAsync(Renderer*,
+                                                 const ShaderConfig& config,
+                                                 const std::string& vert_src,
+                                                 const std::string& frag_src) {
+  return StageShader(OpenGLStageShaderAsync, config, vert_src, frag_src);
+}
+
+ShaderStatus RendererPollShader(Renderer*, const Shader* shader) {
+  return OpenGLPollShader(gBackend.get(), *shader, false);
+}
+
+ShaderStatus RendererWaitForShader(Renderer*, const Shader* shader) {
+  return OpenGLPollShader(gBackend.get(), *shader, true);
+}
+
 void RendererUnstageShader(Renderer*, Shader* shader) {
   auto* opengl = gBackend.get();
   opengl->shader_map.erase(shader->config.name);
   OpenGLUnstageShader(opengl, shader);
 }
 
+bool RendererSetProgramCacheDir(Renderer*, const std::string& dir) {
+  return SetProgramCacheDir(gBackend.get(), dir);
+}
+
 const Shader* RendererGetShader(Renderer*, const char* name) {
   auto* opengl = gBackend.get();
   auto it = opengl->shader_map.find(name);
@@ -266,7 +380,11 @@ bool RendererStageTexture(Renderer*, Texture* texture) {
     ERROR(Graphics, "Received null texture");
     return false;
   }
-  return OpenGLStageTexture(gBackend.get(), texture);
+  if (!OpenGLStageTexture(gBackend.get(), texture))
+    return false;
+
+  ApplyCPUDataPolicy(texture);
+  return true;
 }
 
 void RendererUnstageTexture(Renderer*, Texture* texture) {
@@ -277,4 +395,39 @@ void RendererSubTexture(Renderer*, Texture* texture, void* data, Int2 offset, In
   OpenGLSubTexture(gBackend.get(), texture, data, offset, range);
 }
 
+// Render Targets ----------------------------------------------------------------------------------
+
+bool RendererStageRenderTarget(Renderer* renderer, RenderTarget* rt) {
+  ASSERT_MSG(!Staged(*rt), "Render target \"%s\" already staged.", rt->name.c_str());
+  if (!OpenGLStageRenderTarget(gBackend.get(), rt))
+    return false;
+
+  rt->renderer = renderer;
+  return true;
+}
+
+void RendererUnstageRenderTarget(Renderer*, RenderTarget* rt) {
+  OpenGLUnstageRenderTarget(gBackend.get(), rt);
+}
+
+// Instance Sets -----------------------------------------------------------------------------------
+
+bool RendererStageInstanceSet(Renderer* renderer, InstanceSet* set) {
+  ASSERT_MSG(!Staged(*set), "Instance set \"%s\" already staged.", set->name.c_str());
+  if (!OpenGLStageInstanceSet(gBackend.get(), set))
+    return false;
+
+  set->renderer = renderer;
+  return true;
+}
+
+void RendererUnstageInstanceSet(Renderer*, InstanceSet* set) {
+  OpenGLUnstageInstanceSet(gBackend.get(), set);
+}
+
+bool RendererUploadInstanceSet(Renderer*, InstanceSet* set) {
+  ASSERT_MSG(Staged(*set), "Instance set \"%s\" not staged.", set->name.c_str());
+  return OpenGLUploadInstanceSet(gBackend.get(), set);
+}
+
 }  // namespace rothko
@@ -4,28 +4,131 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "rothko/graphics/commands.h"
+#include "rothko/graphics/mesh.h"
 #include "rothko/graphics/opengl/shader.h"
 #include "rothko/math/math.h"
+#include "rothko/memory/range_allocator.h"
 #include "rothko/utils/macros.h"
 
 namespace rothko {
 
+struct RenderTarget;
 struct Shader;
 struct Texture;
 struct Window;
 
 namespace opengl {
 
+struct MeshPool;
+
+// How many copies of their data dynamic meshes cycle through.
+constexpr uint32_t kDynamicMeshRegions = 3;
+
 struct MeshHandles {
   uint32_t vbo = 0;
   uint32_t ebo = 0;
   uint32_t vao = 0;
+
+  // Where the mesh data lives within the buffers. Only shared meshes (MeshUsage::kShared) have
+  // non-zero offsets, as they are sub-allocated from |pool|. Offsets and sizes are in bytes.
+  MeshPool* pool = nullptr;
+  uint32_t base_vertex = 0;
+  uint64_t vertex_offset = 0;
+  uint64_t vertex_size = 0;
+  uint64_t index_offset = 0;
+  uint64_t index_size = 0;
+
+  // Dynamic meshes (MeshUsage::kDynamic) have |kDynamicMeshRegions| times the space and the
+  // offsets point to the region of the last upload. Each region has a fence (GLsync) that gets
+  // signaled once the GPU is done with the draws that read it.
+  uint32_t region = 0;
+  void* region_fences[kDynamicMeshRegions] = {};
+  uint8_t* mapped_vertices = nullptr;   // Set if the buffers are persistently mapped.
+  uint8_t* mapped_indices = nullptr;
+};
+
+// Shared meshes with the same vertex type and index format are sub-allocated from the same big
+// buffers and drawn with the same VAO (using the base vertex to find their vertices).
+// When a pool runs out of space, it is moved to bigger buffers with all the meshes packed together,
+// which also gets rid of the fragmentation.
+struct MeshPool {
+  VertexType vertex_type = VertexType::kLast;
+  IndexFormat index_format = IndexFormat::kLast;
+
+  uint32_t vbo = 0;
+  uint32_t ebo = 0;
+  uint32_t vao = 0;
+
+  RangeAllocator vertices;
+  RangeAllocator indices;
 };
 
 struct TextureHandles {
   uint32_t tex_handle = 0;
+  uint32_t target = 0;    // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY.
+};
+
+struct RenderTargetHandles {
+  // Holds |RenderTarget::color_texture|. Multisampled targets get resolved into it.
+  uint32_t fbo = 0;
+  uint32_t depth_rbo = 0;
+
+  // Only for multisampled targets. These get rendered into instead of |fbo|.
+  uint32_t msaa_fbo = 0;
+  uint32_t msaa_color_rbo = 0;
+};
+
+// Layout mandated by glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+  uint32_t count = 0;
+  uint32_t instance_count = 0;
+  uint32_t first_index = 0;
+  int32_t base_vertex = 0;
+  uint32_t base_instance = 0;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 5 * sizeof(uint32_t));
+
+struct InstanceSetHandles {
+  uint32_t instance_buffer = 0;   // |InstanceSet::instances|.
+  uint32_t draw_buffer = 0;       // One indirect command per draw. Instance counts set by culling.
+  uint32_t visible_buffer = 0;    // Indices of the visible instances, grouped by draw.
+
+  uint32_t instance_count = 0;
+
+  // Where the visible instances of each draw start in |visible_buffer|. Used as base instance.
+  std::vector<uint32_t> draw_offsets;
+};
+
+// The compute shader that culls the instance sets. Created on init if supported.
+struct InstanceCulling {
+  uint32_t program = 0;
+  uint32_t pyramid_buffer = 0;    // |RenderInstanceSet::depth_pyramid|, uploaded per command.
+
+  int instance_count_location = -1;
+  int frustum_planes_location = -1;
+  int view_projection_location = -1;
+  int pyramid_size_location = -1;
+  int pyramid_levels_location = -1;
+};
+
+// What is needed to restore the framebuffer state when popping a render target.
+struct BoundRenderTarget {
+  const RenderTarget* target = nullptr;
+  int prev_viewport[4] = {};
+};
+
+// A |Readback| command whose pixels are being copied into |pbo|. Done once |fence| signals.
+struct PendingReadback {
+  uint32_t pbo = 0;
+  void* fence = nullptr;    // GLsync.
+  Int2 pos = {};
+  Int2 size = {};
+  std::function<void(const ReadbackResult&)> callback;
 };
 
 struct CameraData {
@@ -50,6 +153,11 @@ struct OpenGLRendererBackend {
   std::map<uint32_t, MeshHandles> loaded_meshes;
   std::map<uint32_t, ShaderHandles> loaded_shaders;
   std::map<uint32_t, TextureHandles> loaded_textures;
+  std::map<uint32_t, RenderTargetHandles> loaded_render_targets;
+  std::map<uint32_t, InstanceSetHandles> loaded_instance_sets;
+
+  // Keyed by vertex type and index format.
+  std::map<uint64_t, std::unique_ptr<MeshPool>> mesh_pools;
 
   // ID tracking.
 #if DEBUG_MODE
@@ -62,6 +170,32 @@ struct OpenGLRendererBackend {
   Config configs[8] = {};
   int config_index = -1;
 
+  BoundRenderTarget render_targets[kMaxRenderTargetCount] = {};
+  int render_target_index = -1;
+
+  // In the order they were issued. Finished buffers are kept in |readback_pbos| for reuse.
+  std::vector<PendingReadback> pending_readbacks;
+  std::vector<uint32_t> readback_pbos;
+
+  // Dynamic meshes are persistently mapped if GL 4.4 (glBufferStorage) is available.
+  bool buffer_storage_supported = false;
+
+  // Multi-draw needs GL 4.3 + GL_ARB_shader_draw_parameters (for gl_DrawIDARB).
+  bool multi_draw_supported = false;
+  uint32_t indirect_buffer = 0;   // Holds the commands of the current multi-draw batch.
+
+  // Instance sets need compute shaders (GL 4.3) plus what multi-draw needs (gl_BaseInstanceARB).
+  bool instance_culling_supported = false;
+  InstanceCulling instance_culling;
+
+  // GL_KHR_parallel_shader_compile (or the ARB one). Lets async shaders be polled without blocking.
+  bool parallel_shader_compile_supported = false;
+
+  // Program binary cache (see program_cache.h). Disabled while |program_cache_dir| is empty.
+  bool program_binary_supported = false;
+  uint64_t driver_hash = 0;
+  std::string program_cache_dir;
+
   // Special textures.
   std::unique_ptr<Texture> white_texture;
 };
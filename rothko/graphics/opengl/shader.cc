@@ -9,6 +9,7 @@
 #include <optional>
 #include <vector>
 
+#include "rothko/graphics/opengl/program_cache.h"
 #include "rothko/graphics/opengl/renderer_backend.h"
 #include "rothko/graphics/opengl/utils.h"
 #include "rothko/logging/logging.h"
@@ -42,74 +43,88 @@ void OutputShaderForError(const std::string& source) {
 
 namespace {
 
-uint32_t CompileShader(Shader* shader, const char* src, GLenum shader_kind) {
+// Compilation is split in submitting the work and then checking on it, so that many shaders can be
+// submitted before waiting on any of them (see |OpenGLStageShaderAsync|).
+
+uint32_t SubmitShader(const char* src, GLenum shader_kind) {
   uint32_t handle = glCreateShader(shader_kind);
-  if (!handle) {
+  if (!handle)
     return 0;
-  }
 
-  // Compile the shader source.
   const GLchar* gl_src = src;
   glShaderSource(handle, 1, &gl_src, 0);
   glCompileShader(handle);
+  return handle;
+}
 
+bool CheckShader(const Shader& shader, uint32_t handle, GLenum shader_kind) {
   GLint success = 0;
   glGetShaderiv(handle, GL_COMPILE_STATUS, &success);
   if (success == GL_FALSE) {
     GLchar log[2048];
     glGetShaderInfoLog(handle, sizeof(log), 0, log);
-    glDeleteShader(handle);
     ERROR(OpenGL, "* VERT SOURCE ---------------------------------------\n");
-    OutputShaderForError(shader->vert_src);
+    OutputShaderForError(shader.vert_src);
     ERROR(OpenGL, "* FRAG SOURCE ---------------------------------------\n");
-    OutputShaderForError(shader->frag_src);
+    OutputShaderForError(shader.frag_src);
     ERROR(OpenGL, "---------------------------------------\n");
     ERROR(
-        OpenGL, "Shader %s error %s: %s", shader->config.name.c_str(), ToString(shader_kind), log);
-    return 0;
+        OpenGL, "Shader %s error %s: %s", shader.config.name.c_str(), ToString(shader_kind), log);
+    return false;
   }
 
-  return handle;
+  return true;
 }
 
-uint32_t CompileVertShader(Shader* shader) {
-  return CompileShader(shader, shader->vert_src.c_str(), GL_VERTEX_SHADER);
-}
+// Compiles and links without waiting for any of it. Fills the program and shader handles.
+// |retrievable| hints the driver that we will ask for the binary (see program_cache.h).
+bool SubmitProgram(const Shader& shader, bool retrievable, ShaderHandles* handles) {
+  handles->vert_handle = SubmitShader(shader.vert_src.c_str(), GL_VERTEX_SHADER);
+  handles->frag_handle = SubmitShader(shader.frag_src.c_str(), GL_FRAGMENT_SHADER);
+  if (handles->vert_handle == 0 || handles->frag_handle == 0)
+    return false;
+
+  handles->program = glCreateProgram();
+  if (handles->program == 0) {
+    ERROR(OpenGL, "glCreateProgram: could not allocate a program");
+    return false;
+  }
 
-uint32_t CompileFragShader(Shader* shader) {
-  return CompileShader(shader, shader->frag_src.c_str(), GL_FRAGMENT_SHADER);
+  if (retrievable)
+    glProgramParameteri(handles->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+  // Link 'em.
+  glAttachShader(handles->program, handles->vert_handle);
+  glAttachShader(handles->program, handles->frag_handle);
+  glLinkProgram(handles->program);
+  return true;
 }
 
-// Returns the program handle or 0.
-uint32_t LinkProgram(uint32_t vert_handle, uint32_t frag_handle) {
-  auto cleanup = Defer([vert_handle, frag_handle]() {
-    glDeleteShader(vert_handle);
-    glDeleteShader(frag_handle);
+// Blocks until the program submitted by |SubmitProgram| is done. Frees the shader handles.
+bool CheckProgram(const Shader& shader, ShaderHandles* handles) {
+  auto cleanup = Defer([handles]() {
+    glDeleteShader(handles->vert_handle);
+    glDeleteShader(handles->frag_handle);
+    handles->vert_handle = 0;
+    handles->frag_handle = 0;
   });
 
-  uint32_t prog_handle = glCreateProgram();
-  if (prog_handle == 0) {
-    ERROR(OpenGL, "glCreateProgram: could not allocate a program");
-    return 0;
+  // Link errors are not meaningful if the compilation failed.
+  if (!CheckShader(shader, handles->vert_handle, GL_VERTEX_SHADER) ||
+      !CheckShader(shader, handles->frag_handle, GL_FRAGMENT_SHADER)) {
+    return false;
   }
 
-  // Link 'em.
-  glAttachShader(prog_handle, vert_handle);
-  glAttachShader(prog_handle, frag_handle);
-  glLinkProgram(prog_handle);
-  glDeleteShader(vert_handle);
-  glDeleteShader(frag_handle);
-
   GLint success = 0;
-  glGetProgramiv(prog_handle, GL_LINK_STATUS, &success);
+  glGetProgramiv(handles->program, GL_LINK_STATUS, &success);
   if (success == GL_FALSE) {
     GLchar log[2048];
-    glGetProgramInfoLog(prog_handle, sizeof(log), 0, log);
-    ERROR(OpenGL, "Could not link shader: %s", log);
-    return 0;
+    glGetProgramInfoLog(handles->program, sizeof(log), 0, log);
+    ERROR(OpenGL, "Could not link shader %s: %s", shader.config.name.c_str(), log);
+    return false;
   }
 
-  return prog_handle;
+  return true;
 }
 
 bool BindUBO(const std::string& ubo_name, uint32_t ubo_size, uint32_t prog_handle,
@@ -143,6 +158,40 @@ bool BindUBO(const std::string& ubo_name, uint32_t ubo_size, uint32_t prog_handl
   return true;
 }
 
+// Multi-draw shaders read their UBOs from shader storage blocks, with one entry per draw.
+bool BindPerDrawBlock(const std::string& block_name, uint32_t ubo_size, uint32_t prog_handle,
+                      ShaderHandles::UBO* binding, int* current_binding) {
+  if (ubo_size == 0)
+    return true;
+
+  // The array stride in std430 is the struct size rounded to its alignment (16 for vec4/mat4).
+  if (ubo_size % 16 != 0) {
+    ERROR(OpenGL, "Per draw block %s: size %u is not a multiple of 16", block_name.c_str(),
+          ubo_size);
+    return false;
+  }
+
+  uint32_t index = glGetProgramResourceIndex(prog_handle, GL_SHADER_STORAGE_BLOCK,
+                                             block_name.c_str());
+  if (index == GL_INVALID_INDEX) {
+    ERROR(OpenGL, "Could not find storage block index for %s", block_name.c_str());
+    return false;
+  }
+
+  glShaderStorageBlockBinding(prog_handle, index, *current_binding);
+
+  // The buffer is (re)filled with the data of each batch.
+  uint32_t buffer_handle = 0;
+  glGenBuffers(1, &buffer_handle);
+
+  binding->binding_index = *current_binding;
+  binding->buffer_handle = buffer_handle;
+
+  *current_binding += 1;
+
+  return true;
+}
+
 // |log| means whether to log that we didn't find the uniform. In some cases, it is valid to not
 // find the uniform (like camera_pos), so we don't want to clutter the logs in that case.
 bool GetUniformLocation(uint32_t program, const char* uniform_name, int* out, bool log = false) {
@@ -157,24 +206,9 @@ bool GetUniformLocation(uint32_t program, const char* uniform_name, int* out, bo
   return true;
 }
 
-bool UploadShader(Shader* shader, ShaderHandles* handles) {
-  *handles = {};
-
-  // Compile the shaders and and program.
-  uint32_t vert_handle = CompileVertShader(shader);
-  uint32_t frag_handle = CompileFragShader(shader);
-  if (vert_handle == 0 || frag_handle == 0) {
-    glDeleteShader(vert_handle);
-    glDeleteShader(frag_handle);
-    return false;
-  }
-
-  // Link the program.
-  // Will free |vert_handle| and |frag_handle|.
-  uint32_t prog_handle = LinkProgram(vert_handle, frag_handle);
-  if (prog_handle == 0)
-    return false;
-  handles->program = prog_handle;
+// Queries the uniform locations and sets up the UBOs of a linked program.
+bool SetupProgram(const Shader* shader, ShaderHandles* handles) {
+  uint32_t prog_handle = handles->program;
 
   // Get the camera uniform locations.
   // |camera_pos| is optional.
@@ -184,12 +218,23 @@ bool UploadShader(Shader* shader, ShaderHandles* handles) {
 
   // Camera pos is optional.
 
+  // Dequantization uniforms are only present on shaders that read quantized vertices.
+  GetUniformLocation(handles->program, "mesh_pos_offset", &handles->mesh_pos_offset_location);
+  GetUniformLocation(handles->program, "mesh_pos_scale", &handles->mesh_pos_scale_location);
+  GetUniformLocation(handles->program, "mesh_uv_offset", &handles->mesh_uv_offset_location);
+  GetUniformLocation(handles->program, "mesh_uv_scale", &handles->mesh_uv_scale_location);
+
   // Get the uniform buffer object information.
   int current_binding = 0;
   for (uint32_t i = 0; i < std::size(shader->config.ubos); i++) {
     auto& ubo = shader->config.ubos[i];
-    if (!BindUBO(ubo.name, ubo.size, prog_handle, &handles->ubos[i], &current_binding))
-      return false;
+    if (shader->config.multi_draw) {
+      if (!BindPerDrawBlock(ubo.name, ubo.size, prog_handle, &handles->ubos[i], &current_binding))
+        return false;
+    } else {
+      if (!BindUBO(ubo.name, ubo.size, prog_handle, &handles->ubos[i], &current_binding))
+        return false;
+    }
   }
 
   // Get the texture positions.
@@ -205,6 +250,8 @@ bool UploadShader(Shader* shader, ShaderHandles* handles) {
 
 void FreeHandles(ShaderHandles* handles) {
   glDeleteProgram(handles->program);
+  glDeleteShader(handles->vert_handle);
+  glDeleteShader(handles->frag_handle);
 
   for (auto& ubo : handles->ubos) {
     glDeleteBuffers(1, &ubo.buffer_handle);
@@ -213,13 +260,17 @@ void FreeHandles(ShaderHandles* handles) {
 
 }  // namespace
 
-std::unique_ptr<Shader> OpenGLStageShader(OpenGLRendererBackend* opengl,
-                                          const ShaderConfig& config,
-                                          const std::string& vert_src,
-                                          const std::string& frag_src) {
+std::unique_ptr<Shader> OpenGLStageShaderAsync(OpenGLRendererBackend* opengl,
+                                               const ShaderConfig& config,
+                                               const std::string& vert_src,
+                                               const std::string& frag_src) {
   // TODO(Cristian): Keep track by name.
 
-  uint32_t uuid = GetNextShaderUUID();
+  if (config.multi_draw && !opengl->multi_draw_supported) {
+    ERROR(OpenGL, "Shader %s: multi-draw is not supported by this OpenGL context.",
+          config.name.c_str());
+    return {};
+  }
 
   auto shader = std::make_unique<Shader>();
   shader->config = config;
@@ -227,17 +278,84 @@ std::unique_ptr<Shader> OpenGLStageShader(OpenGLRendererBackend* opengl,
   shader->frag_src = frag_src;
 
   ShaderHandles handles;
-  if (!UploadShader(shader.get(), &handles)) {
-    FreeHandles(&handles);
-    return {};
+  if (ProgramCacheEnabled(*opengl)) {
+    handles.cache_key = GetProgramCacheKey(*opengl, *shader);
+    handles.program = LoadCachedProgram(*opengl, handles.cache_key);
+    if (handles.program != 0) {
+      LOG(OpenGL, "Shader %s: loaded from the program cache.", config.name.c_str());
+      if (!SetupProgram(shader.get(), &handles)) {
+        FreeHandles(&handles);
+        return {};
+      }
+
+      handles.status = ShaderStatus::kReady;
+    } else {
+      handles.store_in_cache = true;
+    }
   }
 
+  if (handles.program == 0) {
+    if (!SubmitProgram(*shader, handles.store_in_cache, &handles)) {
+      FreeHandles(&handles);
+      return {};
+    }
+
+    handles.status = ShaderStatus::kPending;
+  }
+
+  uint32_t uuid = GetNextShaderUUID();
   opengl->loaded_shaders[uuid] = std::move(handles);
   shader->uuid = uuid;
 
   return shader;
 }
 
+std::unique_ptr<Shader> OpenGLStageShader(OpenGLRendererBackend* opengl,
+                                          const ShaderConfig& config,
+                                          const std::string& vert_src,
+                                          const std::string& frag_src) {
+  auto shader = OpenGLStageShaderAsync(opengl, config, vert_src, frag_src);
+  if (!shader)
+    return {};
+
+  if (OpenGLPollShader(opengl, *shader, true) != ShaderStatus::kReady) {
+    OpenGLUnstageShader(opengl, shader.get());
+    return {};
+  }
+
+  return shader;
+}
+
+// Poll Shader -----------------------------------------------------------------
+
+ShaderStatus OpenGLPollShader(OpenGLRendererBackend* opengl, const Shader& shader, bool wait) {
+  auto it = opengl->loaded_shaders.find(shader.uuid.value);
+  ASSERT(it != opengl->loaded_shaders.end());
+  ShaderHandles* handles = &it->second;
+  if (handles->status != ShaderStatus::kPending)
+    return handles->status;
+
+  // Without the extension there is no way of asking without blocking, but the driver still had
+  // the time since the shader was submitted.
+  if (!wait && opengl->parallel_shader_compile_supported) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(handles->program, GL_COMPLETION_STATUS_KHR, &done);
+    if (done == GL_FALSE)
+      return ShaderStatus::kPending;
+  }
+
+  if (!CheckProgram(shader, handles) || !SetupProgram(&shader, handles)) {
+    handles->status = ShaderStatus::kFailed;
+    return handles->status;
+  }
+
+  if (handles->store_in_cache)
+    StoreProgramBinary(*opengl, handles->cache_key, handles->program);
+
+  handles->status = ShaderStatus::kReady;
+  return handles->status;
+}
+
 // Unstage Shader --------------------------------------------------------------
 
 void OpenGLUnstageShader(OpenGLRendererBackend* opengl, Shader* shader) {
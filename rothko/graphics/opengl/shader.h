@@ -23,11 +23,27 @@ struct ShaderHandles {
 
   uint32_t program = 0;
 
+  // While |status| is kPending, the shader objects are still alive and the rest of the handles
+  // are not set yet (see |OpenGLPollShader|).
+  ShaderStatus status = ShaderStatus::kPending;
+  uint32_t vert_handle = 0;
+  uint32_t frag_handle = 0;
+
+  // Whether to store the program in the program cache once it's done.
+  bool store_in_cache = false;
+  uint64_t cache_key = 0;
+
   // We expect shaders to have a |proj| and |view| mat4 uniforms.
   int camera_pos_location = -1;     // Optional.
   int camera_proj_location = -1;
   int camera_view_location = -1;
 
+  // Quantized meshes dequantization (see |VertexDequantization|). Optional.
+  int mesh_pos_offset_location = -1;
+  int mesh_pos_scale_location = -1;
+  int mesh_uv_offset_location = -1;
+  int mesh_uv_scale_location = -1;
+
   // The Uniform Buffer Object binding.
   struct UBO {
     int binding_index = -1;
@@ -38,10 +54,21 @@ struct ShaderHandles {
   int texture_handles[kMaxTextures] = {};
 };
 
+// Blocks until the shader is compiled. Returns null if it failed.
 std::unique_ptr<Shader> OpenGLStageShader(OpenGLRendererBackend*,
                                           const ShaderConfig& config,
                                           const std::string& vert_src,
                                           const std::string& frag_src);
+
+// Only submits the shader to the driver. Use |OpenGLPollShader| to know when it is done.
+std::unique_ptr<Shader> OpenGLStageShaderAsync(OpenGLRendererBackend*,
+                                               const ShaderConfig& config,
+                                               const std::string& vert_src,
+                                               const std::string& frag_src);
+
+// |wait| blocks until the shader is no longer pending.
+ShaderStatus OpenGLPollShader(OpenGLRendererBackend*, const Shader&, bool wait);
+
 void OpenGLUnstageShader(OpenGLRendererBackend*, Shader*);
 
 }  // namespace opengl
@@ -24,9 +24,17 @@ uint32_t GetNextTextureUUID() {
   return id;
 }
 
+// Format of the client data. Only meaningful for uncompressed types.
 GLenum TextureTypeToGL(TextureType type) {
   switch (type) {
     case TextureType::kRGBA: return GL_RGBA;
+    case TextureType::kR8: return GL_RED;
+    case TextureType::kRG8: return GL_RG;
+    case TextureType::kBC1: return GL_RGBA;
+    case TextureType::kBC3: return GL_RGBA;
+    case TextureType::kBC4: return GL_RED;
+    case TextureType::kBC5: return GL_RG;
+    case TextureType::kBC7: return GL_RGBA;
     case TextureType::kLast: break;
   }
 
@@ -64,13 +72,63 @@ GLenum FilterToGL(TextureFilterMode filter) {
   return 0;
 }
 
+void UploadLevel(const Texture& texture, GLenum target, uint32_t level) {
+  TextureMipLevel mip = GetMipLevel(texture, level);
+  GLenum internal_format = TextureTypeToInternalFormat(texture.type);
+  uint8_t* data = texture.data.get() + mip.offset;
+
+  if (target == GL_TEXTURE_2D_ARRAY) {
+    if (IsCompressed(texture.type)) {
+      glCompressedTexImage3D(target, level, internal_format, mip.size.width, mip.size.height,
+                             texture.layers, 0, mip.data_size, data);
+    } else {
+      glTexImage3D(target, level, internal_format, mip.size.width, mip.size.height,
+                   texture.layers, 0, TextureTypeToGL(texture.type), GL_UNSIGNED_BYTE, data);
+    }
+    return;
+  }
+
+  if (IsCompressed(texture.type)) {
+    glCompressedTexImage2D(target, level, internal_format, mip.size.width,
+                           mip.size.height, 0, mip.data_size, data);
+  } else {
+    glTexImage2D(target,                            // target
+                 level,                             // level
+                 internal_format,                   // internalformat
+                 mip.size.width,                    // width,
+                 mip.size.height,                   // height
+                 0,                                 // border
+                 TextureTypeToGL(texture.type),     // format
+                 GL_UNSIGNED_BYTE,                  // type,
+                 data);
+  }
+}
+
 }  // namespace
 
+uint32_t TextureTypeToInternalFormat(TextureType type) {
+  switch (type) {
+    case TextureType::kRGBA: return GL_RGBA8;
+    case TextureType::kR8: return GL_R8;
+    case TextureType::kRG8: return GL_RG8;
+    case TextureType::kBC1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case TextureType::kBC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TextureType::kBC4: return GL_COMPRESSED_RED_RGTC1;
+    case TextureType::kBC5: return GL_COMPRESSED_RG_RGTC2;
+    case TextureType::kBC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case TextureType::kLast: break;
+  }
+
+  NOT_REACHED();
+  return 0;
+}
+
 bool OpenGLStageTexture(OpenGLRendererBackend* opengl, Texture* texture) {
-  LOG(OpenGL, "Staging texture %s [Type: %s, Size: %s]",
+  LOG(OpenGL, "Staging texture %s [Type: %s, Size: %s, Layers: %u]",
               texture->name.c_str(),
               ToString(texture->type),
-              ToString(texture->size).c_str());
+              ToString(texture->size).c_str(),
+              texture->layers);
 
   uint32_t uuid = GetNextTextureUUID();
   auto it = opengl->loaded_textures.find(uuid);
@@ -79,35 +137,39 @@ bool OpenGLStageTexture(OpenGLRendererBackend* opengl, Texture* texture) {
     return false;
   }
 
+  GLenum target = IsArray(*texture) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
   uint32_t handle;
   glGenTextures(1, &handle);
-  glBindTexture(GL_TEXTURE_2D, handle);
+  glBindTexture(target, handle);
 
   // Setup wrapping/filtering options.
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, WrapToGL(texture->wrap_mode_u));
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, WrapToGL(texture->wrap_mode_v));
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, FilterToGL(texture->min_filter));
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, FilterToGL(texture->mag_filter));
-
-  // Send the bits over.
-  glTexImage2D(GL_TEXTURE_2D,         // target
-               0,                     // level
-               GL_RGBA8,              // internalformat
-               texture->size.width,   // width,
-               texture->size.height,  // height
-               0,                     // border
-               GL_RGBA,               // format
-               GL_UNSIGNED_BYTE,      // type,
-               texture->data.get());
-
-  if (texture->mipmaps)
-    glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, WrapToGL(texture->wrap_mode_u));
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, WrapToGL(texture->wrap_mode_v));
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, FilterToGL(texture->min_filter));
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, FilterToGL(texture->mag_filter));
+
+  // Send the bits over, one mip level at a time. Rows of R8/RG8 textures are not 4 byte aligned.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (uint32_t level = 0; level < texture->mip_levels; level++) {
+    UploadLevel(*texture, target, level);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  // The driver can only generate the chain from uncompressed data. Textures that ship their levels
+  // don't need it, but the sampler has to know where the chain ends.
+  if (texture->mipmaps && texture->mip_levels == 1 && !IsCompressed(texture->type)) {
+    glGenerateMipmap(target);
+  } else {
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, texture->mip_levels - 1);
+  }
 
   TextureHandles handles;
   handles.tex_handle = handle;
+  handles.target = target;
   opengl->loaded_textures[uuid] = std::move(handles);
 
-  glBindTexture(GL_TEXTURE_2D, NULL);
+  glBindTexture(target, NULL);
   texture->uuid = uuid;
 
   return true;
@@ -134,13 +196,22 @@ void OpenGLSubTexture(OpenGLRendererBackend* opengl, Texture* texture, void* dat
   if (IsZero(offset) && IsZero(range))
     range = texture->size;
 
-  if (data == nullptr)
+  if (data == nullptr) {
+    ASSERT_MSG(Loaded(*texture), "Texture %s: No CPU data to upload (see EnsureCPUData).",
+               texture->name.c_str());
     data = texture->data.get();
+  }
+
+  ASSERT_MSG(!IsCompressed(texture->type), "Texture %s: Cannot sub-upload compressed textures.",
+             texture->name.c_str());
+  ASSERT_MSG(!IsArray(*texture), "Texture %s: Cannot sub-upload array textures.",
+             texture->name.c_str());
 
   auto it = opengl->loaded_textures.find(texture->uuid.value);
   ASSERT(it != opengl->loaded_textures.end());
 
   glBindTexture(GL_TEXTURE_2D, it->second.tex_handle);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   glTexSubImage2D(GL_TEXTURE_2D,
                   0,
                   offset.x,
@@ -150,6 +221,7 @@ void OpenGLSubTexture(OpenGLRendererBackend* opengl, Texture* texture, void* dat
                   TextureTypeToGL(texture->type),
                   GL_UNSIGNED_BYTE,
                   data);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
 }  // namespace opengl
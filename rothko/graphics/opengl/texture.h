@@ -13,6 +13,9 @@ namespace opengl {
 
 struct OpenGLRendererBackend;
 
+// The sized internal format (eg. GL_RGBA8) of |type|.
+uint32_t TextureTypeToInternalFormat(TextureType);
+
 bool OpenGLStageTexture(OpenGLRendererBackend*, Texture*);
 void OpenGLUnstageTexture(OpenGLRendererBackend*, Texture*);
 void OpenGLSubTexture(OpenGLRendererBackend*, Texture*, void* data, Int2 offset, Int2 range);
@@ -0,0 +1,72 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/render_target.h"
+
+#include <math.h>
+
+#include "rothko/graphics/renderer.h"
+
+namespace rothko {
+
+RenderTarget::~RenderTarget() {
+  if (Staged(*this))
+    RendererUnstageRenderTarget(this->renderer, this);
+}
+
+// Dynamic Resolution ------------------------------------------------------------------------------
+
+namespace {
+
+// Over this fraction of the budget we go down, under the second we go up. The gap between them
+// avoids bouncing between two scales.
+constexpr float kOverBudget = 1.05f;
+constexpr float kUnderBudget = 0.85f;
+
+float Clamp(float value, float min, float max) {
+  return value < min ? min : (value > max ? max : value);
+}
+
+}  // namespace
+
+bool UpdateDynamicResolution(DynamicResolution* dr, float frame_time) {
+  if (dr->average_frame_time == 0.0f) {
+    dr->average_frame_time = frame_time;
+  } else {
+    dr->average_frame_time += dr->smoothing * (frame_time - dr->average_frame_time);
+  }
+
+  dr->frames_since_change++;
+  if (dr->frames_since_change < dr->cooldown_frames)
+    return false;
+
+  float scale = dr->scale;
+  if (dr->average_frame_time > dr->target_frame_time * kOverBudget) {
+    // The cost is roughly proportional to the pixel count, which goes with the square of the scale.
+    float wanted = dr->scale * sqrtf(dr->target_frame_time / dr->average_frame_time);
+    scale = floorf(wanted / dr->scale_step) * dr->scale_step;
+    if (scale > dr->scale - dr->scale_step)
+      scale = dr->scale - dr->scale_step;
+  } else if (dr->average_frame_time < dr->target_frame_time * kUnderBudget) {
+    scale = dr->scale + dr->scale_step;
+  }
+
+  scale = Clamp(scale, dr->min_scale, dr->max_scale);
+  if (fabsf(scale - dr->scale) < 0.5f * dr->scale_step)
+    return false;
+
+  dr->scale = scale;
+  dr->frames_since_change = 0;
+  return true;
+}
+
+Int2 GetScaledSize(const DynamicResolution& dr, Int2 size) {
+  Int2 scaled = {(int)(size.x * dr.scale + 0.5f), (int)(size.y * dr.scale + 0.5f)};
+  if (scaled.x < 1)
+    scaled.x = 1;
+  if (scaled.y < 1)
+    scaled.y = 1;
+  return scaled;
+}
+
+}  // namespace rothko
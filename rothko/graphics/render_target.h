@@ -0,0 +1,107 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "rothko/graphics/texture.h"
+#include "rothko/math/math.h"
+#include "rothko/utils/clear_on_move.h"
+#include "rothko/utils/macros.h"
+
+namespace rothko {
+
+struct Renderer;
+
+// Render Target -----------------------------------------------------------------------------------
+//
+// An offscreen framebuffer. Bind it with the |PushRenderTarget| command and everything rendered
+// until the matching |PopRenderTarget| goes into it instead of the window.
+//
+// Once staged, |color_texture| holds the result and can be used as any other texture in later
+// passes (multisampled targets are resolved into it on |PopRenderTarget|). The depth is only used
+// while rendering into the target.
+//
+// |render_size| lets a pass use only part of the target (eg. for dynamic resolution), without
+// having to re-create it. Shaders sampling |color_texture| then need to scale their UVs by
+// |GetRenderUVScale|. |BlitRenderTarget| takes care of that when copying it to the screen.
+
+struct RenderTarget {
+  RAII_CONSTRUCTORS(RenderTarget);
+
+  Renderer* renderer = nullptr;
+  ClearOnMove<uint32_t> uuid = 0;
+
+  std::string name;
+  Int2 size = {};
+
+  // Only uncompressed types can be rendered into. kLast means no color attachment.
+  TextureType color_type = TextureType::kRGBA;
+  bool depth = true;
+
+  // MSAA samples. 1 means no multisampling.
+  uint32_t samples = 1;
+
+  // Used when sampling |color_texture| and when blitting to a different size.
+  TextureFilterMode filter = TextureFilterMode::kLinear;
+
+  // Zero means the whole |size|. Must fit in |size|. Can be changed between frames.
+  Int2 render_size = {};
+
+  // Created by the renderer on staging.
+  std::unique_ptr<Texture> color_texture;
+};
+
+inline bool Staged(const RenderTarget& rt) { return rt.renderer && rt.uuid.has_value(); }
+
+inline Int2 GetRenderSize(const RenderTarget& rt) {
+  return IsZero(rt.render_size) ? rt.size : rt.render_size;
+}
+
+inline Vec2 GetRenderUVScale(const RenderTarget& rt) {
+  Int2 render_size = GetRenderSize(rt);
+  return {(float)render_size.x / rt.size.x, (float)render_size.y / rt.size.y};
+}
+
+// Dynamic Resolution ------------------------------------------------------------------------------
+//
+// Picks the scale at which to render (eg. the 3D scene) from the measured frame time, so that the
+// frame rate stays stable on slow machines. Typical use:
+//
+//   UpdateDynamicResolution(&dynamic_resolution, time.frame_delta);
+//   scene_target.render_size = GetScaledSize(dynamic_resolution, scene_target.size);
+//   <PushRenderTarget, render the scene, PopRenderTarget>
+//   <BlitRenderTarget to upscale it into the window, render the UI at full resolution>
+
+struct DynamicResolution {
+  float target_frame_time = 1.0f / 60.0f;   // In seconds.
+
+  float min_scale = 0.5f;
+  float max_scale = 1.0f;
+
+  // The scale only moves in steps of this much, so that tiny frame time changes don't resize.
+  float scale_step = 0.05f;
+
+  // Frames to wait after a change before changing again, so that the effect can be measured.
+  uint32_t cooldown_frames = 30;
+
+  // Averaging of the measured frame times. Higher reacts faster but is noisier.
+  float smoothing = 0.1f;
+
+  // Current state.
+  float scale = 1.0f;
+  float average_frame_time = 0.0f;
+  uint32_t frames_since_change = 0;
+};
+
+// |frame_time| in seconds (eg. |Time::frame_delta|). Returns whether the scale changed.
+bool UpdateDynamicResolution(DynamicResolution*, float frame_time);
+
+// |size| scaled by the current scale. Never zero.
+Int2 GetScaledSize(const DynamicResolution&, Int2 size);
+
+}  // namespace rothko
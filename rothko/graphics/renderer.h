@@ -21,7 +21,9 @@
 
 namespace rothko {
 
+struct InstanceSet;
 struct Mesh;
+struct RenderTarget;
 struct Renderer;
 struct Shader;
 struct Texture;
@@ -55,6 +57,9 @@ void RendererUnstageMesh(Renderer*, Mesh*);
 // |index_range| represents what section of indices to upload. X = offset, Y = size.
 //
 // For both ranges, empty size means all.
+//
+// Dynamic meshes (MeshUsage::kDynamic) get a fresh copy of the buffers on each upload, so the data
+// outside the uploaded ranges is undefined afterwards.
 bool RendererUploadMeshRange(Renderer*, Mesh*, Int2 vertex_range = {}, Int2 index_range = {});
 
 // Shaders -----------------------------------------------------------------------------------------
@@ -65,6 +70,25 @@ std::unique_ptr<Shader> RendererStageShader(Renderer*,
                                             const std::string& frag_src);
 void RendererUnstageShader(Renderer*, Shader*);
 
+// Submits the shader to the driver and returns without waiting for it to compile, so many shaders
+// can be compiled in parallel (with GL_KHR_parallel_shader_compile) or while doing other work
+// (eg. loading assets). Only fails for errors that can be known up front.
+//
+// Rendering with a shader that is still pending waits for it. Failed shaders skip their draws.
+std::unique_ptr<Shader> RendererStageShaderAsync(Renderer*,
+                                                 const ShaderConfig&,
+                                                 const std::string& vert_src,
+                                                 const std::string& frag_src);
+
+// Never blocks. Without driver support for polling, this waits for the shader instead.
+ShaderStatus RendererPollShader(Renderer*, const Shader*);
+ShaderStatus RendererWaitForShader(Renderer*, const Shader*);
+
+// Caches the compiled shaders in |dir|, so later runs can skip compiling them. Entries are keyed
+// by the sources and the driver, so stale ones are just recompiled (and rewritten).
+// Affects the shaders staged afterwards. Empty disables the cache (the default).
+bool RendererSetProgramCacheDir(Renderer*, const std::string& dir);
+
 // Returns a NON-OWNING pointer to a shader. It is up to the caller to keep track whether this
 // pointer is valid or not.
 //
@@ -81,10 +105,31 @@ void RendererUnstageTexture(Renderer*, Texture*);
 void RendererSubTexture(Renderer*, Texture*, void* data = nullptr,
                         Int2 offset = {}, Int2 range = {});
 
+// Render Targets ----------------------------------------------------------------------------------
+
+// Creates the framebuffer and stages |color_texture| (see render_target.h). To resize a target,
+// unstage it, change its size and stage it again.
+bool RendererStageRenderTarget(Renderer*, RenderTarget*);
+void RendererUnstageRenderTarget(Renderer*, RenderTarget*);
+
+// Instance Sets -----------------------------------------------------------------------------------
+
+// Uploads the instances into GPU buffers (see instance_set.h). The meshes of |draws| must already
+// be staged. Fails if the GPU doesn't support culling instances.
+bool RendererStageInstanceSet(Renderer*, InstanceSet*);
+void RendererUnstageInstanceSet(Renderer*, InstanceSet*);
+
+// Re-uploads |instances| (eg. after moving some of them). The count can change.
+bool RendererUploadInstanceSet(Renderer*, InstanceSet*);
+
 // Frame -------------------------------------------------------------------------------------------
 
 void RendererStartFrame(Renderer*);
 void RendererExecuteCommands(Renderer*, const PerFrameVector<RenderCommand>&);
 void RendererEndFrame(Renderer*, Window*);
 
+// Blocks until all the pending |Readback| commands are delivered. Meant for shutdown or tests,
+// normally they are delivered on their own without stalling.
+void RendererFlushReadbacks(Renderer*);
+
 }  // namespace rothko
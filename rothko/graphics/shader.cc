@@ -13,6 +13,18 @@
 
 namespace rothko {
 
+const char* ToString(ShaderStatus status) {
+  switch (status) {
+    case ShaderStatus::kPending: return "Pending";
+    case ShaderStatus::kReady: return "Ready";
+    case ShaderStatus::kFailed: return "Failed";
+    case ShaderStatus::kLast: return "<last>";
+  }
+
+  NOT_REACHED_MSG("Invalid ShaderStatus: %u", (uint32_t)status);
+  return "<unknown>";
+}
+
 Shader::~Shader() {
   if (Staged(*this))
     RendererUnstageShader(this->renderer, this);
@@ -48,6 +60,23 @@ namespace {
 uniform vec3 camera_pos;
 uniform mat4 camera_proj;
 uniform mat4 camera_view;
+
+// Quantized vertices.
+uniform vec3 mesh_pos_offset = vec3(0.0);
+uniform vec3 mesh_pos_scale = vec3(1.0);
+uniform vec2 mesh_uv_offset = vec2(0.0);
+uniform vec2 mesh_uv_scale = vec2(1.0);
+
+vec3 DequantizePos(vec3 pos) { return mesh_pos_offset + pos * mesh_pos_scale; }
+vec2 DequantizeUV(vec2 uv) { return mesh_uv_offset + uv * mesh_uv_scale; }
+
+vec3 OctDecode(vec2 e) {
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
   )";
 
 }  // namespace
@@ -83,4 +112,49 @@ std::string CreateFragmentSource(const std::string& frag_src, const char* header
   return src;
 }
 
+// Multi-draw --------------------------------------------------------------------------------------
+
+const char kMultiDrawVertexHeader[] = R"(
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+#define ROTHKO_MULTI_DRAW 1
+#define ROTHKO_DRAW_ID gl_DrawIDARB
+  )";
+
+const char kMultiDrawFragmentHeader[] = R"(
+#version 430 core
+#define ROTHKO_MULTI_DRAW 1
+  )";
+
+// Instance Sets -----------------------------------------------------------------------------------
+
+// The storage block bindings are fixed, the backend binds the instance set buffers to them.
+const char kInstanceSetVertexHeader[] = R"(
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+#define ROTHKO_INSTANCE_SET 1
+
+struct RothkoInstance {
+  mat4 transform;
+  vec3 bounds_min;
+  uint draw_index;
+  vec3 bounds_max;
+  uint padding;
+};
+layout (std430, binding = 6) readonly buffer RothkoInstances {
+  RothkoInstance rothko_instances[];
+};
+layout (std430, binding = 7) readonly buffer RothkoVisibleInstances {
+  uint rothko_visible_instances[];
+};
+
+#define ROTHKO_INSTANCE_INDEX rothko_visible_instances[gl_BaseInstanceARB + gl_InstanceID]
+#define ROTHKO_INSTANCE_TRANSFORM rothko_instances[ROTHKO_INSTANCE_INDEX].transform
+  )";
+
+const char kInstanceSetFragmentHeader[] = R"(
+#version 430 core
+#define ROTHKO_INSTANCE_SET 1
+  )";
+
 }  // namespace rothko
@@ -34,6 +34,28 @@ struct Renderer;
 // - camera_pos: The position of the camera. Passed through the |PushCamera| command.
 // - camera_proj: The projection matrix. Passed through the |PushCamera| command.
 // - camera_view: The view matrix. Passed through the |PushCamera| command.
+// - mesh_pos_offset/scale, mesh_uv_offset/scale: The |VertexDequantization| of the mesh being
+//   rendered. Vertex shaders reading quantized vertices should use the provided |DequantizePos|,
+//   |DequantizeUV| and |OctDecode| functions.
+//
+// Multi-draw: Shaders with |ShaderConfig::multi_draw| let the renderer batch runs of compatible
+//             |RenderMesh| commands into a single indirect draw. Such shaders must be created with
+//             |kMultiDrawVertexHeader| and |kMultiDrawFragmentHeader| (GLSL 4.30) and declare each
+//             UBO as a shader storage block with the same name, holding an array with one entry
+//             per draw, indexed by |ROTHKO_DRAW_ID| (only available in the vertex shader):
+//
+//               struct PerDraw { mat4 model; };
+//               layout (std430) readonly buffer Uniforms { PerDraw draws[]; };
+//               ...
+//               mat4 model = draws[ROTHKO_DRAW_ID].model;
+//
+//             The sizes of the UBOs must be a multiple of 16 bytes (use |FLOAT_PAD|).
+//
+// Instance sets: Shaders drawing an |InstanceSet| (see instance_set.h) must be created with
+//                |kInstanceSetVertexHeader| and |kInstanceSetFragmentHeader| (GLSL 4.30). Their
+//                UBOs work as in normal shaders (shared by all the instances). The vertex shader
+//                gets the instance being drawn through |ROTHKO_INSTANCE_INDEX|, and its transform
+//                through |ROTHKO_INSTANCE_TRANSFORM|.
 
 struct ShaderConfig {
   std::string name;   // Used as key, must be unique.
@@ -55,8 +77,20 @@ struct ShaderConfig {
 
   uint32_t texture_count = 0;
 
+  // See "Multi-draw" above.
+  bool multi_draw = false;
 };
 
+// Shaders staged with |RendererStageShaderAsync| are compiled in the background. They can only be
+// used for rendering once they are ready.
+enum class ShaderStatus : uint8_t {
+  kPending,
+  kReady,
+  kFailed,
+  kLast,
+};
+const char* ToString(ShaderStatus);
+
 struct Shader {
   RAII_CONSTRUCTORS(Shader);
 
@@ -81,6 +115,14 @@ inline bool Staged(const Shader& s) { return s.renderer && s.uuid.has_value(); }
 std::string CreateVertexSource(const std::string& vert_src, const char* header = nullptr);
 std::string CreateFragmentSource(const std::string& frag_src, const char* header = nullptr);
 
+// Headers to use for |ShaderConfig::multi_draw| shaders.
+extern const char kMultiDrawVertexHeader[];
+extern const char kMultiDrawFragmentHeader[];
+
+// Headers to use for shaders drawing an |InstanceSet|.
+extern const char kInstanceSetVertexHeader[];
+extern const char kInstanceSetFragmentHeader[];
+
 bool LoadShaderSources(const std::string& vert_path,
                        const std::string& frag_path,
                        Shader* out);
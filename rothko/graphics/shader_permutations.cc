@@ -0,0 +1,170 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/shader_permutations.h"
+
+#include "rothko/graphics/renderer.h"
+#include "rothko/logging/logging.h"
+#include "rothko/utils/strings.h"
+
+namespace rothko {
+
+namespace {
+
+bool ValidKeyword(const std::string& keyword) {
+  if (keyword.empty())
+    return false;
+
+  for (char c : keyword) {
+    bool valid = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                 c == '_';
+    if (!valid)
+      return false;
+  }
+
+  return !(keyword[0] >= '0' && keyword[0] <= '9');
+}
+
+uint32_t VariantCount(const ShaderPermutations& permutations) {
+  return 1u << permutations.keywords.size();
+}
+
+std::unique_ptr<Shader> StageVariant(Renderer* renderer, const ShaderPermutations& permutations,
+                                     ShaderKey key, bool async) {
+  ShaderConfig config = permutations.config;
+  config.name = GetVariantName(permutations, key);
+  if (permutations.configure_variant)
+    permutations.configure_variant(key, &config);
+
+  auto vert_src = CreateVertexSource(AddKeywordDefines(permutations, key, permutations.vert_src),
+                                     permutations.vert_header);
+  auto frag_src = CreateFragmentSource(AddKeywordDefines(permutations, key, permutations.frag_src),
+                                       permutations.frag_header);
+
+  if (async)
+    return RendererStageShaderAsync(renderer, config, vert_src, frag_src);
+  return RendererStageShader(renderer, config, vert_src, frag_src);
+}
+
+}  // namespace
+
+bool InitShaderPermutations(ShaderPermutations* permutations) {
+  if (permutations->keywords.size() > kMaxShaderKeywords) {
+    ERROR(Graphics, "Shader %s: Too many keywords (%zu, max %u).",
+          permutations->config.name.c_str(), permutations->keywords.size(), kMaxShaderKeywords);
+    return false;
+  }
+
+  for (uint32_t i = 0; i < permutations->keywords.size(); i++) {
+    const std::string& keyword = permutations->keywords[i];
+    if (!ValidKeyword(keyword)) {
+      ERROR(Graphics, "Shader %s: Invalid keyword \"%s\".", permutations->config.name.c_str(),
+            keyword.c_str());
+      return false;
+    }
+
+    for (uint32_t j = 0; j < i; j++) {
+      if (permutations->keywords[j] == keyword) {
+        ERROR(Graphics, "Shader %s: Repeated keyword %s.", permutations->config.name.c_str(),
+              keyword.c_str());
+        return false;
+      }
+    }
+  }
+
+  permutations->variants.clear();
+  permutations->variants.resize(VariantCount(*permutations));
+  permutations->failed.assign(VariantCount(*permutations), false);
+  return true;
+}
+
+ShaderKey GetShaderKey(const ShaderPermutations& permutations, const char* keyword) {
+  for (uint32_t i = 0; i < permutations.keywords.size(); i++) {
+    if (permutations.keywords[i] == keyword)
+      return 1u << i;
+  }
+
+  ERROR(Graphics, "Shader %s: Unknown keyword %s.", permutations.config.name.c_str(), keyword);
+  return 0;
+}
+
+std::string GetVariantName(const ShaderPermutations& permutations, ShaderKey key) {
+  std::string name = permutations.config.name;
+  name.append("[");
+
+  bool first = true;
+  for (uint32_t i = 0; i < permutations.keywords.size(); i++) {
+    if ((key & (1u << i)) == 0)
+      continue;
+
+    if (!first)
+      name.append("|");
+    name.append(permutations.keywords[i]);
+    first = false;
+  }
+
+  name.append("]");
+  return name;
+}
+
+std::string AddKeywordDefines(const ShaderPermutations& permutations, ShaderKey key,
+                              const std::string& src) {
+  std::string result;
+  for (uint32_t i = 0; i < permutations.keywords.size(); i++) {
+    if (key & (1u << i))
+      result.append(StringPrintf("#define %s 1\n", permutations.keywords[i].c_str()));
+  }
+
+  result.append(src);
+  return result;
+}
+
+Shader* GetShaderVariant(Renderer* renderer, ShaderPermutations* permutations, ShaderKey key) {
+  ASSERT_MSG(key < permutations->variants.size(), "Shader %s: Invalid key 0x%x (initialized?)",
+             permutations->config.name.c_str(), key);
+
+  auto& variant = permutations->variants[key];
+  if (variant)
+    return variant.get();
+
+  if (permutations->failed[key])
+    return nullptr;
+
+  LOG(Graphics, "Staging shader variant %s.", GetVariantName(*permutations, key).c_str());
+  variant = StageVariant(renderer, *permutations, key, false);
+  if (!variant) {
+    permutations->failed[key] = true;
+    return nullptr;
+  }
+
+  return variant.get();
+}
+
+bool PrecompileShaderVariants(Renderer* renderer, ShaderPermutations* permutations,
+                              const std::vector<ShaderKey>& keys) {
+  std::vector<ShaderKey> all_keys;
+  const std::vector<ShaderKey>* to_stage = &keys;
+  if (keys.empty()) {
+    for (ShaderKey key = 0; key < permutations->variants.size(); key++) {
+      all_keys.push_back(key);
+    }
+    to_stage = &all_keys;
+  }
+
+  bool success = true;
+  for (ShaderKey key : *to_stage) {
+    ASSERT(key < permutations->variants.size());
+    if (permutations->variants[key] || permutations->failed[key])
+      continue;
+
+    permutations->variants[key] = StageVariant(renderer, *permutations, key, true);
+    if (!permutations->variants[key]) {
+      permutations->failed[key] = true;
+      success = false;
+    }
+  }
+
+  return success;
+}
+
+}  // namespace rothko
@@ -0,0 +1,81 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rothko/graphics/shader.h"
+
+namespace rothko {
+
+struct Renderer;
+
+// Shader Permutations -----------------------------------------------------------------------------
+//
+// A single shader source that declares feature keywords. Each combination of keywords (a variant)
+// is compiled with those keywords #define'd, so the source can strip whatever the use case doesn't
+// need:
+//
+//   #ifdef USE_NORMAL_MAP
+//     normal = ...;
+//   #endif
+//
+// Variants are identified by a |ShaderKey|, where bit N means |keywords[N]| is enabled. They are
+// compiled either lazily (the first time they are requested) or ahead of time through
+// |PrecompileShaderVariants|, and looked up directly by their key.
+
+using ShaderKey = uint32_t;
+
+// The variants are stored densely (2^keywords of them), so this is kept small.
+constexpr uint32_t kMaxShaderKeywords = 8;
+
+struct ShaderPermutations {
+  // |config.name| is used as a prefix of the variant names. See |GetVariantName|.
+  ShaderConfig config;
+
+  // The user shader code, without the header. |CreateVertexSource| and |CreateFragmentSource|
+  // are called with the headers below.
+  std::string vert_src;
+  std::string frag_src;
+  const char* vert_header = nullptr;
+  const char* frag_header = nullptr;
+
+  std::vector<std::string> keywords;
+
+  // Optional. Lets a variant change its config (eg. less textures when a keyword is off).
+  std::function<void(ShaderKey, ShaderConfig*)> configure_variant;
+
+  // Set by |InitShaderPermutations|. Indexed by |ShaderKey|.
+  std::vector<std::unique_ptr<Shader>> variants;
+  std::vector<bool> failed;   // Variants that failed to stage, so they are not retried.
+};
+
+// Validates the keywords and allocates the variant table. Must be called once the fields above
+// are set.
+bool InitShaderPermutations(ShaderPermutations*);
+
+// Returns 0 (and logs) if the keyword is not declared. Meant to be called at setup, not per frame.
+ShaderKey GetShaderKey(const ShaderPermutations&, const char* keyword);
+
+// Eg. "model[USE_NORMAL_MAP|USE_FOG]". Variant names are unique, as needed by the renderer.
+std::string GetVariantName(const ShaderPermutations&, ShaderKey);
+
+// Adds the #define of each enabled keyword before |src|.
+std::string AddKeywordDefines(const ShaderPermutations&, ShaderKey, const std::string& src);
+
+// Returns the variant, staging it if needed (which blocks until it is compiled). Returns null if
+// the variant failed to compile.
+Shader* GetShaderVariant(Renderer*, ShaderPermutations*, ShaderKey);
+
+// Stages the given variants with |RendererStageShaderAsync|, so they compile in the background.
+// Empty |keys| means all of them.
+bool PrecompileShaderVariants(Renderer*, ShaderPermutations*,
+                              const std::vector<ShaderKey>& keys = {});
+
+}  // namespace rothko
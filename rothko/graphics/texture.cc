@@ -6,6 +6,8 @@
 #include <third_party/stb/stb_image.h>
 
 #include "rothko/graphics/renderer.h"
+#include "rothko/graphics/texture_compression.h"
+#include "rothko/graphics/texture_mipmaps.h"
 #include "rothko/logging/logging.h"
 #include "rothko/platform/platform.h"
 
@@ -23,9 +25,17 @@ Texture::~Texture() {
 
 namespace  {
 
+// Compressed textures are loaded as RGBA and then encoded.
 int TextureTypeToChannels(TextureType type) {
   switch (type) {
     case TextureType::kRGBA: return 4;
+    case TextureType::kR8: return 1;
+    case TextureType::kRG8: return 2;
+    case TextureType::kBC1: return 4;
+    case TextureType::kBC3: return 4;
+    case TextureType::kBC4: return 4;
+    case TextureType::kBC5: return 4;
+    case TextureType::kBC7: return 4;
     case TextureType::kLast: break;
   }
 
@@ -35,14 +45,16 @@ int TextureTypeToChannels(TextureType type) {
 
 }  // namespace
 
-bool STBLoadTexture(const std::string& path, TextureType texture_type, Texture* out) {
+bool STBLoadTexture(const std::string& path, TextureType texture_type, Texture* out,
+                    ColorSpace color_space) {
   // OpenGL expects the Y axis to be inverted.
   // TODO(Cristian): Support other rendering backends.
   stbi_set_flip_vertically_on_load(true);
 
   Texture tmp = {};
   tmp.name = GetBasename(path);
-  tmp.type = texture_type;
+  tmp.type = IsCompressed(texture_type) ? TextureType::kRGBA : texture_type;
+  tmp.mipmaps = out->mipmaps;
   int channels;
 
 
@@ -55,9 +67,38 @@ bool STBLoadTexture(const std::string& path, TextureType texture_type, Texture*
 
 
   uint32_t data_size = DataSize(tmp);
-  tmp.data = std::make_unique<uint8_t[]>(data_size);
+  tmp.data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(data_size);
   memcpy(tmp.data.get(), data, data_size);
 
+  // Mipmaps are generated from the uncompressed data and compressed along with the first level.
+  if (tmp.mipmaps && !GenerateMipmaps(&tmp, color_space)) {
+    stbi_image_free(data);
+    return false;
+  }
+
+  if (IsCompressed(texture_type) && !ConvertTexture(&tmp, texture_type)) {
+    ERROR(Graphics, "Could not compress texture %s into %s.", path.c_str(),
+          ToString(texture_type));
+    stbi_image_free(data);
+    return false;
+  }
+
+  // Reloading means just going to the file again.
+  tmp.reload_cpu_data = [path, texture_type, color_space](Texture* texture) {
+    Texture reloaded;
+    reloaded.mipmaps = texture->mipmaps;
+    if (!STBLoadTexture(path, texture_type, &reloaded, color_space))
+      return false;
+
+    if (reloaded.size != texture->size) {
+      ERROR(Graphics, "Texture %s changed size on reload.", path.c_str());
+      return false;
+    }
+
+    texture->data = std::move(reloaded.data);
+    return true;
+  };
+
   *out = std::move(tmp);
 
   // Free the STB data.
@@ -65,11 +106,48 @@ bool STBLoadTexture(const std::string& path, TextureType texture_type, Texture*
   return true;
 }
 
+// CPU Data ----------------------------------------------------------------------------------------
+
+void ApplyCPUDataPolicy(Texture* texture) {
+  CPUDataPolicy policy = Resolve(texture->cpu_data_policy);
+  if (policy == CPUDataPolicy::kKeep)
+    return;
+
+  ASSERT_MSG(policy != CPUDataPolicy::kReload || texture->reload_cpu_data,
+             "Texture %s: Reload policy without a way to reload.", texture->name.c_str());
+  texture->data.reset();
+}
+
+bool EnsureCPUData(Texture* texture) {
+  if (Loaded(*texture))
+    return true;
+
+  if (!texture->reload_cpu_data) {
+    ERROR(Graphics, "Texture %s: CPU data was discarded (policy %s).", texture->name.c_str(),
+          ToString(Resolve(texture->cpu_data_policy)));
+    return false;
+  }
+
+  if (!texture->reload_cpu_data(texture) || !Loaded(*texture)) {
+    ERROR(Graphics, "Texture %s: Could not reload CPU data.", texture->name.c_str());
+    return false;
+  }
+
+  return true;
+}
+
 // Extras ------------------------------------------------------------------------------------------
 
 const char* ToString(TextureType type) {
   switch (type) {
     case TextureType::kRGBA: return "RGBA";
+    case TextureType::kR8: return "R8";
+    case TextureType::kRG8: return "RG8";
+    case TextureType::kBC1: return "BC1";
+    case TextureType::kBC3: return "BC3";
+    case TextureType::kBC4: return "BC4";
+    case TextureType::kBC5: return "BC5";
+    case TextureType::kBC7: return "BC7";
     case TextureType::kLast: return "<last>";
   }
 
@@ -77,6 +155,17 @@ const char* ToString(TextureType type) {
   return "<unknown>";
 }
 
+const char* ToString(ColorSpace color_space) {
+  switch (color_space) {
+    case ColorSpace::kLinear: return "Linear";
+    case ColorSpace::kSRGB: return "SRGB";
+    case ColorSpace::kLast: return "<last>";
+  }
+
+  NOT_REACHED_MSG("Invalid ColorSpace: %u", (uint32_t)color_space);
+  return "<unknown>";
+}
+
 const char* ToString(TextureWrapMode mode) {
   switch (mode) {
     case TextureWrapMode::kClampToBorder: return "ClampToBorder";
@@ -108,6 +197,13 @@ const char* ToString(TextureFilterMode mode) {
 uint32_t ToSize(TextureType type) {
   switch (type) {
     case TextureType::kRGBA: return 4;
+    case TextureType::kR8: return 1;
+    case TextureType::kRG8: return 2;
+    case TextureType::kBC1: return 0;
+    case TextureType::kBC3: return 0;
+    case TextureType::kBC4: return 0;
+    case TextureType::kBC5: return 0;
+    case TextureType::kBC7: return 0;
     case TextureType::kLast: return 0;
   }
 
@@ -115,4 +211,64 @@ uint32_t ToSize(TextureType type) {
   return 0;
 }
 
+uint32_t ToBlockSize(TextureType type) {
+  switch (type) {
+    case TextureType::kRGBA: return 0;
+    case TextureType::kR8: return 0;
+    case TextureType::kRG8: return 0;
+    case TextureType::kBC1: return 8;
+    case TextureType::kBC3: return 16;
+    case TextureType::kBC4: return 8;
+    case TextureType::kBC5: return 16;
+    case TextureType::kBC7: return 16;
+    case TextureType::kLast: return 0;
+  }
+
+  NOT_REACHED();
+  return 0;
+}
+
+uint32_t DataSize(TextureType type, Int2 size) {
+  if (IsCompressed(type)) {
+    uint32_t blocks_x = (size.x + kTextureBlockDim - 1) / kTextureBlockDim;
+    uint32_t blocks_y = (size.y + kTextureBlockDim - 1) / kTextureBlockDim;
+    return blocks_x * blocks_y * ToBlockSize(type);
+  }
+
+  return size.x * size.y * ToSize(type);
+}
+
+// Mip Levels --------------------------------------------------------------------------------------
+
+uint32_t MaxMipLevels(Int2 size) {
+  uint32_t levels = 1;
+  int dim = size.x > size.y ? size.x : size.y;
+  while (dim > 1) {
+    dim >>= 1;
+    levels++;
+  }
+  return levels;
+}
+
+TextureMipLevel GetMipLevel(const Texture& texture, uint32_t level) {
+  ASSERT(level < texture.mip_levels);
+
+  TextureMipLevel mip = {};
+  for (uint32_t i = 0; i <= level; i++) {
+    mip.offset += mip.data_size;
+    mip.size = MipSize(texture.size, i);
+    mip.layer_size = DataSize(texture.type, mip.size);
+    mip.data_size = mip.layer_size * texture.layers;
+  }
+  return mip;
+}
+
+uint32_t DataSize(const Texture& texture) {
+  uint32_t size = 0;
+  for (uint32_t i = 0; i < texture.mip_levels; i++) {
+    size += DataSize(texture.type, MipSize(texture.size, i));
+  }
+  return size * texture.layers;
+}
+
 }  // namespace rothko
@@ -5,10 +5,13 @@
 
 #include <stdint.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 
+#include "rothko/graphics/cpu_data.h"
 #include "rothko/math/math.h"
+#include "rothko/memory/memory_tracker.h"
 #include "rothko/utils/clear_on_move.h"
 #include "rothko/utils/macros.h"
 
@@ -18,11 +21,39 @@ struct Renderer;
 
 enum class TextureType : uint8_t {
   kRGBA,  // 32 bits.
+  kR8,    // 8 bits, single channel.
+  kRG8,   // 16 bits, two channels.
+
+  // Block compressed formats. They encode 4x4 pixel blocks (see texture_compression.h).
+  kBC1,   // RGB, 8 bytes per block (0.5 bytes per pixel). AKA DXT1.
+  kBC3,   // RGBA, 16 bytes per block. AKA DXT5.
+  kBC4,   // R, 8 bytes per block.
+  kBC5,   // RG, 16 bytes per block. Good for normal maps.
+  kBC7,   // RGBA, 16 bytes per block. Much better quality than BC1/BC3.
   kLast,
 };
 const char* ToString(TextureType);
+
+// Bytes per pixel. 0 for compressed types.
 uint32_t ToSize(TextureType type);
 
+constexpr uint32_t kTextureBlockDim = 4;   // Compressed blocks are 4x4 pixels.
+
+// Bytes per 4x4 block. 0 for non-compressed types.
+uint32_t ToBlockSize(TextureType type);
+inline bool IsCompressed(TextureType type) { return ToBlockSize(type) > 0; }
+
+// Bytes needed by an image of |size| pixels.
+uint32_t DataSize(TextureType, Int2 size);
+
+// How the values of a texture should be interpreted when filtering them (eg. generating mipmaps).
+enum class ColorSpace : uint8_t {
+  kLinear,  // Data (masks, normals, etc.).
+  kSRGB,    // Colors.
+  kLast,
+};
+const char* ToString(ColorSpace);
+
 enum class TextureWrapMode : uint8_t {
   kClampToBorder,
   kClampToEdge,
@@ -60,16 +91,64 @@ struct Texture {
   TextureFilterMode min_filter = TextureFilterMode::kLinear;
   TextureFilterMode mag_filter = TextureFilterMode::kLinear;
 
+  // Whether the renderer should generate the mipmaps. Only used if |data| has a single level and
+  // for uncompressed types. Prefer generating them on the CPU (see texture_mipmaps.h).
   uint8_t mipmaps = 1;
 
-  std::unique_ptr<uint8_t[]> data;
+  // How many mip levels are in |data|. They are packed one after the other, starting from the full
+  // size level (see |GetMipLevel|).
+  uint8_t mip_levels = 1;
+
+  // More than one makes this an array texture (sampler2DArray in shaders). All the layers share
+  // size, type and mip levels. Each level holds all its layers one after the other.
+  uint16_t layers = 1;
+
+  TaggedArray<uint8_t, MemoryTag::kGraphics> data;
+
+  // What to do with |data| once staged.
+  CPUDataPolicy cpu_data_policy = CPUDataPolicy::kDefault;
+  // Refills |data|. Needed for |CPUDataPolicy::kReload|. Set by |STBLoadTexture|.
+  std::function<bool(Texture*)> reload_cpu_data;
 };
 
 inline bool Loaded(const Texture& t) { return !!t.data; }
 inline bool Staged(const Texture& t) { return t.uuid.has_value(); }
+inline bool IsArray(const Texture& t) { return t.layers > 1; }
+
+// Mip Levels --------------------------------------------------------------------------------------
+
+struct TextureMipLevel {
+  Int2 size = {};
+  uint32_t offset = 0;      // Within |Texture::data|.
+  uint32_t data_size = 0;   // Of all the layers.
+  uint32_t layer_size = 0;  // Layer N starts at |offset + N * layer_size|.
+};
+
+// Each level halves the size (rounding down, clamped to 1).
+inline Int2 MipSize(Int2 size, uint32_t level) {
+  Int2 mip = {size.x >> level, size.y >> level};
+  return {mip.x > 0 ? mip.x : 1, mip.y > 0 ? mip.y : 1};
+}
+
+// Levels of a full mip chain (down to 1x1).
+uint32_t MaxMipLevels(Int2 size);
+
+TextureMipLevel GetMipLevel(const Texture&, uint32_t level);
+
+// Size of all the mip levels (and layers) of the texture.
+uint32_t DataSize(const Texture&);
+
+// If |out->mipmaps| is set (the default), the mip chain is generated on the CPU and stored in
+// |data| (see |GenerateMipmaps|), before compressing if |TextureType| asks for it. Only |mipmaps|
+// is read from |out|; the rest of it is overwritten.
+bool STBLoadTexture(const std::string& path, TextureType, Texture* out,
+                    ColorSpace color_space = ColorSpace::kSRGB);
 
-inline uint32_t DataSize(const Texture& t) { return t.size.x * t.size.y * ToSize(t.type); }
+// Frees |data| if the (resolved) |cpu_data_policy| says so. Called by the renderer after staging.
+void ApplyCPUDataPolicy(Texture*);
 
-bool STBLoadTexture(const std::string& path, TextureType, Texture* out);
+// Makes sure |data| is present, reloading it if it was evicted with |CPUDataPolicy::kReload|.
+// Returns false if the data is not there and cannot be reloaded.
+bool EnsureCPUData(Texture*);
 
 }  // namespace rothko
@@ -0,0 +1,241 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/texture_atlas.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#include "rothko/graphics/mesh.h"
+#include "rothko/logging/logging.h"
+#include "rothko/utils/strings.h"
+
+namespace rothko {
+
+namespace {
+
+bool Repeats(TextureWrapMode mode) {
+  return mode == TextureWrapMode::kRepeat || mode == TextureWrapMode::kMirroredRepeat;
+}
+
+bool CanAtlas(const Texture& texture, const TexturePackOptions& options) {
+  return texture.size.x <= options.max_atlas_entry_size &&
+         texture.size.y <= options.max_atlas_entry_size &&
+         !Repeats(texture.wrap_mode_u) && !Repeats(texture.wrap_mode_v);
+}
+
+// Copies |src| into |atlas| at |pos|, repeating its edges |padding| pixels around it.
+void Blit(const Texture& src, Texture* atlas, Int2 pos, int padding) {
+  uint32_t pixel_size = ToSize(src.type);
+  for (int y = -padding; y < src.size.y + padding; y++) {
+    int sy = y < 0 ? 0 : (y >= src.size.y ? src.size.y - 1 : y);
+    for (int x = -padding; x < src.size.x + padding; x++) {
+      int sx = x < 0 ? 0 : (x >= src.size.x ? src.size.x - 1 : x);
+      uint8_t* dst = atlas->data.get() + ((pos.y + y) * atlas->size.x + (pos.x + x)) * pixel_size;
+      memcpy(dst, src.data.get() + (sy * src.size.x + sx) * pixel_size, pixel_size);
+    }
+  }
+}
+
+std::unique_ptr<Texture> CreatePackedTexture(const Texture& model, std::string name) {
+  auto texture = std::make_unique<Texture>();
+  texture->name = std::move(name);
+  texture->type = model.type;
+  texture->wrap_mode_u = model.wrap_mode_u;
+  texture->wrap_mode_v = model.wrap_mode_v;
+  texture->min_filter = model.min_filter;
+  texture->mag_filter = model.mag_filter;
+  texture->mipmaps = model.mipmaps;
+  texture->cpu_data_policy = model.cpu_data_policy;
+  return texture;
+}
+
+// Shelf packing: entries sorted by height are laid left to right, opening a new shelf (or a new
+// atlas) when they don't fit.
+void PackAtlases(const std::vector<Texture*>& textures, std::vector<uint32_t> entries,
+                 const TexturePackOptions& options, PackedTextures* out) {
+  std::sort(entries.begin(), entries.end(), [&textures](uint32_t a, uint32_t b) {
+    return textures[a]->size.y > textures[b]->size.y;
+  });
+
+  struct Placement {
+    uint32_t index;
+    uint32_t atlas;
+    Int2 pos;
+  };
+  std::vector<Placement> placements;
+  std::vector<int> atlas_heights;
+
+  Int2 cursor = {0, 0};
+  int shelf_height = 0;
+  for (uint32_t index : entries) {
+    Int2 size = textures[index]->size + Int2(2 * options.padding, 2 * options.padding);
+    ASSERT(size.x <= options.atlas_size.x && size.y <= options.atlas_size.y);
+    if (atlas_heights.empty() || cursor.x + size.x > options.atlas_size.x) {
+      cursor = {0, cursor.y + shelf_height};
+      shelf_height = 0;
+    }
+
+    if (atlas_heights.empty() || cursor.y + size.y > options.atlas_size.y) {
+      atlas_heights.push_back(0);
+      cursor = {0, 0};
+      shelf_height = 0;
+    }
+
+    Int2 pos = cursor + Int2(options.padding, options.padding);
+    placements.push_back({index, (uint32_t)atlas_heights.size() - 1, pos});
+    shelf_height = std::max(shelf_height, size.y);
+    atlas_heights.back() = std::max(atlas_heights.back(), cursor.y + shelf_height);
+    cursor.x += size.x;
+  }
+
+  // Create the atlases, trimmed to the used height (kept a multiple of 4 for block compression).
+  uint32_t first_atlas = out->textures.size();
+  const Texture& model = *textures[entries.front()];
+  for (size_t i = 0; i < atlas_heights.size(); i++) {
+    auto atlas = CreatePackedTexture(model, StringPrintf("atlas-%s-%zu", ToString(model.type),
+                                                         first_atlas + i));
+    atlas->size = {options.atlas_size.x, (atlas_heights[i] + 3) & ~3};
+    atlas->data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(DataSize(*atlas));
+    memset(atlas->data.get(), 0, DataSize(*atlas));
+    out->textures.push_back(std::move(atlas));
+  }
+
+  for (const Placement& placement : placements) {
+    const Texture& src = *textures[placement.index];
+    Texture* atlas = out->textures[first_atlas + placement.atlas].get();
+    Blit(src, atlas, placement.pos, options.padding);
+
+    TextureRegion& region = out->regions[placement.index];
+    region.texture = atlas;
+    region.uv_offset = {(float)placement.pos.x / atlas->size.x,
+                        (float)placement.pos.y / atlas->size.y};
+    region.uv_scale = {(float)src.size.x / atlas->size.x, (float)src.size.y / atlas->size.y};
+  }
+}
+
+void PackArray(const std::vector<Texture*>& textures, const std::vector<uint32_t>& layers,
+               PackedTextures* out) {
+  const Texture& model = *textures[layers.front()];
+  auto array = CreatePackedTexture(model, StringPrintf("array-%s-%s-%zu", ToString(model.type),
+                                                       ToString(model.size).c_str(),
+                                                       out->textures.size()));
+  array->size = model.size;
+  array->layers = (uint16_t)layers.size();
+
+  uint32_t layer_size = DataSize(model);
+  array->data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(DataSize(*array));
+  for (uint32_t layer = 0; layer < layers.size(); layer++) {
+    uint32_t index = layers[layer];
+    memcpy(array->data.get() + layer * layer_size, textures[index]->data.get(), layer_size);
+
+    TextureRegion& region = out->regions[index];
+    region.texture = array.get();
+    region.layer = layer;
+  }
+
+  out->textures.push_back(std::move(array));
+}
+
+}  // namespace
+
+bool PackTextures(const std::vector<Texture*>& textures, PackedTextures* out,
+                  const TexturePackOptions& options) {
+  out->textures.clear();
+  out->regions.clear();
+  out->regions.reserve(textures.size());
+
+  // Textures are grouped by what must match between them: the type and sampling for atlases, and
+  // also the size for arrays.
+  using AtlasKey = std::tuple<TextureType, TextureWrapMode, TextureWrapMode, TextureFilterMode,
+                              TextureFilterMode>;
+  using ArrayKey = std::tuple<TextureType, int, int, TextureWrapMode, TextureWrapMode,
+                              TextureFilterMode, TextureFilterMode>;
+  std::map<AtlasKey, std::vector<uint32_t>> atlas_groups;
+  std::map<ArrayKey, std::vector<uint32_t>> array_groups;
+
+  for (uint32_t i = 0; i < textures.size(); i++) {
+    Texture* texture = textures[i];
+    ASSERT(!Staged(*texture));
+
+    TextureRegion region = {};
+    region.texture = texture;
+    out->regions.push_back(region);
+
+    if (!Loaded(*texture) || IsCompressed(texture->type) || texture->mip_levels > 1 ||
+        IsArray(*texture)) {
+      WARNING(Graphics, "Texture %s: Cannot be packed (needs uncompressed single level data).",
+              texture->name.c_str());
+      continue;
+    }
+
+    if (CanAtlas(*texture, options)) {
+      AtlasKey key = {texture->type, texture->wrap_mode_u, texture->wrap_mode_v,
+                      texture->min_filter, texture->mag_filter};
+      atlas_groups[key].push_back(i);
+      continue;
+    }
+
+    if (!options.create_arrays)
+      continue;
+
+    ArrayKey key = {texture->type, texture->size.x, texture->size.y, texture->wrap_mode_u,
+                    texture->wrap_mode_v, texture->min_filter, texture->mag_filter};
+    array_groups[key].push_back(i);
+  }
+
+  // An atlas with a single entry gains nothing.
+  for (auto& [key, entries] : atlas_groups) {
+    if (entries.size() > 1)
+      PackAtlases(textures, std::move(entries), options, out);
+  }
+
+  for (auto& [key, layers] : array_groups) {
+    if (layers.size() >= options.min_array_layers)
+      PackArray(textures, layers, out);
+  }
+
+  return true;
+}
+
+bool RemapUVs(Mesh* mesh, const TextureRegion& region) {
+  VertexLayout layout = GetVertexLayout(mesh->vertex_type);
+  for (uint32_t i = 0; i < layout.count; i++) {
+    const VertexAttribute& attribute = layout.attributes[i];
+    switch (attribute.component) {
+      case VertComponent::kUV0_float: {
+        if (mesh->vertices.size() < mesh->vertex_count * layout.stride) {
+          ERROR(Graphics, "Mesh %s: No CPU data to remap.", mesh->name.c_str());
+          return false;
+        }
+
+        for (uint32_t v = 0; v < mesh->vertex_count; v++) {
+          uint8_t* ptr = mesh->vertices.data() + v * layout.stride + attribute.offset;
+          Vec2 uv;
+          memcpy(&uv, ptr, sizeof(uv));
+          uv = RemapUV(region, uv);
+          memcpy(ptr, &uv, sizeof(uv));
+        }
+        return true;
+      }
+      case VertComponent::kUV0_byte:
+      case VertComponent::kUV0_short: {
+        // Composing the transforms: offset' + n * scale' = region(offset + n * scale).
+        VertexDequantization& dq = mesh->dequantization;
+        dq.uv_offset = RemapUV(region, dq.uv_offset);
+        dq.uv_scale = {dq.uv_scale.x * region.uv_scale.x, dq.uv_scale.y * region.uv_scale.y};
+        return true;
+      }
+      default: break;
+    }
+  }
+
+  ERROR(Graphics, "Mesh %s: Vertex type %s has no UVs.", mesh->name.c_str(),
+        ToString(mesh->vertex_type));
+  return false;
+}
+
+}  // namespace rothko
@@ -0,0 +1,74 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "rothko/graphics/texture.h"
+#include "rothko/math/math.h"
+
+namespace rothko {
+
+struct Mesh;
+
+// Texture Packing ---------------------------------------------------------------------------------
+//
+// Groups many textures into fewer, so that more draws share their textures (and can be batched).
+//
+// - Small textures that don't repeat are packed into atlases. Meshes using them have to remap their
+//   UVs into their region (see |RemapUVs|), which is meant to be done at load time.
+// - Textures with the same size, type and sampling become layers of an array texture. Shaders need
+//   to sample them with a sampler2DArray and the layer, so this is optional.
+//
+// Textures that cannot be grouped are left as they were.
+
+// Where a texture ended up after packing.
+struct TextureRegion {
+  Texture* texture = nullptr;   // The atlas/array. The original texture if it was not packed.
+  uint32_t layer = 0;           // For array textures.
+
+  // uv_in_atlas = uv_offset + uv * uv_scale.
+  Vec2 uv_offset = {0, 0};
+  Vec2 uv_scale = {1, 1};
+};
+
+inline Vec2 RemapUV(const TextureRegion& region, Vec2 uv) {
+  return {region.uv_offset.x + uv.x * region.uv_scale.x,
+          region.uv_offset.y + uv.y * region.uv_scale.y};
+}
+
+struct TexturePackOptions {
+  // Textures with both sides up to this size (and no repeating wrap mode) go into atlases.
+  int max_atlas_entry_size = 256;
+  // The atlas gets trimmed to the height actually used.
+  Int2 atlas_size = {2048, 2048};
+  // Pixels of repeated border around each atlas entry, so that filtering doesn't bleed.
+  int padding = 2;
+
+  // Off if the shaders using the textures cannot sample arrays.
+  bool create_arrays = true;
+  // How many textures of the same kind are needed to create an array texture.
+  uint32_t min_array_layers = 2;
+};
+
+struct PackedTextures {
+  std::vector<std::unique_ptr<Texture>> textures;   // Atlases and arrays.
+  std::vector<TextureRegion> regions;               // One per input, in the same order.
+};
+
+// Inputs must be loaded, unstaged, uncompressed and have a single mip level. The ones that got
+// packed (|region.texture| is not themselves) can be freed afterwards.
+// Generate mipmaps or compress the outputs after packing.
+bool PackTextures(const std::vector<Texture*>& textures, PackedTextures* out,
+                  const TexturePackOptions& options = {});
+
+// Moves the UV0 of |mesh| into |region|. Float UVs are rewritten in the CPU data (so it must be
+// there and staged meshes need to upload it again), quantized ones only need their dequantization
+// adjusted.
+bool RemapUVs(Mesh* mesh, const TextureRegion& region);
+
+}  // namespace rothko
@@ -0,0 +1,429 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/texture_compression.h"
+
+#include <string.h>
+
+#include "rothko/logging/logging.h"
+
+namespace rothko {
+
+namespace {
+
+constexpr uint32_t kBlockPixels = kTextureBlockDim * kTextureBlockDim;
+
+inline int ClampInt(int v, int min, int max) { return v < min ? min : (v > max ? max : v); }
+inline float AbsF(float v) { return v < 0.0f ? -v : v; }
+
+// Finds the line that best fits the block colors (the principal axis of the covariance matrix)
+// and returns the extremes of the pixels projected over it in |e0| and |e1|.
+// Only the first |channels| of each pixel are considered.
+void FindEndpoints(const uint8_t* rgba, uint32_t channels, float* e0, float* e1) {
+  float mean[4] = {};
+  for (uint32_t i = 0; i < kBlockPixels; i++) {
+    for (uint32_t c = 0; c < channels; c++) {
+      mean[c] += rgba[i * 4 + c];
+    }
+  }
+  for (uint32_t c = 0; c < channels; c++) {
+    mean[c] /= kBlockPixels;
+  }
+
+  float cov[4][4] = {};
+  for (uint32_t i = 0; i < kBlockPixels; i++) {
+    float d[4] = {};
+    for (uint32_t c = 0; c < channels; c++) {
+      d[c] = rgba[i * 4 + c] - mean[c];
+    }
+
+    for (uint32_t r = 0; r < channels; r++) {
+      for (uint32_t c = 0; c < channels; c++) {
+        cov[r][c] += d[r] * d[c];
+      }
+    }
+  }
+
+  // Power iteration. A few steps are enough for a 4x4 block.
+  float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+  for (uint32_t iteration = 0; iteration < 8; iteration++) {
+    float next[4] = {};
+    float max = 0.0f;
+    for (uint32_t r = 0; r < channels; r++) {
+      for (uint32_t c = 0; c < channels; c++) {
+        next[r] += cov[r][c] * axis[c];
+      }
+      if (AbsF(next[r]) > max)
+        max = AbsF(next[r]);
+    }
+
+    // Flat block: any axis works.
+    if (max == 0.0f)
+      break;
+
+    for (uint32_t c = 0; c < channels; c++) {
+      axis[c] = next[c] / max;
+    }
+  }
+
+  float axis_len2 = 0.0f;
+  for (uint32_t c = 0; c < channels; c++) {
+    axis_len2 += axis[c] * axis[c];
+  }
+
+  float min_t = 0.0f;
+  float max_t = 0.0f;
+  for (uint32_t i = 0; i < kBlockPixels; i++) {
+    float t = 0.0f;
+    for (uint32_t c = 0; c < channels; c++) {
+      t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+    }
+    t /= axis_len2;
+
+    if (t < min_t)
+      min_t = t;
+    if (t > max_t)
+      max_t = t;
+  }
+
+  for (uint32_t c = 0; c < channels; c++) {
+    e0[c] = ClampInt((int)(mean[c] + axis[c] * max_t + 0.5f), 0, 255);
+    e1[c] = ClampInt((int)(mean[c] + axis[c] * min_t + 0.5f), 0, 255);
+  }
+}
+
+// Returns the index of the palette entry closest to |pixel|.
+uint32_t ClosestIndex(const uint8_t* pixel, const int (*palette)[4], uint32_t palette_size,
+                      uint32_t channels) {
+  uint32_t best = 0;
+  int best_dist = INT32_MAX;
+  for (uint32_t i = 0; i < palette_size; i++) {
+    int dist = 0;
+    for (uint32_t c = 0; c < channels; c++) {
+      int d = (int)pixel[c] - palette[i][c];
+      dist += d * d;
+    }
+
+    if (dist < best_dist) {
+      best = i;
+      best_dist = dist;
+    }
+  }
+
+  return best;
+}
+
+// BC1 ---------------------------------------------------------------------------------------------
+
+uint16_t To565(const float* color) {
+  int r = ClampInt((int)(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+  int g = ClampInt((int)(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+  int b = ClampInt((int)(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+  return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void From565(uint16_t c, int* out) {
+  int r = (c >> 11) & 31;
+  int g = (c >> 5) & 63;
+  int b = c & 31;
+  out[0] = (r << 3) | (r >> 2);
+  out[1] = (g << 2) | (g >> 4);
+  out[2] = (b << 3) | (b >> 2);
+  out[3] = 255;
+}
+
+void WriteUint16(uint8_t* out, uint16_t v) {
+  out[0] = (uint8_t)(v & 0xff);
+  out[1] = (uint8_t)(v >> 8);
+}
+
+// BC4 ---------------------------------------------------------------------------------------------
+
+// |stride| is the distance between values (so it can read a channel out of RGBA pixels).
+void EncodeBC4(const uint8_t* values, uint32_t stride, uint8_t* out) {
+  int min = 255;
+  int max = 0;
+  for (uint32_t i = 0; i < kBlockPixels; i++) {
+    int v = values[i * stride];
+    min = v < min ? v : min;
+    max = v > max ? v : max;
+  }
+
+  // With red0 > red1, the palette has 6 interpolated values.
+  out[0] = (uint8_t)max;
+  out[1] = (uint8_t)min;
+  int palette[8];
+  palette[0] = max;
+  palette[1] = min;
+  for (int i = 1; i < 7; i++) {
+    palette[i + 1] = ((7 - i) * max + i * min + 3) / 7;
+  }
+
+  uint64_t bits = 0;
+  if (max != min) {
+    for (uint32_t i = 0; i < kBlockPixels; i++) {
+      int v = values[i * stride];
+      uint32_t best = 0;
+      int best_dist = INT32_MAX;
+      for (uint32_t p = 0; p < 8; p++) {
+        int dist = (v - palette[p]) * (v - palette[p]);
+        if (dist < best_dist) {
+          best = p;
+          best_dist = dist;
+        }
+      }
+      bits |= (uint64_t)best << (3 * i);
+    }
+  }
+
+  for (uint32_t i = 0; i < 6; i++) {
+    out[2 + i] = (uint8_t)(bits >> (8 * i));
+  }
+}
+
+// BC7 ---------------------------------------------------------------------------------------------
+
+constexpr int kBC7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BitWriter {
+  uint8_t* data = nullptr;
+  uint32_t pos = 0;
+};
+
+void WriteBits(BitWriter* writer, uint32_t value, uint32_t bits) {
+  for (uint32_t i = 0; i < bits; i++) {
+    uint32_t bit = (value >> i) & 1;
+    writer->data[writer->pos >> 3] |= (uint8_t)(bit << (writer->pos & 7));
+    writer->pos++;
+  }
+}
+
+// Mode 6 endpoints are 7 bits per channel plus a shared lowest bit (p-bit) per endpoint.
+// Picks the p-bit with less error and returns the quantized 7 bit values in |out|.
+uint32_t QuantizeBC7Endpoint(const float* endpoint, int* out) {
+  int best_error = INT32_MAX;
+  uint32_t best_p = 0;
+  for (uint32_t p = 0; p < 2; p++) {
+    int error = 0;
+    int quantized[4];
+    for (uint32_t c = 0; c < 4; c++) {
+      quantized[c] = ClampInt((int)((endpoint[c] - p) / 2.0f + 0.5f), 0, 127);
+      int d = ((quantized[c] << 1) | (int)p) - (int)endpoint[c];
+      error += d * d;
+    }
+
+    if (error < best_error) {
+      best_error = error;
+      best_p = p;
+      memcpy(out, quantized, sizeof(quantized));
+    }
+  }
+
+  return best_p;
+}
+
+}  // namespace
+
+// Blocks ------------------------------------------------------------------------------------------
+
+void EncodeBC1Block(const uint8_t* rgba, uint8_t* out) {
+  float e0[4], e1[4];
+  FindEndpoints(rgba, 3, e0, e1);
+
+  uint16_t c0 = To565(e0);
+  uint16_t c1 = To565(e1);
+
+  // c0 > c1 selects the 4 color mode. Equal endpoints mean a flat block (all index 0).
+  if (c0 < c1) {
+    uint16_t tmp = c0;
+    c0 = c1;
+    c1 = tmp;
+  }
+
+  int palette[4][4];
+  From565(c0, palette[0]);
+  From565(c1, palette[1]);
+  for (uint32_t c = 0; c < 3; c++) {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+  }
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    for (uint32_t i = 0; i < kBlockPixels; i++) {
+      indices |= ClosestIndex(rgba + i * 4, palette, 4, 3) << (2 * i);
+    }
+  }
+
+  WriteUint16(out, c0);
+  WriteUint16(out + 2, c1);
+  for (uint32_t i = 0; i < 4; i++) {
+    out[4 + i] = (uint8_t)(indices >> (8 * i));
+  }
+}
+
+void EncodeBC3Block(const uint8_t* rgba, uint8_t* out) {
+  EncodeBC4(rgba + 3, 4, out);
+  EncodeBC1Block(rgba, out + 8);
+}
+
+void EncodeBC4Block(const uint8_t* values, uint8_t* out) { EncodeBC4(values, 1, out); }
+
+void EncodeBC5Block(const uint8_t* rgba, uint8_t* out) {
+  EncodeBC4(rgba + 0, 4, out);
+  EncodeBC4(rgba + 1, 4, out + 8);
+}
+
+void EncodeBC7Block(const uint8_t* rgba, uint8_t* out) {
+  float e0[4], e1[4];
+  FindEndpoints(rgba, 4, e0, e1);
+
+  int q0[4], q1[4];
+  uint32_t p0 = QuantizeBC7Endpoint(e0, q0);
+  uint32_t p1 = QuantizeBC7Endpoint(e1, q1);
+
+  int palette[16][4];
+  for (uint32_t i = 0; i < 16; i++) {
+    int w = kBC7Weights4[i];
+    for (uint32_t c = 0; c < 4; c++) {
+      int a = (q0[c] << 1) | (int)p0;
+      int b = (q1[c] << 1) | (int)p1;
+      palette[i][c] = ((64 - w) * a + w * b + 32) >> 6;
+    }
+  }
+
+  uint32_t indices[kBlockPixels];
+  for (uint32_t i = 0; i < kBlockPixels; i++) {
+    indices[i] = ClosestIndex(rgba + i * 4, palette, 16, 4);
+  }
+
+  // The first index is stored with 3 bits (its top bit is implicitly 0). Swapping the endpoints
+  // mirrors the indices and guarantees that.
+  if (indices[0] & 8) {
+    for (uint32_t c = 0; c < 4; c++) {
+      int tmp = q0[c];
+      q0[c] = q1[c];
+      q1[c] = tmp;
+    }
+    uint32_t tmp = p0;
+    p0 = p1;
+    p1 = tmp;
+
+    for (uint32_t& index : indices) {
+      index = 15 - index;
+    }
+  }
+
+  memset(out, 0, 16);
+  BitWriter writer = {out, 0};
+  WriteBits(&writer, 1 << 6, 7);    // Mode 6.
+  for (uint32_t c = 0; c < 4; c++) {
+    WriteBits(&writer, q0[c], 7);
+    WriteBits(&writer, q1[c], 7);
+  }
+  WriteBits(&writer, p0, 1);
+  WriteBits(&writer, p1, 1);
+
+  WriteBits(&writer, indices[0], 3);
+  for (uint32_t i = 1; i < kBlockPixels; i++) {
+    WriteBits(&writer, indices[i], 4);
+  }
+  ASSERT(writer.pos == 128);
+}
+
+// Images ------------------------------------------------------------------------------------------
+
+bool EncodeImage(TextureType type, const uint8_t* rgba, Int2 size, uint8_t* out) {
+  switch (type) {
+    case TextureType::kRGBA:
+      memcpy(out, rgba, DataSize(type, size));
+      return true;
+    case TextureType::kR8:
+    case TextureType::kRG8: {
+      uint32_t channels = ToSize(type);
+      uint32_t pixel_count = size.x * size.y;
+      for (uint32_t i = 0; i < pixel_count; i++) {
+        for (uint32_t c = 0; c < channels; c++) {
+          out[i * channels + c] = rgba[i * 4 + c];
+        }
+      }
+      return true;
+    }
+    case TextureType::kBC1: break;
+    case TextureType::kBC3: break;
+    case TextureType::kBC4: break;
+    case TextureType::kBC5: break;
+    case TextureType::kBC7: break;
+    case TextureType::kLast:
+      NOT_REACHED();
+      return false;
+  }
+
+  uint32_t block_size = ToBlockSize(type);
+  uint32_t blocks_x = (size.x + kTextureBlockDim - 1) / kTextureBlockDim;
+  uint32_t blocks_y = (size.y + kTextureBlockDim - 1) / kTextureBlockDim;
+
+  uint8_t block[kBlockPixels * 4];
+  uint8_t values[kBlockPixels];
+  for (uint32_t by = 0; by < blocks_y; by++) {
+    for (uint32_t bx = 0; bx < blocks_x; bx++) {
+      // Gather the block, repeating the edges.
+      for (uint32_t y = 0; y < kTextureBlockDim; y++) {
+        int py = ClampInt(by * kTextureBlockDim + y, 0, size.y - 1);
+        for (uint32_t x = 0; x < kTextureBlockDim; x++) {
+          int px = ClampInt(bx * kTextureBlockDim + x, 0, size.x - 1);
+          const uint8_t* pixel = rgba + 4 * (py * size.x + px);
+          memcpy(block + 4 * (y * kTextureBlockDim + x), pixel, 4);
+          values[y * kTextureBlockDim + x] = pixel[0];
+        }
+      }
+
+      uint8_t* block_out = out + (by * blocks_x + bx) * block_size;
+      switch (type) {
+        case TextureType::kBC1: EncodeBC1Block(block, block_out); break;
+        case TextureType::kBC3: EncodeBC3Block(block, block_out); break;
+        case TextureType::kBC4: EncodeBC4Block(values, block_out); break;
+        case TextureType::kBC5: EncodeBC5Block(block, block_out); break;
+        case TextureType::kBC7: EncodeBC7Block(block, block_out); break;
+        default: NOT_REACHED(); return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool ConvertTexture(Texture* texture, TextureType type) {
+  ASSERT(!Staged(*texture));
+  if (texture->type == type)
+    return true;
+
+  if (texture->type != TextureType::kRGBA) {
+    ERROR(Graphics, "Texture %s: Can only convert from RGBA (got %s).", texture->name.c_str(),
+          ToString(texture->type));
+    return false;
+  }
+
+  Texture converted_layout = {};
+  converted_layout.size = texture->size;
+  converted_layout.type = type;
+  converted_layout.mip_levels = texture->mip_levels;
+  converted_layout.layers = texture->layers;
+
+  auto data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(DataSize(converted_layout));
+  for (uint32_t level = 0; level < texture->mip_levels; level++) {
+    TextureMipLevel src = GetMipLevel(*texture, level);
+    TextureMipLevel dst = GetMipLevel(converted_layout, level);
+    for (uint32_t layer = 0; layer < texture->layers; layer++) {
+      const uint8_t* rgba = texture->data.get() + src.offset + layer * src.layer_size;
+      if (!EncodeImage(type, rgba, src.size, data.get() + dst.offset + layer * dst.layer_size))
+        return false;
+    }
+  }
+
+  texture->type = type;
+  texture->data = std::move(data);
+  return true;
+}
+
+}  // namespace rothko
@@ -0,0 +1,35 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "rothko/graphics/texture.h"
+
+namespace rothko {
+
+// Texture Compression -----------------------------------------------------------------------------
+//
+// CPU encoders for the block compressed texture types, meant for the asset pipeline (offline or at
+// load time). They favour simplicity and speed over the best possible quality: endpoints come from
+// the principal axis of the block and BC7 always uses mode 6 (single subset, RGBA).
+//
+// Blocks are 4x4 pixels, row major. Images that are not a multiple of 4 repeat their edge pixels
+// to fill the border blocks.
+
+// |rgba| is 16 RGBA pixels (64 bytes). |values| is 16 single channel values.
+void EncodeBC1Block(const uint8_t* rgba, uint8_t* out);     // 8 bytes. Alpha is ignored.
+void EncodeBC3Block(const uint8_t* rgba, uint8_t* out);     // 16 bytes.
+void EncodeBC4Block(const uint8_t* values, uint8_t* out);   // 8 bytes.
+void EncodeBC5Block(const uint8_t* rgba, uint8_t* out);     // 16 bytes. Encodes red and green.
+void EncodeBC7Block(const uint8_t* rgba, uint8_t* out);     // 16 bytes.
+
+// Encodes an RGBA image of |size| into |type|. |out| must hold |DataSize(type, size)| bytes.
+// Also works for the uncompressed types (kR8/kRG8 keep the first channels).
+bool EncodeImage(TextureType type, const uint8_t* rgba, Int2 size, uint8_t* out);
+
+// Converts all the mip levels of a kRGBA texture into |type|. The texture cannot be staged.
+bool ConvertTexture(Texture*, TextureType type);
+
+}  // namespace rothko
@@ -0,0 +1,185 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/texture_mipmaps.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#include "rothko/logging/logging.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROTHKO_MIPMAPS_SSE2 1
+#include <emmintrin.h>
+#else
+#define ROTHKO_MIPMAPS_SSE2 0
+#endif
+
+namespace rothko {
+
+namespace {
+
+// Precision of the linear -> sRGB table. 12 bits is enough to hit every 8 bit sRGB value.
+constexpr uint32_t kLinearToSRGBEntries = 4096;
+
+struct ColorTables {
+  float srgb_to_linear[256];
+  uint8_t linear_to_srgb[kLinearToSRGBEntries];
+};
+
+const ColorTables& GetColorTables() {
+  static const ColorTables tables = [] {
+    ColorTables t;
+    for (uint32_t i = 0; i < 256; i++) {
+      float c = i / 255.0f;
+      t.srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (uint32_t i = 0; i < kLinearToSRGBEntries; i++) {
+      float l = (float)i / (kLinearToSRGBEntries - 1);
+      float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+      t.linear_to_srgb[i] = (uint8_t)(c * 255.0f + 0.5f);
+    }
+    return t;
+  }();
+
+  return tables;
+}
+
+// Working images are always 4 floats per pixel, so each pixel maps to one SSE register.
+// Channels not present in the texture are left at 0.
+
+void Decode(const uint8_t* src, Int2 size, uint32_t channels, bool srgb, float* out) {
+  const ColorTables& tables = GetColorTables();
+  uint32_t pixel_count = size.x * size.y;
+  for (uint32_t i = 0; i < pixel_count; i++) {
+    for (uint32_t c = 0; c < 4; c++) {
+      float value = 0.0f;
+      if (c < channels) {
+        uint8_t v = src[i * channels + c];
+        value = (srgb && c < 3) ? tables.srgb_to_linear[v] : v / 255.0f;
+      }
+      out[i * 4 + c] = value;
+    }
+  }
+}
+
+void Encode(const float* src, Int2 size, uint32_t channels, bool srgb, uint8_t* out) {
+  const ColorTables& tables = GetColorTables();
+  uint32_t pixel_count = size.x * size.y;
+  for (uint32_t i = 0; i < pixel_count; i++) {
+    int32_t linear_index[4];
+    int32_t unorm[4];
+
+#if ROTHKO_MIPMAPS_SSE2
+    __m128 v = _mm_loadu_ps(src + i * 4);
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    _mm_storeu_si128((__m128i*)linear_index,
+                     _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(kLinearToSRGBEntries - 1))));
+    _mm_storeu_si128((__m128i*)unorm, _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(255.0f))));
+#else
+    for (uint32_t c = 0; c < 4; c++) {
+      float v = src[i * 4 + c];
+      v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+      linear_index[c] = (int32_t)(v * (kLinearToSRGBEntries - 1) + 0.5f);
+      unorm[c] = (int32_t)(v * 255.0f + 0.5f);
+    }
+#endif
+
+    for (uint32_t c = 0; c < channels; c++) {
+      out[i * channels + c] = (srgb && c < 3) ? tables.linear_to_srgb[linear_index[c]]
+                                              : (uint8_t)unorm[c];
+    }
+  }
+}
+
+// 2x2 box filter. Odd sizes repeat the last row/column.
+void Downsample(const float* src, Int2 src_size, float* dst, Int2 dst_size) {
+  for (int y = 0; y < dst_size.y; y++) {
+    int y0 = 2 * y;
+    int y1 = y0 + 1 < src_size.y ? y0 + 1 : src_size.y - 1;
+    const float* row0 = src + y0 * src_size.x * 4;
+    const float* row1 = src + y1 * src_size.x * 4;
+    float* out = dst + y * dst_size.x * 4;
+
+    for (int x = 0; x < dst_size.x; x++) {
+      int x0 = 2 * x;
+      int x1 = x0 + 1 < src_size.x ? x0 + 1 : src_size.x - 1;
+
+#if ROTHKO_MIPMAPS_SSE2
+      __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0 * 4), _mm_loadu_ps(row0 + x1 * 4)),
+                              _mm_add_ps(_mm_loadu_ps(row1 + x0 * 4), _mm_loadu_ps(row1 + x1 * 4)));
+      _mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+      for (uint32_t c = 0; c < 4; c++) {
+        out[x * 4 + c] = 0.25f * (row0[x0 * 4 + c] + row0[x1 * 4 + c] +
+                                  row1[x0 * 4 + c] + row1[x1 * 4 + c]);
+      }
+#endif
+    }
+  }
+}
+
+}  // namespace
+
+bool GenerateMipmaps(Texture* texture, ColorSpace color_space) {
+  ASSERT(!Staged(*texture));
+  ASSERT(Loaded(*texture));
+
+  if (IsCompressed(texture->type)) {
+    ERROR(Graphics, "Texture %s: Cannot generate mipmaps for compressed type %s.",
+          texture->name.c_str(), ToString(texture->type));
+    return false;
+  }
+
+  uint32_t levels = MaxMipLevels(texture->size);
+  if (texture->mip_levels == levels)
+    return true;
+
+  // We always start over from the first level.
+  Texture layout = {};
+  layout.size = texture->size;
+  layout.type = texture->type;
+  layout.mip_levels = (uint8_t)levels;
+  layout.layers = texture->layers;
+
+  auto data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(DataSize(layout));
+  TextureMipLevel first = GetMipLevel(layout, 0);
+  memcpy(data.get(), texture->data.get(), first.data_size);
+
+  uint32_t channels = ToSize(texture->type);
+  bool srgb = color_space == ColorSpace::kSRGB && texture->type == TextureType::kRGBA;
+
+  // Ping-pong between two float images. The second one only needs to hold the first reduction.
+  Int2 mip1 = MipSize(texture->size, 1);
+  std::vector<float> current(texture->size.x * texture->size.y * 4);
+  std::vector<float> next(mip1.x * mip1.y * 4);
+
+  for (uint32_t layer = 0; layer < texture->layers; layer++) {
+    Decode(texture->data.get() + layer * first.layer_size, texture->size, channels, srgb,
+           current.data());
+
+    Int2 current_size = texture->size;
+    for (uint32_t level = 1; level < levels; level++) {
+      TextureMipLevel mip = GetMipLevel(layout, level);
+      Downsample(current.data(), current_size, next.data(), mip.size);
+      Encode(next.data(), mip.size, channels, srgb,
+             data.get() + mip.offset + layer * mip.layer_size);
+
+      current.swap(next);
+      current_size = mip.size;
+    }
+
+    // |current| might have been swapped into the smaller buffer.
+    if (current.size() < next.size())
+      current.swap(next);
+  }
+
+  texture->mip_levels = (uint8_t)levels;
+  texture->data = std::move(data);
+  return true;
+}
+
+}  // namespace rothko
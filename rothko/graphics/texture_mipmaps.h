@@ -0,0 +1,27 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "rothko/graphics/texture.h"
+
+namespace rothko {
+
+// Texture Mipmaps ---------------------------------------------------------------------------------
+//
+// CPU generation of mip chains, so that they can be computed when the asset is built or loaded
+// (from any thread) instead of by the driver on the render thread. The backend uploads the levels
+// as they are in |Texture::data|.
+//
+// Each level is a 2x2 box filter of the previous one, computed in floating point (with SSE2 when
+// available) so that error does not accumulate down the chain. sRGB colors are filtered in linear
+// space and encoded back, which keeps the brightness of the levels stable.
+
+// Replaces |data| with the full mip chain (down to 1x1) of its first level. Only the color channels
+// of kRGBA textures are affected by |color_space|: R8/RG8 and alpha are always linear.
+// The texture cannot be staged nor compressed (compress after generating, see |ConvertTexture|).
+bool GenerateMipmaps(Texture*, ColorSpace color_space = ColorSpace::kSRGB);
+
+}  // namespace rothko
@@ -13,8 +13,11 @@ const char* ToString(VertComponent vert_component) {
   switch (vert_component) {
     case VertComponent::kPos2d: return "Pos2d";
     case VertComponent::kPos3d: return "Pos3d";
+    case VertComponent::kPos3d_short: return "Pos3d_short";
     case VertComponent::kNormal: return "Normal";
     case VertComponent::kTangent: return "Tangent";
+    case VertComponent::kNormal_oct: return "Normal_oct";
+    case VertComponent::kTangent_byte: return "Tangent_byte";
     case VertComponent::kUV0_byte: return "UV0_byte";
     case VertComponent::kUV0_short: return "UV0_short";
     case VertComponent::kUV0_float: return "UV0_float";
@@ -43,8 +46,11 @@ uint32_t ToSize(VertComponent vert_component) {
   switch (vert_component) {
     case VertComponent::kPos2d: return sizeof(Vec2);
     case VertComponent::kPos3d: return sizeof(Vec3);
+    case VertComponent::kPos3d_short: return sizeof(uint16_t[4]);
     case VertComponent::kNormal: return sizeof(Vec3);
     case VertComponent::kTangent: return sizeof(Vec4);
+    case VertComponent::kNormal_oct: return sizeof(int16_t[2]);
+    case VertComponent::kTangent_byte: return sizeof(int8_t[4]);
     case VertComponent::kUV0_byte: return sizeof(uint16_t);
     case VertComponent::kUV0_short: return sizeof(uint32_t);
     case VertComponent::kUV0_float: return sizeof(Vec2);
@@ -79,6 +85,8 @@ const char* ToString(VertexType type) {
     case VertexType::k3dNormalTangentUV: return "3d Normal Tangent UV";
     case VertexType::k3dUV: return "3d UV";
     case VertexType::k3dUVColor: return "3D UV Color";
+    case VertexType::kQuantized3dNormalUV: return "Quantized 3d Normal UV";
+    case VertexType::kQuantized3dNormalTangentUV: return "Quantized 3d Normal Tangent UV";
     case VertexType::kLast: return "Last";
   }
 
@@ -96,6 +104,8 @@ uint32_t ToSize(VertexType type) {
     case VertexType::k3dNormalTangentUV: return sizeof(Vertex3dNormalTangentUV);
     case VertexType::k3dUV: return sizeof(Vertex3dUV);
     case VertexType::k3dUVColor: return sizeof(Vertex3dUVColor);
+    case VertexType::kQuantized3dNormalUV: return sizeof(VertexQuantized3dNormalUV);
+    case VertexType::kQuantized3dNormalTangentUV: return sizeof(VertexQuantized3dNormalTangentUV);
     case VertexType::kLast: break;
   }
 
@@ -115,6 +125,8 @@ VertexType ToVertexType(uint32_t t) {
     case VertexType::k3dUV:
     case VertexType::k3dUVColor:
     case VertexType::k3dNormalTangentUV:
+    case VertexType::kQuantized3dNormalUV:
+    case VertexType::kQuantized3dNormalTangentUV:
     case VertexType::kLast:
       return type;
   }
@@ -124,6 +136,70 @@ VertexType ToVertexType(uint32_t t) {
   return VertexType::kLast;
 }
 
+// Vertex Layout -----------------------------------------------------------------------------------
+
+VertexLayout GetVertexLayout(VertexType type) {
+  VertexLayout layout = {};
+  if (type == VertexType::kLast)
+    return layout;
+
+  uint32_t bits = (uint32_t)type;
+  for (uint32_t bit = 0; bit < 32; bit++) {
+    uint32_t mask = 1u << bit;
+    if ((bits & mask) == 0)
+      continue;
+
+    ASSERT(layout.count < kMaxVertexAttributes);
+    VertexAttribute& attribute = layout.attributes[layout.count++];
+    attribute.component = (VertComponent)mask;
+    attribute.offset = layout.stride;
+    layout.stride += ToSize(attribute.component);
+  }
+
+  ASSERT_MSG(layout.stride == ToSize(type), "Vertex %s: Layout stride %u, size %u",
+             ToString(type), layout.stride, ToSize(type));
+  return layout;
+}
+
+// Quantization ------------------------------------------------------------------------------------
+
+namespace {
+
+inline float Clamp01(float v) { return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v); }
+inline float Clamp11(float v) { return v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v); }
+inline float Round(float v) { return v >= 0.0f ? (float)(int)(v + 0.5f) : (float)(int)(v - 0.5f); }
+inline float SignNotZero(float v) { return v >= 0.0f ? 1.0f : -1.0f; }
+inline float AbsF(float v) { return v >= 0.0f ? v : -v; }
+
+}  // namespace
+
+uint16_t QuantizeUnorm16(float value) { return (uint16_t)Round(Clamp01(value) * 65535.0f); }
+int16_t QuantizeSnorm16(float value) { return (int16_t)Round(Clamp11(value) * 32767.0f); }
+int8_t QuantizeSnorm8(float value) { return (int8_t)Round(Clamp11(value) * 127.0f); }
+
+Vec2 OctEncode(Vec3 n) {
+  float l1 = AbsF(n.x) + AbsF(n.y) + AbsF(n.z);
+  if (l1 == 0.0f)
+    return {0, 0};
+
+  Vec2 p = {n.x / l1, n.y / l1};
+  if (n.z < 0.0f) {
+    // Fold the lower hemisphere over the diagonals.
+    Vec2 folded = {(1.0f - AbsF(p.y)) * SignNotZero(p.x), (1.0f - AbsF(p.x)) * SignNotZero(p.y)};
+    p = folded;
+  }
+
+  return p;
+}
+
+Vec3 OctDecode(Vec2 e) {
+  Vec3 n = {e.x, e.y, 1.0f - AbsF(e.x) - AbsF(e.y)};
+  float t = n.z < 0.0f ? -n.z : 0.0f;
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  return Normalize(n);
+}
+
 // ToString ----------------------------------------------------------------------------------------
 
 std::string ToString(const Vertex3dNormalTangentUV& vertex) {
@@ -10,16 +10,23 @@
 namespace rothko {
 
 // Detection occurs according to bits.
+// Within a vertex, components are laid out in the order of their bits (see |GetVertexLayout|).
+//
+// Quantized components (_short, _oct, _byte) are normalized integers. Positions and UVs are
+// dequantized with the mesh's |VertexDequantization|.
 
 enum class VertComponent : uint32_t {
-  kPos2d   = (1 << 1),             // Vec2
-  kPos3d   = (1 << 2),             // Vec3
+  kPos2d       = (1 << 1),         // Vec2
+  kPos3d       = (1 << 2),         // Vec3
+  kPos3d_short = (1 << 3),         // uint16_t[4]. Normalized within the mesh bounds, w is padding.
 
-  kNormal  = (1 << 4),             // Vec3
-  kTangent = (1 << 5),             // Vec4
+  kNormal     = (1 << 4),          // Vec3
+  kTangent    = (1 << 5),          // Vec4
+  kNormal_oct = (1 << 6),          // int16_t[2]. Octahedral encoded.
+  kTangent_byte = (1 << 7),        // int8_t[4]. w is the bitangent sign.
 
   kUV0_byte   = (1 << 8),          // uint8_t[2] / uint16_t
-  kUV0_short  = (1 << 9),          // uint16_t[2] / uint32_t
+  kUV0_short  = (1 << 9),          // uint16_t[2] / uint32_t. Normalized within the mesh UV bounds.
   kUV0_float  = (1 << 10),         // Vec2
 
   kUV1_byte   = (1 << 11),         // uint8_t[2] / uint16_t
@@ -76,6 +83,16 @@ enum class VertexType : uint32_t {
                        (uint32_t)VertComponent::kNormal |
                        (uint32_t)VertComponent::kTangent |
                        (uint32_t)VertComponent::kUV0_float,
+
+  // Quantized equivalents of the above. See |QuantizeVertices| in mesh.h.
+  kQuantized3dNormalUV = (uint32_t)VertComponent::kPos3d_short |
+                         (uint32_t)VertComponent::kNormal_oct |
+                         (uint32_t)VertComponent::kUV0_short,
+
+  kQuantized3dNormalTangentUV = (uint32_t)VertComponent::kPos3d_short |
+                                (uint32_t)VertComponent::kNormal_oct |
+                                (uint32_t)VertComponent::kTangent_byte |
+                                (uint32_t)VertComponent::kUV0_short,
   kLast = UINT32_MAX,
 };
 // clang-format on
@@ -84,6 +101,52 @@ VertexType ToVertexType(uint32_t);
 const char* ToString(VertexType);
 uint32_t ToSize(VertexType);
 
+// Vertex Layout -----------------------------------------------------------------------------------
+//
+// Derived from the component bits of the vertex type, so backends don't need to know about each
+// vertex struct.
+
+constexpr uint32_t kMaxVertexAttributes = 8;
+
+struct VertexAttribute {
+  VertComponent component = VertComponent::kLast;
+  uint32_t offset = 0;    // In bytes, from the start of the vertex.
+};
+
+struct VertexLayout {
+  VertexAttribute attributes[kMaxVertexAttributes] = {};
+  uint32_t count = 0;
+  uint32_t stride = 0;
+};
+
+VertexLayout GetVertexLayout(VertexType);
+
+// Quantization ------------------------------------------------------------------------------------
+
+// Maps the normalized quantized values back into the original range:
+// value = offset + normalized * scale.
+struct VertexDequantization {
+  Vec3 pos_offset = {0, 0, 0};
+  Vec3 pos_scale = {1, 1, 1};
+  Vec2 uv_offset = {0, 0};
+  Vec2 uv_scale = {1, 1};
+};
+
+// |value| is expected to be in [0, 1] for unorm and [-1, 1] for snorm. It gets clamped otherwise.
+uint16_t QuantizeUnorm16(float value);
+int16_t QuantizeSnorm16(float value);
+int8_t QuantizeSnorm8(float value);
+
+inline float DequantizeUnorm16(uint16_t value) { return (float)value / 65535.0f; }
+inline float DequantizeSnorm16(int16_t value) {
+  float v = (float)value / 32767.0f;
+  return v < -1.0f ? -1.0f : v;
+}
+
+// Octahedral normal encoding: maps a unit vector into [-1, 1]^2.
+Vec2 OctEncode(Vec3 normal);
+Vec3 OctDecode(Vec2 encoded);
+
 // Vertex Definitions ==============================================================================
 
 // NOTE: pragma pack(push, <MODE>) pushes into the compiler state the way the compiler should pad
@@ -164,6 +227,25 @@ struct Vertex3dNormalTangentUV {
 static_assert(sizeof(Vertex3dNormalTangentUV) == 48);
 std::string ToString(const Vertex3dNormalTangentUV&);
 
+struct VertexQuantized3dNormalUV {
+  static constexpr VertexType kVertexType = VertexType::kQuantized3dNormalUV;
+
+  uint16_t pos[4];
+  int16_t normal[2];
+  uint16_t uv[2];
+};
+static_assert(sizeof(VertexQuantized3dNormalUV) == 16);
+
+struct VertexQuantized3dNormalTangentUV {
+  static constexpr VertexType kVertexType = VertexType::kQuantized3dNormalTangentUV;
+
+  uint16_t pos[4];
+  int16_t normal[2];
+  int8_t tangent[4];
+  uint16_t uv[2];
+};
+static_assert(sizeof(VertexQuantized3dNormalTangentUV) == 20);
+
 #pragma pack(pop)
 
 }  // namespace rothko
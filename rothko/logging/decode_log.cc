@@ -0,0 +1,44 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+// Offline decoder for the binary log format (see rothko/logging/log_file.h).
+//
+// Usage: decode_log <BINARY_LOG> [OUTPUT_TEXT_FILE]
+// If no output is given, the decoded log is printed to stdout.
+
+#include <stdio.h>
+
+#include "rothko/logging/log_file.h"
+#include "rothko/utils/file.h"
+
+using namespace rothko;
+
+int main(int argc, const char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <BINARY_LOG> [OUTPUT_TEXT_FILE]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<uint8_t> data;
+  if (!ReadWholeFile(argv[1], &data))
+    return 1;
+
+  std::string text;
+  bool ok = DecodeBinaryLog(data.data(), data.size(), &text);
+
+  if (argc >= 3) {
+    FileHandle file = OpenFile(argv[2]);
+    if (!Valid(file))
+      return 1;
+    WriteToFile(&file, text.data(), text.size());
+  } else {
+    fwrite(text.data(), 1, text.size(), stdout);
+  }
+
+  if (!ok) {
+    fprintf(stderr, "%s: malformed binary log, output is truncated.\n", argv[1]);
+    return 1;
+  }
+
+  return 0;
+}
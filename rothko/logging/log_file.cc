@@ -0,0 +1,330 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/logging/log_file.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <third_party/stb/stb_sprintf.h>
+
+#include "rothko/logging/logging.h"
+
+namespace rothko {
+
+const char* ToString(LogFileFormat format) {
+  switch (format) {
+    case LogFileFormat::kText: return "Text";
+    case LogFileFormat::kBinary: return "Binary";
+  }
+
+  NOT_REACHED();
+  return "<unknown>";
+}
+
+LogFileSink::~LogFileSink() {
+  Close(this);
+}
+
+namespace {
+
+std::string RotatedPath(const std::string& path, int index) {
+  if (index == 0)
+    return path;
+  return path + "." + std::to_string(index);
+}
+
+void WriteHeader(LogFileSink* sink) {
+  if (sink->config.format != LogFileFormat::kBinary)
+    return;
+
+  sink->buffer.insert(sink->buffer.end(), kBinaryLogMagic, kBinaryLogMagic + 6);
+  sink->buffer.push_back(kBinaryLogVersion & 0xff);
+  sink->buffer.push_back(kBinaryLogVersion >> 8);
+}
+
+bool OpenCurrentFile(LogFileSink* sink) {
+  sink->file = OpenFile(sink->config.path, false, true);
+  if (!Valid(sink->file))
+    return false;
+
+  sink->file_size = 0;
+  sink->location_ids.clear();
+  WriteHeader(sink);
+  return true;
+}
+
+// Moves |path| to |path|.1 and so on, deleting the oldest one.
+void RotateFiles(const std::string& path, int max_files) {
+  if (max_files <= 0)
+    return;
+
+  remove(RotatedPath(path, max_files).c_str());
+  for (int i = max_files - 1; i >= 0; i--) {
+    rename(RotatedPath(path, i).c_str(), RotatedPath(path, i + 1).c_str());
+  }
+}
+
+bool FileExists(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+
+  fclose(file);
+  return true;
+}
+
+void Rotate(LogFileSink* sink) {
+  CloseFile(&sink->file);
+  RotateFiles(sink->config.path, sink->config.max_rotated_files);
+  OpenCurrentFile(sink);
+}
+
+// Binary encoding ---------------------------------------------------------------------------------
+
+template <typename T>
+void Put(LogFileSink::Buffer* buffer, T value) {
+  for (size_t i = 0; i < sizeof(T); i++) {
+    buffer->push_back((uint8_t)((uint64_t)value >> (8 * i)));
+  }
+}
+
+void PutString(LogFileSink::Buffer* buffer, const char* str) {
+  size_t len = str ? strlen(str) : 0;
+  if (len > UINT16_MAX)
+    len = UINT16_MAX;
+  Put<uint16_t>(buffer, (uint16_t)len);
+  buffer->insert(buffer->end(), str, str + len);
+}
+
+void EncodeBinary(LogFileSink* sink, const LogEntry& entry) {
+  auto& buffer = sink->buffer;
+
+  auto key = std::make_pair(entry.location.file, entry.location.line);
+  uint32_t location_id = 0;
+  auto it = sink->location_ids.find(key);
+  if (it == sink->location_ids.end()) {
+    location_id = (uint32_t)sink->location_ids.size();
+    sink->location_ids[key] = location_id;
+
+    Put<uint8_t>(&buffer, (uint8_t)BinaryLogRecord::kLocation);
+    Put<uint32_t>(&buffer, location_id);
+    Put<uint32_t>(&buffer, (uint32_t)entry.location.line);
+    PutString(&buffer, entry.location.file);
+    PutString(&buffer, entry.location.function);
+  } else {
+    location_id = it->second;
+  }
+
+  Put<uint8_t>(&buffer, (uint8_t)BinaryLogRecord::kEntry);
+  Put<uint64_t>(&buffer, entry.log_time.nanos);
+  Put<uint8_t>(&buffer, (uint8_t)entry.category);
+  Put<uint8_t>(&buffer, (uint8_t)entry.severity);
+  Put<uint32_t>(&buffer, location_id);
+  PutString(&buffer, entry.msg);
+}
+
+void FormatLine(uint64_t nanos,
+                LogCategory category,
+                LogSeverity severity,
+                const char* file,
+                int line,
+                const char* function,
+                const char* msg,
+                size_t msg_len,
+                std::string* out) {
+  uint64_t micros = nanos / 1000;
+  uint64_t secs = micros / 1000000;
+  uint64_t mins = secs / 60;
+
+  char prefix[512];
+  stbsp_snprintf(prefix, sizeof(prefix), "[%02d:%02d:%02d.%06d][%s][%s][%s:%d][%s] ",
+                 (int)(mins / 60),
+                 (int)(mins % 60),
+                 (int)(secs % 60),
+                 (int)(micros % 1000000),
+                 ToString(severity),
+                 ToString(category),
+                 file ? file : "",
+                 line,
+                 function ? function : "");
+  out->append(prefix);
+  out->append(msg, msg_len);
+  out->push_back('\n');
+}
+
+}  // namespace
+
+bool Init(LogFileSink* sink, const LogFileConfig& config) {
+  Close(sink);
+  sink->config = config;
+  sink->buffer.clear();
+  sink->buffer.reserve(config.buffer_size);
+
+  // The file from the previous run is the one that has its crash, so it is kept.
+  if (FileExists(config.path))
+    RotateFiles(config.path, config.max_rotated_files);
+
+  return OpenCurrentFile(sink);
+}
+
+void Append(LogFileSink* sink, const LogEntry& entry) {
+  if (!Valid(sink->file))
+    return;
+
+  if (sink->config.format == LogFileFormat::kBinary) {
+    EncodeBinary(sink, entry);
+  } else {
+    // |buffer| is uint8_t, so we go through a thread-local scratch string.
+    static thread_local std::string line;
+    line.clear();
+    LogEntryToText(entry, &line);
+    sink->buffer.insert(sink->buffer.end(), line.begin(), line.end());
+  }
+
+  if (sink->buffer.size() >= sink->config.buffer_size)
+    Flush(sink);
+}
+
+void Flush(LogFileSink* sink) {
+  if (!Valid(sink->file) || sink->buffer.empty())
+    return;
+
+  WriteToFile(&sink->file, sink->buffer.data(), sink->buffer.size());
+  Flush(&sink->file);
+  sink->file_size += sink->buffer.size();
+  sink->buffer.clear();
+
+  if (sink->config.max_file_size > 0 && sink->file_size >= sink->config.max_file_size)
+    Rotate(sink);
+}
+
+void Close(LogFileSink* sink) {
+  if (!Valid(sink->file))
+    return;
+
+  Flush(sink);
+  CloseFile(&sink->file);
+  sink->buffer.clear();
+  sink->location_ids.clear();
+}
+
+void LogEntryToText(const LogEntry& entry, std::string* out) {
+  FormatLine(entry.log_time.nanos,
+             entry.category,
+             entry.severity,
+             entry.location.file,
+             entry.location.line,
+             entry.location.function,
+             entry.msg,
+             strlen(entry.msg),
+             out);
+}
+
+// Decoding ----------------------------------------------------------------------------------------
+
+namespace {
+
+struct Reader {
+  const uint8_t* data;
+  size_t size;
+  size_t pos = 0;
+};
+
+template <typename T>
+bool Get(Reader* reader, T* out) {
+  if (reader->pos + sizeof(T) > reader->size)
+    return false;
+
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    value |= (uint64_t)reader->data[reader->pos++] << (8 * i);
+  }
+  *out = (T)value;
+  return true;
+}
+
+bool GetString(Reader* reader, std::string* out) {
+  uint16_t len = 0;
+  if (!Get(reader, &len) || reader->pos + len > reader->size)
+    return false;
+
+  out->assign((const char*)reader->data + reader->pos, len);
+  reader->pos += len;
+  return true;
+}
+
+struct DecodedLocation {
+  std::string file;
+  std::string function;
+  int line = 0;
+};
+
+}  // namespace
+
+bool DecodeBinaryLog(const uint8_t* data, size_t size, std::string* out) {
+  Reader reader = {data, size};
+  if (size < 8 || memcmp(data, kBinaryLogMagic, 6) != 0)
+    return false;
+  reader.pos = 6;
+
+  uint16_t version = 0;
+  if (!Get(&reader, &version) || version != kBinaryLogVersion)
+    return false;
+
+  std::vector<DecodedLocation> locations;
+  std::string msg;
+  while (reader.pos < reader.size) {
+    uint8_t type = 0;
+    Get(&reader, &type);
+
+    if (type == (uint8_t)BinaryLogRecord::kLocation) {
+      uint32_t id = 0, line = 0;
+      DecodedLocation location;
+      if (!Get(&reader, &id) || !Get(&reader, &line) || !GetString(&reader, &location.file) ||
+          !GetString(&reader, &location.function)) {
+        return false;
+      }
+      location.line = (int)line;
+
+      if (id >= locations.size())
+        locations.resize(id + 1);
+      locations[id] = std::move(location);
+      continue;
+    }
+
+    if (type == (uint8_t)BinaryLogRecord::kEntry) {
+      uint64_t nanos = 0;
+      uint8_t category = 0, severity = 0;
+      uint32_t location_id = 0;
+      if (!Get(&reader, &nanos) || !Get(&reader, &category) || !Get(&reader, &severity) ||
+          !Get(&reader, &location_id) || !GetString(&reader, &msg)) {
+        return false;
+      }
+
+      if (location_id >= locations.size() || category >= (uint8_t)LogCategory::kLast ||
+          severity > (uint8_t)LogSeverity::kAssert) {
+        return false;
+      }
+
+      auto& location = locations[location_id];
+      FormatLine(nanos,
+                 (LogCategory)category,
+                 (LogSeverity)severity,
+                 location.file.c_str(),
+                 location.line,
+                 location.function.c_str(),
+                 msg.data(),
+                 msg.size(),
+                 out);
+      continue;
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace rothko
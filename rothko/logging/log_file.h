@@ -0,0 +1,101 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rothko/memory/memory_tracker.h"
+#include "rothko/utils/file.h"
+#include "rothko/utils/macros.h"
+
+namespace rothko {
+
+struct LogEntry;
+
+// Log File Sink -----------------------------------------------------------------------------------
+//
+// Output used by the logging thread. Entries are encoded into a memory buffer that is written out
+// to the file in one go when it fills up or when the logging thread has nothing else to do.
+// When the file grows over |max_file_size| it gets rotated:
+//
+//   log.txt -> log.txt.1 -> log.txt.2 -> ... -> log.txt.<max_rotated_files> (deleted)
+//
+// |Init| also rotates the file left by a previous run, so it is not lost when a new one starts.
+
+enum class LogFileFormat {
+  kText,
+  kBinary,  // See "Binary Format" below.
+};
+const char* ToString(LogFileFormat);
+
+struct LogFileConfig {
+  std::string path;   // Empty means no file output.
+  LogFileFormat format = LogFileFormat::kText;
+
+  uint32_t buffer_size = 64 * 1024;
+  uint64_t max_file_size = 64 * 1024 * 1024;  // 0 means never rotate.
+  int max_rotated_files = 4;  // 0 means the file is overwritten instead.
+};
+
+struct LogFileSink {
+  using Buffer = TaggedVector<uint8_t, MemoryTag::kLogging>;
+
+  RAII_CONSTRUCTORS(LogFileSink);
+
+  LogFileConfig config = {};
+  FileHandle file = {};
+  uint64_t file_size = 0;   // Bytes already written into the current file.
+
+  Buffer buffer;
+
+  // Binary format only: locations already written into the current file.
+  std::map<std::pair<const char*, int>, uint32_t> location_ids;
+};
+inline bool Valid(const LogFileSink& sink) { return Valid(sink.file); }
+
+bool Init(LogFileSink*, const LogFileConfig&);
+
+// Encodes the entry into the sink buffer. Might write to the file if the buffer is full.
+void Append(LogFileSink*, const LogEntry&);
+
+// Writes whatever is in the buffer into the file.
+void Flush(LogFileSink*);
+
+// Flushes and closes the file. The sink can be |Init| again afterwards.
+void Close(LogFileSink*);
+
+// Text Format -------------------------------------------------------------------------------------
+
+// Appends the entry as a single text line (ending in '\n').
+void LogEntryToText(const LogEntry&, std::string* out);
+
+// Binary Format -----------------------------------------------------------------------------------
+//
+// All values are little-endian. A file is the header followed by records:
+//
+//   Header:   "RTKLOG" u16(version)
+//   Location: u8(kLocation) u32(id) u32(line) u16(len) file u16(len) function
+//   Entry:    u8(kEntry) u64(nanos) u8(category) u8(severity) u32(location id) u16(len) msg
+//
+// A location record is written the first time a location is used within a file, so entries only
+// need to carry the id.
+
+constexpr char kBinaryLogMagic[] = "RTKLOG";
+constexpr uint16_t kBinaryLogVersion = 1;
+
+enum class BinaryLogRecord : uint8_t {
+  kLocation = 1,
+  kEntry = 2,
+};
+
+// Decodes a whole binary log into text with the same format |LogEntryToText| uses.
+// Returns false if the data is malformed (whatever could be decoded is still in |out|).
+bool DecodeBinaryLog(const uint8_t* data, size_t size, std::string* out);
+
+}  // namespace rothko
@@ -3,14 +3,19 @@
 
 #include "rothko/logging/logging.h"
 
+#include <inttypes.h>
 #include <stdarg.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
+#include <third_party/stb/stb_sprintf.h>
+
+#include "rothko/logging/log_file.h"
 #include "rothko/platform/platform.h"
 #include "rothko/utils/macros.h"
-#include "rothko/utils/strings.h"
 
 namespace rothko {
 
@@ -41,15 +46,62 @@ const char* ToString(LogSeverity severity) {
   return "<unknown>";
 }
 
+// Log Filtering -----------------------------------------------------------------------------------
+
+namespace internal {
+std::atomic<LogSeverity> gLogThresholds[(int)LogCategory::kLast] = {};
+}  // namespace internal
+
+LogSeverity GetLogThreshold(LogCategory category) {
+  return internal::gLogThresholds[(int)category].load(std::memory_order_relaxed);
+}
+
+void SetLogThreshold(LogCategory category, LogSeverity severity) {
+  internal::gLogThresholds[(int)category].store(severity, std::memory_order_relaxed);
+}
+
+void SetAllLogThresholds(LogSeverity severity) {
+  for (int i = 0; i < (int)LogCategory::kLast; i++) {
+    SetLogThreshold((LogCategory)i, severity);
+  }
+}
+
 // LogContainer ------------------------------------------------------------------------------------
 //
 // Actual struct that holds the logs for the system.
 // The system is active while there is an active LoggerHandle.
 
+LogContainer::LogContainer() {
+  for (uint64_t i = 0; i < kMaxEntries; i++) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+bool ReadLogEntry(const LogContainer& logs, uint64_t index, LogEntry* out) {
+  const LogSlot& slot = logs.slots[index % LogContainer::kMaxEntries];
+
+  uint32_t version = slot.version.load(std::memory_order_acquire);
+  if (version & 1)
+    return false;
+
+  // The slot must still be holding |index| (either waiting to be consumed or already consumed).
+  uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+  if (sequence != index + 1 && sequence != index + LogContainer::kMaxEntries)
+    return false;
+
+  *out = slot.entry;
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.version.load(std::memory_order_relaxed) == version;
+}
+
 // Logging Loop ------------------------------------------------------------------------------------
 //
-// Loop that runs on another thread that outputs the logs into stdout.
-// TODO(Cristian): Output to a file instead.
+// Loop that runs on another thread that outputs the logs into stdout and the log file (if any).
+// It sleeps on |gWakeup| while there is nothing to output. Producers only take the mutex when the
+// logging thread has announced (through |gLoggingThreadWaiting|) that it's about to sleep.
+// The file sink is flushed every time the loop runs out of messages, so under heavy logging the
+// writes get batched up to the sink buffer size.
 
 namespace {
 
@@ -57,29 +109,85 @@ std::unique_ptr<LogContainer> gLogs = nullptr;
 std::atomic<bool> gLoggingActive = false;
 bool gLogToStdout = false;
 
+// Only touched by the logging thread while it's running.
+LogFileSink gLogFile;
+
+std::mutex gWakeupMutex;
+std::condition_variable gWakeup;
+std::atomic<bool> gLoggingThreadWaiting = false;
+
 // If |to_stdout| is true, it will also log into stdout.
 void OutputLogMessage(bool to_stdout, const LogEntry& entry);  // Defined further down.
 
 // Must only be changed by the logging thread.
 uint64_t gReaderIndex = 0;
+uint64_t gReportedDrops = 0;
+
+// Up to where the logging thread has output and flushed. See |FlushLogs|.
+std::atomic<uint64_t> gFlushedIndex = 0;
+std::mutex gFlushMutex;
+std::condition_variable gFlushed;
+
+bool HasPendingMessages() {
+  const LogSlot& slot = gLogs->slots[gReaderIndex % LogContainer::kMaxEntries];
+  return slot.sequence.load() == gReaderIndex + 1;
+}
+
+void WakeupLoggingThread() {
+  if (!gLoggingThreadWaiting.load())
+    return;
+
+  // Taking the lock guarantees the logging thread is either before its last check or already
+  // waiting, so the notification cannot be lost.
+  std::lock_guard<std::mutex> lock(gWakeupMutex);
+  gWakeup.notify_one();
+}
+
+void ReportDroppedMessages() {
+  uint64_t dropped = gLogs->dropped_messages.load(std::memory_order_relaxed);
+  if (dropped == gReportedDrops)
+    return;
+
+  if (gLogToStdout) {
+    printf("[Logging] Dropped %" PRIu64 " messages (logging buffer full).\n",
+           dropped - gReportedDrops);
+    fflush(stdout);
+  }
+  gReportedDrops = dropped;
+}
 
 void LoggingLoop() {
   while (true) {
-    // Output all messages currently not written in this logger iteration.
-    uint64_t writer_index = gLogs->write_index;
-    while (gReaderIndex < writer_index) {
-      uint64_t reader_index = gReaderIndex % LogContainer::kMaxEntries;
+    // Output all messages currently published.
+    while (true) {
+      LogSlot& slot = gLogs->slots[gReaderIndex % LogContainer::kMaxEntries];
+      if (slot.sequence.load(std::memory_order_acquire) != gReaderIndex + 1)
+        break;
 
-      OutputLogMessage(false, gLogs->entries[reader_index]);
+      OutputLogMessage(false, slot.entry);
+      Append(&gLogFile, slot.entry);
+
+      // Hand the slot back to the writers.
+      slot.sequence.store(gReaderIndex + LogContainer::kMaxEntries, std::memory_order_release);
       gReaderIndex++;
     }
+    ReportDroppedMessages();
+
+    Flush(&gLogFile);
+    {
+      std::lock_guard<std::mutex> lock(gFlushMutex);
+      gFlushedIndex = gReaderIndex;
+      gFlushed.notify_all();
+    }
 
     if (!gLoggingActive)
       break;
 
-    // We sleep until the next logging iteration.
-    // Should be faster than a frame so that's hard to overflow the buffer.
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::unique_lock<std::mutex> lock(gWakeupMutex);
+    gLoggingThreadWaiting.store(true);
+    if (!HasPendingMessages() && gLoggingActive)
+      gWakeup.wait(lock);
+    gLoggingThreadWaiting.store(false);
   }
 };
 
@@ -90,6 +198,12 @@ std::thread gLoggingThread;
 // Logger Handle -----------------------------------------------------------------------------------
 
 std::unique_ptr<LoggerHandle> InitLoggingSystem(bool log_to_stdout) {
+  LoggingConfig config = {};
+  config.log_to_stdout = log_to_stdout;
+  return InitLoggingSystem(config);
+}
+
+std::unique_ptr<LoggerHandle> InitLoggingSystem(const LoggingConfig& config) {
   if (gLogs) {
     printf("%s:%d -> LOGGING SHOULD NOT BE ACTIVE ON INIT!\n", __FILE__, __LINE__);
     fflush(stdout);
@@ -98,8 +212,20 @@ std::unique_ptr<LoggerHandle> InitLoggingSystem(bool log_to_stdout) {
 
   // Start the logging loop thread.
   gLoggingActive = true;
-  gLogToStdout = log_to_stdout;
+  gLogToStdout = config.log_to_stdout;
+  for (int i = 0; i < (int)LogCategory::kLast; i++) {
+    SetLogThreshold((LogCategory)i, config.thresholds[i]);
+  }
   gLogs.reset(new LogContainer());
+  gReaderIndex = 0;
+  gReportedDrops = 0;
+  gFlushedIndex = 0;
+
+  if (!config.file.path.empty() && !Init(&gLogFile, config.file)) {
+    printf("%s:%d -> Could not open log file %s\n", __FILE__, __LINE__, config.file.path.c_str());
+    fflush(stdout);
+  }
+
   gLoggingThread = std::thread(LoggingLoop);
 
   return std::make_unique<LoggerHandle>();
@@ -115,11 +241,32 @@ LoggerHandle::~LoggerHandle() {
   }
 
   // Wait for the loop to end.
-  gLoggingActive = false;
+  {
+    std::lock_guard<std::mutex> lock(gWakeupMutex);
+    gLoggingActive = false;
+    gWakeup.notify_one();
+  }
   gLoggingThread.join();
+  Close(&gLogFile);
   gLogs.reset();
 }
 
+void FlushLogs() {
+  if (!gLoggingActive)
+    return;
+
+  uint64_t target = gLogs->write_index;
+  {
+    // Make sure the logging thread runs another iteration.
+    std::lock_guard<std::mutex> lock(gWakeupMutex);
+    gWakeup.notify_one();
+  }
+
+  // We don't wait forever: if the logging thread is wedged we still want to crash.
+  std::unique_lock<std::mutex> lock(gFlushMutex);
+  gFlushed.wait_for(lock, std::chrono::seconds(1), [target]() { return gFlushedIndex >= target; });
+}
+
 const LogContainer& GetLogs() {
   if (!gLogs)
     SEGFAULT();
@@ -150,7 +297,10 @@ void NanoToLogTime(LogTime* time, uint64_t nanos) {
 }
 
 void OutputLogMessage(bool to_stdout, const LogEntry& message) {
-  // TODO(Cristian): Log to file.
+  // Asserts are output synchronously by the thread that logged them, so we don't repeat them.
+  if (!to_stdout && message.severity == LogSeverity::kAssert)
+    return;
+
   if (to_stdout || gLogToStdout) {
     // TODO(Cristian): Add time.
     printf("[%s][%s:%d][%s] %s\n",
@@ -158,7 +308,7 @@ void OutputLogMessage(bool to_stdout, const LogEntry& message) {
            message.location.file,
            message.location.line,
            message.location.function,
-           message.msg.c_str());
+           message.msg);
     fflush(stdout);
   }
 }
@@ -170,11 +320,6 @@ void DoLogging(
   if (!gLoggingActive)
     return;
 
-  va_list va;
-  va_start(va, fmt);
-  auto msg = StringPrintfV(fmt, va);
-  va_end(va);
-
   // Assert goes to the console.
   if (severity == LogSeverity::kAssert) {
     LogEntry entry = {};
@@ -182,21 +327,65 @@ void DoLogging(
     entry.category = category;
     entry.severity = severity;
     entry.location = location;
-    entry.msg = std::move(msg);
+
+    va_list va;
+    va_start(va, fmt);
+    stbsp_vsnprintf(entry.msg, sizeof(entry.msg), fmt, va);
+    va_end(va);
 
     OutputLogMessage(true, entry);
-    return;
+
+    // We still queue it so that it reaches the log file.
+  }
+
+  // Claim a slot. If the ring is full we drop the message rather than block the caller.
+  LogSlot* slot = nullptr;
+  uint64_t pos = gLogs->write_index.load(std::memory_order_relaxed);
+  while (true) {
+    slot = &gLogs->slots[pos % LogContainer::kMaxEntries];
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    int64_t diff = (int64_t)sequence - (int64_t)pos;
+    if (diff == 0) {
+      if (gLogs->write_index.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      // The logging thread hasn't consumed this slot yet. Only drop if nobody moved on meanwhile.
+      uint64_t current = gLogs->write_index.load(std::memory_order_relaxed);
+      if (current == pos) {
+        gLogs->dropped_messages.fetch_add(1, std::memory_order_relaxed);
+        WakeupLoggingThread();
+        return;
+      }
+      pos = current;
+    } else {
+      pos = gLogs->write_index.load(std::memory_order_relaxed);
+    }
   }
 
-  // Insert the logs into the log system.
-  int write_index = gLogs->write_index++ % LogContainer::kMaxEntries;
+  slot->version.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
 
-  auto& entry = gLogs->entries[write_index];
+  auto& entry = slot->entry;
   NanoToLogTime(&entry.log_time, GetNanoseconds());
   entry.category = category;
   entry.severity = severity;
-  entry.location = std::move(location);
-  entry.msg = std::move(msg);
+  entry.location = location;
+
+  va_list va;
+  va_start(va, fmt);
+  stbsp_vsnprintf(entry.msg, sizeof(entry.msg), fmt, va);
+  va_end(va);
+
+  slot->version.fetch_add(1, std::memory_order_release);
+
+  // Publish the entry to the logging thread.
+  slot->sequence.store(pos + 1);
+  WakeupLoggingThread();
+
+  // Asserts (and errors in debug builds) are followed by a crash, so we make sure they reach the
+  // file. Release errors are recoverable and must not block the caller.
+  if (severity == LogSeverity::kAssert || (DEBUG_MODE && severity == LogSeverity::kError))
+    FlushLogs();
 }
 
 }  // namespace rothko
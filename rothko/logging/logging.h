@@ -9,6 +9,8 @@
 #include <memory>
 #include <string>
 
+#include "rothko/logging/log_file.h"
+#include "rothko/memory/memory_tracker.h"
 #include "rothko/utils/location.h"
 #include "rothko/utils/macros.h"
 
@@ -37,6 +39,43 @@ enum class LogSeverity : uint32_t {
 };
 const char* ToString(LogSeverity);
 
+// Log Filtering -----------------------------------------------------------------------------------
+//
+// There are two levels of filtering:
+//
+// - Compile time: Any log under LOG_MIN_SEVERITY (a LogSeverity value) is stripped from the binary.
+//                 Defaults to kInfo for debug builds and kWarning for release builds.
+// - Runtime:      Each category has a minimum severity that can be changed at any time.
+//
+// Both are checked by the logging macros *before* the arguments are evaluated, so a filtered log
+// costs a relaxed atomic load at most. Asserts are never filtered at runtime.
+
+#ifndef LOG_MIN_SEVERITY
+#if DEBUG_MODE
+#define LOG_MIN_SEVERITY 0
+#else
+#define LOG_MIN_SEVERITY 1
+#endif
+#endif
+
+constexpr bool LogSeverityCompiled(LogSeverity severity) {
+  return (uint32_t)severity >= LOG_MIN_SEVERITY;
+}
+
+namespace internal {
+extern std::atomic<LogSeverity> gLogThresholds[(int)LogCategory::kLast];
+}  // namespace internal
+
+inline bool ShouldLog(LogCategory category, LogSeverity severity) {
+  if (severity == LogSeverity::kAssert)
+    return true;
+  return severity >= internal::gLogThresholds[(int)category].load(std::memory_order_relaxed);
+}
+
+LogSeverity GetLogThreshold(LogCategory);
+void SetLogThreshold(LogCategory, LogSeverity);
+void SetAllLogThresholds(LogSeverity);
+
 // Shutdowns the logger system at destruction. There should only be one active at a time.
 struct LoggerHandle {
   LoggerHandle();
@@ -46,8 +85,21 @@ struct LoggerHandle {
   DELETE_MOVE_AND_ASSIGN(LoggerHandle);
 };
 
+struct LoggingConfig {
+  bool log_to_stdout = false;
+  LogFileConfig file = {};    // Leave |file.path| empty to not log into a file.
+
+  // Initial runtime thresholds (see "Log Filtering" above).
+  LogSeverity thresholds[(int)LogCategory::kLast] = {};
+};
+
 // Keeps alive the logging system. Treat as singleton.
 std::unique_ptr<LoggerHandle> InitLoggingSystem(bool log_to_stdout);
+std::unique_ptr<LoggerHandle> InitLoggingSystem(const LoggingConfig&);
+
+// Blocks (for a bounded time) until every message logged so far has been written out.
+// Called automatically for errors and asserts, which are followed by a crash.
+void FlushLogs();
 
 struct LogTime {
   int hours;
@@ -60,35 +112,68 @@ struct LogTime {
 };
 
 struct LogEntry {
+  // Messages are formatted directly into the entry, so logging never touches the heap.
+  // Longer messages get truncated.
+  static constexpr int kMaxMessageSize = 512;
+
   LogTime log_time;
   LogCategory category;
   LogSeverity severity;
   Location location = {};
-  std::string msg;
+  char msg[kMaxMessageSize];
+};
+
+// Bounded multiple-producer/single-consumer ring. Each slot carries a sequence number that tells
+// whether it's free for the writer at a given position or ready for the reader:
+//
+//   sequence == pos                    -> Free for the writer claiming |pos|.
+//   sequence == pos + 1                -> Written, waiting for the logging thread.
+//   sequence == pos + kMaxEntries      -> Consumed, free for |pos + kMaxEntries|.
+//
+// |version| is a seqlock counter (odd while the entry is being written) used by readers that want
+// to look at the history without consuming it (see |ReadLogEntry|).
+struct LogSlot {
+  std::atomic<uint64_t> sequence = 0;
+  std::atomic<uint32_t> version = 0;
+  LogEntry entry;
 };
 
 struct LogContainer {
+  TAGGED_NEW_DELETE(kLogging);
+
   static constexpr int kMaxEntries = 4096;
 
-  LogContainer() = default;
+  LogContainer();
   ~LogContainer() = default;
   DELETE_COPY_AND_ASSIGN(LogContainer);
   DELETE_MOVE_AND_ASSIGN(LogContainer);
 
   std::atomic<uint64_t> write_index = 0;
-  LogEntry entries[kMaxEntries] = {};
+
+  // Messages that were thrown away because the logging thread couldn't keep up.
+  std::atomic<uint64_t> dropped_messages = 0;
+
+  LogSlot slots[kMaxEntries];
 };
 const LogContainer& GetLogs();
 
+// Copies the entry at |index| (an absolute index, not wrapped) into |out|.
+// Returns false if the entry is not valid or was overwritten while being read.
+bool ReadLogEntry(const LogContainer&, uint64_t index, LogEntry* out);
+
 void DoLogging(LogCategory category, LogSeverity severity, Location, const char* fmt, ...)
     PRINTF_FORMAT(4, 5);
 
 #undef ERROR
 
-#if DEBUG_MODE
+// LOG, WARNING and ERROR are available in every build, subject to the filtering described above.
+// ERROR only crashes in debug builds.
 
 #define LOG(category, ...) INTERNAL_LOG(category, Info, __VA_ARGS__)
 #define WARNING(category, ...) INTERNAL_LOG(category, Warning, __VA_ARGS__)
+
+#if DEBUG_MODE
+
 #define ERROR(category, ...)                    \
   do {                                          \
     INTERNAL_LOG(category, Error, __VA_ARGS__); \
@@ -121,7 +206,7 @@ void DoLogging(LogCategory category, LogSeverity severity, Location, const char*
 #define NOT_REACHED_MSG(...)                     \
   do {                                           \
     INTERNAL_LOG(Fatal, Assert, "Invalid path"); \
-    INTERNAL_LOG(Fatal, Assert, __VA_ARGS__)     \
+    INTERNAL_LOG(Fatal, Assert, __VA_ARGS__);    \
     SEGFAULT();                                  \
   } while (false)
 
@@ -131,22 +216,9 @@ void DoLogging(LogCategory category, LogSeverity severity, Location, const char*
     SEGFAULT();                                     \
   } while (false)
 
-// You shouldn't be calling this directly.
-#define INTERNAL_LOG(category, severity, ...)                                                    \
-  {                                                                                              \
-    constexpr ::rothko::Location location{::rothko::StrAfterToken(__FILE__, FILEPATH_SEPARATOR), \
-                                          __LINE__,                                              \
-                                          rothko::StrAfterToken(__FUNCTION__, ':')};             \
-    ::rothko::DoLogging(::rothko::LogCategory::k##category,                                      \
-                        ::rothko::LogSeverity::k##severity,                                      \
-                        location VA_ARGS(__VA_ARGS__));                                          \
-  }
-
 #else
 
-#define LOG(category, ...) do {} while (false);
-#define WARNING(category, ...) do {} while (false);
-#define ERROR(category, ...) do {} while (false);
+#define ERROR(category, ...) INTERNAL_LOG(category, Error, __VA_ARGS__)
 
 #define ASSERT(condition) do {} while (false);
 #define ASSERT_MSG(condition, ...) do {} while (false);
@@ -158,4 +230,22 @@ void DoLogging(LogCategory category, LogSeverity severity, Location, const char*
 
 #endif
 
+// You shouldn't be calling this directly.
+// The compile time check is an |if constexpr|, so stripped logs never make it into the binary.
+#define INTERNAL_LOG(category, severity, ...)                                                      \
+  {                                                                                                \
+    if constexpr (::rothko::LogSeverityCompiled(::rothko::LogSeverity::k##severity)) {             \
+      if (::rothko::ShouldLog(::rothko::LogCategory::k##category,                                  \
+                              ::rothko::LogSeverity::k##severity)) {                               \
+        constexpr ::rothko::Location location{                                                     \
+            ::rothko::StrAfterToken(__FILE__, FILEPATH_SEPARATOR),                                 \
+            __LINE__,                                                                              \
+            rothko::StrAfterToken(__FUNCTION__, ':')};                                             \
+        ::rothko::DoLogging(::rothko::LogCategory::k##category,                                    \
+                            ::rothko::LogSeverity::k##severity,                                    \
+                            location VA_ARGS(__VA_ARGS__));                                        \
+      }                                                                                            \
+    }                                                                                              \
+  }
+
 }  // namespace rothko
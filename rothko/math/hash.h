@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "rothko/utils/macros.h"
@@ -36,4 +37,23 @@ inline constexpr uint32_t FNA1a32Hash(const char* str, const uint32_t value = kF
   return FNA1a32Hash(str + 1, (uint32_t)((value ^ uint32_t(str[0])) * (uint64_t)kFNV1a32Prime));
 }
 
+// FNV-1a (64-bit) ---------------------------------------------------------------------------------
+
+namespace {
+
+constexpr uint64_t kFNV1a64Hash = 0xcbf29ce484222325;
+constexpr uint64_t kFNV1a64Prime = 0x100000001b3;
+
+}  // namespace
+
+// Runtime version over arbitrary bytes. Pass the previous result as |value| to hash several
+// buffers as one.
+inline uint64_t FNA1a64Hash(const void* data, size_t size, uint64_t value = kFNV1a64Hash) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; i++) {
+    value = (value ^ bytes[i]) * kFNV1a64Prime;
+  }
+  return value;
+}
+
 }  // namespace rothko
@@ -4,15 +4,15 @@
 #pragma once
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdint.h>
 
-#include <mutex>
+#include <atomic>
 
 #include "rothko/logging/logging.h"
 #include "rothko/memory/memory_block.h"
 #include "rothko/utils/intrinsics.h"
 #include "rothko/utils/macros.h"
-#include "rothko/utils/thread_annotations.h"
 
 namespace rothko {
 
@@ -27,6 +27,10 @@ namespace rothko {
 // -> Returns an invalid block if no more space.
 //
 // void Deallocate(SizedBlockAllocator*);
+//
+// The allocator is lock-free: blocks are handed out in chunks of 64, each one tracked by an atomic
+// bitset that is claimed with CAS. When every chunk is full a new one is allocated and chained
+// (also with CAS), up to |MaxChunks|. A block index is |chunk * kBlocksPerChunk + bit|.
 
 struct BlockAllocator {
   virtual MemoryBlock Allocate() = 0;
@@ -34,13 +38,28 @@ struct BlockAllocator {
   virtual uint8_t* GetBlockMemory(int index) = 0;
 };
 
-template <uint64_t BlockSize>
+template <uint64_t BlockSize,
+          uint64_t Alignment = alignof(max_align_t),
+          int MaxChunks = 64>
 struct SizedBlockAllocator : public BlockAllocator {
-  static constexpr uint64_t kBlockSize = BlockSize;
-  static constexpr uint64_t kBlockCount = 64u;
+  static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two.");
+
+  // Blocks are padded so that every block in a chunk is aligned.
+  static constexpr uint64_t kBlockSize = (BlockSize + Alignment - 1) & ~(Alignment - 1);
+  static constexpr uint64_t kAlignment = Alignment;
+  static constexpr uint64_t kBlocksPerChunk = 64u;
+  static constexpr int kMaxChunks = MaxChunks;
+  static constexpr uint64_t kMaxBlocks = kBlocksPerChunk * MaxChunks;
+
+  struct Chunk {
+    alignas(Alignment) uint8_t memory[kBlockSize * kBlocksPerChunk];
+    // The bit set means the block is free.
+    std::atomic<uint64_t> free_bitset = U64_ALL_ONES();
+  };
 
   // Block Allocators do not move.
-  SizedBlockAllocator();
+  SizedBlockAllocator() = default;
+  ~SizedBlockAllocator();
   DELETE_COPY_AND_ASSIGN(SizedBlockAllocator);
   DELETE_MOVE_AND_ASSIGN(SizedBlockAllocator);
 
@@ -50,85 +69,124 @@ struct SizedBlockAllocator : public BlockAllocator {
   uint8_t* GetBlockMemory(int index) override;
 
   // Fields.
-  uint8_t memory[kBlockSize * kBlockCount];
-  // Allows for 64 blocks.
-  // The bit set means the block is free.
-  uint64_t block_bitset GUARDED_BY(mutex) = U64_ALL_ONES();
-  int used_blocks = 0;
+  std::atomic<Chunk*> chunks[MaxChunks] = {};
+  std::atomic<int> chunk_count = 0;
 
-  std::mutex mutex;
+  std::atomic<int> used_blocks = 0;
+  std::atomic<int> high_water_mark = 0;   // Max |used_blocks| ever seen.
 };
 
 // Implementations -------------------------------------------------------------
 
-static constexpr uint64_t kAllOnes = 0xffff'ffff'ffff'fffflu;
-
-template <uint64_t BlockSize>
-SizedBlockAllocator<BlockSize>::SizedBlockAllocator()
-    : block_bitset(kAllOnes), used_blocks(0) {}
-
-template <uint64_t BlockSize>
-MemoryBlock Allocate(SizedBlockAllocator<BlockSize>* allocator) {
-  int free_block_index = 0;
-  {
-    std::lock_guard<std::mutex>(allocator->mutex);
-    if (allocator->used_blocks == allocator->kBlockCount)
-      return {};  // Invalid block;
+template <uint64_t BlockSize, uint64_t Alignment, int MaxChunks>
+SizedBlockAllocator<BlockSize, Alignment, MaxChunks>::~SizedBlockAllocator() {
+  for (auto& chunk : chunks) {
+    delete chunk.load();
+  }
+}
 
-    free_block_index = FindFirstSet(allocator->block_bitset);
-    allocator->block_bitset &= ~(((uint64_t)1u) << (free_block_index - 1));
-    allocator->used_blocks++;
+namespace internal {
+
+// Tries to claim a free block from |chunk|. Returns the bit index or -1 if the chunk is full.
+template <typename Chunk>
+int ClaimBlock(Chunk* chunk) {
+  uint64_t bits = chunk->free_bitset.load(std::memory_order_relaxed);
+  while (bits != 0) {
+    int bit = FindFirstSet(bits) - 1;
+    uint64_t claimed = bits & ~((uint64_t)1u << bit);
+    if (chunk->free_bitset.compare_exchange_weak(
+            bits, claimed, std::memory_order_acquire, std::memory_order_relaxed)) {
+      return bit;
+    }
   }
 
-  /* static int alloc_count = 0; */
-  /* alloc_count++; */
-  /* LOG(DEBUG, "Alloc %d: Block bitset: 0x%zx", alloc_count, */
-  /*                                             allocator->block_bitset); */
+  return -1;
+}
 
-  ASSERT(free_block_index > 0);
+// Chains a new chunk at position |index|. Returns false if we're out of chunks.
+template <typename Allocator>
+bool AddChunk(Allocator* allocator, int index) {
+  if (index >= Allocator::kMaxChunks)
+    return false;
+
+  // Somebody else might be adding the same chunk. Only one wins.
+  auto* chunk = new typename Allocator::Chunk();
+  typename Allocator::Chunk* expected = nullptr;
+  if (!allocator->chunks[index].compare_exchange_strong(expected, chunk))
+    delete chunk;
+
+  // Publish the chunk (or help whoever won to publish it).
+  int count = index;
+  allocator->chunk_count.compare_exchange_strong(count, index + 1);
+  return true;
+}
 
-  MemoryBlock block = {};
-  block.allocator = allocator;
-  block.index = free_block_index - 1;
-  block.size = allocator->kBlockSize;
+inline void UpdateHighWaterMark(std::atomic<int>* high_water_mark, int used) {
+  int current = high_water_mark->load(std::memory_order_relaxed);
+  while (current < used &&
+         !high_water_mark->compare_exchange_weak(current, used, std::memory_order_relaxed)) {
+  }
+}
 
-  return block;
+}  // namespace internal
+
+template <uint64_t BlockSize, uint64_t Alignment, int MaxChunks>
+MemoryBlock Allocate(SizedBlockAllocator<BlockSize, Alignment, MaxChunks>* allocator) {
+  while (true) {
+    int chunk_count = allocator->chunk_count.load(std::memory_order_acquire);
+    for (int i = 0; i < chunk_count; i++) {
+      auto* chunk = allocator->chunks[i].load(std::memory_order_acquire);
+      int bit = internal::ClaimBlock(chunk);
+      if (bit < 0)
+        continue;
+
+      int used = allocator->used_blocks.fetch_add(1, std::memory_order_relaxed) + 1;
+      internal::UpdateHighWaterMark(&allocator->high_water_mark, used);
+
+      MemoryBlock block = {};
+      block.allocator = allocator;
+      block.index = i * (int)allocator->kBlocksPerChunk + bit;
+      block.size = allocator->kBlockSize;
+      return block;
+    }
+
+    // Everything is full.
+    if (!internal::AddChunk(allocator, chunk_count))
+      return {};  // Invalid block;
+  }
 }
 
-template <uint64_t BlockSize>
-MemoryBlock SizedBlockAllocator<BlockSize>::Allocate() {
+template <uint64_t BlockSize, uint64_t Alignment, int MaxChunks>
+MemoryBlock SizedBlockAllocator<BlockSize, Alignment, MaxChunks>::Allocate() {
   return ::rothko::Allocate(this);
 }
 
-template <uint64_t BlockSize>
-void Deallocate(SizedBlockAllocator<BlockSize>* allocator, int index) {
-  ASSERT(index >= 0 && index < 64);
-
-  /* static int dealloc_count = 0; */
-  /* dealloc_count++; */
-  /* LOG(DEBUG, "Dealloc %d: Block bitset: 0x%zx", dealloc_count, */
-  /*                                               allocator->block_bitset); */
-
-  bool was_set = false;
-  {
-    std::lock_guard<std::mutex>(allocator->mutex);
-    was_set = ((allocator->block_bitset & (1llu << index)) == 0);
-    allocator->block_bitset |= (((uint64_t)1llu) << index);
-    allocator->used_blocks--;
-  }
+template <uint64_t BlockSize, uint64_t Alignment, int MaxChunks>
+void Deallocate(SizedBlockAllocator<BlockSize, Alignment, MaxChunks>* allocator, int index) {
+  ASSERT(index >= 0 && index < (int)allocator->kMaxBlocks);
+
+  auto* chunk = allocator->chunks[index / allocator->kBlocksPerChunk].load(
+      std::memory_order_acquire);
+  ASSERT(chunk);
+
+  uint64_t mask = (uint64_t)1u << (index % allocator->kBlocksPerChunk);
+  uint64_t previous = chunk->free_bitset.fetch_or(mask, std::memory_order_release);
+  allocator->used_blocks.fetch_sub(1, std::memory_order_relaxed);
 
-  ASSERT(was_set);
+  ASSERT((previous & mask) == 0);
+  (void)previous;
 }
 
-template <uint64_t BlockSize>
-void SizedBlockAllocator<BlockSize>::Deallocate(int index) {
+template <uint64_t BlockSize, uint64_t Alignment, int MaxChunks>
+void SizedBlockAllocator<BlockSize, Alignment, MaxChunks>::Deallocate(int index) {
   ::rothko::Deallocate(this, index);
 }
 
-template <uint64_t BlockSize>
-uint8_t* SizedBlockAllocator<BlockSize>::GetBlockMemory(int index) {
-  ASSERT(index >= 0 && index < 64);
-  return memory + index * kBlockSize;
+template <uint64_t BlockSize, uint64_t Alignment, int MaxChunks>
+uint8_t* SizedBlockAllocator<BlockSize, Alignment, MaxChunks>::GetBlockMemory(int index) {
+  ASSERT(index >= 0 && index < (int)kMaxBlocks);
+  auto* chunk = chunks[index / kBlocksPerChunk].load(std::memory_order_acquire);
+  return chunk->memory + (index % kBlocksPerChunk) * kBlockSize;
 }
 
 }  // namespace rothko
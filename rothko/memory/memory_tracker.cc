@@ -0,0 +1,115 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/memory/memory_tracker.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "rothko/utils/file.h"
+
+namespace rothko {
+
+const char* ToString(MemoryTag tag) {
+  switch (tag) {
+    case MemoryTag::kGeneral: return "General";
+    case MemoryTag::kGraphics: return "Graphics";
+    case MemoryTag::kModels: return "Models";
+    case MemoryTag::kScene: return "Scene";
+    case MemoryTag::kLogging: return "Logging";
+    case MemoryTag::kEmulator: return "Emulator";
+    case MemoryTag::kLast: return "Last";
+  }
+
+  return "<unknown>";
+}
+
+namespace {
+
+struct AtomicTagStats {
+  std::atomic<int64_t> live_bytes = 0;
+  std::atomic<int64_t> peak_bytes = 0;
+  std::atomic<int64_t> live_allocations = 0;
+  std::atomic<int64_t> total_allocations = 0;
+};
+
+// Global, so it's available before main and after every handle goes away.
+AtomicTagStats gTagStats[(int)MemoryTag::kLast];
+
+}  // namespace
+
+void TrackAllocation(MemoryTag tag, size_t size) {
+  auto& stats = gTagStats[(int)tag];
+  int64_t live = stats.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  stats.live_allocations.fetch_add(1, std::memory_order_relaxed);
+  stats.total_allocations.fetch_add(1, std::memory_order_relaxed);
+
+  int64_t peak = stats.peak_bytes.load(std::memory_order_relaxed);
+  while (peak < live &&
+         !stats.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+void TrackDeallocation(MemoryTag tag, size_t size) {
+  auto& stats = gTagStats[(int)tag];
+  stats.live_bytes.fetch_sub(size, std::memory_order_relaxed);
+  stats.live_allocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void* TaggedAlloc(MemoryTag tag, size_t size, size_t alignment) {
+  TrackAllocation(tag, size);
+  if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    return ::operator new(size, std::align_val_t(alignment));
+  return ::operator new(size);
+}
+
+void TaggedFree(MemoryTag tag, void* ptr, size_t size, size_t alignment) {
+  if (!ptr)
+    return;
+
+  TrackDeallocation(tag, size);
+  if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    ::operator delete(ptr, std::align_val_t(alignment));
+  } else {
+    ::operator delete(ptr);
+  }
+}
+
+MemoryTagStats GetMemoryStats(MemoryTag tag) {
+  auto& stats = gTagStats[(int)tag];
+
+  MemoryTagStats result = {};
+  result.live_bytes = stats.live_bytes.load(std::memory_order_relaxed);
+  result.peak_bytes = stats.peak_bytes.load(std::memory_order_relaxed);
+  result.live_allocations = stats.live_allocations.load(std::memory_order_relaxed);
+  result.total_allocations = stats.total_allocations.load(std::memory_order_relaxed);
+  return result;
+}
+
+bool DumpMemoryStats(const std::string& path) {
+  FileHandle file = OpenFile(path);
+  if (!Valid(file))
+    return false;
+
+  char line[256];
+  int len = snprintf(line, sizeof(line), "%-10s %16s %16s %12s %12s\n",
+                     "TAG", "LIVE BYTES", "PEAK BYTES", "LIVE ALLOCS", "TOTAL ALLOCS");
+  WriteToFile(&file, line, len);
+
+  for (int i = 0; i < (int)MemoryTag::kLast; i++) {
+    MemoryTagStats stats = GetMemoryStats((MemoryTag)i);
+    len = snprintf(line,
+                   sizeof(line),
+                   "%-10s %16" PRId64 " %16" PRId64 " %12" PRId64 " %12" PRId64 "\n",
+                   ToString((MemoryTag)i),
+                   stats.live_bytes,
+                   stats.peak_bytes,
+                   stats.live_allocations,
+                   stats.total_allocations);
+    WriteToFile(&file, line, len);
+  }
+
+  return true;
+}
+
+}  // namespace rothko
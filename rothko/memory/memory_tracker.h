@@ -0,0 +1,129 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "rothko/utils/macros.h"
+
+namespace rothko {
+
+// Memory Tracking ---------------------------------------------------------------------------------
+//
+// Every engine allocation that we care about goes through |TaggedAlloc|/|TaggedFree| with a tag
+// that says which sub-system owns it. The tracker keeps live/peak bytes and allocation counts per
+// tag. The usual ways of routing allocations through it are:
+//
+// - TaggedVector<T, Tag>:  std::vector using a |TaggedAllocator|.
+// - TaggedArray<T, Tag>:   std::unique_ptr<T[]> equivalent (create with |MakeTaggedArray|).
+// - TAGGED_NEW_DELETE(Tag): Inside a struct, makes heap allocations of it go through the tracker.
+//
+// NOTE: This header cannot use logging, as logging itself is tracked.
+
+enum class MemoryTag : uint32_t {
+  kGeneral,
+  kGraphics,
+  kModels,
+  kScene,
+  kLogging,
+  kEmulator,
+  kLast,
+};
+const char* ToString(MemoryTag);
+
+struct MemoryTagStats {
+  int64_t live_bytes = 0;
+  int64_t peak_bytes = 0;
+  int64_t live_allocations = 0;
+  int64_t total_allocations = 0;
+};
+
+// Snapshot of the current stats of a tag.
+MemoryTagStats GetMemoryStats(MemoryTag);
+
+// Writes a text table with the stats of every tag into |path|.
+bool DumpMemoryStats(const std::string& path);
+
+// For memory that is not allocated through |TaggedAlloc| but we still want to account for.
+void TrackAllocation(MemoryTag, size_t size);
+void TrackDeallocation(MemoryTag, size_t size);
+
+void* TaggedAlloc(MemoryTag, size_t size, size_t alignment = alignof(max_align_t));
+// |size| and |alignment| must be the same given to |TaggedAlloc|.
+void TaggedFree(MemoryTag, void* ptr, size_t size, size_t alignment = alignof(max_align_t));
+
+// TaggedAllocator ---------------------------------------------------------------------------------
+
+template <typename T, MemoryTag Tag>
+struct TaggedAllocator {
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = TaggedAllocator<U, Tag>;
+  };
+
+  TaggedAllocator() = default;
+  template <typename U>
+  TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+  T* allocate(size_t count) { return (T*)TaggedAlloc(Tag, count * sizeof(T), alignof(T)); }
+  void deallocate(T* ptr, size_t count) { TaggedFree(Tag, ptr, count * sizeof(T), alignof(T)); }
+};
+
+template <typename T, typename U, MemoryTag Tag>
+bool operator==(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) {
+  return true;
+}
+
+template <typename T, typename U, MemoryTag Tag>
+bool operator!=(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) {
+  return false;
+}
+
+template <typename T, MemoryTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag>>;
+
+// TaggedArray -------------------------------------------------------------------------------------
+
+template <typename T, MemoryTag Tag>
+struct TaggedArrayDeleter {
+  size_t count = 0;
+
+  void operator()(T* ptr) const { TaggedFree(Tag, ptr, count * sizeof(T), alignof(T)); }
+};
+
+template <typename T, MemoryTag Tag>
+using TaggedArray = std::unique_ptr<T[], TaggedArrayDeleter<T, Tag>>;
+
+// Zero initialized, like std::make_unique<T[]>.
+template <typename T, MemoryTag Tag>
+TaggedArray<T, Tag> MakeTaggedArray(size_t count) {
+  static_assert(std::is_trivial<T>::value, "Tagged arrays only hold trivial types.");
+  T* ptr = (T*)TaggedAlloc(Tag, count * sizeof(T), alignof(T));
+  memset(ptr, 0, count * sizeof(T));
+  return TaggedArray<T, Tag>(ptr, TaggedArrayDeleter<T, Tag>{count});
+}
+
+// TAGGED_NEW_DELETE -------------------------------------------------------------------------------
+
+// The sized delete lets us untrack the exact amount without storing a header.
+#define TAGGED_NEW_DELETE(tag)                                      \
+  static void* operator new(size_t size) {                          \
+    return ::rothko::TaggedAlloc(::rothko::MemoryTag::tag, size);   \
+  }                                                                 \
+  static void operator delete(void* ptr, size_t size) {             \
+    ::rothko::TaggedFree(::rothko::MemoryTag::tag, ptr, size);      \
+  }
+
+}  // namespace rothko
@@ -0,0 +1,137 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/memory/range_allocator.h"
+
+#include <inttypes.h>
+
+#include "rothko/logging/logging.h"
+
+namespace rothko {
+
+RangeAllocator CreateRangeAllocator(uint64_t size) {
+  ASSERT(size > 0);
+  RangeAllocator ra = {};
+  ra.size = size;
+  ra.free_ranges[0] = size;
+  return ra;
+}
+
+namespace {
+
+inline uint64_t AlignUp(uint64_t offset, uint64_t alignment) {
+  uint64_t rem = offset % alignment;
+  return rem == 0 ? offset : offset + (alignment - rem);
+}
+
+}  // namespace
+
+uint64_t AllocateRange(RangeAllocator* ra, uint64_t size, uint64_t alignment) {
+  ASSERT(Valid(*ra));
+  ASSERT(size > 0 && alignment > 0);
+
+  // Best fit: the smallest free range that can hold the aligned allocation.
+  auto best = ra->free_ranges.end();
+  uint64_t best_waste = UINT64_MAX;
+  for (auto it = ra->free_ranges.begin(); it != ra->free_ranges.end(); it++) {
+    uint64_t aligned = AlignUp(it->first, alignment);
+    uint64_t padding = aligned - it->first;
+    if (it->second < padding + size)
+      continue;
+
+    uint64_t waste = it->second - size;
+    if (waste < best_waste) {
+      best = it;
+      best_waste = waste;
+      if (waste == padding)
+        break;
+    }
+  }
+
+  if (best == ra->free_ranges.end())
+    return kInvalidRange;
+
+  uint64_t range_offset = best->first;
+  uint64_t range_size = best->second;
+  uint64_t offset = AlignUp(range_offset, alignment);
+  ra->free_ranges.erase(best);
+
+  // Whatever is left at each side of the allocation remains free.
+  if (offset > range_offset)
+    ra->free_ranges[range_offset] = offset - range_offset;
+
+  uint64_t end = offset + size;
+  uint64_t range_end = range_offset + range_size;
+  if (end < range_end)
+    ra->free_ranges[end] = range_end - end;
+
+  ra->used += size;
+  return offset;
+}
+
+void FreeRange(RangeAllocator* ra, uint64_t offset, uint64_t size) {
+  ASSERT(offset + size <= ra->size);
+  ASSERT(ra->used >= size);
+  ra->used -= size;
+
+  auto next = ra->free_ranges.lower_bound(offset);
+  ASSERT_MSG(next == ra->free_ranges.end() || next->first >= offset + size,
+             "Freeing overlapping range %" PRIu64 " (size %" PRIu64 ").", offset, size);
+
+  // Merge with the next range.
+  if (next != ra->free_ranges.end() && next->first == offset + size) {
+    size += next->second;
+    next = ra->free_ranges.erase(next);
+  }
+
+  // Merge with the previous range.
+  if (next != ra->free_ranges.begin()) {
+    auto prev = std::prev(next);
+    ASSERT(prev->first + prev->second <= offset);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+
+  ra->free_ranges[offset] = size;
+}
+
+void Grow(RangeAllocator* ra, uint64_t new_size) {
+  ASSERT(new_size >= ra->size);
+  if (new_size == ra->size)
+    return;
+
+  uint64_t old_size = ra->size;
+  ra->size = new_size;
+
+  // Reuse |FreeRange|'s merging by pretending the new space was allocated.
+  ra->used += new_size - old_size;
+  FreeRange(ra, old_size, new_size - old_size);
+}
+
+void Reset(RangeAllocator* ra) {
+  ra->used = 0;
+  ra->free_ranges.clear();
+  if (ra->size > 0)
+    ra->free_ranges[0] = ra->size;
+}
+
+uint64_t LargestFreeRange(const RangeAllocator& ra) {
+  uint64_t largest = 0;
+  for (auto& [offset, size] : ra.free_ranges) {
+    (void)offset;
+    if (size > largest)
+      largest = size;
+  }
+  return largest;
+}
+
+float Fragmentation(const RangeAllocator& ra) {
+  uint64_t free = ra.size - ra.used;
+  if (free == 0)
+    return 0.0f;
+  return 1.0f - (float)LargestFreeRange(ra) / (float)free;
+}
+
+}  // namespace rothko
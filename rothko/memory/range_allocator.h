@@ -0,0 +1,52 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+
+namespace rothko {
+
+// RangeAllocator ----------------------------------------------------------------------------------
+//
+// Sub-allocates ranges out of a linear space it doesn't own (eg. a GPU buffer). It only tracks
+// offsets: the free ranges are kept sorted by offset and are coalesced with their neighbours when
+// freed, so the space doesn't slowly shatter into unusable slivers.
+//
+// Allocations are best-fit. Alignments don't need to be powers of two, so a buffer of vertices can
+// be aligned to the vertex stride (making every offset a valid base vertex).
+
+constexpr uint64_t kInvalidRange = UINT64_MAX;
+
+struct RangeAllocator {
+  uint64_t size = 0;
+  uint64_t used = 0;
+
+  std::map<uint64_t, uint64_t> free_ranges;   // offset -> size.
+};
+
+inline bool Valid(const RangeAllocator& ra) { return ra.size > 0; }
+
+RangeAllocator CreateRangeAllocator(uint64_t size);
+
+// Returns the offset of the range or |kInvalidRange| if no free range can hold it.
+uint64_t AllocateRange(RangeAllocator*, uint64_t size, uint64_t alignment = 1);
+
+// |offset| and |size| must be the exact values of a previous allocation.
+void FreeRange(RangeAllocator*, uint64_t offset, uint64_t size);
+
+// Extends the space to |new_size|. The new space is merged with a free range at the end.
+void Grow(RangeAllocator*, uint64_t new_size);
+
+// Frees everything.
+void Reset(RangeAllocator*);
+
+uint64_t LargestFreeRange(const RangeAllocator&);
+
+// How much of the free space is unusable for an allocation of the largest free range.
+// 0 means all free space is contiguous, values close to 1 mean it is very fragmented.
+float Fragmentation(const RangeAllocator&);
+
+}  // namespace rothko
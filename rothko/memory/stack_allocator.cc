@@ -3,14 +3,111 @@
 
 #include "rothko/memory/stack_allocator.h"
 
-
 namespace rothko {
 
-StackAllocator CreateStackAllocator(uint32_t size) {
+namespace {
+
+StackBlock CreateBlock(uint64_t size) {
+  StackBlock block = {};
+  block.data = MakeTaggedArray<uint8_t, MemoryTag::kGeneral>(size);
+  block.size = size;
+  return block;
+}
+
+// Returns the offset within |block| where an allocation would go. Returns |UINT64_MAX| if it
+// doesn't fit.
+uint64_t FitInBlock(const StackBlock& block, uint64_t offset, uint64_t size, uint64_t alignment) {
+  uintptr_t base = (uintptr_t)block.data.get();
+  uintptr_t aligned = (base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  uint64_t aligned_offset = aligned - base;
+  if (aligned_offset + size > block.size)
+    return UINT64_MAX;
+  return aligned_offset;
+}
+
+}  // namespace
+
+StackAllocator CreateStackAllocator(uint64_t size) {
   StackAllocator sa = {};
-  sa.data_ = std::make_unique<uint8_t[]>(size);
-  sa.size = size;
+  sa.blocks.push_back(CreateBlock(size));
   return sa;
 }
 
+uint64_t Capacity(const StackAllocator& sa) {
+  uint64_t capacity = 0;
+  for (auto& block : sa.blocks) {
+    capacity += block.size;
+  }
+  return capacity;
+}
+
+void Reset(StackAllocator* sa) {
+  if (sa->blocks.size() > 1) {
+    uint64_t capacity = Capacity(*sa);
+    sa->blocks.clear();
+    sa->blocks.push_back(CreateBlock(capacity));
+  }
+
+  sa->block_index = 0;
+  sa->current = 0;
+}
+
+void RewindTo(StackAllocator* sa, StackMarker marker) {
+  assert(marker.block_index < sa->block_index ||
+         (marker.block_index == sa->block_index && marker.offset <= sa->current));
+  sa->block_index = marker.block_index;
+  sa->current = marker.offset;
+}
+
+void* AllocateBytes(StackAllocator* sa, uint64_t size, uint64_t alignment) {
+  if (!Valid(*sa))
+    return nullptr;
+
+  assert((alignment & (alignment - 1)) == 0);
+
+  // Try the current block and then the ones already chained after it (left there by a rewind).
+  while (true) {
+    StackBlock& block = sa->blocks[sa->block_index];
+    uint64_t offset = FitInBlock(block, sa->current, size, alignment);
+    if (offset != UINT64_MAX) {
+      sa->current = offset + size;
+      return block.data.get() + offset;
+    }
+
+    if (sa->block_index + 1 >= sa->blocks.size())
+      break;
+
+    sa->block_index++;
+    sa->current = 0;
+  }
+
+  // Chain a new block. It's at least as big as the first one.
+  uint64_t block_size = sa->blocks.front().size;
+  if (block_size < size + alignment)
+    block_size = size + alignment;
+  sa->blocks.push_back(CreateBlock(block_size));
+  sa->block_index = sa->blocks.size() - 1;
+  sa->current = 0;
+
+  StackBlock& block = sa->blocks.back();
+  uint64_t offset = FitInBlock(block, 0, size, alignment);
+  assert(offset != UINT64_MAX);
+  sa->current = offset + size;
+  return block.data.get() + offset;
+}
+
+// Scratch Memory ----------------------------------------------------------------------------------
+
+StackAllocator* GetScratchAllocator() {
+  thread_local StackAllocator scratch = CreateStackAllocator(kScratchAllocatorSize);
+  return &scratch;
+}
+
+ScratchScope::ScratchScope(StackAllocator* allocator)
+    : allocator(allocator), marker(GetMarker(*allocator)) {}
+
+ScratchScope::~ScratchScope() {
+  RewindTo(allocator, marker);
+}
+
 }  // namespace rothko
@@ -7,40 +7,81 @@
 #include <stdint.h>
 
 #include <memory>
+#include <vector>
+
+#include "rothko/memory/memory_tracker.h"
+#include "rothko/utils/macros.h"
 
 namespace rothko {
 
+// StackAllocator ----------------------------------------------------------------------------------
+//
+// Linear allocator meant for temporary memory. Allocations respect the alignment of the type.
+// When the current block runs out, another block is chained (so previously returned pointers stay
+// valid), and |Reset| consolidates all the blocks into one big enough for the next round.
+//
+// Allocations can be undone up to a point with |GetMarker|/|RewindTo| or, more conveniently, with
+// a |ScratchScope|.
+
+struct StackBlock {
+  TaggedArray<uint8_t, MemoryTag::kGeneral> data;
+  uint64_t size = 0;
+};
+
 struct StackAllocator {
-  uint32_t size = 0;
-  uint32_t current = 0;
+  std::vector<StackBlock> blocks;
+  uint32_t block_index = 0;   // Block we're currently allocating from.
+  uint64_t current = 0;       // Offset within |blocks[block_index]|.
+};
 
-  std::unique_ptr<uint8_t[]> data_;   // Should not be accessed directly.
+struct StackMarker {
+  uint32_t block_index = 0;
+  uint64_t offset = 0;
 };
 
-inline bool Valid(const StackAllocator& sa) { return !!sa.data_; }
-inline void Reset(StackAllocator* sa) { sa->current = 0; }
+inline bool Valid(const StackAllocator& sa) { return !sa.blocks.empty(); }
+
+// Total amount of bytes the allocator holds across all of its blocks.
+uint64_t Capacity(const StackAllocator&);
+
+// Frees every allocation. If blocks were chained, they are merged into a single one.
+void Reset(StackAllocator*);
 
-StackAllocator CreateStackAllocator(uint32_t size);
+inline StackMarker GetMarker(const StackAllocator& sa) { return {sa.block_index, sa.current}; }
+
+// Frees every allocation done after |marker| was obtained.
+void RewindTo(StackAllocator*, StackMarker marker);
+
+StackAllocator CreateStackAllocator(uint64_t size);
 
 template <typename T>
-StackAllocator CreateStackAllocatorFor(uint32_t count) {
+StackAllocator CreateStackAllocatorFor(uint64_t count) {
   return CreateStackAllocator(sizeof(T) * count);
 }
 
+// Returns nullptr only if |sa| is not valid.
+void* AllocateBytes(StackAllocator* sa, uint64_t size, uint64_t alignment);
+
 template <typename T>
-T* Allocate(StackAllocator* sa, uint32_t count = 1) {
-  if (!Valid(*sa))
-    return nullptr;
+T* Allocate(StackAllocator* sa, uint64_t count = 1) {
+  return (T*)AllocateBytes(sa, sizeof(T) * count, alignof(T));
+}
 
-  uint32_t size_to_alloc = sizeof(T) * count;
-  if (sa->current + size_to_alloc > sa->size)
-    return nullptr;
+// Scratch Memory ----------------------------------------------------------------------------------
 
-  // Get the current pointer and cast it to the correct type.
-  T* ptr = (T*)(sa->data_.get() + sa->current);
-  sa->current += size_to_alloc;
+// Each thread gets its own scratch allocator, created on first use.
+constexpr uint64_t kScratchAllocatorSize = 1024 * 1024;
+StackAllocator* GetScratchAllocator();
 
-  return ptr;
-}
+// Rewinds the allocator to where it was when the scope was created.
+struct ScratchScope {
+  ScratchScope(StackAllocator* allocator = GetScratchAllocator());
+  ~ScratchScope();
+  DELETE_COPY_AND_ASSIGN(ScratchScope);
+  DELETE_MOVE_AND_ASSIGN(ScratchScope);
+
+  StackAllocator* allocator = nullptr;
+  StackMarker marker = {};
+};
 
 }  // namespace rothko
@@ -11,25 +11,20 @@ namespace rothko {
 
 namespace {
 
-std::vector<Mesh::IndexType> GetIndices() {
-  std::vector<Mesh::IndexType> indices = {
-    // X
-    0, 1, 2, 2, 3, 0,
-    /* 4, 5, 6, 6, 7, 4, */
-    6, 5, 4, 4, 7, 6,
-
-    // Y
-    8, 9, 10, 10, 11, 8,
-    /* 12, 13, 14, 14, 15, 12, */
-    14, 13, 12, 12, 15, 14,
-
-    // Z
-    18, 17, 16, 16, 19, 18,
-    20, 21, 22, 22, 23, 20,
-
-  };
-
-  return indices;
+constexpr Mesh::IndexType kIndices[] = {
+  // X
+  0, 1, 2, 2, 3, 0,
+  /* 4, 5, 6, 6, 7, 4, */
+  6, 5, 4, 4, 7, 6,
+
+  // Y
+  8, 9, 10, 10, 11, 8,
+  /* 12, 13, 14, 14, 15, 12, */
+  14, 13, 12, 12, 15, 14,
+
+  // Z
+  18, 17, 16, 16, 19, 18,
+  20, 21, 22, 22, 23, 20,
 };
 
 }  // namespace
@@ -95,7 +90,7 @@ Mesh CreateCubeMesh_3d(const std::string& name, Vec3 extents) {
 
   PushVertices(&mesh, vertices, ARRAY_SIZE(vertices));
   /* PushIndices(&mesh, indices, ARRAY_SIZE(indices)); */
-  mesh.indices = GetIndices();
+  PushIndices(&mesh, kIndices, ARRAY_SIZE(kIndices));
 
   ASSERT_MSG(mesh.vertex_count == ARRAY_SIZE(vertices), "Count: %u", mesh.vertex_count);
   return mesh;
@@ -164,7 +159,7 @@ Mesh CreateCubeMesh_3dNormal(const std::string& name, Vec3 extents) {
   }
 
   PushVertices(&mesh, vertices, ARRAY_SIZE(vertices));
-  mesh.indices = GetIndices();
+  PushIndices(&mesh, kIndices, ARRAY_SIZE(kIndices));
 
   ASSERT_MSG(mesh.vertex_count == ARRAY_SIZE(vertices), "Count: %u", mesh.vertex_count);
 
@@ -235,7 +230,7 @@ Mesh CreateCubeMesh_3dNormalUV(const std::string& name, Vec3 extents) {
   }
 
   PushVertices(&mesh, vertices, ARRAY_SIZE(vertices));
-  mesh.indices = GetIndices();
+  PushIndices(&mesh, kIndices, ARRAY_SIZE(kIndices));
 
   ASSERT_MSG(mesh.vertex_count == ARRAY_SIZE(vertices), "Count: %u", mesh.vertex_count);
 
@@ -306,7 +301,7 @@ Mesh CreateCubeMesh_3dUVColor(const std::string& name, Vec3 extents) {
   }
 
   PushVertices(&mesh, vertices, ARRAY_SIZE(vertices));
-  mesh.indices = GetIndices();
+  PushIndices(&mesh, kIndices, ARRAY_SIZE(kIndices));
 
   ASSERT_MSG(mesh.vertex_count == ARRAY_SIZE(vertices), "Count: %u", mesh.vertex_count);
 
@@ -327,6 +322,8 @@ Mesh CreateCubeMesh(VertexType vertex_type, const std::string& name, Vec3 extent
     case VertexType::k3dUV: return {};
     case VertexType::k3dUVColor: return CreateCubeMesh_3dUVColor(name, extents);
     case VertexType::k3dNormalTangentUV: return {};
+    case VertexType::kQuantized3dNormalUV: return {};
+    case VertexType::kQuantized3dNormalTangentUV: return {};
     case VertexType::kLast: return {};
   }
 
@@ -5,11 +5,14 @@
 
 #include <third_party/tiny_gltf/tiny_gltf.h>
 
+#include <string.h>
+
 #include <map>
 #include <set>
 
 #include "rothko/graphics/graphics.h"
 #include "rothko/logging/logging.h"
+#include "rothko/memory/stack_allocator.h"
 #include "rothko/models/model.h"
 #include "rothko/scene/scene_graph.h"
 #include "rothko/utils/strings.h"
@@ -26,6 +29,8 @@ struct NodeContext {
 };
 
 struct ProcessingContext {
+  std::string path;
+  LoadOptions options;
   Model model;
 
   std::unique_ptr<SceneGraph> scene_graph;
@@ -38,10 +43,13 @@ struct ProcessingContext {
 
   // The uniqueness of the mesh (which corresponds to the glTF primitive) is ensured by the
   // |processed_node_meshes| set.
-  std::vector<std::unique_ptr<Mesh>> meshes;
+  TaggedVector<std::unique_ptr<Mesh>, MemoryTag::kModels> meshes;
 
   std::map<int, std::unique_ptr<Texture>> textures;
   std::map<int, std::unique_ptr<Material>> materials;
+
+  // Atlases created by |PackModelTextures|. They replace the packed |textures|.
+  std::vector<std::unique_ptr<Texture>> packed_textures;
 };
 
 enum class BufferViewTarget : int {
@@ -242,13 +250,17 @@ VertexType DetectVertexType(
   return ToVertexType(types);
 }
 
+// The extracted vertices live in |scratch|, so they're only valid within the caller's
+// |ScratchScope|.
 struct VerticesExtraction {
-  std::vector<uint8_t> data;
+  uint8_t* data = nullptr;
+  uint32_t size = 0;
   Vec3 min;
   Vec3 max;
 };
 VerticesExtraction ExtractVertices(const tinygltf::Model& model,
                                    const tinygltf::Primitive& primitive,
+                                   StackAllocator* scratch,
                                    VertexType vertex_type = VertexType::kLast) {
   std::map<VertComponent, const tinygltf::Accessor*> accessors;
   vertex_type = DetectVertexType(model, primitive, &accessors);
@@ -261,8 +273,8 @@ VerticesExtraction ExtractVertices(const tinygltf::Model& model,
   auto accessor_it = accessors.begin();
   uint32_t vertices_size = accessor_it->second->count * vertex_size;
 
-  std::vector<uint8_t> vertices;
-  vertices.resize(vertices_size);  // We're going to overwrite the contents.
+  // We're going to overwrite the contents. Aligned so it can be read back as vertex structs.
+  uint8_t* vertices = (uint8_t*)AllocateBytes(scratch, vertices_size, alignof(float));
 
   constexpr float kMaxBound = 10000;
   Vec3 min_pos = {kMaxBound, kMaxBound, kMaxBound};
@@ -279,8 +291,8 @@ VerticesExtraction ExtractVertices(const tinygltf::Model& model,
     const tinygltf::BufferView& buffer_view = model.bufferViews[accessor->bufferView];
     const tinygltf::Buffer& buffer = model.buffers[buffer_view.buffer];
 
-    uint8_t* vertices_ptr = vertices.data() + component_offset;
-    uint8_t* vertices_end = vertices.data() + vertices_size;
+    uint8_t* vertices_ptr = vertices + component_offset;
+    uint8_t* vertices_end = vertices + vertices_size;
     const uint8_t* buffer_ptr =
         (const uint8_t*)buffer.data.data() + buffer_view.byteOffset + accessor->byteOffset;
     const uint8_t* buffer_end = (const uint8_t*)buffer.data.data() + buffer.data.size();
@@ -303,14 +315,9 @@ VerticesExtraction ExtractVertices(const tinygltf::Model& model,
         // clang-format on
       }
 
-      // Copy over the component value.
-      uint8_t* write_ptr = vertices_ptr;
-      for (size_t j = 0; j < component_size; j++) {
-        *write_ptr++ = *buffer_ptr++;
-      }
-
-      // Advance by the stride.
-      buffer_ptr += buffer_view.byteStride;
+      // Copy over the component value and advance by the stride.
+      memcpy(vertices_ptr, buffer_ptr, component_size);
+      buffer_ptr += component_size + buffer_view.byteStride;
       vertices_ptr += vertex_size;
     }
 
@@ -318,27 +325,18 @@ VerticesExtraction ExtractVertices(const tinygltf::Model& model,
   }
 
   VerticesExtraction extraction = {};
-  extraction.data = std::move(vertices);
+  extraction.data = vertices;
+  extraction.size = vertices_size;
   extraction.min = min_pos;
   extraction.max = max_pos;
   return extraction;
 }
 
-template <typename T>
-std::vector<uint32_t> ObtainIndices(const uint8_t* data, uint32_t count) {
-  std::vector<uint32_t> indices;
-  indices.reserve(count);
-
-  const T* ptr = (const T*)data;
-  for (uint32_t i = 0; i < count; i++) {
-    indices.push_back(*ptr++);
-  }
-
-  return indices;
-}
-
-std::vector<uint32_t> ExtractIndices(const tinygltf::Model& model,
-                                     const tinygltf::Primitive& primitive) {
+// Writes the indices into |mesh| with its index format. glTF 16-bit indices (the common case) for a
+// 16-bit mesh get copied straight over.
+void ExtractIndices(const tinygltf::Model& model,
+                    const tinygltf::Primitive& primitive,
+                    Mesh* mesh) {
   const tinygltf::Accessor& accessor = model.accessors[primitive.indices];
   uint32_t index_count = accessor.count;
 
@@ -349,10 +347,13 @@ std::vector<uint32_t> ExtractIndices(const tinygltf::Model& model,
   const tinygltf::Buffer& buffer = model.buffers[buffer_view.buffer];
 
   const uint8_t* data = (const uint8_t*)buffer.data.data();
-  data += buffer_view.byteOffset;
+  data += buffer_view.byteOffset + accessor.byteOffset;
 
-  return component_type == ComponentType::kUint16 ? ObtainIndices<uint16_t>(data, index_count)
-                                                  : ObtainIndices<uint32_t>(data, index_count);
+  if (component_type == ComponentType::kUint16) {
+    PushIndices(mesh, (const uint16_t*)data, index_count);
+  } else {
+    PushIndices(mesh, (const uint32_t*)data, index_count);
+  }
 }
 
 Vec3 NodeToVec3(const double* d) { return {(float)d[0], (float)d[1], (float)d[2]}; }
@@ -379,6 +380,157 @@ NO_DISCARD Transform ProcessNodeTransform(const tinygltf::Node& node) {
   return transform;
 }
 
+// Fills in the vertices and indices of |mesh| from |primitive|.
+bool BuildMesh(const tinygltf::Model& model, const tinygltf::Primitive& primitive,
+               const LoadOptions& options, Mesh* mesh, Bounds* bounds) {
+  VertexType vertex_type = DetectVertexType(model, primitive);
+
+  // The raw extraction is temporary: it only lives until it's copied/converted into the mesh.
+  ScratchScope scratch_scope;
+  auto [extracted, extracted_size, min, max] =
+      ExtractVertices(model, primitive, scratch_scope.allocator);
+  uint32_t vertex_count = extracted_size / ToSize(vertex_type);
+
+  Mesh::VertexBuffer vertices;
+
+  // TODO(Cristian): Right now we handle only k3dNormalUV;
+  if (vertex_type == VertexType::k3dNormalUV) {
+    vertices.resize(extracted_size);
+    memcpy(vertices.data(), extracted, extracted_size);
+  } else if (vertex_type == VertexType::k3dNormalTangentUV) {
+    // We transform the vertices into the supported vertex format.
+    vertices.resize(sizeof(Vertex3dNormalUV) * vertex_count);
+
+    const auto* vertex_ptr = (const Vertex3dNormalTangentUV*)extracted;
+    auto* out = (Vertex3dNormalUV*)vertices.data();
+    for (uint32_t i = 0; i < vertex_count; i++) {
+      out[i].pos = vertex_ptr[i].pos;
+      out[i].normal = vertex_ptr[i].normal;
+      out[i].uv = vertex_ptr[i].uv;
+    }
+    vertex_type = VertexType::k3dNormalUV;
+  } else if (vertex_type != VertexType::k3dNormalUV) {
+    ERROR(App, "Unsupported vertex type: %s", ToString(vertex_type));
+    return false;
+  }
+
+  mesh->vertex_type = vertex_type;
+  mesh->vertices = std::move(vertices);
+  mesh->vertex_count = vertex_count;
+  mesh->index_format = SelectIndexFormat(vertex_count);
+  ExtractIndices(model, primitive, mesh);
+
+  if (options.quantize_vertices && !QuantizeVertices(mesh)) {
+    WARNING(Model, "Mesh %s: Vertex type %s cannot be quantized.", mesh->name.c_str(),
+            ToString(mesh->vertex_type));
+  }
+
+  bounds->min = min;
+  bounds->max = max;
+  return true;
+}
+
+bool LoadGLTFFile(const std::string& path, tinygltf::Model* out) {
+  std::string err, warn;
+  tinygltf::TinyGLTF gltf_loader;
+  if (!gltf_loader.LoadASCIIFromFile(out, &err, &warn, path)) {
+    ERROR(Model, "Could not load model %s: %s.", path.c_str(), err.c_str());
+    return false;
+  }
+
+  if (!warn.empty())
+    WARNING(Model, "Loading model %s: %s.", path.c_str(), warn.c_str());
+  return true;
+}
+
+// Reloading (CPUDataPolicy::kReload) --------------------------------------------------------------
+//
+// Data evicted after staging is reloaded by going back to the file. The whole file gets parsed, so
+// this is meant for the occasional access, not for streaming.
+
+bool ReloadMeshData(const std::string& path, const LoadOptions& options, int mesh_index,
+                    uint32_t primitive_index, Mesh* mesh) {
+  tinygltf::Model model;
+  if (!LoadGLTFFile(path, &model))
+    return false;
+
+  if (mesh_index < 0 || (size_t)mesh_index >= model.meshes.size() ||
+      primitive_index >= model.meshes[mesh_index].primitives.size()) {
+    ERROR(Model, "Model %s changed: cannot reload mesh %s.", path.c_str(), mesh->name.c_str());
+    return false;
+  }
+
+  Mesh reloaded;
+  reloaded.name = mesh->name;
+  Bounds bounds = {};
+  if (!BuildMesh(model, model.meshes[mesh_index].primitives[primitive_index], options, &reloaded,
+                 &bounds)) {
+    return false;
+  }
+
+  if (reloaded.vertex_type != mesh->vertex_type || reloaded.index_format != mesh->index_format ||
+      reloaded.vertex_count != mesh->vertex_count || reloaded.index_count != mesh->index_count) {
+    ERROR(Model, "Model %s changed: cannot reload mesh %s.", path.c_str(), mesh->name.c_str());
+    return false;
+  }
+
+  mesh->vertices = std::move(reloaded.vertices);
+  mesh->indices = std::move(reloaded.indices);
+  mesh->dequantization = reloaded.dequantization;
+  return true;
+}
+
+bool ReloadTextureData(const std::string& path, int image_index, Texture* texture) {
+  tinygltf::Model model;
+  if (!LoadGLTFFile(path, &model))
+    return false;
+
+  if (image_index < 0 || (size_t)image_index >= model.images.size() ||
+      model.images[image_index].image.size() != DataSize(*texture)) {
+    ERROR(Model, "Model %s changed: cannot reload texture %s.", path.c_str(),
+          texture->name.c_str());
+    return false;
+  }
+
+  const tinygltf::Image& image = model.images[image_index];
+  texture->data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(image.image.size());
+  memcpy(texture->data.get(), image.image.data(), image.image.size());
+  return true;
+}
+
+TextureWrapMode ToWrapMode(int wrap) {
+  switch (wrap) {
+    case TINYGLTF_TEXTURE_WRAP_REPEAT: return TextureWrapMode::kRepeat;
+    case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE: return TextureWrapMode::kClampToEdge;
+    case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT: return TextureWrapMode::kMirroredRepeat;
+    default: break;
+  }
+
+  WARNING(Model, "Unknown wrap mode %d. Using repeat.", wrap);
+  return TextureWrapMode::kRepeat;
+}
+
+// glTF doesn't define a default filter (-1), so those are linear.
+TextureFilterMode ToFilterMode(int filter) {
+  switch (filter) {
+    case -1: return TextureFilterMode::kLinear;
+    case TINYGLTF_TEXTURE_FILTER_NEAREST: return TextureFilterMode::kNearest;
+    case TINYGLTF_TEXTURE_FILTER_LINEAR: return TextureFilterMode::kLinear;
+    case TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST:
+      return TextureFilterMode::kNearestMipmapNearest;
+    case TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST:
+      return TextureFilterMode::kLinearMipmapNearest;
+    case TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR:
+      return TextureFilterMode::kNearestMipmapLinear;
+    case TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR:
+      return TextureFilterMode::kLinearMipampLinear;
+    default: break;
+  }
+
+  WARNING(Model, "Unknown filter mode %d. Using linear.", filter);
+  return TextureFilterMode::kLinear;
+}
+
 Texture* LoadTexture(const tinygltf::Model& model,
                      const tinygltf::Material& material,
                      ProcessingContext* context) {
@@ -400,17 +552,27 @@ Texture* LoadTexture(const tinygltf::Model& model,
     auto rothko_texture = std::make_unique<Texture>();
     rothko_texture->name = base_image.name;
     rothko_texture->size = {base_image.width, base_image.height};
-    // TODO(Cristian): Do tinygltf -> rothko modes translation instead of hardcoding.
-    //                 This is obtained from |base_texture.sampler|.
     rothko_texture->name = model.images[base_texture.source].uri;
     rothko_texture->type = TextureType::kRGBA;
-    rothko_texture->wrap_mode_u = TextureWrapMode::kRepeat;
-    rothko_texture->wrap_mode_v = TextureWrapMode::kRepeat;
-    rothko_texture->min_filter = TextureFilterMode::kLinear;
-    rothko_texture->mag_filter = TextureFilterMode::kLinear;
+
+    // Without a sampler, glTF says to repeat and leaves the filtering to the implementation.
+    tinygltf::Sampler sampler = {};
+    if (base_texture.sampler >= 0)
+      sampler = model.samplers[base_texture.sampler];
+    rothko_texture->wrap_mode_u = ToWrapMode(sampler.wrapS);
+    rothko_texture->wrap_mode_v = ToWrapMode(sampler.wrapT);
+    rothko_texture->min_filter = ToFilterMode(sampler.minFilter);
+    rothko_texture->mag_filter = ToFilterMode(sampler.magFilter);
+
+    rothko_texture->cpu_data_policy = context->options.cpu_data_policy;
+    rothko_texture->reload_cpu_data = [path = context->path,
+                                       image_index = base_texture.source](Texture* texture) {
+      return ReloadTextureData(path, image_index, texture);
+    };
 
     ASSERT(DataSize(*rothko_texture) == base_image.image.size());
-    rothko_texture->data = std::make_unique<uint8_t[]>(base_image.image.size());
+    rothko_texture->data =
+        MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(base_image.image.size());
     memcpy(rothko_texture->data.get(), base_image.image.data(), base_image.image.size());
 
     texture_ptr = rothko_texture.get();
@@ -471,63 +633,34 @@ bool ProcessNode(const tinygltf::Model& model,
   // Process the primitives.
   for (uint32_t primitive_i = 0; primitive_i < mesh.primitives.size(); primitive_i++) {
     const tinygltf::Primitive& primitive = mesh.primitives[primitive_i];
-    VertexType vertex_type = DetectVertexType(model, primitive);
-
-    auto [vertices, min, max] = ExtractVertices(model, primitive);
-    uint32_t vertex_count = vertices.size() / ToSize(vertex_type);
-
-    // TODO(Cristian): Right now we handle only k3dNormalUV;
-    if (vertex_type == VertexType::k3dNormalTangentUV) {
-      // We transform the vertices into the supported vertex format.
-      std::vector<uint8_t> new_vertices;
-      new_vertices.reserve(sizeof(Vertex3dNormalUV) * vertex_count);
-
-      const auto* vertex_ptr = (const Vertex3dNormalTangentUV*)vertices.data();
-      for (uint32_t i = 0; i < vertex_count; i++) {
-        Vertex3dNormalUV vertex = {};
-        vertex.pos = vertex_ptr->pos;
-        vertex.normal = vertex_ptr->normal;
-        vertex.uv = vertex_ptr->uv;
-
-        uint8_t* ptr = (uint8_t*)&vertex;
-        for (uint32_t j = 0; j < sizeof(vertex); j++) {
-          new_vertices.emplace_back(*ptr++);
-        }
-
-        /* new_vertices.emplace_back(std::move(vertex)); */
-        vertex_ptr++;
-      }
-      vertices = std::move(new_vertices);
-      vertex_type = VertexType::k3dNormalUV;
-    } else if (vertex_type != VertexType::k3dNormalUV) {
-      ERROR(App, "Unsupported vertex type: %s", ToString(vertex_type));
-      return false;
-    }
-
-    std::vector<uint32_t> indices = ExtractIndices(model, primitive);
-
     // Create the mesh.
     auto rothko_mesh = std::make_unique<Mesh>();
     rothko_mesh->name = StringPrintf("%s-%u", mesh.name.c_str(), primitive_i);
-    rothko_mesh->vertex_type = vertex_type;
-    rothko_mesh->vertices = std::move(vertices);
-    rothko_mesh->vertex_count = vertex_count;
-    rothko_mesh->indices = std::move(indices);
+    rothko_mesh->usage = context->options.mesh_usage;
+    rothko_mesh->cpu_data_policy = context->options.cpu_data_policy;
+    rothko_mesh->reload_cpu_data = [path = context->path, options = context->options,
+                                    mesh_index = node.mesh, primitive_i](Mesh* mesh) {
+      return ReloadMeshData(path, options, mesh_index, primitive_i, mesh);
+    };
+
+    Bounds bounds = {};
+    if (!BuildMesh(model, primitive, context->options, rothko_mesh.get(), &bounds))
+      return false;
+
     const Mesh* mesh_ptr = rothko_mesh.get();
     context->meshes.push_back(std::move(rothko_mesh));
 
     /* LOG(App, */
-    /*     "Mesh for %s: %s -> Vertices: %u (Min: %s, Max: %s), Indices: %zu", */
+    /*     "Mesh for %s: %s -> Vertices: %u (Min: %s, Max: %s), Indices: %u", */
     /*     node.name.c_str(), */
     /*     mesh_ptr->name.c_str(), */
     /*     mesh_ptr->vertex_count, */
     /*     ToString(min).c_str(), */
     /*     ToString(max).c_str(), */
-    /*     mesh_ptr->indices.size()); */
+    /*     mesh_ptr->index_count); */
 
     // Material.
-    model_node.primitives[primitive_i].bounds.min = min;
-    model_node.primitives[primitive_i].bounds.max = max;
+    model_node.primitives[primitive_i].bounds = bounds;
     model_node.primitives[primitive_i].mesh = mesh_ptr;
     model_node.primitives[primitive_i].material = HandleMaterial(model, primitive, context);
   }
@@ -551,8 +684,113 @@ bool ProcessNodes(const tinygltf::Model& model, const tinygltf::Node& node,
   return true;
 }
 
-bool ProcessModel(const tinygltf::Model& model, const tinygltf::Scene& scene, Model* model_out) {
+// Texture Packing ---------------------------------------------------------------------------------
+
+bool PackModelTextures(ProcessingContext* context) {
+  std::vector<Texture*> textures;
+  textures.reserve(context->textures.size());
+  for (auto& [id, texture] : context->textures) {
+    textures.push_back(texture.get());
+  }
+
+  // Materials only have a 2D base texture, so arrays would not be sampled correctly.
+  TexturePackOptions pack_options = context->options.pack_options;
+  pack_options.create_arrays = false;
+
+  PackedTextures packed;
+  if (!PackTextures(textures, &packed, pack_options))
+    return false;
+
+  std::map<const Texture*, TextureRegion> regions;
+  for (uint32_t i = 0; i < textures.size(); i++) {
+    if (packed.regions[i].texture != textures[i])
+      regions[textures[i]] = packed.regions[i];
+  }
+
+  // Meshes using atlased textures get their UVs moved into the atlas. Reloading their data has to
+  // do it again.
+  for (auto& mesh : context->meshes) {
+    const Material* material = nullptr;
+    for (const ModelNode& node : context->model.nodes) {
+      for (const ModelPrimitive& primitive : node.primitives) {
+        if (primitive.mesh == mesh.get())
+          material = primitive.material;
+      }
+    }
+
+    if (!material || !material->base_texture)
+      continue;
+
+    auto it = regions.find(material->base_texture);
+    if (it == regions.end())
+      continue;
+
+    const TextureRegion& region = it->second;
+    if (!RemapUVs(mesh.get(), region))
+      return false;
+
+    mesh->reload_cpu_data = [reload = std::move(mesh->reload_cpu_data), region](Mesh* mesh) {
+      return reload(mesh) && RemapUVs(mesh, region);
+    };
+  }
+
+  for (auto& [id, material] : context->materials) {
+    auto it = regions.find(material->base_texture);
+    if (it == regions.end())
+      continue;
+
+    material->base_texture = it->second.texture;
+  }
+
+  // The packed textures are not needed anymore.
+  for (auto it = context->textures.begin(); it != context->textures.end();) {
+    if (regions.count(it->second.get())) {
+      it = context->textures.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  // Packed textures cannot go back to the file for their data.
+  for (auto& texture : packed.textures) {
+    if (Resolve(texture->cpu_data_policy) == CPUDataPolicy::kReload)
+      texture->cpu_data_policy = CPUDataPolicy::kDiscard;
+  }
+
+  context->packed_textures = std::move(packed.textures);
+  return true;
+}
+
+// LODs --------------------------------------------------------------------------------------------
+
+void GenerateModelLODs(Model* model, const LoadOptions& options) {
+  std::vector<MeshLOD> lods;
+  for (ModelNode& node : model->nodes) {
+    for (ModelPrimitive& primitive : node.primitives) {
+      if (!primitive.mesh)
+        continue;
+
+      // Not every primitive can be simplified (eg. lines). Those are still drawn, without LODs.
+      if (!GenerateLODs(*primitive.mesh, options.lod_options, &lods)) {
+        WARNING(Model, "Mesh %s: Could not generate LODs.", primitive.mesh->name.c_str());
+        continue;
+      }
+
+      for (MeshLOD& lod : lods) {
+        if (Resolve(lod.mesh->cpu_data_policy) == CPUDataPolicy::kReload)
+          lod.mesh->cpu_data_policy = CPUDataPolicy::kDiscard;
+      }
+
+      AddLODs(model, &primitive, &lods);
+    }
+  }
+}
+
+bool ProcessModel(const std::string& path, const tinygltf::Model& model,
+                  const tinygltf::Scene& scene, const LoadOptions& options, Model* model_out) {
   ProcessingContext context = {};
+  context.path = path;
+  context.options = options;
   context.scene_graph = std::make_unique<SceneGraph>();
 
   for (int node_index : scene.nodes) {
@@ -560,15 +798,23 @@ bool ProcessModel(const tinygltf::Model& model, const tinygltf::Scene& scene, Mo
       return false;
   }
 
+  if (options.pack_textures && !PackModelTextures(&context))
+    return false;
+
   // Fill in the context into the model.
   *model_out = std::move(context.model);
 
   model_out->meshes = std::move(context.meshes);
+  if (options.generate_lods)
+    GenerateModelLODs(model_out, options);
 
-  model_out->textures.reserve(context.textures.size());
+  model_out->textures.reserve(context.textures.size() + context.packed_textures.size());
   for (auto& [id, texture] : context.textures) {
     model_out->textures.push_back(std::move(texture));
   }
+  for (auto& texture : context.packed_textures) {
+    model_out->textures.push_back(std::move(texture));
+  }
 
   model_out->materials.reserve(context.materials.size());
   for (auto& [id, material] : context.materials) {
@@ -587,17 +833,10 @@ bool ProcessModel(const tinygltf::Model& model, const tinygltf::Scene& scene, Mo
 
 }  // namespace
 
-bool LoadModel(const std::string& path, Model* model_out) {
-    std::string err, warn;
-    tinygltf::TinyGLTF gltf_loader;
+bool LoadModel(const std::string& path, Model* model_out, const LoadOptions& options) {
     tinygltf::Model gltf_model = {};
-    if (!gltf_loader.LoadASCIIFromFile(&gltf_model, &err, &warn, path)) {
-      ERROR(Model, "Could not load model %s: %s.", path.c_str(), err.c_str());
+    if (!LoadGLTFFile(path, &gltf_model))
       return false;
-    }
-
-    if (!warn.empty())
-      WARNING(Model, "Loading model %s: %s.", path.c_str(), warn.c_str());
 
     // TODO(donosoc): Load mode than the default scene.
     if (gltf_model.scenes.size() > 1u) {
@@ -606,7 +845,7 @@ bool LoadModel(const std::string& path, Model* model_out) {
     }
 
     auto& gltf_scene = gltf_model.scenes[gltf_model.defaultScene];
-    if (!ProcessModel(gltf_model, gltf_scene, model_out))
+    if (!ProcessModel(path, gltf_model, gltf_scene, options, model_out))
       return false;
 
     model_out->path= path;
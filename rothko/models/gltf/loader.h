@@ -5,13 +5,42 @@
 
 #include <string>
 
+#include "rothko/graphics/mesh.h"
+#include "rothko/graphics/texture_atlas.h"
+#include "rothko/models/lod.h"
+
 namespace rothko {
 
 struct Model;
 
 namespace gltf {
 
-bool LoadModel(const std::string& path, Model* out);
+struct LoadOptions {
+  // Converts the meshes into their quantized vertex formats (see |QuantizeVertices|). Shaders
+  // rendering them must dequantize.
+  bool quantize_vertices = false;
+
+  // Models tend to have many small meshes of the same vertex type, which can share buffers.
+  MeshUsage mesh_usage = MeshUsage::kStatic;
+
+  // Applied to all the meshes and textures of the model. |CPUDataPolicy::kReload| re-parses the
+  // file to get the data back.
+  CPUDataPolicy cpu_data_policy = CPUDataPolicy::kDefault;
+
+  // Groups the textures into atlases (see |PackTextures|) and remaps the UVs of the meshes using
+  // them. Materials point to the atlases. Arrays are never created, as materials sample their
+  // texture as a regular 2D one (|TexturePackOptions::create_arrays| is ignored).
+  bool pack_textures = false;
+  TexturePackOptions pack_options = {};
+
+  // Simplified versions of each mesh, stored in |ModelPrimitive::lods| (see lod.h). They cannot be
+  // reloaded from the file, so |CPUDataPolicy::kReload| turns into discarding for them. Primitives
+  // that cannot be simplified (see |SimplifyMesh|) are left without LODs.
+  bool generate_lods = false;
+  LODOptions lod_options = {};
+};
+
+bool LoadModel(const std::string& path, Model* out, const LoadOptions& options = {});
 
 }  // namespace gltf
 }  // namespace rothko
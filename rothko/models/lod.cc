@@ -0,0 +1,122 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/models/lod.h"
+
+#include <float.h>
+
+#include "rothko/graphics/mesh.h"
+#include "rothko/models/simplify.h"
+#include "rothko/utils/strings.h"
+
+namespace rothko {
+
+bool GenerateLODs(const Mesh& mesh, const LODOptions& options, std::vector<MeshLOD>* out) {
+  out->clear();
+
+  uint32_t lod_count = Min(options.lod_count, kMaxModelLODs);
+  uint32_t previous_count = mesh.index_count;
+  for (uint32_t i = 0; i < lod_count; i++) {
+    SimplifyOptions simplify_options = {};
+    simplify_options.target_index_count = (uint32_t)(previous_count * options.reduction) / 3 * 3;
+    simplify_options.max_error = options.max_error;
+
+    auto lod = std::make_unique<Mesh>();
+    float error = 0;
+    if (!SimplifyMesh(mesh, simplify_options, lod.get(), &error))
+      return false;
+
+    // Not worth having if it didn't get at least halfway to the target.
+    float halfway = (previous_count + simplify_options.target_index_count) * 0.5f;
+    if (lod->index_count == 0 || lod->index_count > halfway)
+      break;
+
+    lod->name = StringPrintf("%s-lod%u", mesh.name.c_str(), i + 1);
+    previous_count = lod->index_count;
+
+    MeshLOD& mesh_lod = out->emplace_back();
+    mesh_lod.mesh = std::move(lod);
+    mesh_lod.error = error;
+  }
+
+  return true;
+}
+
+void AddLODs(Model* model, ModelPrimitive* primitive, std::vector<MeshLOD>* lods) {
+  primitive->lod_count = 0;
+  for (MeshLOD& lod : *lods) {
+    if (primitive->lod_count == kMaxModelLODs)
+      break;
+
+    primitive->lods[primitive->lod_count++] = {lod.mesh.get(), lod.error};
+    model->meshes.push_back(std::move(lod.mesh));
+  }
+
+  lods->clear();
+}
+
+// Selection ---------------------------------------------------------------------------------------
+
+float GetProjectedRadius(const Bounds& bounds, const Mat4& transform,
+                         const LODSelection& selection) {
+  Vec3 center = ToVec3(transform * ((bounds.min + bounds.max) * 0.5f));
+  float scale = Max(Length(ToVec3(transform.cols[0])),
+                    Max(Length(ToVec3(transform.cols[1])), Length(ToVec3(transform.cols[2]))));
+  float radius = Length(bounds.max - bounds.min) * 0.5f * scale;
+
+  float distance = Length(center - selection.camera_pos);
+  if (distance <= radius)
+    return FLT_MAX;
+
+  // The vertical scale of the projection takes a size at distance 1 into NDC, which span 2 units.
+  float ndc_radius = radius / distance * selection.projection.cols[1].y;
+  return ndc_radius * selection.viewport_height * 0.5f;
+}
+
+uint32_t SelectLOD(const ModelPrimitive& primitive, const Mat4& transform,
+                   const LODSelection& selection, uint32_t current_lod) {
+  if (primitive.lod_count == 0)
+    return 0;
+
+  float radius = GetProjectedRadius(primitive.bounds, transform, selection);
+  auto pixel_error = [&primitive, radius](uint32_t lod) {
+    return lod == 0 ? 0.0f : primitive.lods[lod - 1].error * radius;
+  };
+
+  float max_error = selection.max_pixel_error;
+  float finer_threshold = max_error * (1.0f + selection.hysteresis);
+  float coarser_threshold = max_error * (1.0f - selection.hysteresis);
+  uint32_t lod = Min(current_lod, primitive.lod_count);
+
+  // Too coarse: go to the first one that is good enough.
+  if (pixel_error(lod) > finer_threshold) {
+    while (lod > 0 && pixel_error(lod) > max_error)
+      lod--;
+    return lod;
+  }
+
+  while (lod < primitive.lod_count && pixel_error(lod + 1) <= coarser_threshold)
+    lod++;
+  return lod;
+}
+
+void SelectModelLODs(ModelInstance* instance, const LODSelection& selection) {
+  const Model& model = *instance->model;
+  instance->lods.resize(model.nodes.size() * kMaxPrimitivesPerModelNode);
+
+  for (uint32_t node_index = 0; node_index < model.nodes.size(); node_index++) {
+    const ModelNode& node = model.nodes[node_index];
+    Mat4 transform = instance->transform.world_matrix * node.transform.world_matrix;
+
+    for (uint32_t i = 0; i < kMaxPrimitivesPerModelNode; i++) {
+      const ModelPrimitive& primitive = node.primitives[i];
+      if (!Valid(primitive))
+        continue;
+
+      uint8_t& lod = instance->lods[node_index * kMaxPrimitivesPerModelNode + i];
+      lod = (uint8_t)SelectLOD(primitive, transform, selection, lod);
+    }
+  }
+}
+
+}  // namespace rothko
@@ -0,0 +1,80 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "rothko/math/math.h"
+#include "rothko/models/model.h"
+
+namespace rothko {
+
+// Level Of Detail ---------------------------------------------------------------------------------
+//
+// Far away primitives cover a handful of pixels, so most of their triangles are wasted. Each
+// primitive can have a chain of simplified meshes (|ModelPrimitive::lods|), generated with
+// |SimplifyMesh|. Every frame the least detailed one whose error would still be smaller than
+// |LODSelection::max_pixel_error| on screen gets drawn.
+
+struct LODOptions {
+  uint32_t lod_count = 3;         // Up to |kMaxModelLODs|.
+  float reduction = 0.5f;         // Index count of each LOD relative to the previous one.
+
+  // See |SimplifyOptions::max_error|. The chain stops at the first LOD that cannot be simplified
+  // enough without going over it.
+  float max_error = 0.05f;
+};
+
+struct MeshLOD {
+  std::unique_ptr<Mesh> mesh;
+  float error = 0;
+};
+
+// Every LOD is simplified from |mesh| directly, so the errors are not accumulated. Returns false if
+// |mesh| cannot be simplified (see |SimplifyMesh|). |out| can end up with less than |lod_count|
+// entries.
+bool GenerateLODs(const Mesh& mesh, const LODOptions&, std::vector<MeshLOD>* out);
+
+// Moves the LODs into |model->meshes| and points the primitive to them.
+void AddLODs(Model* model, ModelPrimitive* primitive, std::vector<MeshLOD>* lods);
+
+inline const Mesh* GetLODMesh(const ModelPrimitive& primitive, uint32_t lod) {
+  if (lod == 0 || primitive.lod_count == 0)
+    return primitive.mesh;
+  return primitive.lods[Min(lod, primitive.lod_count) - 1].mesh;
+}
+
+// Selection ---------------------------------------------------------------------------------------
+
+struct LODSelection {
+  Vec3 camera_pos = {};
+  Mat4 projection = Mat4::Identity();   // Perspective. Only the vertical scale is used.
+  int viewport_height = 0;
+
+  // How far (in pixels) the surface of the selected LOD can be from the original one.
+  float max_pixel_error = 1.0f;
+
+  // Going to a less detailed LOD requires it to be this fraction under |max_pixel_error| and
+  // going to a more detailed one requires the current one to be this fraction over it. Stops
+  // primitives at the edge of a threshold from switching back and forth.
+  float hysteresis = 0.2f;
+};
+
+// Radius in pixels of the sphere around |bounds|. Huge when the camera is inside it.
+float GetProjectedRadius(const Bounds& bounds, const Mat4& transform, const LODSelection&);
+
+uint32_t SelectLOD(const ModelPrimitive&, const Mat4& transform, const LODSelection&,
+                   uint32_t current_lod);
+
+// Updates |instance->lods| for all the primitives of the model.
+void SelectModelLODs(ModelInstance* instance, const LODSelection&);
+
+inline uint32_t GetLOD(const ModelInstance& instance, uint32_t node_index,
+                       uint32_t primitive_index) {
+  uint32_t index = node_index * kMaxPrimitivesPerModelNode + primitive_index;
+  return index < instance.lods.size() ? instance.lods[index] : 0;
+}
+
+}  // namespace rothko
@@ -3,10 +3,12 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "rothko/math/math.h"
+#include "rothko/memory/memory_tracker.h"
 #include "rothko/scene/transform.h"
 
 namespace rothko {
@@ -15,11 +17,25 @@ struct Material;
 struct Mesh;
 struct Texture;
 
+// Simplified versions of a primitive's mesh, to be drawn when it's far away (see lod.h).
+struct ModelLOD {
+  const Mesh* mesh = nullptr;
+
+  // How far the surface moved from the original mesh, relative to the radius of the bounds.
+  float error = 0;
+};
+
+constexpr uint32_t kMaxModelLODs = 4;
+
 struct ModelPrimitive {
   const Mesh* mesh = nullptr;
   const Material* material = nullptr;
 
   Bounds bounds = {};   // In local space.
+
+  // From most to least detailed. |mesh| is LOD 0, |lods[0]| is LOD 1 and so on.
+  ModelLOD lods[kMaxModelLODs] = {};
+  uint32_t lod_count = 0;
 };
 inline bool Valid(const ModelPrimitive& p) { return !!p.mesh && !!p.material; }
 
@@ -31,13 +47,15 @@ struct ModelNode {
 };
 
 struct Model {
+  TAGGED_NEW_DELETE(kModels);
+
   std::string path;
 
-  std::vector<std::unique_ptr<Material>> materials;
-  std::vector<std::unique_ptr<Mesh>> meshes;
-  std::vector<std::unique_ptr<Texture>> textures;
+  TaggedVector<std::unique_ptr<Material>, MemoryTag::kModels> materials;
+  TaggedVector<std::unique_ptr<Mesh>, MemoryTag::kModels> meshes;
+  TaggedVector<std::unique_ptr<Texture>, MemoryTag::kModels> textures;
 
-  std::vector<ModelNode> nodes;
+  TaggedVector<ModelNode, MemoryTag::kModels> nodes;
 };
 
 // Instances.
@@ -50,6 +68,9 @@ struct ModelTransform {
 struct ModelInstance {
   const Model* model = {};
   Transform transform = {};
+
+  // Current LOD of each primitive, |kMaxPrimitivesPerModelNode| per node (see |SelectModelLODs|).
+  TaggedVector<uint8_t, MemoryTag::kModels> lods;
 };
 
 }  // namespace rothko
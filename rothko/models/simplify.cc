@@ -0,0 +1,508 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/models/simplify.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "rothko/graphics/mesh.h"
+#include "rothko/logging/logging.h"
+
+namespace rothko {
+
+namespace {
+
+// Quadric -----------------------------------------------------------------------------------------
+//
+// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix (only the 10 unique
+// values). Doubles because summing many nearly equal planes loses too much precision in floats.
+
+struct Quadric {
+  double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+  double a11 = 0, a12 = 0, a13 = 0;
+  double a22 = 0, a23 = 0;
+  double a33 = 0;
+
+  // Area of the triangles that contributed. Dividing by it turns the sum into a mean.
+  double weight = 0;
+};
+
+// Plane given by |normal| (normalized) and |d|, so that distance = dot(normal, p) + d.
+void AddPlane(Quadric* q, const Vec3& normal, float d, double scale) {
+  double a = normal.x * scale, b = normal.y * scale, c = normal.z * scale, sd = d * scale;
+  q->a00 += a * normal.x; q->a01 += a * normal.y; q->a02 += a * normal.z; q->a03 += a * d;
+  q->a11 += b * normal.y; q->a12 += b * normal.z; q->a13 += b * d;
+  q->a22 += c * normal.z; q->a23 += c * d;
+  q->a33 += sd * d;
+}
+
+void Add(Quadric* q, const Quadric& o) {
+  q->a00 += o.a00; q->a01 += o.a01; q->a02 += o.a02; q->a03 += o.a03;
+  q->a11 += o.a11; q->a12 += o.a12; q->a13 += o.a13;
+  q->a22 += o.a22; q->a23 += o.a23;
+  q->a33 += o.a33;
+  q->weight += o.weight;
+}
+
+double Evaluate(const Quadric& q, const Vec3& p) {
+  double x = p.x, y = p.y, z = p.z;
+  return q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x +
+         q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y +
+         q.a22 * z * z + 2 * q.a23 * z +
+         q.a33;
+}
+
+// Border edges get a plane perpendicular to the surface, so moving the border away from itself has
+// a cost. Scaled up so corners are more expensive than what the surface would say.
+constexpr double kBorderWeight = 10.0;
+
+// Topology ----------------------------------------------------------------------------------------
+
+enum class VertexKind : uint8_t {
+  kManifold,  // Can collapse into any neighbour.
+  kBorder,    // Can only collapse along a border edge.
+  kLocked,    // Seams and non-manifold vertices never move.
+};
+
+uint64_t EdgeKey(uint32_t a, uint32_t b) {
+  if (a > b)
+    std::swap(a, b);
+  return ((uint64_t)a << 32) | b;
+}
+
+struct SimplifyContext {
+  std::vector<Vec3> positions;      // Normalized to the bounds (center 0, radius 1).
+  std::vector<uint32_t> welded;     // First vertex with the same position.
+  std::vector<VertexKind> kinds;
+  std::vector<Quadric> quadrics;
+
+  std::vector<uint32_t> indices;
+
+  // Triangles around each vertex. Rebuilt on every pass.
+  std::vector<uint32_t> adjacency_offsets;
+  std::vector<uint32_t> adjacency;
+
+  // Times each (welded) edge is used by a triangle. Rebuilt on every pass.
+  std::unordered_map<uint64_t, uint32_t> edge_counts;
+};
+
+void WeldPositions(SimplifyContext* context) {
+  const auto& positions = context->positions;
+  uint32_t vertex_count = positions.size();
+
+  std::vector<uint32_t> order(vertex_count);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&positions](uint32_t a, uint32_t b) {
+    const Vec3& pa = positions[a];
+    const Vec3& pb = positions[b];
+    if (pa.x != pb.x)
+      return pa.x < pb.x;
+    if (pa.y != pb.y)
+      return pa.y < pb.y;
+    if (pa.z != pb.z)
+      return pa.z < pb.z;
+    return a < b;
+  });
+
+  context->welded.resize(vertex_count);
+  context->kinds.assign(vertex_count, VertexKind::kManifold);
+  for (uint32_t i = 0; i < vertex_count;) {
+    uint32_t end = i + 1;
+    while (end < vertex_count && positions[order[end]] == positions[order[i]])
+      end++;
+
+    for (uint32_t j = i; j < end; j++) {
+      context->welded[order[j]] = order[i];
+      if (end - i > 1)
+        context->kinds[order[j]] = VertexKind::kLocked;   // Seam.
+    }
+    i = end;
+  }
+}
+
+void CountEdges(SimplifyContext* context) {
+  context->edge_counts.clear();
+  const auto& indices = context->indices;
+  for (uint32_t i = 0; i < indices.size(); i += 3) {
+    for (uint32_t e = 0; e < 3; e++) {
+      uint32_t a = context->welded[indices[i + e]];
+      uint32_t b = context->welded[indices[i + (e + 1) % 3]];
+      context->edge_counts[EdgeKey(a, b)]++;
+    }
+  }
+}
+
+bool IsBorderEdge(const SimplifyContext& context, uint32_t a, uint32_t b) {
+  auto it = context.edge_counts.find(EdgeKey(context.welded[a], context.welded[b]));
+  return it != context.edge_counts.end() && it->second == 1;
+}
+
+void ClassifyVertices(SimplifyContext* context) {
+  std::vector<uint32_t> border_edges(context->positions.size());
+  for (auto& [key, count] : context->edge_counts) {
+    uint32_t a = (uint32_t)(key >> 32);
+    uint32_t b = (uint32_t)key;
+    if (count == 1) {
+      border_edges[a]++;
+      border_edges[b]++;
+    } else if (count > 2) {
+      context->kinds[a] = VertexKind::kLocked;
+      context->kinds[b] = VertexKind::kLocked;
+    }
+  }
+
+  for (uint32_t i = 0; i < context->kinds.size(); i++) {
+    VertexKind& kind = context->kinds[i];
+    if (kind == VertexKind::kLocked || border_edges[i] == 0)
+      continue;
+
+    // Anything else than a simple border (eg. two borders touching at a vertex) stays in place.
+    kind = border_edges[i] == 2 ? VertexKind::kBorder : VertexKind::kLocked;
+  }
+}
+
+void ComputeQuadrics(SimplifyContext* context) {
+  const auto& positions = context->positions;
+  const auto& indices = context->indices;
+  context->quadrics.assign(positions.size(), {});
+
+  for (uint32_t i = 0; i < indices.size(); i += 3) {
+    const uint32_t* tri = &indices[i];
+    Vec3 normal = Cross(positions[tri[1]] - positions[tri[0]],
+                        positions[tri[2]] - positions[tri[0]]);
+    float length = Length(normal);
+    if (length == 0)
+      continue;
+    normal = normal * (1.0f / length);
+
+    // Weighted by area, so big triangles are harder to move than small ones.
+    Quadric quadric = {};
+    double area = length * 0.5;
+    AddPlane(&quadric, normal, -Dot(normal, positions[tri[0]]), area);
+    quadric.weight = area;
+    for (uint32_t v = 0; v < 3; v++) {
+      Add(&context->quadrics[tri[v]], quadric);
+    }
+
+    for (uint32_t e = 0; e < 3; e++) {
+      uint32_t a = tri[e];
+      uint32_t b = tri[(e + 1) % 3];
+      if (!IsBorderEdge(*context, a, b))
+        continue;
+
+      Vec3 edge = positions[b] - positions[a];
+      Vec3 border_normal = Cross(edge, normal);
+      float border_length = Length(border_normal);
+      if (border_length == 0)
+        continue;
+      border_normal = border_normal * (1.0f / border_length);
+
+      Quadric border = {};
+      AddPlane(&border, border_normal, -Dot(border_normal, positions[a]),
+               LengthSq(edge) * kBorderWeight);
+      Add(&context->quadrics[a], border);
+      Add(&context->quadrics[b], border);
+    }
+  }
+}
+
+void BuildAdjacency(SimplifyContext* context) {
+  const auto& indices = context->indices;
+  uint32_t vertex_count = context->positions.size();
+
+  context->adjacency_offsets.assign(vertex_count + 1, 0);
+  for (uint32_t index : indices) {
+    context->adjacency_offsets[index + 1]++;
+  }
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    context->adjacency_offsets[i + 1] += context->adjacency_offsets[i];
+  }
+
+  std::vector<uint32_t> fill(context->adjacency_offsets.begin(),
+                             context->adjacency_offsets.end() - 1);
+  context->adjacency.resize(indices.size());
+  for (uint32_t i = 0; i < indices.size(); i++) {
+    context->adjacency[fill[indices[i]]++] = i / 3;
+  }
+}
+
+// Collapses ---------------------------------------------------------------------------------------
+
+struct Collapse {
+  uint32_t from = 0;
+  uint32_t to = 0;
+  float cost = 0;
+};
+
+bool CanCollapse(const SimplifyContext& context, uint32_t from, uint32_t to) {
+  switch (context.kinds[from]) {
+    case VertexKind::kManifold: return true;
+    case VertexKind::kBorder:
+      return context.kinds[to] != VertexKind::kManifold && IsBorderEdge(context, from, to);
+    case VertexKind::kLocked: return false;
+  }
+
+  NOT_REACHED();
+  return false;
+}
+
+float CollapseCost(const SimplifyContext& context, uint32_t from, uint32_t to) {
+  const Quadric& qf = context.quadrics[from];
+  const Quadric& qt = context.quadrics[to];
+  const Vec3& p = context.positions[to];
+
+  double weight = qf.weight + qt.weight;
+  double error = Evaluate(qf, p) + Evaluate(qt, p);
+  if (weight > 0)
+    error /= weight;
+  return error > 0 ? (float)error : 0.0f;
+}
+
+template <typename Callback>
+void ForEachTriangle(const SimplifyContext& context, uint32_t vertex, Callback callback) {
+  for (uint32_t i = context.adjacency_offsets[vertex]; i < context.adjacency_offsets[vertex + 1];
+       i++) {
+    callback(&context.indices[context.adjacency[i] * 3]);
+  }
+}
+
+// Collapsing an edge whose ends share more neighbours than the ones across the edge would pinch the
+// surface into a non-manifold one.
+bool KeepsTopology(const SimplifyContext& context, uint32_t from, uint32_t to) {
+  std::vector<uint32_t> from_ring, to_ring;
+  uint32_t shared_triangles = 0;
+
+  ForEachTriangle(context, from, [&](const uint32_t* tri) {
+    bool has_to = tri[0] == to || tri[1] == to || tri[2] == to;
+    shared_triangles += has_to;
+    for (uint32_t v = 0; v < 3; v++) {
+      if (tri[v] != from && tri[v] != to)
+        from_ring.push_back(tri[v]);
+    }
+  });
+  ForEachTriangle(context, to, [&](const uint32_t* tri) {
+    for (uint32_t v = 0; v < 3; v++) {
+      if (tri[v] != from && tri[v] != to)
+        to_ring.push_back(tri[v]);
+    }
+  });
+
+  std::sort(from_ring.begin(), from_ring.end());
+  from_ring.erase(std::unique(from_ring.begin(), from_ring.end()), from_ring.end());
+  std::sort(to_ring.begin(), to_ring.end());
+  to_ring.erase(std::unique(to_ring.begin(), to_ring.end()), to_ring.end());
+
+  std::vector<uint32_t> shared;
+  std::set_intersection(from_ring.begin(), from_ring.end(), to_ring.begin(), to_ring.end(),
+                        std::back_inserter(shared));
+  return shared.size() <= shared_triangles;
+}
+
+// Whether moving |from| onto |to| turns any of the surviving triangles around.
+bool FlipsTriangles(const SimplifyContext& context, uint32_t from, uint32_t to) {
+  const auto& positions = context.positions;
+  bool flips = false;
+  ForEachTriangle(context, from, [&](const uint32_t* tri) {
+    if (flips || tri[0] == to || tri[1] == to || tri[2] == to)
+      return;
+
+    Vec3 p[3] = {positions[tri[0]], positions[tri[1]], positions[tri[2]]};
+    Vec3 before = Cross(p[1] - p[0], p[2] - p[0]);
+    for (uint32_t v = 0; v < 3; v++) {
+      if (tri[v] == from)
+        p[v] = positions[to];
+    }
+    Vec3 after = Cross(p[1] - p[0], p[2] - p[0]);
+    flips = Dot(before, after) <= 0;
+  });
+  return flips;
+}
+
+// Does one round of non-overlapping collapses. Returns how many triangles were removed.
+uint32_t SimplifyPass(SimplifyContext* context, uint32_t target_index_count, float max_cost,
+                      float* error) {
+  auto& indices = context->indices;
+  uint32_t vertex_count = context->positions.size();
+
+  CountEdges(context);
+  BuildAdjacency(context);
+
+  std::vector<Collapse> collapses;
+  collapses.reserve(indices.size());
+  for (uint32_t i = 0; i < indices.size(); i += 3) {
+    for (uint32_t e = 0; e < 3; e++) {
+      uint32_t a = indices[i + e];
+      uint32_t b = indices[i + (e + 1) % 3];
+
+      Collapse collapse = {};
+      collapse.cost = INFINITY;
+      if (CanCollapse(*context, a, b))
+        collapse = {a, b, CollapseCost(*context, a, b)};
+      if (CanCollapse(*context, b, a)) {
+        float cost = CollapseCost(*context, b, a);
+        if (cost < collapse.cost)
+          collapse = {b, a, cost};
+      }
+
+      if (collapse.cost <= max_cost)
+        collapses.push_back(collapse);
+    }
+  }
+
+  std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+    if (a.cost != b.cost)
+      return a.cost < b.cost;
+    if (a.from != b.from)
+      return a.from < b.from;
+    return a.to < b.to;
+  });
+
+  std::vector<uint32_t> remap(vertex_count);
+  std::iota(remap.begin(), remap.end(), 0);
+
+  // A vertex touched by a collapse cannot be part of another one in the same pass, so the checks
+  // above always look at the current state of the triangles.
+  std::vector<uint8_t> locked(vertex_count);
+
+  uint32_t triangle_goal = (indices.size() - target_index_count) / 3;
+  uint32_t removed = 0;
+  for (const Collapse& collapse : collapses) {
+    if (removed >= triangle_goal)
+      break;
+
+    if (locked[collapse.from] || locked[collapse.to])
+      continue;
+
+    if (!KeepsTopology(*context, collapse.from, collapse.to) ||
+        FlipsTriangles(*context, collapse.from, collapse.to)) {
+      continue;
+    }
+
+    remap[collapse.from] = collapse.to;
+    Add(&context->quadrics[collapse.to], context->quadrics[collapse.from]);
+
+    ForEachTriangle(*context, collapse.from, [&](const uint32_t* tri) {
+      removed += tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to;
+      for (uint32_t v = 0; v < 3; v++) {
+        locked[tri[v]] = 1;
+      }
+    });
+
+    *error = Max(*error, collapse.cost);
+  }
+
+  // Remove the triangles that degenerated.
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < indices.size(); i += 3) {
+    uint32_t a = remap[indices[i + 0]];
+    uint32_t b = remap[indices[i + 1]];
+    uint32_t c = remap[indices[i + 2]];
+    if (a == b || b == c || a == c)
+      continue;
+
+    indices[count++] = a;
+    indices[count++] = b;
+    indices[count++] = c;
+  }
+
+  uint32_t removed_triangles = (indices.size() - count) / 3;
+  indices.resize(count);
+  return removed_triangles;
+}
+
+void CopyUsedVertices(const Mesh& mesh, const std::vector<uint32_t>& indices, Mesh* out) {
+  std::vector<uint32_t> new_indices(mesh.vertex_count, UINT32_MAX);
+  for (uint32_t index : indices) {
+    new_indices[index] = 0;
+  }
+
+  // Keep the original order, which is normally already cache friendly.
+  uint32_t vertex_count = 0;
+  for (uint32_t& index : new_indices) {
+    if (index != UINT32_MAX)
+      index = vertex_count++;
+  }
+
+  uint32_t stride = ToSize(mesh.vertex_type);
+  out->vertices.resize(vertex_count * stride);
+  for (uint32_t i = 0; i < mesh.vertex_count; i++) {
+    if (new_indices[i] != UINT32_MAX)
+      memcpy(out->vertices.data() + new_indices[i] * stride, mesh.vertices.data() + i * stride,
+             stride);
+  }
+  out->vertex_count = vertex_count;
+
+  out->index_format = SelectIndexFormat(vertex_count);
+  IndexSpan span = AppendIndices(out, indices.size());
+  for (uint32_t i = 0; i < indices.size(); i++) {
+    span.Set(i, new_indices[indices[i]]);
+  }
+}
+
+}  // namespace
+
+bool SimplifyMesh(const Mesh& mesh, const SimplifyOptions& options, Mesh* out, float* out_error) {
+  SimplifyContext context = {};
+  if (!GetVertexPositions(mesh, &context.positions)) {
+    WARNING(Model, "Mesh %s: Cannot simplify, no positions.", mesh.name.c_str());
+    return false;
+  }
+
+  if (mesh.index_count % 3 != 0 ||
+      mesh.indices.size() < (size_t)mesh.index_count * ToSize(mesh.index_format)) {
+    WARNING(Model, "Mesh %s: Cannot simplify, not a triangle list.", mesh.name.c_str());
+    return false;
+  }
+
+  // Work with normalized positions so the errors don't depend on the size of the mesh.
+  Vec3 min = context.positions.empty() ? Vec3{} : context.positions.front();
+  Vec3 max = min;
+  for (const Vec3& p : context.positions) {
+    min = Min(min, p);
+    max = Max(max, p);
+  }
+  Vec3 center = (min + max) * 0.5f;
+  float radius = Length(max - min) * 0.5f;
+  float scale = radius > 0 ? 1.0f / radius : 1.0f;
+  for (Vec3& p : context.positions) {
+    p = (p - center) * scale;
+  }
+
+  context.indices.resize(mesh.index_count);
+  for (uint32_t i = 0; i < mesh.index_count; i++) {
+    context.indices[i] = GetIndex(mesh, i);
+  }
+
+  WeldPositions(&context);
+  CountEdges(&context);
+  ClassifyVertices(&context);
+  ComputeQuadrics(&context);
+
+  float max_cost = options.max_error * options.max_error;
+  float error = 0;
+  while (context.indices.size() > options.target_index_count) {
+    if (SimplifyPass(&context, options.target_index_count, max_cost, &error) == 0)
+      break;
+  }
+
+  Reset(out);
+  out->name = mesh.name;
+  out->vertex_type = mesh.vertex_type;
+  out->usage = mesh.usage;
+  out->cpu_data_policy = mesh.cpu_data_policy;
+  out->dequantization = mesh.dequantization;
+  CopyUsedVertices(mesh, context.indices, out);
+
+  if (out_error)
+    *out_error = sqrtf(error);
+  return true;
+}
+
+}  // namespace rothko
@@ -0,0 +1,35 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace rothko {
+
+struct Mesh;
+
+// Mesh Simplification -----------------------------------------------------------------------------
+//
+// Reduces the triangle count of a mesh by collapsing edges, cheapest first, using the quadric error
+// metric (Garland & Heckbert 97) as cost. Vertices are only ever merged into other existing
+// vertices, so all their attributes stay valid and the output uses a subset of the input vertices.
+//
+// Vertices on open borders only slide along the border, and vertices on attribute seams (same
+// position, different vertex, eg. a UV discontinuity) are never moved so the seams don't open.
+
+struct SimplifyOptions {
+  // Stops once the mesh has this many indices or less.
+  uint32_t target_index_count = 0;
+
+  // Collapses that would move the surface more than this are not done, even if that means not
+  // reaching |target_index_count|. Relative to the radius of the bounds of the mesh.
+  float max_error = 0.01f;
+};
+
+// |mesh| must be a triangle list with CPU data and 3d positions (see |GetVertexPositions|).
+// |out| gets the same vertex type, usage and CPU data policy, with only the vertices still in use.
+// |out_error| gets the error of the result, in the same units as |SimplifyOptions::max_error|.
+bool SimplifyMesh(const Mesh& mesh, const SimplifyOptions&, Mesh* out, float* out_error = nullptr);
+
+}  // namespace rothko
@@ -47,6 +47,14 @@ namespace {
 bool IsDir(const std::filesystem::path& path, bool* error = nullptr) {
   std::error_code err;
   bool is_dir = std::filesystem::is_directory(path, err);
+
+  // A missing path is simply not a directory.
+  if (err == std::errc::no_such_file_or_directory) {
+    if (error)
+      *error = false;
+    return false;
+  }
+
   if (err) {
     fprintf(stderr, "Could not open %s: %s.\n", path.string().c_str(), err.message().c_str());
     if (error)
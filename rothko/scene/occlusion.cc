@@ -0,0 +1,385 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/scene/occlusion.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <thread>
+
+#include "rothko/graphics/mesh.h"
+#include "rothko/logging/logging.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROTHKO_OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#else
+#define ROTHKO_OCCLUSION_SSE2 0
+#endif
+
+namespace rothko {
+
+bool CreateOccluderMesh(const Mesh& mesh, OccluderMesh* out) {
+  if (!GetVertexPositions(mesh, &out->positions))
+    return false;
+
+  if (mesh.indices.size() < (size_t)mesh.index_count * ToSize(mesh.index_format))
+    return false;
+
+  out->indices.resize(mesh.index_count);
+  for (uint32_t i = 0; i < mesh.index_count; i++) {
+    out->indices[i] = GetIndex(mesh, i);
+  }
+
+  return true;
+}
+
+void InitOcclusionCuller(OcclusionCuller* culler, Int2 size, uint32_t worker_count) {
+  ASSERT(size.x > 0 && size.y > 0);
+  culler->size = {(size.x + 3) & ~3, size.y};
+  culler->worker_count = worker_count > 0 ? worker_count : 1;
+
+  culler->levels.clear();
+  Int2 level_size = culler->size;
+  while (true) {
+    DepthLevel level = {};
+    level.size = level_size;
+    level.depth.resize(level_size.x * level_size.y, 1.0f);
+    culler->levels.push_back(std::move(level));
+
+    if (level_size.x == 1 && level_size.y == 1)
+      break;
+    level_size = {Max((level_size.x + 1) / 2, 1), Max((level_size.y + 1) / 2, 1)};
+  }
+
+  culler->triangle_count = 0;
+}
+
+void BeginOcclusionFrame(OcclusionCuller* culler, const Mat4& view_projection) {
+  culler->view_projection = view_projection;
+  culler->occluders.clear();
+  culler->triangle_count = 0;
+}
+
+void AddOccluder(OcclusionCuller* culler, const OccluderMesh& mesh, const Mat4& transform) {
+  OcclusionCuller::Occluder occluder = {};
+  occluder.mesh = &mesh;
+  occluder.transform = transform;
+  culler->occluders.push_back(std::move(occluder));
+}
+
+// Triangle Setup ----------------------------------------------------------------------------------
+
+namespace {
+
+// Distance to the near plane (z = -w in OpenGL clip space).
+inline float NearDistance(const Vec4& v) { return v.z + v.w; }
+
+inline Vec4 Interpolate(const Vec4& a, const Vec4& b, float t) { return a + (b - a) * t; }
+
+void PushScreenTriangle(OcclusionCuller* culler, const Vec4& c0, const Vec4& c1, const Vec4& c2) {
+  Vec4 clip[3] = {c0, c1, c2};
+  float screen[9];
+  for (int i = 0; i < 3; i++) {
+    float inv_w = 1.0f / clip[i].w;
+    screen[i * 3 + 0] = (clip[i].x * inv_w * 0.5f + 0.5f) * culler->size.x;
+    screen[i * 3 + 1] = (clip[i].y * inv_w * 0.5f + 0.5f) * culler->size.y;
+    screen[i * 3 + 2] = clip[i].z * inv_w * 0.5f + 0.5f;
+  }
+
+  // Both faces are rasterized, so make every triangle counter-clockwise.
+  float area = (screen[3] - screen[0]) * (screen[7] - screen[1]) -
+               (screen[6] - screen[0]) * (screen[4] - screen[1]);
+  if (fabsf(area) < 1e-6f)
+    return;
+
+  if (area < 0) {
+    for (int i = 0; i < 3; i++) {
+      float tmp = screen[3 + i];
+      screen[3 + i] = screen[6 + i];
+      screen[6 + i] = tmp;
+    }
+  }
+
+  culler->triangles.insert(culler->triangles.end(), screen, screen + 9);
+}
+
+// Clips against the near plane, which can turn the triangle into a quad.
+void SetupTriangle(OcclusionCuller* culler, const Vec4& c0, const Vec4& c1, const Vec4& c2) {
+  // Trivially outside of one of the side planes.
+  for (int axis = 0; axis < 2; axis++) {
+    float a = c0.elements[axis], b = c1.elements[axis], c = c2.elements[axis];
+    if ((a > c0.w && b > c1.w && c > c2.w) || (a < -c0.w && b < -c1.w && c < -c2.w))
+      return;
+  }
+
+  float d[3] = {NearDistance(c0), NearDistance(c1), NearDistance(c2)};
+  if (d[0] >= 0 && d[1] >= 0 && d[2] >= 0) {
+    PushScreenTriangle(culler, c0, c1, c2);
+    return;
+  }
+
+  if (d[0] < 0 && d[1] < 0 && d[2] < 0)
+    return;
+
+  const Vec4* in[3] = {&c0, &c1, &c2};
+  Vec4 out[4];
+  int count = 0;
+  for (int i = 0; i < 3; i++) {
+    int j = (i + 1) % 3;
+    if (d[i] >= 0)
+      out[count++] = *in[i];
+    if ((d[i] >= 0) != (d[j] >= 0))
+      out[count++] = Interpolate(*in[i], *in[j], d[i] / (d[i] - d[j]));
+  }
+
+  for (int i = 2; i < count; i++) {
+    PushScreenTriangle(culler, out[0], out[i - 1], out[i]);
+  }
+}
+
+}  // namespace
+
+// Rasterization -----------------------------------------------------------------------------------
+
+namespace {
+
+// Edge function of a -> b, positive on the left side (inside of a counter-clockwise triangle).
+// E(x, y) = a * x + b * y + c.
+struct Edge {
+  float a, b, c;
+};
+
+inline Edge CreateEdge(const float* v0, const float* v1) {
+  Edge edge;
+  edge.a = -(v1[1] - v0[1]);
+  edge.b = v1[0] - v0[0];
+  edge.c = -edge.a * v0[0] - edge.b * v0[1];
+  return edge;
+}
+
+// Rasterizes the rows [y_min, y_max) of the depth buffer, keeping the nearest depth.
+void RasterizeBand(OcclusionCuller* culler, int y_min, int y_max) {
+  DepthLevel* level = &culler->levels[0];
+  Int2 size = level->size;
+
+  for (int y = y_min; y < y_max; y++) {
+    float* row = level->depth.data() + y * size.x;
+    for (int x = 0; x < size.x; x++) {
+      row[x] = 1.0f;
+    }
+  }
+
+  const float* triangles = culler->triangles.data();
+  uint32_t triangle_count = (uint32_t)culler->triangles.size() / 9;
+  for (uint32_t t = 0; t < triangle_count; t++) {
+    const float* v0 = triangles + t * 9;
+    const float* v1 = v0 + 3;
+    const float* v2 = v0 + 6;
+
+    // Pixels whose center is within the bounding box.
+    float min_x = Min(v0[0], Min(v1[0], v2[0]));
+    float max_x = Max(v0[0], Max(v1[0], v2[0]));
+    float min_y = Min(v0[1], Min(v1[1], v2[1]));
+    float max_y = Max(v0[1], Max(v1[1], v2[1]));
+
+    int x0 = Max((int)ceilf(min_x - 0.5f), 0);
+    int x1 = Min((int)floorf(max_x - 0.5f), size.x - 1);
+    int y0 = Max((int)ceilf(min_y - 0.5f), y_min);
+    int y1 = Min((int)floorf(max_y - 0.5f), y_max - 1);
+    if (x0 > x1 || y0 > y1)
+      continue;
+
+    // Rows are processed 4 pixels at a time. The width is a multiple of 4, so this never
+    // overflows the row.
+    x0 &= ~3;
+
+    Edge e0 = CreateEdge(v1, v2);
+    Edge e1 = CreateEdge(v2, v0);
+    Edge e2 = CreateEdge(v0, v1);
+
+    // The depth (already divided by w) is linear in screen space, so it interpolates with the same
+    // barycentrics as the edge functions.
+    float area = e2.a * v2[0] + e2.b * v2[1] + e2.c;
+    float inv_area = 1.0f / area;
+    float dz_dx = (e0.a * v0[2] + e1.a * v1[2] + e2.a * v2[2]) * inv_area;
+    float dz_dy = (e0.b * v0[2] + e1.b * v1[2] + e2.b * v2[2]) * inv_area;
+    float z_c = (e0.c * v0[2] + e1.c * v1[2] + e2.c * v2[2]) * inv_area;
+
+#if ROTHKO_OCCLUSION_SSE2
+    const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 e0_a = _mm_set1_ps(e0.a), e1_a = _mm_set1_ps(e1.a), e2_a = _mm_set1_ps(e2.a);
+    const __m128 z_dx = _mm_set1_ps(dz_dx);
+#endif
+
+    for (int y = y0; y <= y1; y++) {
+      float py = (float)y + 0.5f;
+      float* row = level->depth.data() + y * size.x;
+
+      // Per row constants.
+      float r0 = e0.b * py + e0.c;
+      float r1 = e1.b * py + e1.c;
+      float r2 = e2.b * py + e2.c;
+      float rz = dz_dy * py + z_c;
+
+#if ROTHKO_OCCLUSION_SSE2
+      const __m128 r0_v = _mm_set1_ps(r0), r1_v = _mm_set1_ps(r1), r2_v = _mm_set1_ps(r2);
+      const __m128 rz_v = _mm_set1_ps(rz);
+      for (int x = x0; x <= x1; x += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane_offsets);
+        __m128 w0 = _mm_add_ps(_mm_mul_ps(e0_a, px), r0_v);
+        __m128 w1 = _mm_add_ps(_mm_mul_ps(e1_a, px), r1_v);
+        __m128 w2 = _mm_add_ps(_mm_mul_ps(e2_a, px), r2_v);
+        __m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+                                 _mm_cmpge_ps(w2, zero));
+        if (_mm_movemask_ps(mask) == 0)
+          continue;
+
+        __m128 z = _mm_add_ps(_mm_mul_ps(z_dx, px), rz_v);
+        __m128 depth = _mm_loadu_ps(row + x);
+        __m128 nearest = _mm_min_ps(depth, z);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearest), _mm_andnot_ps(mask, depth)));
+      }
+#else
+      for (int x = x0; x <= x1; x++) {
+        float px = (float)x + 0.5f;
+        if (e0.a * px + r0 < 0 || e1.a * px + r1 < 0 || e2.a * px + r2 < 0)
+          continue;
+
+        float z = dz_dx * px + rz;
+        if (z < row[x])
+          row[x] = z;
+      }
+#endif
+    }
+  }
+}
+
+// Each texel gets the farthest of the (up to) 2x2 texels it covers in the previous level.
+void BuildDepthLevel(const DepthLevel& src, DepthLevel* dst) {
+  for (int y = 0; y < dst->size.y; y++) {
+    int sy0 = y * 2;
+    int sy1 = Min(sy0 + 1, src.size.y - 1);
+    const float* row0 = src.depth.data() + sy0 * src.size.x;
+    const float* row1 = src.depth.data() + sy1 * src.size.x;
+    float* out = dst->depth.data() + y * dst->size.x;
+
+    for (int x = 0; x < dst->size.x; x++) {
+      int sx0 = x * 2;
+      int sx1 = Min(sx0 + 1, src.size.x - 1);
+      out[x] = Max(Max(row0[sx0], row0[sx1]), Max(row1[sx0], row1[sx1]));
+    }
+  }
+}
+
+}  // namespace
+
+void RasterizeOccluders(OcclusionCuller* culler) {
+  ASSERT_MSG(!culler->levels.empty(), "Occlusion culler not initialized.");
+
+  culler->triangles.clear();
+  for (const OcclusionCuller::Occluder& occluder : culler->occluders) {
+    const OccluderMesh& mesh = *occluder.mesh;
+    Mat4 mvp = culler->view_projection * occluder.transform;
+
+    culler->clip_positions.resize(mesh.positions.size());
+    for (size_t i = 0; i < mesh.positions.size(); i++) {
+      culler->clip_positions[i] = mvp * mesh.positions[i];
+    }
+
+    const Vec4* clip = culler->clip_positions.data();
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+      SetupTriangle(culler, clip[mesh.indices[i]], clip[mesh.indices[i + 1]],
+                    clip[mesh.indices[i + 2]]);
+    }
+  }
+  culler->triangle_count = (uint32_t)culler->triangles.size() / 9;
+
+  // Each worker owns a band of rows, so they never write to the same pixels.
+  int height = culler->size.y;
+  int band_count = Min((int)culler->worker_count, height);
+  int band_height = (height + band_count - 1) / band_count;
+
+  std::vector<std::thread> workers;
+  for (int band = 1; band < band_count; band++) {
+    int y_min = band * band_height;
+    int y_max = Min(y_min + band_height, height);
+    if (y_min >= y_max)
+      break;
+    workers.emplace_back(RasterizeBand, culler, y_min, y_max);
+  }
+  RasterizeBand(culler, 0, Min(band_height, height));
+
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  for (size_t i = 1; i < culler->levels.size(); i++) {
+    BuildDepthLevel(culler->levels[i - 1], &culler->levels[i]);
+  }
+}
+
+// Testing -----------------------------------------------------------------------------------------
+
+bool IsOccluded(const OcclusionCuller& culler, const Bounds& bounds, const Mat4& transform) {
+  if (culler.levels.empty() || culler.triangle_count == 0)
+    return false;
+
+  Mat4 mvp = culler.view_projection * transform;
+
+  Vec2 screen_min = {FLT_MAX, FLT_MAX};
+  Vec2 screen_max = {-FLT_MAX, -FLT_MAX};
+  float nearest = FLT_MAX;
+  for (int i = 0; i < 8; i++) {
+    Vec3 corner = {(i & 1) ? bounds.max.x : bounds.min.x,
+                   (i & 2) ? bounds.max.y : bounds.min.y,
+                   (i & 4) ? bounds.max.z : bounds.min.z};
+    Vec4 clip = mvp * corner;
+
+    // Behind the camera: the bounds cross the near plane.
+    if (clip.w <= 1e-5f)
+      return false;
+
+    float inv_w = 1.0f / clip.w;
+    Vec2 screen = {(clip.x * inv_w * 0.5f + 0.5f) * culler.size.x,
+                   (clip.y * inv_w * 0.5f + 0.5f) * culler.size.y};
+    screen_min = Min(screen_min, screen);
+    screen_max = Max(screen_max, screen);
+    nearest = Min(nearest, clip.z * inv_w * 0.5f + 0.5f);
+  }
+
+  // Out of the screen is for frustum culling to decide.
+  if (screen_max.x < 0 || screen_max.y < 0 ||
+      screen_min.x > culler.size.x || screen_min.y > culler.size.y) {
+    return false;
+  }
+
+  int x0 = Max((int)screen_min.x, 0);
+  int y0 = Max((int)screen_min.y, 0);
+  int x1 = Min((int)screen_max.x, culler.size.x - 1);
+  int y1 = Min((int)screen_max.y, culler.size.y - 1);
+
+  // Use the level where the rect covers at most 2x2 texels.
+  int extent = Max(x1 - x0, y1 - y0) + 1;
+  int level_index = 0;
+  while ((1 << level_index) < extent && level_index + 1 < (int)culler.levels.size()) {
+    level_index++;
+  }
+
+  const DepthLevel& level = culler.levels[level_index];
+  x0 >>= level_index; x1 >>= level_index;
+  y0 >>= level_index; y1 >>= level_index;
+  for (int y = y0; y <= y1; y++) {
+    const float* row = level.depth.data() + y * level.size.x;
+    for (int x = x0; x <= x1; x++) {
+      if (row[x] >= nearest)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace rothko
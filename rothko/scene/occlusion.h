@@ -0,0 +1,93 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "rothko/math/math.h"
+
+namespace rothko {
+
+struct Mesh;
+
+// Software Occlusion Culling ----------------------------------------------------------------------
+//
+// A small set of designated occluders (walls, floors, big props; normally simplified versions of
+// the real meshes) is rasterized on the CPU into a low resolution depth buffer. A hierarchical-Z
+// pyramid is built from it, where each texel holds the *farthest* depth of the texels it covers.
+// Bounds can then be tested against it with a handful of reads: if the nearest point of the bounds
+// is behind the farthest occluder depth in the area they cover, they are fully hidden.
+//
+// The test is conservative: anything that is not certainly hidden (crossing the near plane,
+// outside of the screen, no occluder data) is reported as visible.
+//
+// Usage per frame:
+//
+//   BeginOcclusionFrame(&culler, projection * view);
+//   for (...) AddOccluder(&culler, occluder_mesh, world_matrix);
+//   RasterizeOccluders(&culler);
+//   for (...) if (IsOccluded(culler, primitive.bounds, world_matrix)) continue;
+
+// Positions and triangles of a mesh used as an occluder, in the mesh local space.
+struct OccluderMesh {
+  std::vector<Vec3> positions;
+  std::vector<uint32_t> indices;
+};
+
+// Extracts the geometry from the CPU data of |mesh|. Returns false if the mesh has no 3d positions
+// or its CPU data is not available (see |EnsureCPUData|).
+bool CreateOccluderMesh(const Mesh& mesh, OccluderMesh* out);
+
+// One level of the depth pyramid. Depth is in [0, 1], 1 being the far plane.
+struct DepthLevel {
+  Int2 size = {};
+  std::vector<float> depth;   // Row major, bottom row first (like OpenGL).
+};
+
+struct OcclusionCuller {
+  // Set by |InitOcclusionCuller|.
+  Int2 size = {};
+  uint32_t worker_count = 1;
+
+  // Level 0 is the rasterized depth buffer. Each next level is half the size.
+  std::vector<DepthLevel> levels;
+
+  // Per frame.
+  Mat4 view_projection = Mat4::Identity();
+
+  struct Occluder {
+    const OccluderMesh* mesh = nullptr;   // Not owning. Must outlive |RasterizeOccluders|.
+    Mat4 transform;
+  };
+  std::vector<Occluder> occluders;
+
+  // Scratch, kept between frames to avoid re-allocating.
+  std::vector<Vec4> clip_positions;
+  std::vector<float> triangles;   // 3 vertices of (x, y, depth) in screen space per triangle.
+
+  uint32_t triangle_count = 0;    // Rasterized last frame, for stats.
+};
+
+// |size| is the resolution of the depth buffer. It doesn't need to match the screen aspect ratio
+// exactly, but the closer it is, the more precise the test gets. The width is rounded up to a
+// multiple of 4, as rows are rasterized 4 pixels at a time.
+//
+// With |worker_count| > 1, the buffer is split in horizontal bands rasterized in parallel.
+void InitOcclusionCuller(OcclusionCuller*, Int2 size, uint32_t worker_count = 1);
+
+// Clears the occluders of the last frame.
+void BeginOcclusionFrame(OcclusionCuller*, const Mat4& view_projection);
+
+void AddOccluder(OcclusionCuller*, const OccluderMesh&, const Mat4& transform);
+
+// Rasterizes all the added occluders and builds the depth pyramid.
+void RasterizeOccluders(OcclusionCuller*);
+
+// Whether the |bounds|, given in the space described by |transform| (eg. |ModelPrimitive::bounds|
+// and the world matrix of the node), are certainly hidden behind the occluders.
+bool IsOccluded(const OcclusionCuller&, const Bounds& bounds, const Mat4& transform);
+
+}  // namespace rothko
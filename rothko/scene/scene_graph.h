@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "rothko/memory/memory_tracker.h"
 #include "rothko/scene/transform.h"
 
 namespace rothko {
@@ -20,7 +21,7 @@ struct SceneNode {
 
   static constexpr uint32_t kDirtyFlag = (1 << 0);
 
-  std::vector<uint32_t> children;
+  TaggedVector<uint32_t, MemoryTag::kScene> children;
 
   Transform transform;
 };
@@ -41,6 +42,8 @@ SceneNode* GetParent(SceneGraph*, SceneNode*);
 constexpr uint64_t kSceneGraphSize = 8192;
 
 struct SceneGraph {
+  TAGGED_NEW_DELETE(kScene);
+
   SceneNode base_node = {};
   SceneNode nodes[kSceneGraphSize];
 
@@ -38,18 +38,25 @@ bool CreateMesh(Renderer* renderer, ImguiRenderer* imgui) {
   Mesh imgui_mesh;
   imgui_mesh.name = "Imgui Mesh";
   imgui_mesh.vertex_type = VertexType::k2dUVColor;
+  imgui_mesh.usage = MeshUsage::kDynamic;   // Rebuilt every frame.
 
-  // A imgui vertex is 20 bytes. An index is 4 bytes.
+  // A imgui vertex is 20 bytes. An index is 2 bytes.
   //
   // 2048 kb / 20 = 104857 vertices.
-  // 1024 kb / 4 = 262144 indices.
+  // 1024 kb / 2 = 524288 indices.
   //
   // We reserve this size when staging the mesh, as we're going to re-upload pieces of this buffer
   // each time, and we don't want to be re-allocating the buffer each time.
+  //
+  // Imgui indices are 16-bit and relative to each draw list, so we keep them as is and offset with
+  // the base vertex of each draw instead.
+  static_assert(sizeof(ImDrawIdx) == 2);
   uint32_t vertex_count = KILOBYTES(2048) / sizeof(Vertex2dUVColor);
-  uint32_t index_count = KILOBYTES(1024) / sizeof(Mesh::IndexType);
-  if (!StageWithCapacity(renderer, &imgui_mesh, VertexType::k2dUVColor, vertex_count, index_count))
+  uint32_t index_count = KILOBYTES(1024) / sizeof(ImDrawIdx);
+  if (!StageWithCapacity(renderer, &imgui_mesh, VertexType::k2dUVColor, vertex_count, index_count,
+                         IndexFormat::kUint16)) {
     return false;
+  }
 
   imgui->mesh = std::move(imgui_mesh);
   return true;
@@ -72,11 +79,31 @@ bool CreateFontTexture(Renderer* renderer, ImguiRenderer* imgui) {
   texture.size = {width, height};
 
   uint32_t data_size = width * height * 4;
-  texture.data = std::make_unique<uint8_t[]>(data_size);
+  texture.data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(data_size);
   memcpy(texture.data.get(), pixels, data_size);
+
+  // Imgui re-builds the atlas if its pixels were cleared.
+  ImGuiIO* io = imgui->io;
+  texture.reload_cpu_data = [io](Texture* font) {
+    uint8_t* font_pixels;
+    int font_width, font_height;
+    io->Fonts->GetTexDataAsRGBA32(&font_pixels, &font_width, &font_height);
+    if (font_width != font->size.width || font_height != font->size.height)
+      return false;
+
+    uint32_t font_size = font_width * font_height * 4;
+    font->data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(font_size);
+    memcpy(font->data.get(), font_pixels, font_size);
+    return true;
+  };
+
   if (!RendererStageTexture(renderer, &texture))
     return false;
 
+  // If our copy got evicted, imgui's copy is not needed either.
+  if (!Loaded(texture))
+    io->Fonts->ClearTexData();
+
   // Imgui wants a way of tracking the font texture id to relay it back to use on render time.
   imgui->font_texture = std::move(texture);
   imgui->io->Fonts->TexID = (ImTextureID)&imgui->font_texture;
@@ -153,30 +180,9 @@ PerFrameVector<RenderCommand> ImguiGetRenderCommands(ImguiRenderer* imgui_render
     PushVertices(&imgui_renderer->mesh, (Vertex2dUVColor*)cmd_list->VtxBuffer.Data,
                                         cmd_list->VtxBuffer.Size);
 
-    // Because each draw command is isolated, it's necessary to offset each index by their right
-    // place within the vertex buffer.
-    //
-    // NOTE: Imgui doesn't have a good way of changing it's index size and compile straight out of
-    //       bat. Here we do the transformation from 16-bit indexs to our 32-bit manually, but
-    //       normally PushIndices should work.
-    static_assert(sizeof(ImDrawIdx) == 2);
-    auto& mesh = imgui_renderer->mesh;
-
-
-    mesh.indices.reserve((mesh.indices.size() + cmd_list->IdxBuffer.Size));
-    for (int ii = 0; ii < cmd_list->IdxBuffer.Size; ii++) {
-      // NOTE: |mesh.indices| is a uint8_t array, so we need to decompose the value into a series of
-      //       bytes that we can append to the indices.
-      Mesh::IndexType val = cmd_list->IdxBuffer[ii] + base_vertex_offset;
-      mesh.indices.push_back(val);
-    }
-
-
-      /* uint8_t* tmp = (uint8_t*)&val; */
-      /* uint8_t* tmp_end = (uint8_t*)(&val + 1); */
-      /* mesh.indices.insert(mesh.indices.end(), tmp, tmp_end); */
-    /* } */
-    /* mesh.index_count += cmd_list->IdxBuffer.Size; */
+    // Each draw list indexes its own vertices, so they are copied as is (16-bit to 16-bit) and
+    // the draws use |base_vertex| to point to the right place within the vertex buffer.
+    PushIndices(&imgui_renderer->mesh, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size);
 
     // This will start appending drawing data into the mesh buffer that's already staged into the
     // renderer.
@@ -192,6 +198,7 @@ PerFrameVector<RenderCommand> ImguiGetRenderCommands(ImguiRenderer* imgui_render
 
       render_mesh.indices_offset = base_index_offset + index_offset;
       render_mesh.indices_count = draw_cmd->ElemCount;
+      render_mesh.base_vertex = base_vertex_offset;
 
       /* render_mesh.vert_ubo_data = (uint8_t*)&imgui_renderer->ubo; */
       render_mesh.flags = kBlendEnabled | kScissorTest;
@@ -212,7 +219,7 @@ PerFrameVector<RenderCommand> ImguiGetRenderCommands(ImguiRenderer* imgui_render
 
       render_commands.push_back(std::move(render_mesh));
 
-      index_offset += draw_cmd->ElemCount * sizeof(Mesh::IndexType);
+      index_offset += draw_cmd->ElemCount * sizeof(ImDrawIdx);
       /* index_offset += draw_cmd->ElemCount; */
     }
 
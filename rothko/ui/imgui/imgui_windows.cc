@@ -3,6 +3,9 @@
 
 #include "rothko/ui/imgui/imgui_windows.h"
 
+#include <inttypes.h>
+
+#include "rothko/memory/memory_tracker.h"
 #include "rothko/ui/imgui.h"
 
 namespace rothko {
@@ -13,6 +16,20 @@ void CreateLogWindow() {
 
   ImGui::Begin("Logs", nullptr);
 
+  // Runtime thresholds per category.
+  if (ImGui::CollapsingHeader("Filters")) {
+    const char* severities[] = {ToString(LogSeverity::kInfo),
+                                ToString(LogSeverity::kWarning),
+                                ToString(LogSeverity::kError),
+                                ToString(LogSeverity::kAssert)};
+    for (int i = 0; i < (int)LogCategory::kLast; i++) {
+      LogCategory category = (LogCategory)i;
+      int threshold = (int)GetLogThreshold(category);
+      if (ImGui::Combo(ToString(category), &threshold, severities, ARRAY_SIZE(severities)))
+        SetLogThreshold(category, (LogSeverity)threshold);
+    }
+  }
+
   ImGui::BeginChild("Logchild");
 
   auto& logs = GetLogs();
@@ -22,18 +39,23 @@ void CreateLogWindow() {
       "%15s | %10s | %25s | %4s | %25s | MESSAGE", "TIME", "CATEGORY", "FILE", "LINE", "FUNCTION");
   ImGui::Separator();
 
-  int write_index = logs.write_index;
+  uint64_t dropped = logs.dropped_messages;
+  if (dropped > 0)
+    ImGui::TextColored({1.0f, 1.0f, 0.0f, 1.0f}, "Dropped messages: %" PRIu64, dropped);
+
+  int64_t write_index = logs.write_index;
   if (write_index == 0)
     return;
-  int read_index = write_index - LogContainer::kMaxEntries;
+  int64_t read_index = write_index - LogContainer::kMaxEntries;
   if (read_index < 0)
     read_index = 0;
 
   // Write the last one first.
-  for (int i = write_index - 1; i >= read_index; i--) {
-    auto& entry = logs.entries[i % LogContainer::kMaxEntries];
-    /* if (entry.log_time.nanos > last_nano) */
-    /*   continue; */
+  LogEntry entry;
+  for (int64_t i = write_index - 1; i >= read_index; i--) {
+    // Entries being written (or overwritten) at this moment are skipped.
+    if (!ReadLogEntry(logs, i, &entry))
+      continue;
 
     ImVec4 color = {1.0f, 1.0f, 1.0f, 1.0f};
     if (entry.severity == LogSeverity::kWarning) {
@@ -53,12 +75,42 @@ void CreateLogWindow() {
                        entry.location.file,
                        entry.location.line,
                        entry.location.function,
-                       entry.msg.c_str());
+                       entry.msg);
   }
 
   ImGui::EndChild();
   ImGui::End();
 }
 
+void CreateMemoryWindow() {
+  ImGui::Begin("Memory", nullptr);
+
+  ImGui::Text("%10s | %14s | %14s | %12s | %12s",
+              "TAG", "LIVE (KB)", "PEAK (KB)", "LIVE ALLOCS", "TOTAL ALLOCS");
+  ImGui::Separator();
+
+  for (int i = 0; i < (int)MemoryTag::kLast; i++) {
+    MemoryTagStats stats = GetMemoryStats((MemoryTag)i);
+    ImGui::Text("%10s | %14.2f | %14.2f | %12" PRId64 " | %12" PRId64,
+                ToString((MemoryTag)i),
+                stats.live_bytes / 1024.0f,
+                stats.peak_bytes / 1024.0f,
+                stats.live_allocations,
+                stats.total_allocations);
+  }
+
+  ImGui::Separator();
+
+  static char path[256] = "memory_stats.txt";
+  ImGui::InputText("##dump_path", path, sizeof(path));
+  ImGui::SameLine();
+  if (ImGui::Button("Dump to file")) {
+    if (!DumpMemoryStats(path))
+      WARNING(App, "Could not dump memory stats to %s", path);
+  }
+
+  ImGui::End();
+}
+
 }  // namespace imgui
 }  // namespace rothko
@@ -11,5 +11,8 @@ namespace imgui {
 // TODO(Cristian): Pass in somw configuration.
 void CreateLogWindow();
 
+// Shows the per-tag memory stats (see rothko/memory/memory_tracker.h).
+void CreateMemoryWindow();
+
 }  // namespace imgui
 }  // namespace rothko
@@ -97,11 +97,18 @@ FileHandle::~FileHandle() {
     CloseFile(this);
 }
 
-FileHandle OpenFile(const std::string& path, bool append) {
-  FileHandle handle;
+FileHandle OpenFile(const std::string& path, bool append, bool binary) {
+  FileHandle handle = {};
+
+  const char* mode = nullptr;
+  if (binary) {
+    mode = append ? "ab" : "wb+";
+  } else {
+    mode = append ? "a" : "w+";
+  }
 
   auto trimmed_path = Trim(path, kCharsToTrim);
-  FILE* file = fopen(trimmed_path.c_str(), append ? "a" : "w+");
+  FILE* file = fopen(trimmed_path.c_str(), mode);
   if (file == NULL) {
     printf("Could not open file %s: %s\n", trimmed_path.c_str(), strerror(errno));
     fflush(stdout);
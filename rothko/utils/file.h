@@ -25,7 +25,7 @@ struct FileHandle {
 };
 inline bool Valid(const FileHandle& file) { return file.hndl.has_value(); }
 
-FileHandle OpenFile(const std::string& path, bool append = false);
+FileHandle OpenFile(const std::string& path, bool append = false, bool binary = false);
 
 // Returns how much bytes were written.
 uint32_t WriteToFile(FileHandle*, void* data, size_t size);
@@ -69,7 +69,7 @@ bool Init(Grid* grid, Renderer* renderer, const Shader* shader) {
   grid->render_command.mesh = &grid->mesh;
   grid->render_command.shader = shader;
   grid->render_command.flags = kBlendEnabled | kDepthTest;
-  grid->render_command.indices_count = grid->mesh.indices.size();
+  grid->render_command.indices_count = grid->mesh.index_count;
 
   return true;
 }
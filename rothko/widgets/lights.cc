@@ -215,7 +215,7 @@ std::vector<RenderCommand> GetRenderCommands(const LightWidgetManager& lights) {
     render_mesh.mesh = &lights.point_light_mesh;
     render_mesh.shader = lights.point_light_shader;
     render_mesh.primitive_type = PrimitiveType::kTriangles;
-    render_mesh.indices_count = lights.point_light_mesh.indices.size();
+    render_mesh.indices_count = lights.point_light_mesh.index_count;
     render_mesh.ubo_data[0] = (uint8_t*)&light.transform->world_matrix;
     render_mesh.ubo_data[1] = (uint8_t*)&light.color;
 
@@ -228,7 +228,7 @@ std::vector<RenderCommand> GetRenderCommands(const LightWidgetManager& lights) {
     render_mesh.mesh = &lights.directional_light_mesh;
     render_mesh.shader = lights.directional_light_shader;
     render_mesh.primitive_type = PrimitiveType::kLineStrip;
-    render_mesh.indices_count = lights.directional_light_mesh.indices.size();
+    render_mesh.indices_count = lights.directional_light_mesh.index_count;
     render_mesh.ubo_data[0] = (uint8_t*)&light.transform->world_matrix;
     render_mesh.ubo_data[1] = (uint8_t*)&light.color;
 
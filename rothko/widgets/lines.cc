@@ -3,6 +3,7 @@
 
 #include "rothko/widgets/lines.h"
 
+#include "rothko/logging/logging.h"
 #include "rothko/utils/strings.h"
 
 namespace rothko {
@@ -55,7 +56,7 @@ constexpr char kLineShaderName[] = "default-line-shader";
 
 }  // namespace
 
-bool Init(LineManager* lines, Renderer* renderer, const std::string& name, uint32_t line_count) {
+bool Init(LineManager* lines, Renderer* renderer, const std::string& name, uint32_t shape_count) {
   // See if we can get the shader.
   const Shader* shader = RendererGetShader(renderer, kLineShaderName);
   if (!shader) {
@@ -67,23 +68,23 @@ bool Init(LineManager* lines, Renderer* renderer, const std::string& name, uint3
     shader = default_shader.get();
   }
 
-  return Init(lines, renderer, shader, name, line_count);
+  return Init(lines, renderer, shader, name, shape_count);
 }
 
 bool Init(LineManager* lines, Renderer* renderer, const Shader* shader, const std::string& name,
-          uint32_t line_count) {
+          uint32_t shape_count) {
   ASSERT(!Valid(lines));
   lines->name = std::move(name);
   lines->shader = shader;
 
-  // Each vertex is 2 vertices.
-  // We asume one index per vertex. This might be less.
-  uint32_t vertex_count = 2 * line_count * sizeof(Vertex3dColor);
-  uint32_t index_count = 2 * line_count * sizeof(Mesh::IndexType);
+  // |StageWithCapacity| takes element counts, not bytes.
+  lines->vertex_capacity = shape_count * kMaxLineShapeVertexCount;
+  lines->index_capacity = shape_count * kMaxLineShapeIndexCount;
 
   lines->strip_mesh.name = StringPrintf("Line-Manager-%s-strip-mesh", name.c_str());
+  lines->strip_mesh.usage = MeshUsage::kDynamic;
   if (!StageWithCapacity(renderer, &lines->strip_mesh, VertexType::k3dColor,
-                         vertex_count, index_count)) {
+                         lines->vertex_capacity, lines->index_capacity)) {
     return false;
   }
 
@@ -103,12 +104,28 @@ void Reset(LineManager* lines) {
   Reset(&lines->strip_mesh);
   lines->staged = false;
   lines->shape_count = 0;
+  lines->dropped_shapes = 0;
   lines->render_command_.indices_count = 0;
 }
 
 bool Stage(LineManager* lines, Renderer* renderer) {
   if (lines->staged)
     return true;
+
+  if (lines->dropped_shapes > 0) {
+    WARNING(App, "%s: %d shapes did not fit (capacity: %u vertices, %u indices).",
+            lines->name.c_str(), lines->dropped_shapes, lines->vertex_capacity,
+            lines->index_capacity);
+  }
+
+  const Mesh& mesh = lines->strip_mesh;
+  if (mesh.vertex_count > lines->vertex_capacity || mesh.index_count > lines->index_capacity) {
+    WARNING(App, "%s: Mesh is over capacity (%u/%u vertices, %u/%u indices).",
+            lines->name.c_str(), mesh.vertex_count, lines->vertex_capacity, mesh.index_count,
+            lines->index_capacity);
+    return false;
+  }
+
   lines->staged = RendererUploadMeshRange(renderer, &lines->strip_mesh);
   return lines->staged;
 }
@@ -123,6 +140,18 @@ RenderCommand GetRenderCommand(const LineManager& lines) {
 
 namespace {
 
+bool Fits(LineManager* lines, uint32_t vertex_count, uint32_t index_count) {
+  ASSERT(vertex_count <= kMaxLineShapeVertexCount && index_count <= kMaxLineShapeIndexCount);
+  const Mesh& mesh = lines->strip_mesh;
+  if (mesh.vertex_count + vertex_count <= lines->vertex_capacity &&
+      mesh.index_count + index_count <= lines->index_capacity) {
+    return true;
+  }
+
+  lines->dropped_shapes++;
+  return false;
+}
+
 inline Vertex3dColor CreateVertex(Vec3 pos, Color color) {
   Vertex3dColor vertex = {};
   vertex.pos = pos;
@@ -133,50 +162,56 @@ inline Vertex3dColor CreateVertex(Vec3 pos, Color color) {
 
 }  // namespace
 
-void PushLine(LineManager* lines, Vec3 from, Vec3 to, Color color) {
-  Vertex3dColor vertices[2] = {
-    CreateVertex(from, color),
-    CreateVertex(to, color),
-  };
+bool PushLine(LineManager* lines, Vec3 from, Vec3 to, Color color) {
+  if (!Fits(lines, 2, 3))
+    return false;
 
-  Mesh::IndexType base = lines->strip_mesh.vertex_count;
-  Mesh::IndexType indices[3] = {base + 0, base + 1, line_strip::kPrimitiveReset};
+  auto vertices = AppendVertices<Vertex3dColor>(&lines->strip_mesh, 2);
+  vertices[0] = CreateVertex(from, color);
+  vertices[1] = CreateVertex(to, color);
 
-  PushVertices(&lines->strip_mesh, vertices, ARRAY_SIZE(vertices));
-  PushIndices(&lines->strip_mesh, indices, ARRAY_SIZE(indices));
+  Mesh::IndexType base = vertices.base;
+  auto indices = AppendIndices(&lines->strip_mesh, 3);
+  indices.Set(0, base + 0);
+  indices.Set(1, base + 1);
+  indices.Set(2, line_strip::kPrimitiveReset);
 
-  lines->render_command_.indices_count += ARRAY_SIZE(indices);
+  lines->render_command_.indices_count += indices.count;
   lines->staged = false;
   lines->shape_count++;
+  return true;
 }
 
-void PushCubeCenter(LineManager* lines, Vec3 c, Vec3 e, Color color) {
-  Vertex3dColor vertices[8] = {
-      CreateVertex(c + Vec3{-e.x, -e.y, -e.z}, color),
-      CreateVertex(c + Vec3{-e.x, -e.y, e.z}, color),
-      CreateVertex(c + Vec3{-e.x, e.y, -e.z}, color),
-      CreateVertex(c + Vec3{-e.x, e.y, e.z}, color),
-      CreateVertex(c + Vec3{e.x, -e.y, -e.z}, color),
-      CreateVertex(c + Vec3{e.x, -e.y, e.z}, color),
-      CreateVertex(c + Vec3{e.x, e.y, -e.z}, color),
-      CreateVertex(c + Vec3{e.x, e.y, e.z}, color),
-  };
-
-  Mesh::IndexType base = lines->strip_mesh.vertex_count;
-  Mesh::IndexType indices[18] = {
-    base + 0, base + 1, base + 3, base + 2, base + 0, base + 4, base + 5, base + 1,
-    line_strip::kPrimitiveReset,
+bool PushCubeCenter(LineManager* lines, Vec3 c, Vec3 e, Color color) {
+  if (!Fits(lines, 8, 18))
+    return false;
 
-    base + 7, base + 3, base + 2, base + 6, base + 7, base + 5, base + 4, base + 6,
-    line_strip::kPrimitiveReset,
+  auto vertices = AppendVertices<Vertex3dColor>(&lines->strip_mesh, 8);
+  vertices[0] = CreateVertex(c + Vec3{-e.x, -e.y, -e.z}, color);
+  vertices[1] = CreateVertex(c + Vec3{-e.x, -e.y, e.z}, color);
+  vertices[2] = CreateVertex(c + Vec3{-e.x, e.y, -e.z}, color);
+  vertices[3] = CreateVertex(c + Vec3{-e.x, e.y, e.z}, color);
+  vertices[4] = CreateVertex(c + Vec3{e.x, -e.y, -e.z}, color);
+  vertices[5] = CreateVertex(c + Vec3{e.x, -e.y, e.z}, color);
+  vertices[6] = CreateVertex(c + Vec3{e.x, e.y, -e.z}, color);
+  vertices[7] = CreateVertex(c + Vec3{e.x, e.y, e.z}, color);
+
+  // The restart index must not be offset, so the base is added per element.
+  constexpr Mesh::IndexType kIndices[18] = {
+    0, 1, 3, 2, 0, 4, 5, 1, line_strip::kPrimitiveReset,
+    7, 3, 2, 6, 7, 5, 4, 6, line_strip::kPrimitiveReset,
   };
 
-  PushVertices(&lines->strip_mesh, vertices, ARRAY_SIZE(vertices));
-  PushIndices(&lines->strip_mesh, indices, ARRAY_SIZE(indices));
-  lines->render_command_.indices_count += ARRAY_SIZE(indices);
+  auto indices = AppendIndices(&lines->strip_mesh, ARRAY_SIZE(kIndices));
+  for (uint32_t i = 0; i < indices.count; i++) {
+    Mesh::IndexType index = kIndices[i];
+    indices.Set(i, index == line_strip::kPrimitiveReset ? index : vertices.base + index);
+  }
+  lines->render_command_.indices_count += indices.count;
 
   lines->staged = false;
   lines->shape_count++;
+  return true;
 }
 
 // Push Ring ---------------------------------------------------------------------------------------
@@ -185,40 +220,44 @@ namespace {
 
 constexpr int kRingVertexCount = 32;
 constexpr float kRingAngle = kRadians360 / (float)kRingVertexCount;
+static_assert((uint32_t)kRingVertexCount == kMaxLineShapeVertexCount);
+static_assert((uint32_t)kRingVertexCount + 2 == kMaxLineShapeIndexCount);
 
 }  // namespace
 
-void PushRing(LineManager* lines, Vec3 center, Vec3 normal, float radius, Color color) {
+bool PushRing(LineManager* lines, Vec3 center, Vec3 normal, float radius, Color color) {
   auto frame = GetAxisFrame(normal);
-  PushRing(lines, center, frame, radius, color);
+  return PushRing(lines, center, frame, radius, color);
 }
 
-void PushRing(LineManager* lines, Vec3 center, const AxisFrame& frame, float radius, Color color) {
+bool PushRing(LineManager* lines, Vec3 center, const AxisFrame& frame, float radius, Color color) {
+  if (!Fits(lines, kRingVertexCount, kRingVertexCount + 2))
+    return false;
+
   Mat3 rotation = ToMat3(Rotate(frame.forward, kRingAngle));
 
-  Vertex3dColor vertices[kRingVertexCount] = {};
-  Mesh::IndexType indices[kRingVertexCount + 2] = {};
-  Mesh::IndexType base = lines->strip_mesh.vertex_count;
+  auto vertices = AppendVertices<Vertex3dColor>(&lines->strip_mesh, kRingVertexCount);
+  auto indices = AppendIndices(&lines->strip_mesh, kRingVertexCount + 2);
+  Mesh::IndexType base = vertices.base;
 
   Vec3 p = frame.up * radius;
   for (int i = 0; i < kRingVertexCount; i++) {
     vertices[i] = CreateVertex(center + p, color);
-    indices[i] = base + i;
+    indices.Set(i, base + i);
 
     // Rotate the point.
     p = rotation * p;
     /* Vec3 p = {radius * Cos(i * kRingAngle), 0, radius * Sin(i * kRingAngle)}; */
     /* vertices[i] = CreateVertex(center + p, color); */
   }
-  indices[kRingVertexCount] = base;  // Loop back to the beginning of the ring.
-  indices[kRingVertexCount + 1] = line_strip::kPrimitiveReset;
+  indices.Set(kRingVertexCount, base);  // Loop back to the beginning of the ring.
+  indices.Set(kRingVertexCount + 1, line_strip::kPrimitiveReset);
 
-  PushVertices(&lines->strip_mesh, vertices, std::size(vertices));
-  PushIndices(&lines->strip_mesh, indices, std::size(indices));
-  lines->render_command_.indices_count += std::size(indices);
+  lines->render_command_.indices_count += indices.count;
 
   lines->staged = false;
   lines->shape_count++;
+  return true;
 }
 
 }  // namespace rothko
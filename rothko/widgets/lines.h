@@ -19,6 +19,11 @@ struct LineManager {
   // How many shapes have been added to the line manager. Will be zeroed upon reset.
   int shape_count = 0;
 
+  // Size of the staged mesh, set by |Init|. Shapes that would go over it are dropped.
+  uint32_t vertex_capacity = 0;
+  uint32_t index_capacity = 0;
+  int dropped_shapes = 0;   // Since the last reset.
+
   bool staged = false;          // Whether the current state of the mesh has been staged.
 
   // Uses PrimitiveType::kLineStrip.
@@ -34,32 +39,39 @@ struct LineManager {
 
 std::unique_ptr<Shader> CreateLineShader(Renderer* renderer, const std::string&);
 
-// |line_count| means how many lines we pre-allocate within the mesh.
-// Keep in mind that a cube = 10 lines.
-bool Init(LineManager*, Renderer*, const std::string& name, uint32_t line_count = 1000);
+// The biggest shape (a ring) needs this many vertices and indices.
+constexpr uint32_t kMaxLineShapeVertexCount = 32;
+constexpr uint32_t kMaxLineShapeIndexCount = 34;
+
+// |shape_count| means how many shapes (lines, cubes or rings) can be pushed between resets.
+// The mesh is sized for the biggest one.
+bool Init(LineManager*, Renderer*, const std::string& name, uint32_t shape_count = 1000);
 bool Init(LineManager*, Renderer*, const Shader*, const std::string& name,
-          uint32_t line_count = 1000);
+          uint32_t shape_count = 1000);
 
 inline bool Valid(LineManager* l) { return Staged(l->strip_mesh); }
 void Reset(LineManager*);
 
+// Fails if the mesh doesn't fit in what was staged (eg. vertices were appended directly).
 bool Stage(LineManager*, Renderer*);
 
 RenderCommand GetRenderCommand(const LineManager&);
 
 // Push primitives ---------------------------------------------------------------------------------
+//
+// All of them return false (and push nothing) if the shape doesn't fit in the capacity.
 
-void PushLine(LineManager*, Vec3 from, Vec3 to, Color color);
+bool PushLine(LineManager*, Vec3 from, Vec3 to, Color color);
 
-void PushCubeCenter(LineManager*, Vec3 center, Vec3 extents, Color color);
-inline void PushCube(LineManager* lm, Vec3 min, Vec3 max, Color color) {
-  PushCubeCenter(lm, (min + max) / 2, Abs((max - min) / 2), color);
+bool PushCubeCenter(LineManager*, Vec3 center, Vec3 extents, Color color);
+inline bool PushCube(LineManager* lm, Vec3 min, Vec3 max, Color color) {
+  return PushCubeCenter(lm, (min + max) / 2, Abs((max - min) / 2), color);
 }
 
 // Normal will be used to calculate the axis frame (where the right and up vectors are according to
 // the |normal|).
-void PushRing(LineManager*, Vec3 center, Vec3 normal, float radius, Color color);
+bool PushRing(LineManager*, Vec3 center, Vec3 normal, float radius, Color color);
 
-void PushRing(LineManager*, Vec3 center, const AxisFrame&, float radius, Color color);
+bool PushRing(LineManager*, Vec3 center, const AxisFrame&, float radius, Color color);
 
 }  // namespace
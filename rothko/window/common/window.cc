@@ -107,6 +107,7 @@ bool WindowCreateVulkanSurface(Window* window, void* vk_instance, void* surface_
 const char* ToString(WindowType type) {
   switch (type) {
     case WindowType::kSDLOpenGL: return "SDLOpenGL";
+    case WindowType::kHeadlessOpenGL: return "HeadlessOpenGL";
     case WindowType::kLast: return "Last";
   }
 
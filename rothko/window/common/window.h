@@ -36,6 +36,7 @@ struct WindowBackend;
 enum class WindowType {
   kSDLOpenGL,
   // kSDLVulkan,  TODO(Cristian): Implement back!
+  kHeadlessOpenGL,  // Offscreen EGL context. See rothko/window/headless/egl_opengl.h.
   kLast,
 };
 const char* ToString(WindowType);
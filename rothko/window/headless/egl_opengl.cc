@@ -0,0 +1,246 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/window/headless/egl_opengl.h"
+
+#include <EGL/eglext.h>
+#include <string.h>
+
+#include <memory>
+
+#include "rothko/input/input.h"
+#include "rothko/logging/logging.h"
+#include "rothko/window/common/window.h"
+
+namespace rothko {
+namespace headless {
+
+// Backend Suscription -----------------------------------------------------------------------------
+
+namespace {
+
+std::unique_ptr<WindowBackend> CreateWindow() {
+  return std::make_unique<EGLOpenGLWindow>();
+}
+
+struct BackendSuscriptor {
+  BackendSuscriptor() {
+    SuscribeWindowBackendFactoryFunction(WindowType::kHeadlessOpenGL, CreateWindow);
+  }
+};
+
+// Trigger the suscription.
+BackendSuscriptor backend_suscriptor;
+
+}  // namespace
+
+// Shutdown ----------------------------------------------------------------------------------------
+
+namespace {
+
+void EGLOpenGLShutdown(EGLOpenGLWindow* egl) {
+  if (egl->display.has_value())
+    eglMakeCurrent(egl->display.value, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+  if (egl->surface.has_value()) {
+    eglDestroySurface(egl->display.value, egl->surface.value);
+    egl->surface.clear();
+  }
+
+  if (egl->context.has_value()) {
+    eglDestroyContext(egl->display.value, egl->context.value);
+    egl->context.clear();
+  }
+
+  if (egl->display.has_value()) {
+    eglTerminate(egl->display.value);
+    egl->display.clear();
+  }
+
+  egl->window = nullptr;
+}
+
+}  // namespace
+
+void EGLOpenGLWindow::Shutdown() {
+  EGLOpenGLShutdown(this);
+}
+
+// Init --------------------------------------------------------------------------------------------
+
+namespace {
+
+// |extensions| is a space separated list.
+bool HasExtension(const char* extensions, const char* name) {
+  if (!extensions)
+    return false;
+
+  size_t len = strlen(name);
+  for (const char* it = strstr(extensions, name); it; it = strstr(it + len, name)) {
+    bool starts = it == extensions || it[-1] == ' ';
+    bool ends = it[len] == ' ' || it[len] == '\0';
+    if (starts && ends)
+      return true;
+  }
+
+  return false;
+}
+
+// Prefers Mesa's surfaceless platform, which doesn't try to connect to a display server.
+EGLDisplay GetDisplay() {
+  const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (HasExtension(client_extensions, "EGL_MESA_platform_surfaceless") &&
+      HasExtension(client_extensions, "EGL_EXT_platform_base")) {
+    auto get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+      EGLDisplay display =
+          get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY)
+        return display;
+    }
+  }
+
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool ChooseConfig(EGLDisplay display, bool pbuffer, EGLConfig* out) {
+  const EGLint attributes[] = {
+    EGL_SURFACE_TYPE, pbuffer ? EGL_PBUFFER_BIT : 0,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_STENCIL_SIZE, 8,
+    EGL_NONE,
+  };
+
+  EGLint count = 0;
+  return eglChooseConfig(display, attributes, out, 1, &count) && count > 0;
+}
+
+bool EGLOpenGLInit(EGLOpenGLWindow* egl, Window* window, InitWindowConfig* config) {
+  egl->display = GetDisplay();
+  if (!egl->display.has_value()) {
+    ERROR(OpenGL, "Could not get an EGL display.");
+    return false;
+  }
+
+  EGLint major = 0, minor = 0;
+  if (!eglInitialize(egl->display.value, &major, &minor)) {
+    ERROR(OpenGL, "Could not initialize EGL: 0x%x", eglGetError());
+    egl->display.clear();
+    return false;
+  }
+  LOG(OpenGL, "Initialized EGL %d.%d (%s).", major, minor,
+      eglQueryString(egl->display.value, EGL_VENDOR));
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    ERROR(OpenGL, "EGL: Desktop OpenGL is not supported.");
+    EGLOpenGLShutdown(egl);
+    return false;
+  }
+
+  // Without pbuffers, we can still render into framebuffer objects if surfaceless contexts are
+  // supported.
+  EGLConfig egl_config = {};
+  bool pbuffer = ChooseConfig(egl->display.value, true, &egl_config);
+  if (!pbuffer) {
+    const char* extensions = eglQueryString(egl->display.value, EGL_EXTENSIONS);
+    if (!HasExtension(extensions, "EGL_KHR_surfaceless_context") ||
+        !ChooseConfig(egl->display.value, false, &egl_config)) {
+      ERROR(OpenGL, "EGL: No config supports pbuffers or surfaceless contexts.");
+      EGLOpenGLShutdown(egl);
+      return false;
+    }
+    WARNING(OpenGL, "EGL: No pbuffer support. Only render targets can be rendered into.");
+  }
+
+  const EGLint context_attributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#if DEBUG_MODE
+    EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+#endif
+    EGL_NONE,
+  };
+  egl->context = eglCreateContext(egl->display.value, egl_config, EGL_NO_CONTEXT,
+                                  context_attributes);
+  if (!egl->context.has_value()) {
+    ERROR(OpenGL, "Error creating OpenGL context: 0x%x", eglGetError());
+    EGLOpenGLShutdown(egl);
+    return false;
+  }
+
+  if (pbuffer) {
+    const EGLint surface_attributes[] = {
+      EGL_WIDTH, config->screen_size.width,
+      EGL_HEIGHT, config->screen_size.height,
+      EGL_NONE,
+    };
+    egl->surface = eglCreatePbufferSurface(egl->display.value, egl_config, surface_attributes);
+    if (!egl->surface.has_value()) {
+      ERROR(OpenGL, "Error creating pbuffer of size %s: 0x%x",
+            ToString(config->screen_size).c_str(), eglGetError());
+      EGLOpenGLShutdown(egl);
+      return false;
+    }
+  }
+
+  if (!eglMakeCurrent(egl->display.value, egl->surface.value, egl->surface.value,
+                      egl->context.value)) {
+    ERROR(OpenGL, "Could not make the EGL context current: 0x%x", eglGetError());
+    EGLOpenGLShutdown(egl);
+    return false;
+  }
+
+  // Nothing is presented, so there is nothing to wait for.
+  eglSwapInterval(egl->display.value, 0);
+
+  window->screen_size = config->screen_size;
+  window->framebuffer_scale = {1.0f, 1.0f};
+
+  egl->window = window;
+  return true;
+}
+
+}  // namespace
+
+bool EGLOpenGLWindow::Init(Window* w, InitWindowConfig* config) {
+  return EGLOpenGLInit(this, w, config);
+}
+
+// UpdateWindow ------------------------------------------------------------------------------------
+
+WindowEvent EGLOpenGLWindow::StartFrame(Window* w, Input* input) {
+  ASSERT(Valid(this));
+
+  for (char& c : w->utf8_chars_inputted) {
+    c = 0;
+  }
+  w->utf8_index = 0;
+
+  NewFrame(input);
+  return WindowEvent::kNone;
+}
+
+// SwapBuffers -------------------------------------------------------------------------------------
+
+void EGLOpenGLWindow::SwapBuffers() {
+  // Swapping a pbuffer does nothing, but it still marks the end of the frame for the driver.
+  if (this->surface.has_value())
+    eglSwapBuffers(this->display.value, this->surface.value);
+}
+
+// Misc --------------------------------------------------------------------------------------------
+
+EGLOpenGLWindow::~EGLOpenGLWindow() {
+  if (Valid(this))
+    EGLOpenGLShutdown(this);
+}
+
+}  // namespace headless
+}  // namespace rothko
@@ -0,0 +1,46 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#pragma once
+
+#include <EGL/egl.h>
+
+#include "rothko/utils/clear_on_move.h"
+#include "rothko/utils/macros.h"
+#include "rothko/window/common/window_backend.h"
+
+namespace rothko {
+namespace headless {
+
+// Window backend without a window: an offscreen OpenGL context created through EGL, for running on
+// machines without a display server (eg. Mesa's llvmpipe on CI).
+//
+// The "window" is a pbuffer of |InitWindowConfig::screen_size|, so rendering to the window and
+// reading it back (see the |Readback| command) work as usual. If the driver can't create a pbuffer
+// the context is made current without any surface, in which case everything has to be rendered
+// into render targets.
+//
+// There is no input: |StartFrame| never reports events.
+struct EGLOpenGLWindow : public WindowBackend {
+  RAII_CONSTRUCTORS(EGLOpenGLWindow);
+
+  ClearOnMove<EGLDisplay> display = EGL_NO_DISPLAY;
+  ClearOnMove<EGLContext> context = EGL_NO_CONTEXT;
+  ClearOnMove<EGLSurface> surface = EGL_NO_SURFACE;   // Stays empty when surfaceless.
+
+  Window* window = nullptr;   // Not owning. Must outlive.
+
+  // Virtual Interface -----------------------------------------------------------------------------
+
+  bool Init(Window*, InitWindowConfig*) override;
+  void Shutdown() override;
+  WindowEvent StartFrame(Window*, Input*) override;
+  void SwapBuffers() override;
+};
+
+inline bool Valid(EGLOpenGLWindow* egl) {
+  return egl->display.has_value() && egl->context.has_value();
+}
+
+}  // namespace headless
+}  // namespace rothko
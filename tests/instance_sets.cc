@@ -0,0 +1,45 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/instance_set.h"
+
+#include <third_party/catch2/catch.hpp>
+
+namespace rothko {
+namespace test {
+
+TEST_CASE("Instance set frustum") {
+  // Camera at the origin looking down -Z.
+  Frustum frustum = GetFrustum(Perspective(ToRadians(60.0f), 1.0f, 0.1f, 100.0f) *
+                               LookAt({0, 0, 0}, {0, 0, -1}));
+
+  Vec3 bmin = {-0.5f, -0.5f, -0.5f};
+  Vec3 bmax = {0.5f, 0.5f, 0.5f};
+
+  CHECK(IsInFrustum(frustum, bmin, bmax, Translate({0, 0, -10})));
+  CHECK(IsInFrustum(frustum, bmin, bmax, Translate({0, 0, 0})));       // Crossing the near plane.
+  CHECK(!IsInFrustum(frustum, bmin, bmax, Translate({0, 0, 10})));     // Behind.
+  CHECK(!IsInFrustum(frustum, bmin, bmax, Translate({0, 0, -200})));   // Past the far plane.
+  CHECK(!IsInFrustum(frustum, bmin, bmax, Translate({20, 0, -10})));   // To the right.
+  CHECK(!IsInFrustum(frustum, bmin, bmax, Translate({0, -20, -10})));  // Below.
+
+  // Scaling the box makes it reach into the view.
+  CHECK(IsInFrustum(frustum, bmin, bmax, Translate({20, 0, -10}) * Scale(30.0f)));
+
+  // Bounds that are not centered on the origin.
+  CHECK(IsInFrustum(frustum, {19, -1, -1}, {21, 1, 1}, Translate({-20, 0, -10})));
+
+  // Rotations keep the box around it.
+  Mat4 rotated = Translate({0, 0, -10}) * Rotate({0, 1, 0}, ToRadians(45.0f));
+  CHECK(IsInFrustum(frustum, bmin, bmax, rotated));
+}
+
+TEST_CASE("Depth pyramid length") {
+  CHECK(GetDepthPyramidLength({4, 4}, 3) == 16 + 4 + 1);
+  CHECK(GetDepthPyramidLength({5, 3}, 3) == 15 + 6 + 2);
+  CHECK(GetDepthPyramidLength({5, 3}, 4) == 15 + 6 + 2 + 1);
+  CHECK(GetDepthPyramidLength({8, 8}, 0) == 0);
+}
+
+}  // namespace test
+}  // namespace rothko
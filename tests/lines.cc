@@ -0,0 +1,71 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/widgets/lines.h"
+
+#include <third_party/catch2/catch.hpp>
+
+namespace rothko {
+namespace test {
+namespace {
+
+// What |Init| sets up, without staging.
+void InitCapacity(LineManager* lines, uint32_t shape_count) {
+  lines->name = "test-lines";
+  lines->strip_mesh.vertex_type = VertexType::k3dColor;
+  lines->vertex_capacity = shape_count * kMaxLineShapeVertexCount;
+  lines->index_capacity = shape_count * kMaxLineShapeIndexCount;
+}
+
+}  // namespace
+
+TEST_CASE("Line manager capacity") {
+  constexpr uint32_t kShapeCount = 20;
+
+  SECTION("Rings") {
+    LineManager lines;
+    InitCapacity(&lines, kShapeCount);
+
+    for (uint32_t i = 0; i < kShapeCount; i++) {
+      REQUIRE(PushRing(&lines, {0, 0, 0}, Vec3{0, 1, 0}, 1.0f, Color::White()));
+    }
+    CHECK(lines.strip_mesh.vertex_count == lines.vertex_capacity);
+    CHECK(lines.strip_mesh.index_count == lines.index_capacity);
+
+    // Full: nothing gets pushed.
+    CHECK(!PushRing(&lines, {0, 0, 0}, Vec3{0, 1, 0}, 1.0f, Color::White()));
+    CHECK(!PushLine(&lines, {0, 0, 0}, {1, 1, 1}, Color::White()));
+    CHECK(lines.strip_mesh.vertex_count == lines.vertex_capacity);
+    CHECK(lines.shape_count == (int)kShapeCount);
+    CHECK(lines.dropped_shapes == 2);
+
+    Reset(&lines);
+    CHECK(lines.dropped_shapes == 0);
+    CHECK(PushRing(&lines, {0, 0, 0}, Vec3{0, 1, 0}, 1.0f, Color::White()));
+  }
+
+  SECTION("Cubes and lines") {
+    LineManager lines;
+    InitCapacity(&lines, kShapeCount);
+
+    // Cubes are limited by their indices (18 each), so they fit more than one per shape.
+    int cubes = 0;
+    while (PushCube(&lines, {0, 0, 0}, {1, 1, 1}, Color::White()))
+      cubes++;
+    CHECK(cubes == (int)(kShapeCount * kMaxLineShapeIndexCount / 18));
+    CHECK(lines.strip_mesh.vertex_count <= lines.vertex_capacity);
+    CHECK(lines.strip_mesh.index_count <= lines.index_capacity);
+    CHECK(lines.render_command_.indices_count == lines.strip_mesh.index_count);
+
+    // Whatever space is left still takes lines.
+    uint32_t index_space = lines.index_capacity - lines.strip_mesh.index_count;
+    uint32_t pushed_lines = 0;
+    while (PushLine(&lines, {0, 0, 0}, {1, 1, 1}, Color::White()))
+      pushed_lines++;
+    CHECK(pushed_lines == index_space / 3);
+    CHECK(lines.strip_mesh.index_count <= lines.index_capacity);
+  }
+}
+
+}  // namespace test
+}  // namespace rothko
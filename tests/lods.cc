@@ -0,0 +1,218 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/mesh.h"
+#include "rothko/models/lod.h"
+#include "rothko/models/simplify.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include <third_party/catch2/catch.hpp>
+
+namespace rothko {
+namespace test {
+namespace {
+
+// |quads| x |quads| grid in the XY plane, from (0, 0) to (1, 1).
+Mesh CreateGrid(uint32_t quads) {
+  Mesh mesh;
+  mesh.name = "grid";
+  mesh.vertex_type = VertexType::k3d;
+
+  uint32_t side = quads + 1;
+  auto vertices = AppendVertices<Vertex3d>(&mesh, side * side);
+  for (uint32_t y = 0; y < side; y++) {
+    for (uint32_t x = 0; x < side; x++) {
+      vertices[y * side + x].pos = {(float)x / quads, (float)y / quads, 0};
+    }
+  }
+
+  auto indices = AppendIndices(&mesh, quads * quads * 6);
+  uint32_t i = 0;
+  for (uint32_t y = 0; y < quads; y++) {
+    for (uint32_t x = 0; x < quads; x++) {
+      uint32_t a = y * side + x;
+      uint32_t b = a + 1;
+      uint32_t c = a + side + 1;
+      uint32_t d = a + side;
+      for (uint32_t index : {a, b, c, a, c, d}) {
+        indices.Set(i++, index);
+      }
+    }
+  }
+
+  return mesh;
+}
+
+// Unit sphere with a single vertex per position.
+Mesh CreateSphere(uint32_t rings, uint32_t segments) {
+  Mesh mesh;
+  mesh.name = "sphere";
+  mesh.vertex_type = VertexType::k3d;
+
+  auto vertices = AppendVertices<Vertex3d>(&mesh, 2 + (rings - 1) * segments);
+  vertices[0].pos = {0, 1, 0};
+  vertices[vertices.count - 1].pos = {0, -1, 0};
+  for (uint32_t r = 1; r < rings; r++) {
+    for (uint32_t s = 0; s < segments; s++) {
+      float theta = kPI * r / rings;
+      float phi = 2 * kPI * s / segments;
+      vertices[1 + (r - 1) * segments + s].pos = {sinf(theta) * cosf(phi), cosf(theta),
+                                                  sinf(theta) * sinf(phi)};
+    }
+  }
+
+  auto index = [segments](uint32_t r, uint32_t s) { return 1 + (r - 1) * segments + s % segments; };
+  uint32_t south = vertices.count - 1;
+
+  std::vector<uint32_t> indices;
+  for (uint32_t s = 0; s < segments; s++) {
+    indices.insert(indices.end(), {0, index(1, s + 1), index(1, s)});
+    for (uint32_t r = 1; r < rings - 1; r++) {
+      uint32_t a = index(r, s), b = index(r, s + 1), c = index(r + 1, s + 1), d = index(r + 1, s);
+      indices.insert(indices.end(), {a, b, c, a, c, d});
+    }
+    indices.insert(indices.end(), {index(rings - 1, s), index(rings - 1, s + 1), south});
+  }
+
+  auto span = AppendIndices(&mesh, indices.size());
+  for (uint32_t i = 0; i < indices.size(); i++) {
+    span.Set(i, indices[i]);
+  }
+
+  return mesh;
+}
+
+// Signed area of the mesh projected on the XY plane.
+float GetXYArea(const Mesh& mesh) {
+  std::vector<Vec3> positions;
+  GetVertexPositions(mesh, &positions);
+
+  float area = 0;
+  for (uint32_t i = 0; i < mesh.index_count; i += 3) {
+    Vec3 a = positions[GetIndex(mesh, i)];
+    Vec3 b = positions[GetIndex(mesh, i + 1)];
+    Vec3 c = positions[GetIndex(mesh, i + 2)];
+    area += Cross(b - a, c - a).z * 0.5f;
+  }
+  return area;
+}
+
+}  // namespace
+
+TEST_CASE("Simplify flat mesh") {
+  Mesh grid = CreateGrid(16);
+  REQUIRE(grid.index_count == 16 * 16 * 6);
+
+  SimplifyOptions options = {};
+  options.target_index_count = 0;
+
+  Mesh simplified;
+  float error = -1;
+  REQUIRE(SimplifyMesh(grid, options, &simplified, &error));
+
+  // Only the corners are needed to represent it.
+  CHECK(simplified.index_count <= 4 * 6);
+  CHECK(simplified.vertex_count < grid.vertex_count);
+  CHECK(simplified.vertex_type == VertexType::k3d);
+  CHECK(error < 0.0001f);
+
+  // No triangle got flipped nor any hole opened.
+  CHECK(GetXYArea(simplified) == Approx(1.0f));
+
+  std::vector<Vec3> positions;
+  REQUIRE(GetVertexPositions(simplified, &positions));
+  for (const Vec3& corner : {Vec3{0, 0, 0}, Vec3{1, 0, 0}, Vec3{1, 1, 0}, Vec3{0, 1, 0}}) {
+    CHECK(std::find(positions.begin(), positions.end(), corner) != positions.end());
+  }
+}
+
+TEST_CASE("Simplify curved mesh") {
+  Mesh sphere = CreateSphere(16, 32);
+
+  SimplifyOptions options = {};
+  options.target_index_count = sphere.index_count / 4;
+  options.max_error = 0.1f;
+
+  Mesh simplified;
+  float error = 0;
+  REQUIRE(SimplifyMesh(sphere, options, &simplified, &error));
+  CHECK(simplified.index_count <= options.target_index_count);
+  CHECK(error > 0);
+  CHECK(error <= options.max_error);
+
+  // Nothing can be collapsed without changing the surface.
+  options.max_error = 0;
+  REQUIRE(SimplifyMesh(sphere, options, &simplified, &error));
+  CHECK(simplified.index_count == sphere.index_count);
+  CHECK(simplified.vertex_count == sphere.vertex_count);
+
+  // LOD chain.
+  LODOptions lod_options = {};
+  lod_options.lod_count = 3;
+  lod_options.max_error = 0.2f;
+
+  std::vector<MeshLOD> lods;
+  REQUIRE(GenerateLODs(sphere, lod_options, &lods));
+  REQUIRE(lods.size() == 3u);
+  uint32_t previous_count = sphere.index_count;
+  float previous_error = 0;
+  for (const MeshLOD& lod : lods) {
+    CHECK(lod.mesh->index_count <= previous_count * 3 / 4);
+    CHECK(lod.error >= previous_error);
+    previous_count = lod.mesh->index_count;
+    previous_error = lod.error;
+  }
+  CHECK(lods[0].mesh->name == "sphere-lod1");
+}
+
+TEST_CASE("LOD selection") {
+  // Only the pointers are needed.
+  Mesh meshes[4];
+
+  ModelPrimitive primitive = {};
+  primitive.mesh = &meshes[0];
+  primitive.bounds = {{-1, -1, -1}, {1, 1, 1}};
+  primitive.lod_count = 3;
+  primitive.lods[0] = {&meshes[1], 0.01f};
+  primitive.lods[1] = {&meshes[2], 0.05f};
+  primitive.lods[2] = {&meshes[3], 0.2f};
+
+  LODSelection selection = {};
+  selection.projection = Perspective(ToRadians(60.0f), 1.0f, 0.1f, 1000.0f);
+  selection.viewport_height = 1000;
+  selection.max_pixel_error = 1.0f;
+  selection.hysteresis = 0.2f;
+
+  // The bounds project to a radius of ~1500 / distance pixels.
+  auto select = [&](float distance, uint32_t current_lod) {
+    return SelectLOD(primitive, Translate({0, 0, -distance}), selection, current_lod);
+  };
+
+  CHECK(GetProjectedRadius(primitive.bounds, Translate({0, 0, -15}), selection) ==
+        Approx(100.0f));
+  CHECK(GetProjectedRadius(primitive.bounds, Mat4::Identity(), selection) > 1000000.0f);
+
+  CHECK(select(10, 0) == 0);
+  CHECK(select(20, 0) == 1);
+  CHECK(select(100, 0) == 2);
+  CHECK(select(400, 0) == 3);
+
+  // Coming closer only goes back when the error is clearly over.
+  CHECK(select(16, 1) == 1);
+  CHECK(select(12, 1) == 0);
+  CHECK(select(10, 3) == 0);
+
+  // Going away only switches when the next LOD is clearly under.
+  CHECK(select(17, 0) == 0);
+  CHECK(select(19, 0) == 1);
+
+  CHECK(GetLODMesh(primitive, 0) == &meshes[0]);
+  CHECK(GetLODMesh(primitive, 2) == &meshes[2]);
+  CHECK(GetLODMesh(primitive, 10) == &meshes[3]);
+}
+
+}  // namespace test
+}  // namespace rothko
@@ -0,0 +1,191 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/logging/logging.h"
+#include "rothko/utils/file.h"
+#include "rothko/utils/strings.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <third_party/catch2/catch.hpp>
+
+namespace rothko {
+namespace test {
+namespace {
+
+TEST_CASE("Logging from multiple threads") {
+  constexpr int kThreadCount = 4;
+  constexpr int kMessagesPerThread = 1000;
+
+  {
+    auto logger = InitLoggingSystem(false);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreadCount; t++) {
+      threads.emplace_back([t]() {
+        for (int i = 0; i < kMessagesPerThread; i++) {
+          DoLogging(LogCategory::kApp, LogSeverity::kInfo, FROM_HERE, "thread %d message %d", t, i);
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    auto& logs = GetLogs();
+    uint64_t written = logs.write_index;
+    uint64_t dropped = logs.dropped_messages;
+    CHECK(written + dropped == kThreadCount * kMessagesPerThread);
+
+    // Every entry still in the ring must be whole.
+    uint64_t start = written > LogContainer::kMaxEntries ? written - LogContainer::kMaxEntries : 0;
+    LogEntry entry;
+    for (uint64_t i = start; i < written; i++) {
+      REQUIRE(ReadLogEntry(logs, i, &entry));
+      CHECK(strncmp(entry.msg, "thread ", 7) == 0);
+      CHECK(entry.category == LogCategory::kApp);
+    }
+  }
+}
+
+TEST_CASE("Logging truncates long messages") {
+  auto logger = InitLoggingSystem(false);
+
+  std::string long_msg(LogEntry::kMaxMessageSize * 2, 'a');
+  DoLogging(LogCategory::kApp, LogSeverity::kInfo, FROM_HERE, "%s", long_msg.c_str());
+
+  LogEntry entry;
+  REQUIRE(ReadLogEntry(GetLogs(), 0, &entry));
+  CHECK(strlen(entry.msg) == LogEntry::kMaxMessageSize - 1);
+}
+
+// Uses WARNING, which is compiled in every build. ERROR cannot be used, as it crashes debug builds.
+TEST_CASE("Log filtering") {
+  LoggingConfig config = {};
+  config.thresholds[(int)LogCategory::kOpenGL] = LogSeverity::kError;
+  auto logger = InitLoggingSystem(config);
+  auto& logs = GetLogs();
+
+  CHECK(GetLogThreshold(LogCategory::kApp) == LogSeverity::kInfo);
+  CHECK(GetLogThreshold(LogCategory::kOpenGL) == LogSeverity::kError);
+  CHECK(ShouldLog(LogCategory::kOpenGL, LogSeverity::kError));
+  CHECK(!ShouldLog(LogCategory::kOpenGL, LogSeverity::kWarning));
+  CHECK(ShouldLog(LogCategory::kOpenGL, LogSeverity::kAssert));
+
+  int evaluations = 0;
+  auto count = [&evaluations]() { return evaluations++; };
+
+  // Filtered logs must not evaluate their arguments.
+  WARNING(OpenGL, "Filtered %d", count());
+  CHECK(evaluations == 0);
+  CHECK(logs.write_index == 0);
+
+  WARNING(App, "Not filtered %d", count());
+  CHECK(evaluations == 1);
+  CHECK(logs.write_index == 1);
+
+  // Runtime change.
+  SetLogThreshold(LogCategory::kApp, LogSeverity::kError);
+  WARNING(App, "Filtered %d", count());
+  CHECK(evaluations == 1);
+  CHECK(logs.write_index == 1);
+
+  SetAllLogThresholds(LogSeverity::kWarning);
+  WARNING(OpenGL, "Not filtered %d", count());
+  CHECK(evaluations == 2);
+  CHECK(logs.write_index == 2);
+  CHECK(!ShouldLog(LogCategory::kApp, LogSeverity::kInfo));
+}
+
+TEST_CASE("Binary log file round trip") {
+  const std::string kPath = "rothko_test_log.bin";
+
+  {
+    LoggingConfig config = {};
+    config.file.path = kPath;
+    config.file.format = LogFileFormat::kBinary;
+    auto logger = InitLoggingSystem(config);
+
+    for (int i = 0; i < 3; i++) {
+      DoLogging(LogCategory::kOpenGL, LogSeverity::kWarning, FROM_HERE, "message %d", i);
+    }
+    DoLogging(LogCategory::kModel, LogSeverity::kInfo, FROM_HERE, "another location");
+  }
+
+  std::vector<uint8_t> data;
+  REQUIRE(ReadWholeFile(kPath, &data));
+  remove(kPath.c_str());
+
+  std::string text;
+  REQUIRE(DecodeBinaryLog(data.data(), data.size(), &text));
+
+  auto lines = SplitToLines(text);
+  REQUIRE(lines.size() == 4);
+  for (int i = 0; i < 3; i++) {
+    CHECK(lines[i].find("[Warning][OpenGL][logging.cc:") != std::string::npos);
+    CHECK(EndsWith(lines[i], StringPrintf("message %d", i)));
+  }
+  CHECK(lines[3].find("[Info][Model]") != std::string::npos);
+  CHECK(EndsWith(lines[3], "another location"));
+
+  // Truncated data should fail, but keep what could be decoded.
+  text.clear();
+  CHECK(!DecodeBinaryLog(data.data(), data.size() - 3, &text));
+  CHECK(SplitToLines(text).size() == 3);
+}
+
+TEST_CASE("Log file rotation") {
+  const std::string kPath = "rothko_test_log.txt";
+
+  LogFileConfig config = {};
+  config.path = kPath;
+  config.buffer_size = 128;
+  config.max_file_size = 256;
+  config.max_rotated_files = 2;
+
+  {
+    LogFileSink sink;
+    REQUIRE(Init(&sink, config));
+
+    LogEntry entry = {};
+    entry.location = FROM_HERE;
+    for (int i = 0; i < 64; i++) {
+      snprintf(entry.msg, sizeof(entry.msg), "line %d", i);
+      Append(&sink, entry);
+    }
+  }
+
+  std::string contents;
+  CHECK(ReadWholeFile(kPath + ".1", &contents));
+  CHECK(ReadWholeFile(kPath + ".2", &contents));
+  CHECK(!ReadWholeFile(kPath + ".3", &contents));
+
+  // Starting again keeps the last file of the previous run.
+  std::string last_file;
+  REQUIRE(ReadWholeFile(kPath, &last_file));
+  REQUIRE(!last_file.empty());
+  {
+    LogFileSink sink;
+    REQUIRE(Init(&sink, config));
+  }
+
+  REQUIRE(ReadWholeFile(kPath + ".1", &contents));
+  CHECK(contents == last_file);
+  std::vector<uint8_t> new_file;
+  REQUIRE(ReadWholeFile(kPath, &new_file));
+  CHECK(new_file.empty());
+
+  remove(kPath.c_str());
+  remove((kPath + ".1").c_str());
+  remove((kPath + ".2").c_str());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace rothko
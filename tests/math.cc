@@ -441,6 +441,14 @@ TEST_CASE("Hash") {
     uint32_t hash = HASH_STRING32("Hello");
     REQUIRE(hash == 0xf55c314b);
   }
+
+  SECTION("FNV-1a 64") {
+    uint64_t hash = FNA1a64Hash("Hello", 5);
+    REQUIRE(hash == 0x63f0bfacf2c00f6bull);
+
+    // Chaining is the same as hashing everything at once.
+    REQUIRE(FNA1a64Hash("llo", 3, FNA1a64Hash("He", 2)) == hash);
+  }
 }
 
 
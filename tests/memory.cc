@@ -2,8 +2,15 @@
 // This code has a BSD license. See LICENSE.
 
 #include "rothko/memory/block_allocator.h"
+#include "rothko/memory/memory_tracker.h"
+#include "rothko/memory/range_allocator.h"
 #include "rothko/memory/stack_allocator.h"
 
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
 #include <third_party/catch2/catch.hpp>
 
 namespace rothko {
@@ -13,9 +20,10 @@ namespace {
 TEST_CASE("StackAllocator") {
   constexpr uint32_t kElemCount = 8;
   StackAllocator sa = CreateStackAllocatorFor<uint32_t>(kElemCount);
-  REQUIRE(sa.size == sizeof(uint32_t) * kElemCount);
+  REQUIRE(sa.blocks.size() == 1);
+  REQUIRE(Capacity(sa) == sizeof(uint32_t) * kElemCount);
 
-  uint32_t* ptr = (uint32_t*)sa.data_.get();
+  uint32_t* ptr = (uint32_t*)sa.blocks[0].data.get();
   for (uint32_t i = 0; i < kElemCount; i++) {
     *ptr++ = i + 1;
   }
@@ -28,22 +36,153 @@ TEST_CASE("StackAllocator") {
   CHECK(array[3] == 4);
   CHECK(array[4] == 5);
 
-  CHECK(sa.current == sizeof(uint32_t) * 5);
-  CHECK(Allocate<uint32_t>(&sa, 10) == nullptr);
-
   CHECK(*Allocate<uint32_t>(&sa) == 6);
   REQUIRE(sa.current == sizeof(uint32_t) * 6);
   CHECK(*Allocate<uint32_t>(&sa) == 7);
-  REQUIRE(sa.current == sizeof(uint32_t) * 7);
   CHECK(*Allocate<uint32_t>(&sa) == 8);
   REQUIRE(sa.current == sizeof(uint32_t) * 8);
-  CHECK(Allocate<uint32_t>(&sa) == nullptr);
-  CHECK(Allocate<uint32_t>(&sa) == nullptr);
-  CHECK(Allocate<uint32_t>(&sa) == nullptr);
-  CHECK(Allocate<uint32_t>(&sa) == nullptr);
 
-  Reset(&sa);
-  CHECK(sa.current == 0);
+  SECTION("Overflow chains a new block") {
+    uint32_t* overflow = Allocate<uint32_t>(&sa, 10);
+    REQUIRE(overflow);
+    CHECK(sa.blocks.size() == 2);
+    CHECK(sa.block_index == 1);
+    CHECK(sa.blocks[1].size >= sizeof(uint32_t) * 10);
+
+    // Previous allocations are untouched.
+    CHECK(array[0] == 1);
+    CHECK(array[4] == 5);
+
+    // Reset merges the blocks.
+    uint64_t capacity = Capacity(sa);
+    Reset(&sa);
+    CHECK(sa.current == 0);
+    CHECK(sa.block_index == 0);
+    REQUIRE(sa.blocks.size() == 1);
+    CHECK(Capacity(sa) == capacity);
+  }
+
+  SECTION("Markers") {
+    Reset(&sa);
+    Allocate<uint32_t>(&sa, 2);
+    StackMarker marker = GetMarker(sa);
+
+    // Go over into another block and then rewind.
+    Allocate<uint32_t>(&sa, 32);
+    CHECK(sa.block_index == 1);
+    RewindTo(&sa, marker);
+    CHECK(sa.block_index == 0);
+    CHECK(sa.current == sizeof(uint32_t) * 2);
+
+    {
+      ScratchScope scope(&sa);
+      Allocate<uint32_t>(&sa, 4);
+      CHECK(sa.current == sizeof(uint32_t) * 6);
+    }
+    CHECK(sa.current == sizeof(uint32_t) * 2);
+
+    // The chained block is reused instead of allocating a new one.
+    Allocate<uint32_t>(&sa, 32);
+    CHECK(sa.blocks.size() == 2);
+  }
+}
+
+TEST_CASE("StackAllocator alignment") {
+  StackAllocator sa = CreateStackAllocator(1024);
+
+  struct alignas(64) Aligned {
+    uint8_t data[64];
+  };
+
+  Allocate<uint8_t>(&sa, 3);
+  Aligned* aligned = Allocate<Aligned>(&sa, 2);
+  CHECK(((uintptr_t)aligned % 64) == 0);
+
+  Allocate<uint8_t>(&sa);
+  double* d = Allocate<double>(&sa);
+  CHECK(((uintptr_t)d % alignof(double)) == 0);
+
+  // Big sizes are 64 bits wide.
+  static_assert(sizeof(StackAllocator::current) == sizeof(uint64_t));
+}
+
+TEST_CASE("ScratchAllocator") {
+  StackAllocator* scratch = GetScratchAllocator();
+  REQUIRE(Valid(*scratch));
+
+  StackAllocator* other_scratch = nullptr;
+  std::thread thread([&other_scratch]() { other_scratch = GetScratchAllocator(); });
+  thread.join();
+  CHECK(other_scratch != scratch);
+
+  StackMarker marker = GetMarker(*scratch);
+  {
+    ScratchScope scope;
+    uint32_t* values = Allocate<uint32_t>(scope.allocator, 128);
+    REQUIRE(values);
+    CHECK(scope.allocator == scratch);
+  }
+  CHECK(scratch->block_index == marker.block_index);
+  CHECK(scratch->current == marker.offset);
+}
+
+TEST_CASE("RangeAllocator") {
+  RangeAllocator ra = CreateRangeAllocator(100);
+  REQUIRE(Valid(ra));
+  CHECK(LargestFreeRange(ra) == 100);
+
+  uint64_t a = AllocateRange(&ra, 30);
+  uint64_t b = AllocateRange(&ra, 30);
+  uint64_t c = AllocateRange(&ra, 30);
+  CHECK(a == 0);
+  CHECK(b == 30);
+  CHECK(c == 60);
+  CHECK(ra.used == 90);
+  CHECK(AllocateRange(&ra, 20) == kInvalidRange);
+
+  // Freeing the middle leaves a hole that best-fit reuses.
+  FreeRange(&ra, b, 30);
+  CHECK(ra.free_ranges.size() == 2);
+  CHECK(LargestFreeRange(ra) == 30);
+  CHECK(Fragmentation(ra) > 0.0f);
+
+  uint64_t d = AllocateRange(&ra, 5);
+  CHECK(d == 90);   // The 10 bytes at the end are a better fit than the 30 byte hole.
+  uint64_t e = AllocateRange(&ra, 25);
+  CHECK(e == 30);
+
+  // Freeing neighbours coalesces them.
+  FreeRange(&ra, a, 30);
+  FreeRange(&ra, e, 25);
+  CHECK(ra.free_ranges.size() == 2);
+  CHECK(ra.free_ranges[0] == 60);   // Also merged with the slack left by |e|.
+  FreeRange(&ra, c, 30);
+  FreeRange(&ra, d, 5);
+  REQUIRE(ra.free_ranges.size() == 1);
+  CHECK(ra.free_ranges[0] == 100);
+  CHECK(ra.used == 0);
+  CHECK(Fragmentation(ra) == 0.0f);
+}
+
+TEST_CASE("RangeAllocator alignment and growth") {
+  // Non power of two alignments (eg. a vertex stride).
+  RangeAllocator ra = CreateRangeAllocator(64);
+  uint64_t a = AllocateRange(&ra, 7);
+  uint64_t b = AllocateRange(&ra, 20, 20);
+  CHECK(a == 0);
+  CHECK(b == 20);
+  CHECK(ra.free_ranges[7] == 13);   // The padding stays free.
+
+  CHECK(AllocateRange(&ra, 40, 20) == kInvalidRange);
+  Grow(&ra, 128);
+  CHECK(ra.size == 128);
+  CHECK(ra.free_ranges.size() == 2);    // The tail got merged with the new space.
+  CHECK(ra.free_ranges[40] == 88);
+  CHECK(AllocateRange(&ra, 40, 20) == 40);
+
+  Reset(&ra);
+  CHECK(ra.used == 0);
+  CHECK(LargestFreeRange(ra) == 128);
 }
 
 constexpr uint64_t BlockSize = 64u;
@@ -53,8 +192,8 @@ TEST_CASE("BlockAllocator") {
 
   {
     // Allocate 64 blocks.
-    MemoryBlock blocks[allocator.kBlockCount] = {};
-    for (int i = 0; i < (int)allocator.kBlockCount; i++) {
+    MemoryBlock blocks[allocator.kBlocksPerChunk] = {};
+    for (int i = 0; i < (int)allocator.kBlocksPerChunk; i++) {
       auto block = Allocate(&allocator);
       REQUIRE(allocator.used_blocks == i + 1);
 
@@ -65,15 +204,18 @@ TEST_CASE("BlockAllocator") {
       REQUIRE(Valid(&blocks[i]));
     }
 
-    // Allocating another should fail.
+    // Allocating another should chain a new chunk.
     {
+      REQUIRE(allocator.chunk_count == 1);
       auto block = Allocate(&allocator);
-      REQUIRE(!Valid(&block));
-      REQUIRE(allocator.used_blocks == allocator.kBlockCount);
+      REQUIRE(Valid(&block));
+      CHECK(block.index == (int)allocator.kBlocksPerChunk);
+      REQUIRE(allocator.used_blocks == allocator.kBlocksPerChunk + 1);
+      REQUIRE(allocator.chunk_count == 2);
     }
 
     // Destroying and invalid block shouldn't have deallocated.
-    REQUIRE(allocator.used_blocks == allocator.kBlockCount);
+    REQUIRE(allocator.used_blocks == allocator.kBlocksPerChunk);
 
     // We free a couple of blocks.
     int deallocs = 0;
@@ -104,17 +246,112 @@ TEST_CASE("BlockAllocator") {
       REQUIRE(allocator.used_blocks == current_allocs + allocs);
     }
 
-    // Allocating another should fail.
+    // The chained chunk should be reused before adding another.
     {
       auto block = Allocate(&allocator);
-      REQUIRE(!Valid(&block));
-      REQUIRE(allocator.used_blocks == allocator.kBlockCount);
+      REQUIRE(Valid(&block));
+      REQUIRE(allocator.chunk_count == 2);
     }
-
   }
 
   // All blocks went out of scope, so they've should've been deallocated.
   REQUIRE(allocator.used_blocks == 0);
+  REQUIRE(allocator.high_water_mark == allocator.kBlocksPerChunk + 1);
+}
+
+TEST_CASE("BlockAllocator limits and alignment") {
+  SizedBlockAllocator<24, 64, 2> allocator;
+  static_assert(allocator.kBlockSize == 64);
+
+  std::vector<MemoryBlock> blocks;
+  for (uint64_t i = 0; i < allocator.kMaxBlocks; i++) {
+    auto block = Allocate(&allocator);
+    REQUIRE(Valid(&block));
+    REQUIRE(((uintptr_t)Data(&block) % 64) == 0);
+    blocks.push_back(std::move(block));
+  }
+
+  // Out of chunks.
+  auto block = Allocate(&allocator);
+  CHECK(!Valid(&block));
+  CHECK(allocator.chunk_count == 2);
+}
+
+TEST_CASE("BlockAllocator from multiple threads") {
+  constexpr int kThreadCount = 4;
+  constexpr int kIterations = 2000;
+  constexpr int kBlocksPerThread = 40;
+
+  SizedBlockAllocator<BlockSize> allocator;
+
+  std::vector<std::thread> threads;
+  std::atomic<int> errors = 0;
+  for (int t = 0; t < kThreadCount; t++) {
+    threads.emplace_back([&allocator, &errors, t]() {
+      std::vector<MemoryBlock> blocks(kBlocksPerThread);
+      for (int i = 0; i < kIterations; i++) {
+        auto& block = blocks[i % kBlocksPerThread];
+        block = Allocate(&allocator);
+
+        // Mark the block and verify nobody else has it.
+        uint8_t* data = Data(&block);
+        memset(data, t + 1, BlockSize);
+        for (uint64_t j = 0; j < BlockSize; j++) {
+          if (data[j] != t + 1)
+            errors++;
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  CHECK(errors == 0);
+  CHECK(allocator.used_blocks == 0);
+  CHECK(allocator.high_water_mark >= kBlocksPerThread);
+  // Reassigning a block allocates the new one before freeing the old one.
+  CHECK(allocator.high_water_mark <= kThreadCount * (kBlocksPerThread + 1));
+}
+
+struct TrackedStruct {
+  TAGGED_NEW_DELETE(kGeneral);
+
+  uint8_t data[100];
+};
+
+TEST_CASE("Memory tracking") {
+  // Other tests might be using tags, so we look at the difference against a start point.
+  MemoryTagStats start = GetMemoryStats(MemoryTag::kGeneral);
+
+  {
+    TaggedVector<uint32_t, MemoryTag::kGeneral> vec;
+    vec.reserve(100);
+
+    MemoryTagStats stats = GetMemoryStats(MemoryTag::kGeneral);
+    CHECK(stats.live_bytes - start.live_bytes == 100 * sizeof(uint32_t));
+    CHECK(stats.live_allocations - start.live_allocations == 1);
+
+    auto array = MakeTaggedArray<uint8_t, MemoryTag::kGeneral>(64);
+    CHECK(array[0] == 0);
+    CHECK(array[63] == 0);
+
+    auto tracked = std::make_unique<TrackedStruct>();
+
+    stats = GetMemoryStats(MemoryTag::kGeneral);
+    CHECK(stats.live_bytes - start.live_bytes ==
+          100 * sizeof(uint32_t) + 64 + sizeof(TrackedStruct));
+    CHECK(stats.live_allocations - start.live_allocations == 3);
+    CHECK(stats.total_allocations - start.total_allocations == 3);
+  }
+
+  MemoryTagStats end = GetMemoryStats(MemoryTag::kGeneral);
+  CHECK(end.live_bytes == start.live_bytes);
+  CHECK(end.live_allocations == start.live_allocations);
+  CHECK(end.total_allocations - start.total_allocations == 3);
+  CHECK(end.peak_bytes >= start.live_bytes + (int64_t)(100 * sizeof(uint32_t) + 64 +
+                                                       sizeof(TrackedStruct)));
 }
 
 }  // namespace
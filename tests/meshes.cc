@@ -0,0 +1,137 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/commands.h"
+#include "rothko/graphics/mesh.h"
+
+#include <third_party/catch2/catch.hpp>
+
+namespace rothko {
+namespace test {
+
+TEST_CASE("Mesh builder") {
+  Mesh mesh;
+  mesh.name = "builder";
+  mesh.vertex_type = VertexType::k3d;
+
+  Reserve(&mesh, 4, 6);
+  CHECK(mesh.index_format == IndexFormat::kUint16);
+
+  // Two quads, built one at a time.
+  for (uint32_t quad = 0; quad < 2; quad++) {
+    auto vertices = AppendVertices<Vertex3d>(&mesh, 4);
+    CHECK(vertices.base == quad * 4);
+    for (uint32_t i = 0; i < 4; i++) {
+      vertices[i].pos = {(float)quad, (float)i, 0};
+    }
+
+    auto indices = AppendIndices(&mesh, 6);
+    CHECK(indices.base == quad * 6);
+    CHECK(indices.format == IndexFormat::kUint16);
+    uint32_t i = 0;
+    for (uint32_t index : {0, 1, 2, 0, 2, 3}) {
+      indices.Set(i++, vertices.base + index);
+    }
+  }
+
+  REQUIRE(mesh.vertex_count == 8u);
+  REQUIRE(mesh.index_count == 12u);
+  CHECK(mesh.vertices.size() == 8 * sizeof(Vertex3d));
+  CHECK(mesh.indices.size() == 12 * sizeof(uint16_t));
+  CHECK(((const Vertex3d*)mesh.vertices.data())[5].pos == Vec3(1, 1, 0));
+  CHECK(GetIndex(mesh, 8) == 6u);
+  CHECK(GetIndex(mesh, 11) == 7u);
+
+  // Pushing applies the offset to both source formats.
+  Mesh::IndexType indices32[] = {0, 1, 2};
+  uint16_t indices16[] = {1, 2, 3};
+  PushIndices(&mesh, indices32, 3, 4);
+  PushIndices(&mesh, indices16, 3, 4);
+  REQUIRE(mesh.index_count == 18u);
+  CHECK(GetIndex(mesh, 12) == 4u);
+  CHECK(GetIndex(mesh, 14) == 6u);
+  CHECK(GetIndex(mesh, 15) == 5u);
+  CHECK(GetIndex(mesh, 17) == 7u);
+}
+
+TEST_CASE("Mesh builder grows geometrically") {
+  Mesh mesh;
+  mesh.vertex_type = VertexType::k3d;
+
+  // Reserving a bit more every time should not reallocate every time.
+  int reallocations = 0;
+  size_t capacity = mesh.vertices.capacity();
+  for (uint32_t i = 0; i < 1000; i++) {
+    Reserve(&mesh, 1, 3);
+    AppendVertices<Vertex3d>(&mesh, 1);
+    AppendIndices(&mesh, 3);
+
+    if (mesh.vertices.capacity() != capacity) {
+      capacity = mesh.vertices.capacity();
+      reallocations++;
+    }
+  }
+
+  CHECK(mesh.vertex_count == 1000u);
+  CHECK(mesh.index_count == 3000u);
+  CHECK(reallocations < 20);
+}
+
+TEST_CASE("Mesh builder widens 16-bit indices") {
+  Mesh mesh;
+  mesh.vertex_type = VertexType::k3d;
+
+  AppendVertices<Vertex3d>(&mesh, 3);
+  Mesh::IndexType indices[] = {0, 1, line_strip::kPrimitiveReset, 2};
+  PushIndices(&mesh, indices, 4);
+  REQUIRE(mesh.index_format == IndexFormat::kUint16);
+  CHECK(GetIndex(mesh, 2) == line_strip::GetPrimitiveReset(IndexFormat::kUint16));
+
+  // Up to the limit stays in 16 bits.
+  AppendVertices<Vertex3d>(&mesh, kMax16BitVertexCount - 3);
+  CHECK(mesh.index_format == IndexFormat::kUint16);
+
+  auto span = AppendVertices<Vertex3d>(&mesh, 1);
+  REQUIRE(mesh.index_format == IndexFormat::kUint32);
+  CHECK(mesh.indices.size() == 4 * sizeof(uint32_t));
+  CHECK(GetIndex(mesh, 1) == 1u);
+  CHECK(GetIndex(mesh, 2) == line_strip::kPrimitiveReset);
+  CHECK(GetIndex(mesh, 3) == 2u);
+
+  // New indices can address the new vertices.
+  PushIndices(&mesh, &span.base, 1);
+  CHECK(GetIndex(mesh, 4) == kMax16BitVertexCount);
+
+  // Reserving for a big mesh selects 32 bits from the start.
+  Mesh big;
+  big.vertex_type = VertexType::k3d;
+  Reserve(&big, kMax16BitVertexCount + 1, 0);
+  CHECK(big.index_format == IndexFormat::kUint32);
+}
+
+TEST_CASE("CopyIndicesWithOffset") {
+  uint16_t src16[] = {0, 1, 2, 3};
+  uint32_t src32[] = {0, 1, 2, 3};
+  uint16_t dst16[4] = {};
+  uint32_t dst32[4] = {};
+
+  CopyIndicesWithOffset(IndexFormat::kUint16, dst16, IndexFormat::kUint16, src16, 4, 0);
+  CHECK(dst16[3] == 3);
+  CopyIndicesWithOffset(IndexFormat::kUint16, dst16, IndexFormat::kUint16, src16, 4, 10);
+  CHECK(dst16[3] == 13);
+  CopyIndicesWithOffset(IndexFormat::kUint16, dst16, IndexFormat::kUint32, src32, 4, 20);
+  CHECK(dst16[0] == 20);
+  CHECK(dst16[3] == 23);
+
+  CopyIndicesWithOffset(IndexFormat::kUint32, dst32, IndexFormat::kUint16, src16, 4, 70000);
+  CHECK(dst32[0] == 70000u);
+  CHECK(dst32[3] == 70003u);
+  CopyIndicesWithOffset(IndexFormat::kUint32, dst32, IndexFormat::kUint32, src32, 4, 0);
+  CHECK(dst32[3] == 3u);
+  CopyIndicesWithOffset(IndexFormat::kUint32, dst32, IndexFormat::kUint32, src32, 3, 5);
+  CHECK(dst32[2] == 7u);
+  CHECK(dst32[3] == 3u);  // Past |count| is untouched.
+}
+
+}  // namespace test
+}  // namespace rothko
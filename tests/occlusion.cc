@@ -0,0 +1,110 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/scene/occlusion.h"
+
+#include <third_party/catch2/catch.hpp>
+
+namespace rothko {
+namespace test {
+namespace {
+
+// A 2x2 quad in the XY plane, facing +Z.
+OccluderMesh CreateQuad() {
+  OccluderMesh quad;
+  quad.positions = {{-1, -1, 0}, {1, -1, 0}, {1, 1, 0}, {-1, 1, 0}};
+  quad.indices = {0, 1, 2, 0, 2, 3};
+  return quad;
+}
+
+Bounds UnitBox() { return {{-0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, 0.5f}}; }
+
+}  // namespace
+
+TEST_CASE("Occlusion culling") {
+  // Camera at the origin looking down -Z.
+  Mat4 view_projection = Perspective(ToRadians(60.0f), 1.0f, 0.1f, 100.0f) *
+                         LookAt({0, 0, 0}, {0, 0, -1});
+
+  OccluderMesh quad = CreateQuad();
+
+  for (uint32_t workers : {1u, 3u}) {
+    OcclusionCuller culler;
+    InitOcclusionCuller(&culler, {62, 64}, workers);
+    CHECK(culler.size == Int2(64, 64));
+    CHECK(culler.levels.back().size == Int2(1, 1));
+
+    // Nothing rasterized yet.
+    BeginOcclusionFrame(&culler, view_projection);
+    CHECK(!IsOccluded(culler, UnitBox(), Translate({0, 0, -20})));
+
+    // A wall at z = -5 that covers the whole view.
+    AddOccluder(&culler, quad, Translate({0, 0, -5}) * Scale(10.0f));
+    RasterizeOccluders(&culler);
+    CHECK(culler.triangle_count == 2);
+
+    // Behind the wall.
+    CHECK(IsOccluded(culler, UnitBox(), Translate({0, 0, -20})));
+    CHECK(IsOccluded(culler, UnitBox(), Translate({3, -2, -50})));
+
+    // In front of or crossing the wall.
+    CHECK(!IsOccluded(culler, UnitBox(), Translate({0, 0, -2})));
+    CHECK(!IsOccluded(culler, UnitBox(), Translate({0, 0, -5})));
+
+    // Crossing the near plane or behind the camera.
+    CHECK(!IsOccluded(culler, UnitBox(), Translate({0, 0, 0})));
+    CHECK(!IsOccluded(culler, UnitBox(), Translate({0, 0, 10})));
+  }
+}
+
+TEST_CASE("Occlusion culling partial occluders") {
+  Mat4 view_projection = Perspective(ToRadians(60.0f), 1.0f, 0.1f, 100.0f) *
+                         LookAt({0, 0, 0}, {0, 0, -1});
+
+  OccluderMesh quad = CreateQuad();
+
+  OcclusionCuller culler;
+  InitOcclusionCuller(&culler, {128, 128});
+  BeginOcclusionFrame(&culler, view_projection);
+
+  // A 2x2 wall at z = -5, only covering the center of the view.
+  AddOccluder(&culler, quad, Translate({0, 0, -5}));
+  RasterizeOccluders(&culler);
+
+  // Small and right behind it.
+  CHECK(IsOccluded(culler, UnitBox(), Translate({0, 0, -10})));
+
+  // Peeking out to the side.
+  CHECK(!IsOccluded(culler, UnitBox(), Translate({3, 0, -10})));
+
+  // Bigger than what the wall hides.
+  CHECK(!IsOccluded(culler, UnitBox(), Translate({0, 0, -10}) * Scale(8.0f)));
+}
+
+TEST_CASE("Occlusion culling near plane clipping") {
+  Mat4 view_projection = Perspective(ToRadians(60.0f), 1.0f, 0.1f, 100.0f) *
+                         LookAt({0, 0, 0}, {0, 0, -1});
+
+  // A floor going from behind the camera into the distance. Half of it is behind the near plane.
+  OccluderMesh floor = CreateQuad();
+  Mat4 floor_transform = Translate({0, -1, -50}) * Scale(100.0f) *
+                         Rotate({1, 0, 0}, ToRadians(-90.0f));
+
+  OcclusionCuller culler;
+  InitOcclusionCuller(&culler, {64, 64});
+  BeginOcclusionFrame(&culler, view_projection);
+  AddOccluder(&culler, floor, floor_transform);
+  RasterizeOccluders(&culler);
+
+  // The clipped quad turns into more triangles.
+  CHECK(culler.triangle_count > 2);
+
+  // Under the floor.
+  CHECK(IsOccluded(culler, UnitBox(), Translate({0, -5, -20})));
+
+  // Above it.
+  CHECK(!IsOccluded(culler, UnitBox(), Translate({0, 2, -20})));
+}
+
+}  // namespace test
+}  // namespace rothko
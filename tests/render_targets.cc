@@ -0,0 +1,68 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/render_target.h"
+
+#include <third_party/catch2/catch.hpp>
+
+namespace rothko {
+namespace test {
+
+TEST_CASE("Render target render size") {
+  RenderTarget rt;
+  rt.size = {1920, 1080};
+  CHECK(GetRenderSize(rt) == Int2(1920, 1080));
+  CHECK(GetRenderUVScale(rt) == Vec2(1, 1));
+
+  rt.render_size = {960, 540};
+  CHECK(GetRenderSize(rt) == Int2(960, 540));
+  CHECK(GetRenderUVScale(rt) == Vec2(0.5f, 0.5f));
+}
+
+TEST_CASE("Dynamic resolution") {
+  DynamicResolution dr;
+  dr.cooldown_frames = 10;
+
+  SECTION("Stays when within budget") {
+    for (int i = 0; i < 100; i++) {
+      CHECK(!UpdateDynamicResolution(&dr, dr.target_frame_time));
+    }
+    CHECK(dr.scale == 1.0f);
+  }
+
+  SECTION("Waits for the cooldown") {
+    for (uint32_t i = 0; i < dr.cooldown_frames - 1; i++) {
+      CHECK(!UpdateDynamicResolution(&dr, 2 * dr.target_frame_time));
+    }
+    CHECK(UpdateDynamicResolution(&dr, 2 * dr.target_frame_time));
+    CHECK(dr.scale < 1.0f);
+  }
+
+  SECTION("Goes down when slow and back up when fast") {
+    // Twice the budget needs around 1 / sqrt(2) of the resolution.
+    for (int i = 0; i < 100; i++) {
+      UpdateDynamicResolution(&dr, 2 * dr.target_frame_time);
+    }
+    CHECK(dr.scale <= 0.75f);
+    CHECK(dr.scale >= dr.min_scale);
+
+    Int2 scaled = GetScaledSize(dr, {1920, 1080});
+    CHECK(scaled.x < 1920);
+    CHECK(scaled.y < 1080);
+
+    for (int i = 0; i < 1000; i++) {
+      UpdateDynamicResolution(&dr, 0.5f * dr.target_frame_time);
+    }
+    CHECK(dr.scale == Approx(dr.max_scale));
+  }
+
+  SECTION("Respects the minimum") {
+    for (int i = 0; i < 1000; i++) {
+      UpdateDynamicResolution(&dr, 10 * dr.target_frame_time);
+    }
+    CHECK(dr.scale == Approx(dr.min_scale));
+  }
+}
+
+}  // namespace test
+}  // namespace rothko
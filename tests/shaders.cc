@@ -0,0 +1,48 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/shader_permutations.h"
+
+#include <third_party/catch2/catch.hpp>
+
+namespace rothko {
+namespace test {
+namespace {
+
+ShaderPermutations CreatePermutations() {
+  ShaderPermutations permutations;
+  permutations.config.name = "model";
+  permutations.keywords = {"USE_NORMAL_MAP", "USE_FOG", "USE_SKINNING"};
+  return permutations;
+}
+
+}  // namespace
+
+TEST_CASE("Shader permutations") {
+  ShaderPermutations permutations = CreatePermutations();
+  REQUIRE(InitShaderPermutations(&permutations));
+  CHECK(permutations.variants.size() == 8);
+  CHECK(permutations.failed.size() == 8);
+
+  SECTION("Keys") {
+    CHECK(GetShaderKey(permutations, "USE_NORMAL_MAP") == 1);
+    CHECK(GetShaderKey(permutations, "USE_FOG") == 2);
+    CHECK(GetShaderKey(permutations, "USE_SKINNING") == 4);
+  }
+
+  SECTION("Names") {
+    CHECK(GetVariantName(permutations, 0) == "model[]");
+    CHECK(GetVariantName(permutations, 1) == "model[USE_NORMAL_MAP]");
+    CHECK(GetVariantName(permutations, 6) == "model[USE_FOG|USE_SKINNING]");
+    CHECK(GetVariantName(permutations, 7) == "model[USE_NORMAL_MAP|USE_FOG|USE_SKINNING]");
+  }
+
+  SECTION("Defines") {
+    CHECK(AddKeywordDefines(permutations, 0, "void main() {}") == "void main() {}");
+    CHECK(AddKeywordDefines(permutations, 5, "void main() {}") ==
+          "#define USE_NORMAL_MAP 1\n#define USE_SKINNING 1\nvoid main() {}");
+  }
+}
+
+}  // namespace test
+}  // namespace rothko
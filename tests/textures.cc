@@ -0,0 +1,430 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include "rothko/graphics/mesh.h"
+#include "rothko/graphics/texture.h"
+#include "rothko/graphics/texture_atlas.h"
+#include "rothko/graphics/texture_compression.h"
+#include "rothko/graphics/texture_mipmaps.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <third_party/catch2/catch.hpp>
+#include <third_party/stb/stb_image_write.h>
+
+namespace rothko {
+namespace test {
+namespace {
+
+// Reference decoders ------------------------------------------------------------------------------
+
+void Decode565(uint16_t c, int* out) {
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  out[0] = (r << 3) | (r >> 2);
+  out[1] = (g << 2) | (g >> 4);
+  out[2] = (b << 3) | (b >> 2);
+}
+
+// Returns RGB of the 16 pixels (4 color mode only).
+void DecodeBC1(const uint8_t* block, int out[16][3]) {
+  uint16_t c0 = block[0] | (block[1] << 8);
+  uint16_t c1 = block[2] | (block[3] << 8);
+  int palette[4][3];
+  Decode565(c0, palette[0]);
+  Decode565(c1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+
+  uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+  for (int i = 0; i < 16; i++) {
+    memcpy(out[i], palette[(indices >> (2 * i)) & 3], sizeof(palette[0]));
+  }
+}
+
+void DecodeBC4(const uint8_t* block, int out[16]) {
+  int r0 = block[0], r1 = block[1];
+  int palette[8] = {r0, r1};
+  for (int i = 1; i < 7; i++) {
+    palette[i + 1] = r0 > r1 ? ((7 - i) * r0 + i * r1) / 7 : 0;
+  }
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 6; i++) {
+    bits |= (uint64_t)block[2 + i] << (8 * i);
+  }
+  for (int i = 0; i < 16; i++) {
+    out[i] = palette[(bits >> (3 * i)) & 7];
+  }
+}
+
+uint32_t ReadBits(const uint8_t* data, uint32_t* pos, uint32_t count) {
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < count; i++, (*pos)++) {
+    value |= ((data[*pos >> 3] >> (*pos & 7)) & 1) << i;
+  }
+  return value;
+}
+
+// Mode 6 only.
+bool DecodeBC7(const uint8_t* block, int out[16][4]) {
+  uint32_t pos = 0;
+  if (ReadBits(block, &pos, 7) != (1 << 6))
+    return false;
+
+  int e[2][4];
+  for (int c = 0; c < 4; c++) {
+    e[0][c] = ReadBits(block, &pos, 7);
+    e[1][c] = ReadBits(block, &pos, 7);
+  }
+  for (int i = 0; i < 2; i++) {
+    int p = ReadBits(block, &pos, 1);
+    for (int c = 0; c < 4; c++) {
+      e[i][c] = (e[i][c] << 1) | p;
+    }
+  }
+
+  constexpr int kWeights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+  for (int i = 0; i < 16; i++) {
+    int w = kWeights[ReadBits(block, &pos, i == 0 ? 3 : 4)];
+    for (int c = 0; c < 4; c++) {
+      out[i][c] = ((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6;
+    }
+  }
+  return true;
+}
+
+int Abs(int v) { return v < 0 ? -v : v; }
+
+// A gradient along a line in color space, which is what a single endpoint pair can represent.
+void GradientBlock(uint8_t rgba[64]) {
+  for (int i = 0; i < 16; i++) {
+    uint8_t* pixel = rgba + 4 * i;
+    pixel[0] = (uint8_t)(40 + 12 * i);
+    pixel[1] = (uint8_t)(200 - 9 * i);
+    pixel[2] = (uint8_t)(30 + 4 * i);
+    pixel[3] = (uint8_t)(255 - 6 * i);
+  }
+}
+
+// Tests -------------------------------------------------------------------------------------------
+
+TEST_CASE("Texture data sizes and mip levels") {
+  CHECK(DataSize(TextureType::kRGBA, {16, 8}) == 16 * 8 * 4);
+  CHECK(DataSize(TextureType::kR8, {3, 3}) == 9);
+  CHECK(DataSize(TextureType::kBC1, {16, 8}) == 4 * 2 * 8);
+  CHECK(DataSize(TextureType::kBC7, {5, 5}) == 2 * 2 * 16);   // Partial blocks round up.
+  CHECK(DataSize(TextureType::kBC4, {1, 1}) == 8);
+
+  CHECK(MaxMipLevels({1, 1}) == 1);
+  CHECK(MaxMipLevels({256, 16}) == 9);
+  CHECK(MaxMipLevels({5, 3}) == 3);
+
+  Texture texture = {};
+  texture.size = {8, 4};
+  texture.type = TextureType::kRGBA;
+  texture.mip_levels = 4;
+
+  TextureMipLevel level = GetMipLevel(texture, 0);
+  CHECK(level.size == Int2(8, 4));
+  CHECK(level.offset == 0);
+  CHECK(level.data_size == 128);
+
+  level = GetMipLevel(texture, 2);
+  CHECK(level.size == Int2(2, 1));
+  CHECK(level.offset == 128 + 32);
+  CHECK(level.data_size == 8);
+
+  level = GetMipLevel(texture, 3);
+  CHECK(level.size == Int2(1, 1));
+  CHECK(level.offset == 128 + 32 + 8);
+  CHECK(DataSize(texture) == 128 + 32 + 8 + 4);
+}
+
+TEST_CASE("BC1 encoding") {
+  uint8_t rgba[64];
+  uint8_t block[8];
+  int decoded[16][3];
+
+  SECTION("Solid colors representable in 565 are exact") {
+    for (int i = 0; i < 16; i++) {
+      rgba[i * 4 + 0] = 255;
+      rgba[i * 4 + 1] = 0;
+      rgba[i * 4 + 2] = 132;   // 16 in 5 bits.
+      rgba[i * 4 + 3] = 255;
+    }
+    EncodeBC1Block(rgba, block);
+    DecodeBC1(block, decoded);
+    for (int i = 0; i < 16; i++) {
+      CHECK(decoded[i][0] == 255);
+      CHECK(decoded[i][1] == 0);
+      CHECK(decoded[i][2] == 132);
+    }
+  }
+
+  SECTION("Gradients stay close") {
+    GradientBlock(rgba);
+    EncodeBC1Block(rgba, block);
+    DecodeBC1(block, decoded);
+    for (int i = 0; i < 16; i++) {
+      for (int c = 0; c < 3; c++) {
+        // Half a step of the 4 color palette (red covers 180 values) plus 565 rounding.
+        CHECK(Abs(decoded[i][c] - rgba[i * 4 + c]) <= 34);
+      }
+    }
+  }
+}
+
+TEST_CASE("BC4 encoding") {
+  uint8_t values[16];
+  uint8_t block[8];
+  int decoded[16];
+
+  for (int i = 0; i < 16; i++) {
+    values[i] = (uint8_t)(i * 17);
+  }
+  EncodeBC4Block(values, block);
+  DecodeBC4(block, decoded);
+
+  // The extremes are the endpoints, so they're exact.
+  CHECK(decoded[0] == 0);
+  CHECK(decoded[15] == 255);
+  for (int i = 0; i < 16; i++) {
+    CHECK(Abs(decoded[i] - values[i]) <= 19);   // Half a step of the 8 value palette.
+  }
+}
+
+TEST_CASE("BC7 encoding") {
+  uint8_t rgba[64];
+  uint8_t block[16];
+  int decoded[16][4];
+
+  SECTION("Solid color") {
+    for (int i = 0; i < 16; i++) {
+      rgba[i * 4 + 0] = 10;
+      rgba[i * 4 + 1] = 77;
+      rgba[i * 4 + 2] = 200;
+      rgba[i * 4 + 3] = 128;
+    }
+    EncodeBC7Block(rgba, block);
+    REQUIRE(DecodeBC7(block, decoded));
+    for (int i = 0; i < 16; i++) {
+      for (int c = 0; c < 4; c++) {
+        CHECK(Abs(decoded[i][c] - rgba[i * 4 + c]) <= 1);
+      }
+    }
+  }
+
+  SECTION("Gradients are better than BC1") {
+    GradientBlock(rgba);
+    EncodeBC7Block(rgba, block);
+    REQUIRE(DecodeBC7(block, decoded));
+    for (int i = 0; i < 16; i++) {
+      for (int c = 0; c < 4; c++) {
+        CHECK(Abs(decoded[i][c] - rgba[i * 4 + c]) <= 8);
+      }
+    }
+  }
+}
+
+TEST_CASE("ConvertTexture") {
+  Texture texture = {};
+  texture.name = "test";
+  texture.size = {6, 6};
+  texture.type = TextureType::kRGBA;
+  texture.mip_levels = 3;   // 6x6, 3x3, 1x1.
+  texture.data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(DataSize(texture));
+  memset(texture.data.get(), 0xff, DataSize(texture));
+
+  REQUIRE(ConvertTexture(&texture, TextureType::kBC3));
+  CHECK(texture.type == TextureType::kBC3);
+  CHECK(DataSize(texture) == (4 + 1 + 1) * 16);
+}
+
+TEST_CASE("GenerateMipmaps") {
+  // Checkerboard of black and white pixels, half transparent.
+  Texture texture = {};
+  texture.name = "test";
+  texture.size = {4, 2};
+  texture.type = TextureType::kRGBA;
+  texture.data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(DataSize(texture));
+  for (int i = 0; i < 8; i++) {
+    uint8_t value = ((i + i / 4) % 2) ? 255 : 0;
+    memset(texture.data.get() + i * 4, value, 3);
+    texture.data[i * 4 + 3] = 128;
+  }
+
+  SECTION("sRGB averages in linear space") {
+    REQUIRE(GenerateMipmaps(&texture, ColorSpace::kSRGB));
+    REQUIRE(texture.mip_levels == 3);   // 4x2, 2x1, 1x1.
+    CHECK(DataSize(texture) == (8 + 2 + 1) * 4);
+
+    // Half the light is 188 in sRGB, not 128.
+    for (uint32_t level = 1; level < 3; level++) {
+      TextureMipLevel mip = GetMipLevel(texture, level);
+      uint8_t* pixel = texture.data.get() + mip.offset;
+      CHECK(Abs(pixel[0] - 188) <= 1);
+      CHECK(Abs(pixel[1] - 188) <= 1);
+      CHECK(Abs(pixel[2] - 188) <= 1);
+      CHECK(pixel[3] == 128);
+    }
+  }
+
+  SECTION("Linear") {
+    REQUIRE(GenerateMipmaps(&texture, ColorSpace::kLinear));
+    TextureMipLevel mip = GetMipLevel(texture, 2);
+    uint8_t* pixel = texture.data.get() + mip.offset;
+    CHECK(Abs(pixel[0] - 128) <= 1);
+    CHECK(pixel[3] == 128);
+  }
+
+  SECTION("Single channel and odd sizes") {
+    Texture r8 = {};
+    r8.name = "r8";
+    r8.size = {3, 3};
+    r8.type = TextureType::kR8;
+    r8.data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(DataSize(r8));
+    memset(r8.data.get(), 200, DataSize(r8));
+
+    REQUIRE(GenerateMipmaps(&r8));
+    REQUIRE(r8.mip_levels == 2);
+    CHECK(r8.data[9] == 200);
+  }
+}
+
+TEST_CASE("STBLoadTexture mipmaps") {
+  const std::string kPath = "rothko_test_texture.png";
+
+  uint8_t pixels[8 * 4 * 4];
+  memset(pixels, 100, sizeof(pixels));
+  REQUIRE(stbi_write_png(kPath.c_str(), 8, 4, 4, pixels, 8 * 4));
+
+  Texture texture;
+  REQUIRE(STBLoadTexture(kPath, TextureType::kRGBA, &texture));
+  CHECK(texture.size == Int2(8, 4));
+  CHECK(texture.mip_levels == 4);
+
+  // Opting out keeps only the first level, also when reloading.
+  Texture no_mipmaps;
+  no_mipmaps.mipmaps = 0;
+  REQUIRE(STBLoadTexture(kPath, TextureType::kRGBA, &no_mipmaps));
+  CHECK(no_mipmaps.mipmaps == 0);
+  CHECK(no_mipmaps.mip_levels == 1);
+  CHECK(DataSize(no_mipmaps) == 8 * 4 * 4);
+
+  no_mipmaps.data.reset();
+  REQUIRE(no_mipmaps.reload_cpu_data(&no_mipmaps));
+  CHECK(no_mipmaps.data[DataSize(no_mipmaps) - 1] == 100);
+
+  remove(kPath.c_str());
+}
+
+std::unique_ptr<Texture> CreateSolidTexture(Int2 size, uint8_t value, TextureWrapMode wrap) {
+  auto texture = std::make_unique<Texture>();
+  texture->name = "solid";
+  texture->size = size;
+  texture->type = TextureType::kRGBA;
+  texture->wrap_mode_u = wrap;
+  texture->wrap_mode_v = wrap;
+  texture->data = MakeTaggedArray<uint8_t, MemoryTag::kGraphics>(DataSize(*texture));
+  memset(texture->data.get(), value, DataSize(*texture));
+  return texture;
+}
+
+TEST_CASE("PackTextures") {
+  std::vector<std::unique_ptr<Texture>> owned;
+  owned.push_back(CreateSolidTexture({16, 16}, 10, TextureWrapMode::kClampToEdge));
+  owned.push_back(CreateSolidTexture({8, 32}, 20, TextureWrapMode::kClampToEdge));
+  owned.push_back(CreateSolidTexture({512, 512}, 30, TextureWrapMode::kRepeat));
+  owned.push_back(CreateSolidTexture({512, 512}, 40, TextureWrapMode::kRepeat));
+  owned.push_back(CreateSolidTexture({256, 512}, 50, TextureWrapMode::kRepeat));
+
+  std::vector<Texture*> textures;
+  for (auto& texture : owned) {
+    textures.push_back(texture.get());
+  }
+
+  TexturePackOptions options = {};
+  options.atlas_size = {64, 64};
+  options.padding = 1;
+
+  PackedTextures packed;
+  REQUIRE(PackTextures(textures, &packed, options));
+  REQUIRE(packed.textures.size() == 2u);
+  REQUIRE(packed.regions.size() == textures.size());
+
+  // The small ones go into an atlas, trimmed to the tallest shelf (32 + 2 padding, rounded to 4).
+  Texture* atlas = packed.regions[0].texture;
+  REQUIRE(atlas == packed.regions[1].texture);
+  CHECK(!IsArray(*atlas));
+  CHECK(atlas->size == Int2(64, 36));
+
+  for (uint32_t i = 0; i < 2; i++) {
+    const TextureRegion& region = packed.regions[i];
+    Vec2 corner = RemapUV(region, {1.0f, 1.0f});
+    int x = (int)(region.uv_offset.x * atlas->size.x);
+    int y = (int)(region.uv_offset.y * atlas->size.y);
+    CHECK((int)(corner.x * atlas->size.x + 0.5f) == x + textures[i]->size.x);
+    CHECK((int)(corner.y * atlas->size.y + 0.5f) == y + textures[i]->size.y);
+
+    // Corners and padding have the texture's color.
+    CHECK(atlas->data[(y * atlas->size.x + x) * 4] == textures[i]->data[0]);
+    CHECK(atlas->data[((y - 1) * atlas->size.x + (x - 1)) * 4] == textures[i]->data[0]);
+  }
+
+  // Same size repeating textures become an array.
+  Texture* array = packed.regions[2].texture;
+  REQUIRE(array == packed.regions[3].texture);
+  REQUIRE(IsArray(*array));
+  CHECK(array->layers == 2);
+  CHECK(packed.regions[2].layer == 0);
+  CHECK(packed.regions[3].layer == 1);
+  CHECK(array->data[GetMipLevel(*array, 0).layer_size] == 40);
+
+  // Nothing to group with.
+  CHECK(packed.regions[4].texture == textures[4]);
+
+  // Different sampling cannot share an atlas.
+  textures[1]->min_filter = TextureFilterMode::kNearest;
+  options.create_arrays = false;
+  REQUIRE(PackTextures(textures, &packed, options));
+  CHECK(packed.textures.empty());
+  for (uint32_t i = 0; i < textures.size(); i++) {
+    CHECK(packed.regions[i].texture == textures[i]);
+  }
+}
+
+TEST_CASE("RemapUVs") {
+  TextureRegion region = {};
+  region.uv_offset = {0.5f, 0.25f};
+  region.uv_scale = {0.5f, 0.25f};
+
+  Mesh mesh = {};
+  mesh.vertex_type = VertexType::k3dUV;
+  Vertex3dUV vertices[2] = {{{0, 0, 0}, {0.0f, 0.0f}}, {{1, 1, 1}, {1.0f, 0.5f}}};
+  mesh.vertices.resize(sizeof(vertices));
+  memcpy(mesh.vertices.data(), vertices, sizeof(vertices));
+  mesh.vertex_count = 2;
+
+  REQUIRE(RemapUVs(&mesh, region));
+  memcpy(vertices, mesh.vertices.data(), sizeof(vertices));
+  CHECK(vertices[0].uv == Vec2(0.5f, 0.25f));
+  CHECK(vertices[1].uv == Vec2(1.0f, 0.375f));
+  CHECK(vertices[1].pos == Vec3(1, 1, 1));
+
+  // Quantized UVs only touch the dequantization.
+  Mesh quantized = {};
+  quantized.vertex_type = VertexType::kQuantized3dNormalUV;
+  quantized.dequantization.uv_offset = {0.0f, 0.5f};
+  quantized.dequantization.uv_scale = {1.0f, 0.5f};
+
+  REQUIRE(RemapUVs(&quantized, region));
+  CHECK(quantized.dequantization.uv_offset == Vec2(0.5f, 0.375f));
+  CHECK(quantized.dequantization.uv_scale == Vec2(0.5f, 0.125f));
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace rothko
@@ -0,0 +1,91 @@
+// Copyright 2019, Cristián Donoso.
+// This code has a BSD license. See LICENSE.
+
+#include <third_party/catch2/catch.hpp>
+
+#include "rothko/graphics/vertices.h"
+
+namespace rothko {
+namespace test {
+namespace {
+
+void VerifyLayout(VertexType type) {
+  VertexLayout layout = GetVertexLayout(type);
+  INFO("Vertex Type: " << ToString(type));
+  CHECK(layout.stride == ToSize(type));
+
+  // Offsets are contiguous and follow the bit order.
+  uint32_t offset = 0;
+  uint32_t prev_bit = 0;
+  for (uint32_t i = 0; i < layout.count; i++) {
+    CHECK(layout.attributes[i].offset == offset);
+    CHECK((uint32_t)layout.attributes[i].component > prev_bit);
+    prev_bit = (uint32_t)layout.attributes[i].component;
+    offset += ToSize(layout.attributes[i].component);
+  }
+}
+
+TEST_CASE("Vertex layouts") {
+  VerifyLayout(VertexType::k2dUVColor);
+  VerifyLayout(VertexType::k3d);
+  VerifyLayout(VertexType::k3dColor);
+  VerifyLayout(VertexType::k3dNormal);
+  VerifyLayout(VertexType::k3dNormalUV);
+  VerifyLayout(VertexType::k3dUV);
+  VerifyLayout(VertexType::k3dUVColor);
+  VerifyLayout(VertexType::k3dNormalTangentUV);
+  VerifyLayout(VertexType::kQuantized3dNormalUV);
+  VerifyLayout(VertexType::kQuantized3dNormalTangentUV);
+
+  VertexLayout layout = GetVertexLayout(VertexType::kQuantized3dNormalTangentUV);
+  REQUIRE(layout.count == 4);
+  CHECK(layout.attributes[0].component == VertComponent::kPos3d_short);
+  CHECK(layout.attributes[1].component == VertComponent::kNormal_oct);
+  CHECK(layout.attributes[2].component == VertComponent::kTangent_byte);
+  CHECK(layout.attributes[3].component == VertComponent::kUV0_short);
+  CHECK(layout.attributes[3].offset == offsetof(VertexQuantized3dNormalTangentUV, uv));
+}
+
+TEST_CASE("Quantization") {
+  CHECK(QuantizeUnorm16(0.0f) == 0);
+  CHECK(QuantizeUnorm16(1.0f) == 65535);
+  CHECK(QuantizeUnorm16(2.0f) == 65535);   // Clamped.
+  CHECK(QuantizeSnorm16(-1.0f) == -32767);
+  CHECK(QuantizeSnorm16(1.0f) == 32767);
+  CHECK(QuantizeSnorm8(-1.0f) == -127);
+
+  CHECK(DequantizeUnorm16(QuantizeUnorm16(0.25f)) == Approx(0.25f).margin(1.0f / 65535));
+  CHECK(DequantizeSnorm16(QuantizeSnorm16(-0.5f)) == Approx(-0.5f).margin(1.0f / 32767));
+}
+
+TEST_CASE("Octahedral encoding") {
+  Vec3 normals[] = {
+    {0, 0, 1},
+    {0, 0, -1},
+    {1, 0, 0},
+    {0, -1, 0},
+    Normalize(Vec3{1, 2, 3}),
+    Normalize(Vec3{-1, 0.5f, -3}),
+    Normalize(Vec3{0.3f, -0.7f, -0.1f}),
+  };
+
+  for (Vec3 normal : normals) {
+    Vec2 encoded = OctEncode(normal);
+    CHECK(encoded.x >= -1.0f);
+    CHECK(encoded.x <= 1.0f);
+    CHECK(encoded.y >= -1.0f);
+    CHECK(encoded.y <= 1.0f);
+
+    // Round trip through the 16-bit storage.
+    Vec2 stored = {DequantizeSnorm16(QuantizeSnorm16(encoded.x)),
+                   DequantizeSnorm16(QuantizeSnorm16(encoded.y))};
+    Vec3 decoded = OctDecode(stored);
+    CHECK(decoded.x == Approx(normal.x).margin(0.001f));
+    CHECK(decoded.y == Approx(normal.y).margin(0.001f));
+    CHECK(decoded.z == Approx(normal.z).margin(0.001f));
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace rothko